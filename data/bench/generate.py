@@ -0,0 +1,137 @@
+#!/usr/bin/env python
+#
+# Generates the procedural parts of the benchmark scenes: the hair strands
+# in 'hair.txt' and the scene 'many-lights.xml'. Both use fixed random
+# seeds, hence running this script reproduces the files in the repository.
+#
+# Usage: python generate.py   (from within data/bench)
+
+import math, random
+
+def sensor(origin, target):
+    return '''	<sensor type="perspective">
+		<float name="fov" value="40"/>
+		<transform name="toWorld">
+			<lookat origin="%s" target="%s" up="0, 1, 0"/>
+		</transform>
+
+		<sampler type="deterministic">
+			<integer name="sampleCount" value="$spp"/>
+		</sampler>
+
+		<film type="hdrfilm">
+			<integer name="width" value="320"/>
+			<integer name="height" value="240"/>
+			<string name="componentFormat" value="float32"/>
+			<boolean name="banner" value="false"/>
+			<boolean name="attachLog" value="false"/>
+		</film>
+	</sensor>''' % (origin, target)
+
+def header(comment, spp):
+    return '''<?xml version="1.0" encoding="utf-8"?>
+
+<!-- %s -->
+<scene version="0.5.0">
+	<default name="spp" value="%i"/>
+''' % (comment, spp)
+
+def diffuse(color):
+    return '''		<bsdf type="diffuse">
+			<rgb name="reflectance" value="%s"/>
+		</bsdf>''' % color
+
+def generateHair(filename):
+    """900 strands with 6 vertices each on the upper cap of a sphere,
+       which bend downwards with a little random jitter"""
+    rnd = random.Random(1234)
+    lines = []
+    for i in range(900):
+        u, v = rnd.random(), rnd.random()
+        theta = math.acos(1 - 0.9 * u)
+        phi = 2 * math.pi * v
+        n = (math.sin(theta)*math.cos(phi), math.cos(theta), math.sin(theta)*math.sin(phi))
+        p = [0.5*n[0], 0.5*n[1], 0.5*n[2]]
+        d = list(n)
+        for k in range(6):
+            lines.append("%.4f %.4f %.4f" % tuple(p))
+            d = [d[0] + rnd.uniform(-0.15, 0.15), d[1] - 0.35, d[2] + rnd.uniform(-0.15, 0.15)]
+            l = math.sqrt(sum(c*c for c in d))
+            d = [c / l for c in d]
+            p = [p[j] + 0.12 * d[j] for j in range(3)]
+        lines.append("")
+    with open(filename, "w") as f:
+        f.write("\n".join(lines))
+
+def generateManyLights(filename):
+    """A grid of cubes and spheres lit by 96 small spherical area
+       lights and 32 point lights at random positions"""
+    s = header("Many lights: 96 small area lights and 32 point lights above a field of objects (emitter sampling)", 32)
+    s += '''	<integrator type="path">
+		<integer name="maxDepth" value="6"/>
+	</integrator>
+
+''' + sensor("0, 4, 7", "0, 0, 0") + '''
+
+	<shape type="rectangle">
+		<transform name="toWorld">
+			<scale value="8"/>
+			<rotate x="1" angle="-90"/>
+		</transform>
+''' + diffuse("0.6, 0.6, 0.6") + '''
+	</shape>
+'''
+    rnd = random.Random(42)
+    for i in range(-3, 4):
+        for j in range(-3, 4):
+            if (i + j) % 2 == 0:
+                s += '''
+	<shape type="cube">
+		<transform name="toWorld">
+			<scale value="0.25"/>
+			<rotate y="1" angle="%i"/>
+			<translate x="%.2f" y="0.25" z="%.2f"/>
+		</transform>
+''' % ((i*7 + j*13) % 90, i*1.1, j*1.1) + diffuse("0.7, 0.7, 0.7") + '''
+	</shape>
+'''
+            else:
+                s += '''
+	<shape type="sphere">
+		<point name="center" x="%.2f" y="0.3" z="%.2f"/>
+		<float name="radius" value="0.3"/>
+		<bsdf type="roughplastic">
+			<float name="alpha" value="0.1"/>
+		</bsdf>
+	</shape>
+''' % (i*1.1, j*1.1)
+    for k in range(96):
+        x, z = rnd.uniform(-4, 4), rnd.uniform(-4, 4)
+        y = rnd.uniform(1.0, 2.5)
+        c = [rnd.uniform(0.3, 1.0) for _ in range(3)]
+        s += '''
+	<shape type="sphere">
+		<point name="center" x="%.3f" y="%.3f" z="%.3f"/>
+		<float name="radius" value="0.04"/>
+		<emitter type="area">
+			<rgb name="radiance" value="%.2f, %.2f, %.2f"/>
+		</emitter>
+	</shape>
+''' % (x, y, z, c[0]*60, c[1]*60, c[2]*60)
+    for k in range(32):
+        x, z = rnd.uniform(-4, 4), rnd.uniform(-4, 4)
+        y = rnd.uniform(0.8, 2.0)
+        c = [rnd.uniform(0.3, 1.0) for _ in range(3)]
+        s += '''
+	<emitter type="point">
+		<point name="position" x="%.3f" y="%.3f" z="%.3f"/>
+		<rgb name="intensity" value="%.3f, %.3f, %.3f"/>
+	</emitter>
+''' % (x, y, z, c[0]*0.8, c[1]*0.8, c[2]*0.8)
+    s += "</scene>\n"
+    with open(filename, "w") as f:
+        f.write(s)
+
+if __name__ == "__main__":
+    generateHair("hair.txt")
+    generateManyLights("many-lights.xml")
@@ -130,6 +130,12 @@ if (MTS_NOSHADINGNORMAL)
   add_definitions(-DMTS_NOSHADINGNORMAL)
 endif()
 
+# Hierarchical profiler of the rendering hot paths
+option(MTS_PROFILER "Record a per-category time breakdown of rendering" OFF)
+if (MTS_PROFILER)
+  add_definitions(-DMTS_ENABLE_PROFILER)
+endif()
+
 # Use CUDA as an option
 option(MTS_CUDA "Cuda use for reconstruction" OFF)
 if (MTS_CUDA)
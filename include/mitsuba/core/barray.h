@@ -24,6 +24,57 @@
 
 MTS_NAMESPACE_BEGIN
 
+/**
+ * \brief Compute the component-wise minimum, maximum, and average of
+ * a 2D array of values stored in row-major order
+ *
+ * Assumes that \c Value is some kind of \c TVector or \c TSpectrum instance.
+ */
+template <typename Value> void computeArrayStatistics(const Value *data,
+        const Vector2i &size, Value &min_, Value &max_, Value &avg_) {
+    typedef typename Value::Scalar Scalar;
+
+    /* Rows are processed in parallel; the statistics of each row
+       are reduced afterwards */
+    std::vector<Value>
+        rowMin(size.y, Value(+std::numeric_limits<Scalar>::infinity())),
+        rowMax(size.y, Value(-std::numeric_limits<Scalar>::infinity())),
+        rowSum(size.y, Value((Scalar) 0));
+
+    #if defined(MTS_OPENMP)
+        #pragma omp parallel for if (size.y >= 64)
+    #endif
+    for (int y=0; y<size.y; ++y) {
+        const Value *row = data + (size_t) y * (size_t) size.x;
+        Value &min = rowMin[y], &max = rowMax[y], &sum = rowSum[y];
+
+        for (int x=0; x<size.x; ++x) {
+            const Value &value = row[x];
+            for (int i=0; i<Value::dim; ++i) {
+                min[i]  = std::min(min[i], value[i]);
+                max[i]  = std::max(max[i], value[i]);
+                sum[i] += value[i];
+            }
+        }
+    }
+
+    Value
+        min(+std::numeric_limits<Scalar>::infinity()),
+        max(-std::numeric_limits<Scalar>::infinity()),
+        avg((Scalar) 0);
+
+    for (int y=0; y<size.y; ++y) {
+        for (int i=0; i<Value::dim; ++i) {
+            min[i]  = std::min(min[i], rowMin[y][i]);
+            max[i]  = std::max(max[i], rowMax[y][i]);
+            avg[i] += rowSum[y][i];
+        }
+    }
+    min_ = min;
+    max_ = max;
+    avg_ = avg / (Scalar) ((size_t) size.x * (size_t) size.y);
+}
+
 /**
  * \brief Blocked generic 2D array data type
  *
@@ -86,9 +137,14 @@ public:
      * \remark This function performs type casts when <tt>Value != AltValue</tt>
      */
     template <typename AltValue> void init(const AltValue *data) {
-        for (int y=0; y<m_size.y; ++y)
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for if (m_size.y >= 64)
+        #endif
+        for (int y=0; y<m_size.y; ++y) {
+            const AltValue *row = data + (size_t) y * (size_t) m_size.x;
             for (int x=0; x<m_size.x; ++x)
-                    (*this)(x, y) = Value(*data++);
+                (*this)(x, y) = Value(row[x]);
+        }
     }
 
     /**
@@ -101,28 +157,9 @@ public:
      * \remark This function performs type casts when <tt>Value != AltValue</tt>
      */
     template <typename AltValue> void init(const AltValue *data,
-            AltValue &min_, AltValue &max_, AltValue &avg_) {
-        typedef typename AltValue::Scalar Scalar;
-
-        AltValue
-            min(+std::numeric_limits<Scalar>::infinity()),
-            max(-std::numeric_limits<Scalar>::infinity()),
-            avg((Scalar) 0);
-
-        for (int y=0; y<m_size.y; ++y) {
-            for (int x=0; x<m_size.x; ++x) {
-                const AltValue &value = *data++;
-                for (int i=0; i<AltValue::dim; ++i) {
-                    min[i]  = std::min(min[i], value[i]);
-                    max[i]  = std::max(max[i], value[i]);
-                    avg[i] += value[i];
-                }
-                (*this)(x, y) = Value(value);
-            }
-        }
-        min_ = min;
-        max_ = max;
-        avg_ = avg / (Scalar) (m_size.x * m_size.y);
+            AltValue &min, AltValue &max, AltValue &avg) {
+        init(data);
+        computeArrayStatistics(data, m_size, min, max, avg);
     }
 
     /**
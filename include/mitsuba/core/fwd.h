@@ -58,6 +58,7 @@ class Object;
 class ParallelProcess;
 class Plugin;
 class PluginManager;
+class Profiler;
 class ProgressReporter;
 class Properties;
 struct Version;
@@ -65,6 +66,7 @@ class Random;
 template <typename PointType, typename VectorType> struct TRay;
 struct RayDifferential;
 class RemoteProcess;
+class ResourceCache;
 class RemoteWorker;
 class RemoteWorkerReader;
 class Scheduler;
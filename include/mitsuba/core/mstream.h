@@ -75,6 +75,30 @@ public:
     /// Set size and position to zero without changing the underlying buffer
     void reset();
 
+    /**
+     * \brief Ensure that the underlying buffer can hold at least
+     * \c size bytes without further reallocations
+     *
+     * Useful to avoid repeated copies when the final amount of data
+     * is known in advance. Does not change the size of the stream.
+     */
+    void reserve(size_t size);
+
+    /// Return the capacity of the underlying buffer
+    inline size_t getCapacity() const { return m_capacity; }
+
+    /**
+     * \brief Return a memory stream containing the next \c size
+     * bytes of \c stream and advance its position accordingly
+     *
+     * When \c stream is itself a memory stream, the returned stream
+     * refers to its buffer instead of copying the data and therefore
+     * must not outlive it. Otherwise, the data is copied.
+     *
+     * \remark This function is not available in the python bindings
+     */
+    static ref<MemoryStream> readView(Stream *stream, size_t size);
+
     //! @}
     // =============================================================
 
@@ -35,6 +35,13 @@ MTS_NAMESPACE_BEGIN
  * threads. These are internally realized via atomic compare and exchange
  * operations, meaning that no lock must be acquired.
  *
+ * Items are never removed while the list exists. A fully initialized item is
+ * published by a single compare and exchange (which acts as a full memory
+ * barrier), hence readers can traverse the list concurrently with writers
+ * and will always observe a consistent (though possibly slightly outdated)
+ * snapshot. No further synchronization such as epoch-based reclamation is
+ * required.
+ *
  * \ingroup libcore
  */
 template <typename T> class LockFreeList {
@@ -47,7 +54,7 @@ public:
             value(value), next(NULL) { }
     };
 
-    inline LockFreeList() : m_head(NULL) {}
+    inline LockFreeList() : m_head(NULL), m_size(0) {}
 
     ~LockFreeList() {
         ListItem *cur = m_head;
@@ -62,15 +69,45 @@ public:
         return m_head;
     }
 
+    /// Return the number of items in the list
+    inline size_t size() const {
+        return (size_t) m_size;
+    }
+
+    /**
+     * \brief Append an item to the end of the list
+     *
+     * This operation requires a traversal of the entire list
+     * and thus takes time that is linear in its size.
+     */
     void append(const T &value) {
         ListItem *item = new ListItem(value);
         ListItem **cur = &m_head;
 
         while (!atomicCompareAndExchangePtr<ListItem>(cur, item, NULL))
             cur = &((*cur)->next);
+        atomicAdd(&m_size, 1);
+    }
+
+    /**
+     * \brief Insert an item at the front of the list
+     *
+     * In contrast to \ref append(), this operation takes constant time
+     * and only contends with other threads inserting into the same list.
+     */
+    void prepend(const T &value) {
+        ListItem *item = new ListItem(value);
+        ListItem *head;
+
+        do {
+            head = m_head;
+            item->next = head;
+        } while (!atomicCompareAndExchangePtr<ListItem>(&m_head, item, head));
+        atomicAdd(&m_size, 1);
     }
 private:
     ListItem *m_head;
+    volatile int64_t m_size;
 };
 
 /**
@@ -246,6 +283,12 @@ protected:
  * Based on the excellent implementation in PBRT. Modifications are
  * the addition of a bounding sphere query and support for multithreading.
  *
+ * Insertions are lock-free: new nodes are attached using atomic compare and
+ * exchange operations, and items are prepended to the lock-free list of
+ * each overlapped node in constant time. Lookups may run concurrently with
+ * insertions, since neither nodes nor items are released before the
+ * octree is destroyed.
+ *
  * This class is currently used to implement irradiance caching.
  *
  * \ingroup libcore
@@ -320,7 +363,7 @@ private:
            than the current node size */
         if (depth == m_maxDepth ||
             (nodeAABB.getExtents().lengthSquared() < diag2)) {
-            node->data.append(value);
+            node->data.prepend(value);
             return;
         }
 
@@ -238,42 +238,52 @@ namespace math {
      */
     template <typename Scalar, typename QuantizedScalar, typename Index> float makeAliasTable(
             AliasTableEntry<QuantizedScalar, Index> *tbl, Scalar *pmf, Index size) {
-        /* Allocate temporary storage for classification purposes */
-        Index *c = new Index[size],
-              *c_short = c - 1, *c_long  = c + size;
-
         /* Begin by computing the normalization constant */
         Scalar sum = 0;
-        for (size_t i=0; i<size; ++i)
+        for (Index i=0; i<size; ++i)
             sum += pmf[i];
 
-        Scalar normalization = (Scalar) 1 / sum;
+        /* Vose's method: classify the entries into separate worklists
+           depending on whether they have "too little" or "too much"
+           probability mass. Entries at the mean go to the latter list */
+        std::vector<Scalar> prob(size);
+        std::vector<Index> smallEntries, largeEntries;
+        smallEntries.reserve(size);
+        largeEntries.reserve(size);
+
+        Scalar normalization = (Scalar) size / sum;
         for (Index i=0; i<size; ++i) {
-            /* For each entry, determine whether there is
-               "too little" or "too much" probability mass */
-            Scalar value = size * normalization * pmf[i];
-            if (value < 1)
-                *++c_short = i;
-            else if (value > 1)
-                *--c_long  = i;
-            tbl[i].prob  = value;
+            prob[i] = pmf[i] * normalization;
             tbl[i].index = i;
+            if (prob[i] < 1)
+                smallEntries.push_back(i);
+            else
+                largeEntries.push_back(i);
         }
 
-        /* Perform pairwise exchanges while there are entries
-           with too much probability mass */
-        for (Index i=0; i < size-1 && c_long - c < size; ++i) {
-            Index short_index = c[i],
-                  long_index  = *c_long;
-
-            tbl[short_index].index = long_index;
-            tbl[long_index].prob  -= (Scalar) 1 - tbl[short_index].prob;
-
-            if (tbl[long_index].prob <= 1)
-                ++c_long;
+        /* Fill up each small entry with mass from a large one, which is
+           demoted to the small list once it drops below the mean */
+        while (!smallEntries.empty() && !largeEntries.empty()) {
+            Index smallIndex = smallEntries.back(),
+                  largeIndex = largeEntries.back();
+            smallEntries.pop_back();
+            largeEntries.pop_back();
+
+            tbl[smallIndex].prob  = (QuantizedScalar) prob[smallIndex];
+            tbl[smallIndex].index = largeIndex;
+            prob[largeIndex] = (prob[largeIndex] + prob[smallIndex]) - (Scalar) 1;
+
+            if (prob[largeIndex] < 1)
+                smallEntries.push_back(largeIndex);
+            else
+                largeEntries.push_back(largeIndex);
         }
 
-        delete[] c;
+        /* Remaining entries are at the mean up to roundoff errors */
+        for (size_t i=0; i<largeEntries.size(); ++i)
+            tbl[largeEntries[i]].prob = (QuantizedScalar) 1;
+        for (size_t i=0; i<smallEntries.size(); ++i)
+            tbl[smallEntries[i]].prob = (QuantizedScalar) 1;
 
         return sum;
     }
@@ -315,6 +325,205 @@ namespace math {
     }
 };
 
+/**
+ * \brief Discrete probability distribution based on Walker's alias method
+ *
+ * This class provides the same interface as \ref DiscreteDistribution,
+ * but it generates samples in constant time instead of performing a
+ * binary search over the cumulative distribution. The table is
+ * constructed using \ref math::makeAliasTable() when \ref normalize()
+ * is called. A distribution whose entries sum to zero has no table
+ * and always returns index 0 with probability 0.
+ *
+ * Note that the alias method generally does not preserve the
+ * stratification properties of QMC number sequences. The sample values
+ * returned by \ref sampleReuse() are uniformly distributed, but their
+ * ordering with respect to the input sample is not monotonic.
+ *
+ * \ingroup libcore
+ */
+struct AliasDistribution {
+public:
+    /// Allocate memory for a distribution with the given number of entries
+    explicit inline AliasDistribution(size_t nEntries = 0) {
+        reserve(nEntries);
+        clear();
+    }
+
+    /// Clear all entries
+    inline void clear() {
+        m_pmf.clear();
+        m_table.clear();
+        m_sum = 0.0f;
+        m_normalized = false;
+    }
+
+    /// Reserve memory for a certain number of entries
+    inline void reserve(size_t nEntries) {
+        m_pmf.reserve(nEntries);
+    }
+
+    /// Append an entry with the specified discrete probability
+    inline void append(Float pdfValue) {
+        m_pmf.push_back(pdfValue);
+    }
+
+    /// Return the number of entries so far
+    inline size_t size() const {
+        return m_pmf.size();
+    }
+
+    /// Access an entry by its index
+    inline Float operator[](size_t entry) const {
+        return m_pmf[entry];
+    }
+
+    /// Have the probability densities been normalized?
+    inline bool isNormalized() const {
+        return m_normalized;
+    }
+
+    /**
+     * \brief Return the original (unnormalized) sum of all PDF entries
+     *
+     * This assumes that \ref normalize() has previously been called
+     */
+    inline Float getSum() const {
+        return m_sum;
+    }
+
+    /**
+     * \brief Return the normalization factor (i.e. the inverse of \ref getSum())
+     *
+     * This assumes that \ref normalize() has previously been called
+     */
+    inline Float getNormalization() const {
+        return m_normalization;
+    }
+
+    /**
+     * \brief Normalize the distribution and build the alias table
+     *
+     * Throws an exception when no entries were previously
+     * added to the distribution.
+     *
+     * \return Sum of the (previously unnormalized) entries
+     */
+    inline Float normalize() {
+        SAssert(m_pmf.size() > 0);
+        size_t n = m_pmf.size();
+        m_table.clear();
+        m_normalized = false;
+
+        /* Accumulate in double precision, as there may be many entries */
+        double sum = 0;
+        for (size_t i=0; i<n; ++i)
+            sum += m_pmf[i];
+        m_sum = (Float) sum;
+
+        if (!(m_sum > 0)) {
+            m_normalization = 0.0f;
+            return m_sum;
+        }
+
+        m_normalization = 1.0f / m_sum;
+        m_table.resize(n);
+        math::makeAliasTable(&m_table[0], &m_pmf[0], (uint32_t) n);
+        for (size_t i=0; i<n; ++i)
+            m_pmf[i] *= m_normalization;
+
+        m_normalized = true;
+        return m_sum;
+    }
+
+    /**
+     * \brief %Transform a uniformly distributed sample to the stored distribution
+     *
+     * \param[in] sampleValue
+     *     An uniformly distributed sample on [0,1]
+     * \return
+     *     The discrete index associated with the sample
+     */
+    inline size_t sample(Float sampleValue) const {
+        return sampleReuse(sampleValue);
+    }
+
+    /**
+     * \brief %Transform a uniformly distributed sample to the stored distribution
+     *
+     * \param[in] sampleValue
+     *     An uniformly distributed sample on [0,1]
+     * \param[out] pdf
+     *     Probability value of the sample
+     * \return
+     *     The discrete index associated with the sample
+     */
+    inline size_t sample(Float sampleValue, Float &pdf) const {
+        size_t index = sampleReuse(sampleValue);
+        pdf = m_table.empty() ? 0.0f : m_pmf[index];
+        return index;
+    }
+
+    /**
+     * \brief %Transform a uniformly distributed sample to the stored distribution
+     *
+     * The original sample is value adjusted so that it can be "reused".
+     *
+     * \param[in, out] sampleValue
+     *     An uniformly distributed sample on [0,1]
+     * \return
+     *     The discrete index associated with the sample
+     */
+    inline size_t sampleReuse(Float &sampleValue) const {
+        /* Distributions with a zero sum have no table (see \ref normalize()) */
+        if (EXPECT_NOT_TAKEN(m_table.empty()))
+            return 0;
+        return math::sampleAliasReuse(&m_table[0],
+            (uint32_t) m_table.size(), sampleValue);
+    }
+
+    /**
+     * \brief %Transform a uniformly distributed sample.
+     *
+     * The original sample is value adjusted so that it can be "reused".
+     *
+     * \param[in,out]
+     *     An uniformly distributed sample on [0,1]
+     * \param[out] pdf
+     *     Probability value of the sample
+     * \return
+     *     The discrete index associated with the sample
+     */
+    inline size_t sampleReuse(Float &sampleValue, Float &pdf) const {
+        size_t index = sampleReuse(sampleValue);
+        pdf = m_table.empty() ? 0.0f : m_pmf[index];
+        return index;
+    }
+
+    /**
+     * \brief Turn the underlying distribution into a
+     * human-readable string format
+     */
+    std::string toString() const {
+        std::ostringstream oss;
+        oss << "AliasDistribution[sum=" << m_sum << ", normalized="
+            << (int) m_normalized << ", pmf={";
+        for (size_t i=0; i<m_pmf.size(); ++i) {
+            oss << m_pmf[i];
+            if (i != m_pmf.size()-1)
+                oss << ", ";
+        }
+        oss << "}]";
+        return oss.str();
+    }
+private:
+    std::vector<Float> m_pmf;
+    std::vector<math::AliasTableEntry<Float, uint32_t> > m_table;
+    Float m_sum, m_normalization;
+    bool m_normalized;
+};
+
+
 MTS_NAMESPACE_END
 
 #endif /* __MITSUBA_CORE_PMF_H_ */
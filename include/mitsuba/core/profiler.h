@@ -0,0 +1,130 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_CORE_PROFILER_H_)
+#define __MITSUBA_CORE_PROFILER_H_
+
+#include <mitsuba/core/timer.h>
+#include <mitsuba/core/lock.h>
+
+/**
+ * Uncomment this (or configure with -DMTS_PROFILER=ON) to enable
+ * the hierarchical profiler. When disabled, \ref MTS_PROFILE_SCOPE
+ * expands to nothing and has no runtime cost.
+ */
+//#define MTS_ENABLE_PROFILER 1
+
+/// Maximum number of distinct call paths that are tracked per thread
+#define MTS_PROFILER_MAX_NODES 256
+
+MTS_NAMESPACE_BEGIN
+
+/// Categories of work distinguished by the \ref Profiler
+enum EProfilerPhase {
+    EProfilerRender = 0,      ///< Rendering of an image block or pixel
+    EProfilerRayIntersect,    ///< Ray traversal with intersection details
+    EProfilerShadowRay,       ///< Shadow ray (occlusion-only) traversal
+    EProfilerEmitterSample,   ///< Direct illumination sampling (NEE)
+    EProfilerBSDFEval,        ///< BSDF evaluation
+    EProfilerBSDFSample,      ///< BSDF sampling
+    EProfilerTextureEval,     ///< Texture lookups
+    EProfilerFilm,            ///< Splatting into image blocks and the film
+    EProfilerPhaseCount
+};
+
+/**
+ * \brief Low-overhead hierarchical profiler of the rendering hot paths
+ *
+ * Code regions are annotated with \ref MTS_PROFILE_SCOPE, which records
+ * the time spent in them (measured using the CPU timestamp counter)
+ * separately for every call path, e.g. texture lookups performed
+ * during BSDF sampling are distinguished from those performed during
+ * BSDF evaluation.
+ *
+ * Every thread records into its own cache line-aligned call tree, hence
+ * no atomic operations or locks are needed on the hot path. The trees
+ * of all threads are merged when a report is requested.
+ *
+ * The profiler is compiled in only when \c MTS_ENABLE_PROFILER is
+ * defined. Its report is then part of \ref Statistics::getStats().
+ *
+ * \ingroup libcore
+ */
+class MTS_EXPORT_CORE Profiler : public Object {
+public:
+    /// Call tree of a single thread (opaque)
+    struct ThreadRecord;
+
+    /// Return the global profiler instance
+    inline static Profiler *getInstance() { return m_instance; }
+
+    /// Enter a region of the given category (called by \ref ScopedPhase)
+    static void enter(EProfilerPhase phase);
+
+    /// Leave the most recently entered region
+    static void leave();
+
+    /// Return a human-readable name of a phase
+    static const char *getPhaseName(EProfilerPhase phase);
+
+    /// Return a per-category breakdown of the recorded times
+    std::string getReport() const;
+
+    /// Print the report using the logger
+    void printReport() const;
+
+    /// Discard all recorded times
+    void reset();
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Create a profiler instance
+    Profiler();
+
+    /// Virtual destructor
+    virtual ~Profiler();
+
+    /// Create the record of the calling thread
+    ThreadRecord *registerThread();
+private:
+    static ref<Profiler> m_instance;
+    std::vector<ThreadRecord *> m_threads;
+    uint64_t m_startTicks;
+    ref<Timer> m_timer;
+    mutable ref<Mutex> m_mutex;
+};
+
+/**
+ * \brief Attributes the lifetime of this object to a profiler phase
+ * \ingroup libcore
+ */
+struct ScopedPhase {
+    inline ScopedPhase(EProfilerPhase phase) { Profiler::enter(phase); }
+    inline ~ScopedPhase() { Profiler::leave(); }
+};
+
+#if defined(MTS_ENABLE_PROFILER)
+#define MTS_PROFILE_SCOPE(phase) ScopedPhase __profilerScope(phase)
+#else
+#define MTS_PROFILE_SCOPE(phase)
+#endif
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_CORE_PROFILER_H_ */
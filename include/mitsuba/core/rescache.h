@@ -0,0 +1,179 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_CORE_RESCACHE_H_)
+#define __MITSUBA_CORE_RESCACHE_H_
+
+#include <mitsuba/core/lock.h>
+#include <boost/filesystem.hpp>
+
+/// Cache file version -- increase when the chunk file layout changes
+#define MTS_RESCACHE_VERSION 0x01
+
+/**
+ * Serialized resources below this size (in bytes) are always sent
+ * to remote workers as a whole instead of being split into chunks
+ */
+#define MTS_RESCACHE_MIN_RESOURCE_SIZE (256 * 1024)
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Content-addressed on-disk cache of serialized resource chunks
+ *
+ * Network rendering transmits every resource (most importantly, the
+ * serialized scene with all of its meshes and textures) to every
+ * connected server. To avoid re-sending the same data for each job,
+ * \ref RemoteWorker splits serialized resources into content-defined
+ * chunks (\ref split()) and only transmits those chunks that the
+ * server does not already hold in its cache.
+ *
+ * Chunk boundaries are determined by a rolling hash of the data rather
+ * than by fixed offsets. Local modifications of a resource (e.g.
+ * editing one mesh of a large scene) thus only change the chunks
+ * overlapping the modified region, while all others can be reused.
+ *
+ * Each chunk is stored in a separate file named after its 128-bit
+ * content hash. The cache is shared by all connections of a server
+ * and bounded in size; whenever it grows beyond the limit, the least
+ * recently used chunks are evicted.
+ *
+ * \ingroup libcore
+ */
+class MTS_EXPORT_CORE ResourceCache : public Object {
+public:
+    /// 128-bit content hash of a chunk
+    struct Hash {
+        uint64_t lo, hi;
+
+        inline Hash() : lo(0), hi(0) { }
+
+        /// Unserialize a hash value from a binary data stream
+        inline Hash(Stream *stream) {
+            lo = stream->readULong();
+            hi = stream->readULong();
+        }
+
+        /// Serialize a hash value to a binary data stream
+        inline void serialize(Stream *stream) const {
+            stream->writeULong(lo);
+            stream->writeULong(hi);
+        }
+
+        inline bool operator==(const Hash &h) const { return lo == h.lo && hi == h.hi; }
+        inline bool operator!=(const Hash &h) const { return lo != h.lo || hi != h.hi; }
+        inline bool operator<(const Hash &h) const { return hi < h.hi || (hi == h.hi && lo < h.lo); }
+
+        /// Return a hexadecimal string representation
+        std::string toString() const;
+    };
+
+    /// Describes one chunk of a serialized resource
+    struct Chunk {
+        /// Content hash
+        Hash hash;
+        /// Offset within the resource
+        size_t offset;
+        /// Size of the chunk in bytes
+        size_t size;
+    };
+
+    // =============================================================
+    //! @{ \name Content hashing and chunking
+    // =============================================================
+
+    /// Compute the 128-bit content hash of a memory region
+    static Hash hash(const void *data, size_t size);
+
+    /**
+     * \brief Split a memory region into content-defined chunks
+     *
+     * Chunks are between 32 KiB and 1 MiB large (160 KiB on average)
+     * and cover the region without gaps.
+     */
+    static void split(const void *data, size_t size, std::vector<Chunk> &chunks);
+
+    //! @}
+    // =============================================================
+
+    // =============================================================
+    //! @{ \name Cache access
+    // =============================================================
+
+    /**
+     * \brief Open (or create) a cache in the given directory
+     *
+     * \param path
+     *    Directory, in which the chunk files are stored
+     * \param maxSize
+     *    Maximum size of the cache in bytes. Existing caches, which
+     *    exceed this limit are trimmed right away.
+     */
+    ResourceCache(const fs::path &path, size_t maxSize);
+
+    /**
+     * \brief Try to load a chunk from the cache
+     *
+     * Returns \c false if no valid entry exists. On success, the chunk
+     * counts as recently used.
+     */
+    bool load(const Hash &hash, std::vector<uint8_t> &data);
+
+    /**
+     * \brief Store a chunk in the cache
+     *
+     * Failures (e.g. due to a full disk) only produce a warning, since
+     * the cache is purely an optimization.
+     */
+    void store(const Hash &hash, const void *data, size_t size);
+
+    /// Evict the least recently used chunks until the size limit is met
+    void trim();
+
+    /// Return the cache directory
+    inline const fs::path &getPath() const { return m_path; }
+
+    /// Return the maximum size of the cache in bytes
+    inline size_t getMaxSize() const { return m_maxSize; }
+
+    /// Return the current size of the cache in bytes
+    inline size_t getSize() const { LockGuard lock(m_mutex); return m_size; }
+
+    /// Return a string representation
+    std::string toString() const;
+
+    //! @}
+    // =============================================================
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Virtual destructor
+    virtual ~ResourceCache() { }
+
+    /// Return the filename associated with a chunk
+    fs::path getChunkPath(const Hash &hash) const;
+private:
+    fs::path m_path;
+    size_t m_maxSize, m_size;
+    mutable ref<Mutex> m_mutex;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_CORE_RESCACHE_H_ */
@@ -21,6 +21,7 @@
 #define __MITSUBA_CORE_RFILTER_H_
 
 #include <mitsuba/core/cobject.h>
+#include <mitsuba/core/sse.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -76,6 +77,53 @@ public:
     inline Float evalDiscretized(Float x) const { return m_values[
         std::min((int) std::abs(x * m_scaleFactor), MTS_FILTER_RESOLUTION)]; }
 
+    /**
+     * \brief Perform lookups into the discretized version at a
+     * sequence of integer pixel positions
+     *
+     * This is equivalent to evaluating <tt>evalDiscretized(start + i - center)</tt>
+     * for <tt>i = 0, ..., count-1</tt>, but computes four table indices at
+     * a time when SSE is available.
+     *
+     * \param center
+     *    Center of the filter (e.g. a sample position in pixel coordinates)
+     * \param start
+     *    First pixel position
+     * \param count
+     *    Number of pixel positions
+     * \param target
+     *    Array receiving the \c count filter weights
+     */
+    inline void evalDiscretized(Float center, int start, int count, Float *target) const {
+        int i = 0;
+#if defined(MTS_SSE)
+        const __m128 scale = _mm_set1_ps(m_scaleFactor),
+                     maxIndex = _mm_set1_ps((float) MTS_FILTER_RESOLUTION),
+                     absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)),
+                     centerV = _mm_set1_ps(center);
+        const __m128i step = _mm_set1_epi32(4);
+        __m128i pixel = _mm_add_epi32(_mm_set1_epi32(start), _mm_set_epi32(3, 2, 1, 0));
+
+        for (; i + 4 <= count; i += 4) {
+            /* Clamping before the conversion is equivalent to the scalar
+               version, since the table index is always non-negative */
+            __m128 x = _mm_sub_ps(_mm_cvtepi32_ps(pixel), centerV);
+            __m128i index = _mm_cvttps_epi32(_mm_min_ps(
+                _mm_mul_ps(_mm_and_ps(x, absMask), scale), maxIndex));
+
+            MM_ALIGN16 int32_t indices[4];
+            _mm_store_si128((__m128i *) indices, index);
+            target[i]   = m_values[indices[0]];
+            target[i+1] = m_values[indices[1]];
+            target[i+2] = m_values[indices[2]];
+            target[i+3] = m_values[indices[3]];
+            pixel = _mm_add_epi32(pixel, step);
+        }
+#endif
+        for (; i < count; ++i)
+            target[i] = evalDiscretized((start + i) - center);
+    }
+
     /// Serialize the filter to a binary data stream
     void serialize(Stream *stream, InstanceManager *manager) const;
 
@@ -433,7 +481,98 @@ template <typename Scalar> struct Resampler {
         }
     }
 
+    /**
+     * \brief Compute one output row when resampling a row-major array
+     * along its vertical axis
+     *
+     * This produces the same values as calling \ref resample() on each column
+     * of the array with a stride of \c rowSize samples, but accumulates whole
+     * contiguous rows for each filter tap. The inner loop thus streams through
+     * memory and can be vectorized by the compiler, whereas the column-wise
+     * variant touches a different cache line for every sample.
+     *
+     * \param source
+     *     Source array of \c sourceRes rows
+     * \param rowSize
+     *     Number of samples per row (i.e. width times channels)
+     * \param target
+     *     Target row of \c rowSize samples
+     * \param i
+     *     Index of the target row
+     */
+    void resampleRow(const Scalar *source, size_t rowSize, Scalar *target, int i) {
+        const int taps = m_taps;
+        const int start = m_start ? m_start[i] : (i - m_halfTaps);
+        const Scalar *weights = m_start ? (m_weights + i * taps) : m_weights;
+
+        for (size_t k=0; k<rowSize; ++k)
+            target[k] = (Scalar) 0;
+
+        for (int j=0; j<taps; ++j) {
+            const Scalar weight = weights[j];
+            int pos = start + j;
+
+            if (EXPECT_NOT_TAKEN(pos < 0 || pos >= m_sourceRes)) {
+                Scalar value;
+                if (!boundaryLookup(pos, value)) {
+                    for (size_t k=0; k<rowSize; ++k)
+                        target[k] += value * weight;
+                    continue;
+                }
+            }
+
+            const Scalar *row = source + rowSize * (size_t) pos;
+            for (size_t k=0; k<rowSize; ++k)
+                target[k] += row[k] * weight;
+        }
+    }
+
+    /**
+     * \brief Compute one output row when resampling a row-major array
+     * along its vertical axis, and clamp the results to a specified
+     * valid range
+     *
+     * See \ref resampleRow() and \ref resampleAndClamp().
+     */
+    void resampleRowAndClamp(const Scalar *source, size_t rowSize, Scalar *target, int i,
+            Scalar min = (Scalar) 0, Scalar max = (Scalar) 1) {
+        resampleRow(source, rowSize, target, i);
+
+        for (size_t k=0; k<rowSize; ++k)
+            target[k] = std::min(max, std::max(min, target[k]));
+    }
+
 private:
+    /**
+     * \brief Apply the boundary condition to an out-of-range sample index
+     *
+     * Returns \c true and updates \c pos if the sample maps to another
+     * position within the input, or \c false if it evaluates to the
+     * constant \c value.
+     */
+    inline bool boundaryLookup(int &pos, Scalar &value) const {
+        switch (m_bc) {
+            case ReconstructionFilter::EClamp:
+                pos = math::clamp(pos, 0, m_sourceRes - 1);
+                break;
+            case ReconstructionFilter::ERepeat:
+                pos = math::modulo(pos, m_sourceRes);
+                break;
+            case ReconstructionFilter::EMirror:
+                pos = math::modulo(pos, 2*m_sourceRes);
+                if (pos >= m_sourceRes)
+                    pos = 2*m_sourceRes - pos - 1;
+                break;
+            case ReconstructionFilter::EZero:
+                value = (Scalar) 0;
+                return false;
+            case ReconstructionFilter::EOne:
+                value = (Scalar) 1;
+                return false;
+        }
+        return true;
+    }
+
     FINLINE Scalar lookup(const Scalar *source, int pos, size_t stride, int offset) const {
         if (EXPECT_NOT_TAKEN(pos < 0 || pos >= m_sourceRes)) {
             switch (m_bc) {
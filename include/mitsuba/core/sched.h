@@ -29,6 +29,13 @@
  */
 //#define DEBUG_SCHED 1
 
+/**
+ * Byte order of serialized resources. Little endian matches all common
+ * hosts, which lets large arrays (e.g. mesh data) be written and read
+ * without byte swapping
+ */
+#define MTS_RESOURCE_BYTE_ORDER Stream::ELittleEndian
+
 MTS_NAMESPACE_BEGIN
 
 /**
@@ -254,6 +261,23 @@ public:
     virtual void processResult(const WorkResult *result,
         bool cancelled) = 0;
 
+    /**
+     * \brief Called when a worker starts processing a work unit
+     *
+     * Local workers generate work units in batches ahead of time, and
+     * queued units may be stolen by other workers. Hence, this function
+     * (and not \ref generateWork()) marks the point where work on a unit
+     * actually begins, and \c worker refers to the worker processing it.
+     * Work units sent to remote workers begin when they are dispatched.
+     *
+     * Note that this function may concurrently be executed by
+     * multiple threads. The default implementation does nothing.
+     *
+     * \param unit   Work unit that is about to be processed
+     * \param worker ID of the worker processing the work unit
+     */
+    virtual void handleWorkBegin(const WorkUnit *unit, int worker);
+
     /**
      * \brief Called when the parallel process is canceled by
      * \ref Scheduler::cancel().
@@ -345,6 +369,13 @@ class Worker;
  * units from the scheduler, which are then executed on the current machine
  * or sent to remote nodes over a network connection.
  *
+ * Local workers don't contend for the central queue on every work unit:
+ * each of them owns a small double-ended queue, which it refills by
+ * generating a batch of work units (see \ref setBatchSize()) whenever
+ * it runs dry. Idle workers steal half of the queued units of another
+ * local worker before falling back to the central queue. Remote workers
+ * use the central queue directly.
+ *
  * \ingroup libcore
  * \ingroup libpython
  */
@@ -402,6 +433,37 @@ public:
      */
     int registerMultiResource(std::vector<SerializableObject *> &resources);
 
+    /**
+     * \brief Register a \a multiple resource, whose instances may be
+     * moved to the NUMA node of the worker that uses them
+     *
+     * When \c nodeLocal is set and the machine has several NUMA nodes,
+     * each local worker replaces its instance by a copy that it
+     * unserializes itself when first accessing the resource. This ensures
+     * that the instance's memory is allocated on the worker's node. The
+     * caller must not retain pointers to the registered instances.
+     */
+    int registerMultiResource(std::vector<SerializableObject *> &resources,
+        bool nodeLocal);
+
+    /**
+     * \brief Register a resource that may be replicated on every NUMA node
+     *
+     * When resource replication is enabled (see \ref setResourceReplication())
+     * and the machine has several NUMA nodes, the local workers of each node
+     * access a private copy of the resource, which is unserialized by the first
+     * worker that needs it. This trades memory for locality (e.g. for the scene
+     * and its kd-tree) and has the same requirements as network rendering.
+     * Otherwise, this function is equivalent to \ref registerResource().
+     */
+    int registerReplicatedResource(SerializableObject *resource);
+
+    /// Enable or disable the replication of resources on every NUMA node
+    inline void setResourceReplication(bool value) { m_resourceReplication = value; }
+
+    /// Are resources replicated on every NUMA node?
+    inline bool getResourceReplication() const { return m_resourceReplication; }
+
     /**
      * \brief Increase the reference count of a previously registered resource.
      *
@@ -477,6 +539,19 @@ public:
     /// Is the scheduler currently executing work?
     bool isBusy() const;
 
+    /**
+     * \brief Set the number of work units that a local worker generates
+     * each time it accesses the central work queue (default: 4)
+     *
+     * The surplus units are placed into the worker's own queue, from
+     * which other workers can steal them. A value of \c 1 reproduces
+     * the behavior of a single shared work queue.
+     */
+    void setBatchSize(int batchSize);
+
+    /// Return the number of work units generated per central queue access
+    inline int getBatchSize() const { return m_batchSize; }
+
     /// Initialize the scheduler of this process -- called once in main()
     static void staticInitialization();
 
@@ -513,6 +588,28 @@ public:
         }
     };
 
+    /// Work unit that was generated ahead of time for a specific process
+    struct QueuedUnit {
+        int id;
+        ref<WorkUnit> workUnit;
+
+        inline QueuedUnit() : id(-1) { }
+        inline QueuedUnit(int id, WorkUnit *workUnit)
+            : id(id), workUnit(workUnit) { }
+    };
+
+    /**
+     * Work queue owned by a local worker. The owner takes units from
+     * the front, while other workers steal from the back.
+     */
+    struct LocalQueue {
+        std::deque<QueuedUnit> units;
+        volatile int32_t size;
+        volatile int32_t lock;
+
+        inline LocalQueue() : size(0), lock(0) { }
+    };
+
     /**
      * Data structure, which contains a piece of work
      * as well as the information required to either execute
@@ -529,9 +626,20 @@ public:
         ref<WorkUnit> workUnit;
         ref<WorkResult> workResult;
         bool stop;
+        /* Work queue of a local worker (NULL for remote workers) */
+        LocalQueue *queue;
+        /* Recycled work units of the current process */
+        std::vector<ref<WorkUnit> > unitPool;
+        /* State of the random number generator used to select victims */
+        uint32_t stealState;
+        /* Time spent waiting for new work during the last acquisition */
+        uint64_t idleTime;
+        /* NUMA node of a local worker (-1 if unknown or irrelevant) */
+        int node;
 
         inline Item() : id(-1), workerIndex(-1), coreOffset(-1),
-            proc(NULL), rec(NULL), stop(false) {
+            proc(NULL), rec(NULL), stop(false), queue(NULL),
+            stealState(0), idleTime(0), node(-1) {
         }
 
         std::string toString() const;
@@ -542,14 +650,22 @@ public:
         ref<MemoryStream> stream;
         int refCount;
         bool multi;
+        /* Replicate on every NUMA node / move multi instances to their node */
+        bool replicated, nodeLocal;
+        /* Per-node copies of a replicated resource */
+        std::vector<SerializableObject *> replicas;
+        /* Multi instances that were already moved to their node */
+        std::vector<bool> localized;
 
         inline ResourceRecord(SerializableObject *resource)
-         : resources(1), refCount(1), multi(false) {
+         : resources(1), refCount(1), multi(false),
+           replicated(false), nodeLocal(false) {
             resources[0] = resource;
         }
 
         inline ResourceRecord(std::vector<SerializableObject *> resources)
-         : resources(resources), refCount(1), multi(true) {
+         : resources(resources), refCount(1), multi(true),
+           replicated(false), nodeLocal(false) {
         }
     };
 
@@ -567,6 +683,12 @@ public:
     /// Look up a resource by ID & core index
     SerializableObject *getResource(int id, int coreIndex = -1);
 
+    /**
+     * \brief Look up a resource on behalf of a local worker running on
+     * the given NUMA node, and create node-local copies if requested
+     */
+    SerializableObject *getLocalResource(int id, int coreIndex, int node);
+
     /// Return a resource in the form of a binary data stream
     const MemoryStream *getResourceStream(int id);
 
@@ -588,6 +710,26 @@ protected:
      */
     EStatus acquireWork(Item &item, bool local, bool onlyTry, bool keepLock);
 
+    /**
+     * Acquire a piece of work for a local worker, either from its own
+     * queue, by stealing from another local worker, or by generating a
+     * new batch from the central queue.
+     */
+    EStatus acquireLocalWork(Item &item);
+
+    /**
+     * Generate a batch of work units from the process on top of the
+     * central queue. The first unit is returned in \c unit, and the
+     * remainder is appended to the worker's own queue.
+     */
+    EStatus generateLocalWork(Item &item, QueuedUnit &unit);
+
+    /// Try to steal work units from the queue of another local worker
+    bool stealLocalWork(Item &item, QueuedUnit &unit);
+
+    /// Remove all queued work units of a (cancelled) process
+    void purgeLocalWork(ProcessRecord *rec);
+
     /// Release the main scheduler lock -- internally used by the remote worker
     inline void releaseLock() { m_mutex->unlock(); }
 
@@ -633,7 +775,8 @@ protected:
         const ParallelProcess::ResourceBindings &bindings = item.proc->getResourceBindings();
         for (ParallelProcess::ResourceBindings::const_iterator it = bindings.begin();
             it != bindings.end(); ++it)
-            item.wp->m_resources[(*it).first] = m_scheduler->getResource((*it).second, item.coreOffset);
+            item.wp->m_resources[(*it).first] = m_scheduler->getLocalResource(
+                (*it).second, item.coreOffset, item.node);
         try {
             item.wp->prepare();
             item.workUnit = item.wp->createWorkUnit();
@@ -662,8 +805,16 @@ private:
     std::map<int, ResourceRecord *> m_resources;
     /// List of all active workers
     std::vector<Worker *> m_workers;
+    /// Work queues of the local workers (only valid while running)
+    std::vector<LocalQueue *> m_localWorkQueues;
+    /// Total number of work units in the local work queues
+    volatile int32_t m_queuedUnits;
+    /// Number of local workers waiting for new work
+    int m_idleWorkers;
+    int m_batchSize;
     int m_resourceCounter, m_processCounter;
     bool m_running;
+    bool m_resourceReplication;
 };
 
 /**
@@ -21,13 +21,15 @@
 #define __MITSUBA_CORE_SCHED_REMOTE_H_
 
 #include <mitsuba/core/sched.h>
+#include <mitsuba/core/rescache.h>
 #include <set>
 
 /// Default port of <tt>mtssrv</tt>
 #define MTS_DEFAULT_PORT 7554
 
 /** How many work units should be sent to a remote worker
-   at a time? This is a multiple of the worker's core count */
+   at a time? This is a multiple of the worker's core count
+   (default value, see \ref RemoteWorker::setBacklogFactor()) */
 #define MTS_BACKLOG_FACTOR 3
 
 /** Once the back log factor drops below this value (also a
@@ -35,6 +37,11 @@
    continue sending batches of work units */
 #define MTS_CONTINUE_FACTOR 2
 
+/** Revision of the wire protocol. It is exchanged along with
+   \ref MTS_VERSION when connecting and must be incremented
+   whenever messages or the serialization format change */
+#define MTS_PROTOCOL_VERSION 2
+
 MTS_NAMESPACE_BEGIN
 
 class RemoteWorkerReader;
@@ -59,6 +66,37 @@ public:
     /// Return the name of the node on the other side
     inline const std::string &getNodeName() const { return m_nodeName; }
 
+    /**
+     * \brief Ask the remote side to compress the work results
+     * it sends back
+     *
+     * Useful when the network link is the bottleneck, e.g. when
+     * rendering with many remote cores over 1GbE. Image data is
+     * byte-shuffled and compressed with \c zlib (see \ref ZStream).
+     *
+     * \param level
+     *    Compression level between 1 (fastest) and 9 (best).
+     *    Zero disables compression (the default).
+     */
+    void setCompressionLevel(int level);
+
+    /// Return the compression level of work results
+    inline int getCompressionLevel() const { return m_compressionLevel; }
+
+    /**
+     * \brief Set the number of work units, which are kept in
+     * flight per remote core (Default: \ref MTS_BACKLOG_FACTOR)
+     *
+     * Higher values hide the network latency and allow the remote
+     * side to process the next work unit while earlier results are
+     * still being transmitted, at the cost of coarser load balancing
+     * at the end of a job.
+     */
+    void setBacklogFactor(int factor);
+
+    /// Return the number of work units kept in flight per remote core
+    inline int getBacklogFactor() const { return (int) m_backlogFactor; }
+
     MTS_DECLARE_CLASS()
 protected:
     /// Virtual destructor
@@ -72,6 +110,21 @@ protected:
     virtual void start(Scheduler *scheduler, int workerIndex, int coreOffset);
     void flush();
 
+    /**
+     * \brief Transmit a resource to the remote side
+     *
+     * Large resources are sent in chunks, omitting those that
+     * the remote side already holds in its resource cache.
+     * Expects the message buffer lock to be held.
+     */
+    void sendResources(const std::vector<std::pair<int, const MemoryStream *> > &resources);
+
+    /// Called by the reader thread when the list of missing chunks arrives
+    void receiveChunkRequest(int id, Stream *stream);
+
+    /// Called by the reader thread when the connection has failed
+    void signalConnectionLoss();
+
     inline void signalCompletion() {
         LockGuard lock(m_mutex);
         m_inFlight--;
@@ -80,6 +133,7 @@ protected:
 protected:
     ref<Mutex> m_mutex;
     ref<ConditionVariable> m_finishCond;
+    ref<ConditionVariable> m_chunkCond;
     ref<MemoryStream> m_memStream;
     ref<Stream> m_stream;
     ref<RemoteWorkerReader> m_reader;
@@ -89,8 +143,13 @@ protected:
     std::set<int> m_resources;
     std::set<int> m_processes;
     std::set<std::string> m_plugins;
+    /* Chunks requested by the remote side (by resource ID) */
+    std::map<int, std::vector<int> > m_chunkRequests;
     std::string m_nodeName;
     size_t m_inFlight;
+    size_t m_backlogFactor;
+    int m_compressionLevel;
+    bool m_connectionLost;
 };
 
 /**
@@ -212,12 +271,17 @@ public:
      *    Stream used for communications
      * \param detach
      *    Should the associated thread be joinable or detach instead?
+     * \param cache
+     *    Optional cache of resource chunks received in earlier
+     *    sessions (may be shared between several backends)
      */
     StreamBackend(const std::string &name, Scheduler *scheduler,
-        const std::string &nodeName, Stream *stream, bool detach);
+        const std::string &nodeName, Stream *stream, bool detach,
+        ResourceCache *cache = NULL);
 
     MTS_DECLARE_CLASS()
 protected:
+    friend class StreamBackendWriter;
     enum EMessage {
         EUnknown = 0,
         ENewProcess,
@@ -233,6 +297,11 @@ protected:
         EResourceExpired,
         EQuit,
         EIncompatible,
+        EQueryResourceChunks,
+        EResourceChunkRequest,
+        ENewChunkedResource,
+        ESetCompression,
+        ECompressedWorkResult,
         EHello = 0x1bcd
     };
 
@@ -241,14 +310,40 @@ protected:
     virtual void run();
     void sendWorkResult(int id, const WorkResult *result, bool cancelled);
     void sendCancellation(int id, int numLost);
+    void sendChunkRequest(int id, const std::vector<int> &missing);
+    void receiveResource(int id, MemoryStream *mstream);
+
+    /**
+     * \brief Queue a message for transmission by the writer thread
+     *
+     * When \c throttle is set, the call blocks while too many
+     * messages are waiting to be sent.
+     */
+    void enqueueMessage(MemoryStream *message, bool throttle);
+
+    /// Body of the writer thread
+    void writeMessages();
 private:
+    /// Cached chunk, which is about to be used by an incoming resource
+    struct PendingChunk {
+        std::vector<uint8_t> data;
+        int uses;
+    };
+
     Scheduler *m_scheduler;
     std::string m_nodeName;
     ref<Stream> m_stream;
     ref<MemoryStream> m_memStream;
     std::map<int, RemoteProcess *> m_processes;
     std::map<int, int> m_resources;
+    std::map<ResourceCache::Hash, PendingChunk> m_pendingChunks;
+    ref<ResourceCache> m_cache;
     ref<Mutex> m_sendMutex;
+    ref<ConditionVariable> m_sendCond;
+    std::deque<ref<MemoryStream> > m_sendQueue;
+    ref<Thread> m_writer;
+    bool m_writerShutdown;
+    int m_compressionLevel;
     bool m_detach;
 };
 
@@ -58,7 +58,8 @@ enum EStatsType {
     EPercentage,      ///< Percentage with respect to a base counter
     EMinimumValue,    ///< Minimum observed value of some quantity
     EMaximumValue,    ///< Maximum observed value of some quantity
-    EAverage          ///< Average value with respect to a base counter
+    EAverage,         ///< Average value with respect to a base counter
+    EMemoryUsage      ///< Live memory usage in bytes (the base counter holds the high-water mark)
 };
 
 #if (defined(_WIN32) && !defined(_WIN64)) || (defined(__POWERPC__) && !defined(_LP64))
@@ -210,6 +211,39 @@ public:
         } while (!atomicCompareAndExchange(ptr, newMaximum, curMaximum));
     }
 
+    /**
+     * \brief When this is a memory usage counter, this function records
+     * an allocation of the given size and updates the high-water mark
+     *
+     * Unlike the other counter types, memory counters are not spread
+     * over several cache lines, since the high-water mark requires a
+     * consistent view of the live value. They are therefore only meant
+     * to track large allocations (e.g. buffers of meshes, kd-trees,
+     * or textures) rather than individual small objects.
+     */
+    inline void recordAllocation(size_t size) {
+#if !defined(MTS_NO_STATISTICS)
+        #if MTS_32BIT_COUNTERS == 1
+            int32_t live = atomicAdd((volatile int32_t *) &m_value[0].value, (int32_t) size);
+            atomicMaximum((volatile int32_t *) &m_base[0].value, live);
+        #else
+            int64_t live = atomicAdd((volatile int64_t *) &m_value[0].value, (int64_t) size);
+            atomicMaximum((volatile int64_t *) &m_base[0].value, live);
+        #endif
+#endif
+    }
+
+    /// Record that memory previously passed to \ref recordAllocation() was released
+    inline void recordRelease(size_t size) {
+#if !defined(MTS_NO_STATISTICS)
+        #if MTS_32BIT_COUNTERS == 1
+            atomicAdd((volatile int32_t *) &m_value[0].value, -(int32_t) size);
+        #else
+            atomicAdd((volatile int64_t *) &m_value[0].value, -(int64_t) size);
+        #endif
+#endif
+    }
+
     /// Return the name of this counter
     inline const std::string &getName() const { return m_name; }
 
@@ -259,8 +293,17 @@ public:
     }
 #endif
 
-    /// Reset the stored counter values
+    /**
+     * \brief Reset the stored counter values
+     *
+     * Memory usage counters keep their live value, and their
+     * high-water mark is reset to it.
+     */
     inline void reset() {
+        if (m_type == EMemoryUsage) {
+            m_base[0].value = m_value[0].value;
+            return;
+        }
         for (int i=0; i<NUM_COUNTERS; ++i) {
             m_value[i].value = m_base[i].value = 0;
         }
@@ -353,6 +396,42 @@ public:
     /// Return a string containing gathered statistics
     std::string getStats();
 
+    /// Value and base of every counter at some point in time
+    typedef std::map<const StatsCounter *, std::pair<uint64_t, uint64_t> > Snapshot;
+
+    /// Record the current value and base of all counters
+    Snapshot getSnapshot();
+
+    /**
+     * \brief Return the values of all counters as a JSON object
+     *
+     * Counters are grouped by category. Percentages and averages are
+     * written as <tt>{"value": .., "base": ..}</tt> pairs, memory usage
+     * counters as <tt>{"live": .., "peak": ..}</tt> pairs, and all other
+     * counters as plain numbers. Unlike \ref getStats(), counters with
+     * a value of zero are included, so that every record has the
+     * same structure.
+     *
+     * \param since
+     *    When specified, accumulating counters (numbers, byte counts,
+     *    percentages and averages) report their increase since the given
+     *    snapshot. Minimum, maximum and memory usage counters always
+     *    report their current state.
+     */
+    std::string getStatsJSON(const Snapshot *since = NULL);
+
+    /**
+     * \brief Return the increase of a counter's value since a snapshot
+     *
+     * When the counter has been reset in the meantime, its current value
+     * is returned.
+     */
+    static uint64_t getIncrease(const StatsCounter *counter, const Snapshot &since);
+
+    /// Look up a counter by category and name (returns \c NULL if not found)
+    const StatsCounter *getCounter(const std::string &category,
+        const std::string &name);
+
     /// Reset all statistics counters
     void resetAll();
 
@@ -79,6 +79,18 @@ public:
     /// Return the core affinity
     int getCoreAffinity() const;
 
+    /**
+     * \brief Restrict the thread to the cores of a NUMA node
+     *
+     * Memory that the thread touches first is then allocated on this
+     * node. A core affinity set via \ref setCoreAffinity() takes
+     * precedence. Only supported on Linux; -1 means no restriction.
+     */
+    void setNUMANode(int node);
+
+    /// Return the NUMA node that the thread is restricted to
+    int getNUMANode() const;
+
     /**
      * \brief Specify whether or not this thread is critical
      *
@@ -145,6 +157,9 @@ public:
     /// Sleep for a certain amount of time
     static void sleep(unsigned int ms);
 
+    /// Yield the processor to another thread
+    static void yield();
+
     /// Initialize the threading system
     static void staticInitialization();
 
@@ -186,9 +201,6 @@ protected:
      */
     void exit();
 
-    /// Yield to another processor
-    void yield();
-
     /// The thread's run method
     virtual void run() = 0;
 private:
@@ -65,6 +65,9 @@ extern MTS_EXPORT_CORE std::string timeString(Float time, bool precise = false);
 /// Turn a memory size into a human-readable string
 extern MTS_EXPORT_CORE std::string memString(size_t size, bool precise = false);
 
+/// Quote and escape a string for use in a JSON document
+extern MTS_EXPORT_CORE std::string jsonString(const std::string &string);
+
 /// Return a string representation of a list of objects
 template<class Iterator> std::string containerToString(const Iterator &start, const Iterator &end) {
     std::ostringstream oss;
@@ -112,12 +115,34 @@ extern std::string MTS_EXPORT_CORE lastErrorText();
 /// Determine the number of available CPU cores
 extern MTS_EXPORT_CORE int getCoreCount();
 
+/**
+ * \brief Determine the number of NUMA nodes that contain available cores
+ *
+ * The topology is read from sysfs on Linux. On other platforms, or when
+ * it cannot be determined, the machine is treated as a single node.
+ */
+extern MTS_EXPORT_CORE int getNUMANodeCount();
+
+/**
+ * \brief Return the NUMA node of an available CPU core
+ *
+ * Cores are numbered from 0 to \ref getCoreCount()-1, in the same way as
+ * in \ref Thread::setCoreAffinity().
+ */
+extern MTS_EXPORT_CORE int getCoreNUMANode(int coreID);
+
+/// Return the operating system IDs of the available cores of a NUMA node
+extern MTS_EXPORT_CORE std::vector<int> getNUMANodeCPUs(int node);
+
 /// Return the host name of this machine
 extern MTS_EXPORT_CORE std::string getHostName();
 
 /// Return the process private memory usage in bytes
 extern MTS_EXPORT_CORE size_t getPrivateMemoryUsage();
 
+/// Return the peak physical memory usage (high-water mark) of the process in bytes
+extern MTS_EXPORT_CORE size_t getPeakMemoryUsage();
+
 /// Returns the total amount of memory available to the OS
 extern MTS_EXPORT_CORE size_t getTotalSystemMemory();
 
@@ -0,0 +1,129 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_EMITTERTREE_H_)
+#define __MITSUBA_RENDER_EMITTERTREE_H_
+
+#include <mitsuba/render/emitter.h>
+#include <mitsuba/core/pmf.h>
+#include <mitsuba/core/aabb.h>
+#include <boost/unordered_map.hpp>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Bounding volume hierarchy over the emitters of a scene, which is
+ * used to choose emitters for direct illumination sampling based on their
+ * estimated contribution at a reference point.
+ *
+ * Every node stores the total sampling weight of its emitters, their
+ * bounding box, and a cone bounding the directions into which they emit
+ * (following "Importance Sampling of Many Lights with Adaptive Tree
+ * Splitting" by Conty Estevez and Kulla, 2018). An emitter is chosen by
+ * descending from the root and picking one of the two children proportional
+ * to a conservative estimate of their contribution at the reference point.
+ * The discrete probability of this choice can be evaluated for arbitrary
+ * emitters, which is needed for multiple importance sampling.
+ *
+ * Emitters without a finite position (e.g. environment and directional
+ * emitters) are not part of the hierarchy. They are chosen according to
+ * their sampling weight, and the probability of choosing one of them
+ * is independent of the reference point.
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER EmitterTree : public Object {
+public:
+    /// Build the hierarchy over the given emitters
+    EmitterTree(const ref_vector<Emitter> &emitters);
+
+    /// Return the number of emitters in the hierarchy
+    inline size_t getEmitterCount() const { return m_emitters.size(); }
+
+    /**
+     * \brief Randomly choose an emitter for the given reference point
+     *
+     * \param ref
+     *    Reference point
+     * \param sample
+     *    A uniformly distributed sample on [0,1], which is adjusted
+     *    so that it can be reused
+     * \param pdf
+     *    Discrete probability of the chosen emitter
+     */
+    const Emitter *sampleReuse(const Point &ref, Float &sample, Float &pdf) const;
+
+    /// Evaluate the discrete probability of choosing an emitter in \ref sampleReuse()
+    Float pdf(const Point &ref, const Emitter *emitter) const;
+
+    /// Return a human-readable string representation
+    std::string toString() const;
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Node of the emitter hierarchy
+    struct Node {
+        /// Bounds of the emitter positions
+        AABB aabb;
+        /// Axis of the cone bounding the surface normals
+        Vector axis;
+        /// Half angle of the normal cone (>= pi: unbounded)
+        Float normalAngle;
+        /// Half angle of the emission profile around a normal
+        Float emissionAngle;
+        /// Total sampling weight
+        Float weight;
+        /// Parent node index (-1 for the root)
+        int32_t parent;
+        /// Child node indices (leaves: -1 and the emitter index)
+        int32_t left, right;
+
+        inline bool isLeaf() const { return left < 0; }
+    };
+
+    /// Recursively build the subtree over the given range of emitter indices
+    int32_t build(uint32_t *start, uint32_t *end, int32_t parent);
+
+    /// Estimated contribution of a node to a reference point
+    Float importance(const Node &node, const Point &ref) const;
+
+    /// Probability of descending into the left child of an interior node
+    Float leftProbability(const Node &node, const Point &ref) const;
+
+    /// Sampling weight of an emitter (one for all emitters if they sum to zero)
+    inline Float getWeight(const Emitter *emitter) const {
+        return m_uniform ? 1.0f : emitter->getSamplingWeight();
+    }
+
+    /// Virtual destructor
+    virtual ~EmitterTree() { }
+private:
+    std::vector<Node> m_nodes;
+    std::vector<const Emitter *> m_emitters;
+    std::vector<AABB> m_bounds;
+    std::vector<const Emitter *> m_infiniteEmitters;
+    AliasDistribution m_infinitePDF;
+    boost::unordered_map<const Emitter *, int32_t> m_leaves;
+    Float m_infiniteProb;
+    bool m_uniform;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_EMITTERTREE_H_ */
@@ -51,6 +51,16 @@ public:
     /// Merge an image block into the film
     virtual void put(const ImageBlock *block) = 0;
 
+    /**
+     * \brief Merge an image block into the film while other threads
+     * may be doing the same
+     *
+     * The default implementation serializes calls to \ref put(). Films
+     * that store their contents in an \ref ImageBlock override this
+     * function and only lock the rows that are covered by the block.
+     */
+    virtual void putConcurrent(const ImageBlock *block);
+
     /// Overwrite the film with the given bitmap and optionally multiply it by a scalar
     virtual void setBitmap(const Bitmap *bitmap, Float multiplier = 1.0f) = 0;
 
@@ -131,6 +141,7 @@ protected:
     Vector2i m_size, m_cropSize;
     bool m_highQualityEdges;
     ref<ReconstructionFilter> m_filter;
+    ref<Mutex> m_putMutex;
 };
 
 MTS_NAMESPACE_END
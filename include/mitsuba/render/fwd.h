@@ -30,6 +30,7 @@ struct BSDFSamplingRecord;
 struct DirectionSamplingRecord;
 struct DirectSamplingRecord;
 class Emitter;
+class EmitterTree;
 class Film;
 class GatherPhotonProcess;
 class HemisphereSampler;
@@ -22,6 +22,7 @@
 
 #include <mitsuba/core/timer.h>
 #include <mitsuba/core/lock.h>
+#include <mitsuba/core/statistics.h>
 #include <boost/static_assert.hpp>
 #include <stack>
 
@@ -59,6 +60,11 @@
 
 MTS_NAMESPACE_BEGIN
 
+/* Memory usage of kd-tree nodes, index lists, and temporary build data */
+namespace stats {
+    extern MTS_EXPORT_RENDER StatsCounter kdtreeMemory;
+    extern MTS_EXPORT_RENDER StatsCounter kdtreeBuildMemory;
+};
 
 /**
  * \brief Special "ordered" memory allocator
@@ -92,8 +98,10 @@ public:
      */
     void cleanup() {
         for (std::vector<Chunk>::iterator it = m_chunks.begin();
-                it != m_chunks.end(); ++it)
+                it != m_chunks.end(); ++it) {
             freeAligned((*it).start);
+            stats::kdtreeBuildMemory.recordRelease((*it).size);
+        }
         m_chunks.clear();
     }
 
@@ -139,6 +147,7 @@ public:
 
         Chunk chunk;
         chunk.start = (uint8_t *) allocAligned(allocSize);
+        stats::kdtreeBuildMemory.recordAllocation(allocSize);
         chunk.cur = chunk.start + size;
         chunk.size = allocSize;
         m_chunks.push_back(chunk);
@@ -743,16 +752,22 @@ public:
         m_parallelBuild = true;
         m_minMaxBins = 128;
         m_logLevel = EDebug;
+        m_nodeCount = m_indexCount = 0;
+        m_buildTime = m_heuristicCost = 0;
     }
 
     /**
      * \brief Release all memory
      */
     virtual ~GenericKDTree() {
-        if (m_indices)
+        if (m_indices) {
             delete[] m_indices;
-        if (m_nodes)
+            stats::kdtreeMemory.recordRelease(sizeof(IndexType) * m_indexCount);
+        }
+        if (m_nodes) {
             freeAligned(m_nodes-1); // undo alignment shift
+            stats::kdtreeMemory.recordRelease(sizeof(KDNode) * (m_nodeCount+1));
+        }
     }
 
     /**
@@ -931,6 +946,18 @@ public:
     inline SizeType getExactPrimitiveThreshold() const {
         return m_exactPrimThreshold;
     }
+
+    /// Return the number of nodes of the constructed tree
+    inline SizeType getNodeCount() const { return m_nodeCount; }
+
+    /// Return the number of primitive references stored in the leaf nodes
+    inline SizeType getIndexCount() const { return m_indexCount; }
+
+    /// Return the time (in seconds) that was needed to construct the tree
+    inline Float getBuildTime() const { return m_buildTime; }
+
+    /// Return the final cost of the tree according to the construction heuristic
+    inline Float getHeuristicCost() const { return m_heuristicCost; }
 protected:
     /**
      * \brief Once the tree has been constructed, it is rewritten into
@@ -972,8 +999,10 @@ protected:
         if (primCount == 0) {
             KDLog(EWarn, "kd-tree contains no geometry!");
             // +1 shift is for alignment purposes (see KDNode::getSibling)
+            m_nodeCount = 1;
             m_nodes = static_cast<KDNode *>(allocAligned(sizeof(KDNode) * 2))+1;
             m_nodes[0].initLeafNode(0, 0);
+            stats::kdtreeMemory.recordAllocation(sizeof(KDNode) * 2);
             return;
         }
 
@@ -993,7 +1022,7 @@ protected:
         OrderedChunkAllocator &leftAlloc = ctx.leftAlloc;
         IndexType *indices = leftAlloc.allocate<IndexType>(primCount);
 
-        ref<Timer> timer = new Timer();
+        ref<Timer> timer = new Timer(), buildTimer = new Timer();
         AABBType &aabb = m_aabb;
         aabb.reset();
         for (IndexType i=0; i<primCount; ++i) {
@@ -1113,6 +1142,8 @@ protected:
         m_nodes = static_cast<KDNode *> (allocAligned(
                 sizeof(KDNode) * (m_nodeCount+1)))+1;
         m_indices = new IndexType[m_indexCount];
+        stats::kdtreeMemory.recordAllocation(sizeof(KDNode) * (m_nodeCount+1)
+            + sizeof(IndexType) * m_indexCount);
 
         /* The following code rewrites all tree nodes with proper relative
            indices. It also computes the final tree cost and some other
@@ -1209,6 +1240,7 @@ protected:
         expLeavesVisited /= rootQuantity;
         expPrimitivesIntersected /= rootQuantity;
         heuristicCost /= rootQuantity;
+        m_heuristicCost = heuristicCost;
 
         /* Slightly enlarge the bounding box
            (necessary e.g. when the scene is planar) */
@@ -1255,6 +1287,7 @@ protected:
                 expPrimitivesIntersected);
         KDLog(m_logLevel, "   Final cost                  : %.2f", heuristicCost);
         KDLog(m_logLevel, "");
+        m_buildTime = buildTimer->getSeconds();
 
         #if defined(__LINUX__)
             /* Forcefully release Heap memory back to the OS */
@@ -2603,6 +2636,8 @@ protected:
     SizeType m_minMaxBins;
     SizeType m_nodeCount;
     SizeType m_indexCount;
+    Float m_buildTime;
+    Float m_heuristicCost;
     std::vector<TreeBuilder *> m_builders;
     std::vector<KDNode *> m_indirections;
     ref<Mutex> m_indirectionLock;
@@ -23,6 +23,10 @@
 #include <mitsuba/core/bitmap.h>
 #include <mitsuba/core/sched.h>
 #include <mitsuba/core/rfilter.h>
+#include <mitsuba/core/atomic.h>
+
+/// Number of rows protected by each spin lock in ImageBlock::putConcurrent() (log2)
+#define MTS_IMAGEBLOCK_STRIPE_SHIFT 2
 
 MTS_NAMESPACE_BEGIN
 
@@ -165,44 +169,121 @@ public:
                           max(std::min((int) std::floor(pos.x + filterRadius), size.x - 1),
                               std::min((int) std::floor(pos.y + filterRadius), size.y - 1));
 
-            /* Lookup values from the pre-rasterized filter */
-            for (int x=min.x, idx = 0; x<=max.x; ++x)
-                m_weightsX[idx++] = m_filter->evalDiscretized(x-pos.x);
-            for (int y=min.y, idx = 0; y<=max.y; ++y)
-                m_weightsY[idx++] = m_filter->evalDiscretized(y-pos.y);
-
-            /* Rasterize the filtered sample into the framebuffer */
-            for (int y=min.y, yr=0; y<=max.y; ++y, ++yr) {
-                const Float weightY = m_weightsY[yr];
-                Float *dest = m_bitmap->getFloatData()
-                    + (y * (size_t) size.x + min.x) * channels;
-
-                for (int x=min.x, xr=0; x<=max.x; ++x, ++xr) {
-                    const Float weight = m_weightsX[xr] * weightY;
+            const int width = max.x - min.x + 1, height = max.y - min.y + 1;
+            if (width <= 0 || height <= 0)
+                return true;
 
+            /* Lookup values from the pre-rasterized filter */
+            m_filter->evalDiscretized(pos.x, min.x, width, m_weightsX);
+            m_filter->evalDiscretized(pos.y, min.y, height, m_weightsY);
+
+            /* Rasterize the filtered sample into the framebuffer. Since the
+               filter is separable, every row of the footprint receives a
+               scaled copy of the same horizontally weighted sample values */
+            Float *dest = m_bitmap->getFloatData()
+                + (min.y * (size_t) size.x + min.x) * channels;
+            const size_t rowStride = (size_t) size.x * channels;
+
+            bool done = false;
+            if (channels == SPECTRUM_SAMPLES + 2)
+                done = rasterizeFixed<SPECTRUM_SAMPLES + 2>(dest, rowStride, width, height, value);
+            else if (channels == SPECTRUM_SAMPLES)
+                done = rasterizeFixed<SPECTRUM_SAMPLES>(dest, rowStride, width, height, value);
+
+            if (!done) {
+                for (int x=0, idx=0; x<width; ++x)
                     for (int k=0; k<channels; ++k)
-                        *dest++ += weight * value[k];
-                }
+                        m_rowValues[idx++] = m_weightsX[x] * value[k];
+                for (int y=0; y<height; ++y, dest += rowStride)
+                    accumulateRow(dest, m_rowValues, m_weightsY[y], width * channels);
             }
         }
 
         return true;
 
         bad_sample:
-        {
-            std::ostringstream oss;
-            oss << "Invalid sample value : [";
-            for (int i=0; i<channels; ++i) {
-                oss << value[i];
-                if (i+1 < channels)
-                    oss << ", ";
+        warnInvalidSample(value);
+        return false;
+    }
+
+    /**
+     * \brief Store a single sample inside an image block that is
+     * shared by several threads
+     *
+     * This function is equivalent to \ref put(const Point2 &, const Float *),
+     * except that it may be called concurrently from multiple threads.
+     * The rows of the block are partitioned into stripes that are protected
+     * by spin locks, and a sample only locks the few stripes covered by its
+     * filter footprint. No per-block scratch memory is used. This allows
+     * particle tracing-style techniques, which splat samples anywhere
+     * on the image plane, to share a single full-resolution accumulation
+     * buffer instead of allocating one per thread.
+     *
+     * \param _pos
+     *    Denotes the sample position in fractional pixel coordinates
+     * \param value
+     *    Pointer to an array containing each channel of the sample values.
+     *    The array must match the length given by \ref getChannelCount()
+     * \return \c false if one of the sample values was \a invalid, e.g.
+     *    NaN or negative. A warning is also printed in this case
+     */
+    FINLINE bool putConcurrent(const Point2 &_pos, const Float *value) {
+        const int channels = m_bitmap->getChannelCount();
+
+        /* Check if all sample values are valid */
+        for (int i=0; i<channels; ++i) {
+            if (EXPECT_NOT_TAKEN((!std::isfinite(value[i]) || value[i] < 0) && m_warn)) {
+                warnInvalidSample(value);
+                return false;
             }
-            oss << "]";
-            Log(EWarn, "%s", oss.str().c_str());
         }
-        return false;
+
+        const Float filterRadius = m_filter->getRadius();
+        const Vector2i &size = m_bitmap->getSize();
+
+        /* Convert to pixel coordinates within the image block */
+        const Point2 pos(
+            _pos.x - 0.5f - (m_offset.x - m_borderSize),
+            _pos.y - 0.5f - (m_offset.y - m_borderSize));
+
+        /* Determine the affected range of pixels */
+        const Point2i min(std::max((int) std::ceil (pos.x - filterRadius), 0),
+                          std::max((int) std::ceil (pos.y - filterRadius), 0)),
+                      max(std::min((int) std::floor(pos.x + filterRadius), size.x - 1),
+                          std::min((int) std::floor(pos.y + filterRadius), size.y - 1));
+
+        if (min.x > max.x || min.y > max.y)
+            return true;
+
+        lockStripes(min.y, max.y);
+
+        /* Rasterize the filtered sample into the framebuffer. The filter
+           weights are looked up on the fly, since the scratch buffers of
+           the image block can't be shared between threads */
+        for (int y=min.y; y<=max.y; ++y) {
+            const Float weightY = m_filter->evalDiscretized(y-pos.y);
+            Float *dest = m_bitmap->getFloatData()
+                + (y * (size_t) size.x + min.x) * channels;
+
+            for (int x=min.x; x<=max.x; ++x) {
+                const Float weight = m_filter->evalDiscretized(x-pos.x) * weightY;
+
+                for (int k=0; k<channels; ++k)
+                    *dest++ += weight * value[k];
+            }
+        }
+
+        unlockStripes(min.y, max.y);
+
+        return true;
     }
 
+    /**
+     * \brief Accumulate another image block into this one while other
+     * threads may concurrently call \ref putConcurrent()
+     */
+    void putConcurrent(const ImageBlock *block);
+
     /// Create a clone of the entire image block
     ref<ImageBlock> clone() const {
         ref<ImageBlock> clone = new ImageBlock(m_bitmap->getPixelFormat(),
@@ -234,13 +315,81 @@ public:
 protected:
     /// Virtual destructor
     virtual ~ImageBlock();
+
+    /// Print a warning about an invalid sample value
+    void warnInvalidSample(const Float *value) const;
+
+    /// Compute <tt>dest[i] += weight * source[i]</tt> for \c count entries
+    static FINLINE void accumulateRow(Float *dest, const Float *source,
+            Float weight, int count) {
+        int i = 0;
+#if defined(MTS_SSE)
+        const __m128 weightV = _mm_set1_ps(weight);
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i),
+                _mm_mul_ps(weightV, _mm_loadu_ps(source + i))));
+#endif
+        for (; i < count; ++i)
+            dest[i] += weight * source[i];
+    }
+
+    /// Rasterize a sample with a fixed footprint width and channel count
+    template <int Width, int Channels> FINLINE void rasterizeFixed(Float *dest,
+            size_t rowStride, int height, const Float *value) {
+        for (int x=0; x<Width; ++x)
+            for (int k=0; k<Channels; ++k)
+                m_rowValues[x*Channels + k] = m_weightsX[x] * value[k];
+        for (int y=0; y<height; ++y, dest += rowStride)
+            accumulateRow(dest, m_rowValues, m_weightsY[y], Width * Channels);
+    }
+
+    /**
+     * \brief Dispatch to specialized loops for the footprints of common
+     * filters (e.g. 4 pixels for \c gaussian and \c mitchell, 6 pixels
+     * for a 3-lobe \c lanczos). Returns \c false for other widths.
+     */
+    template <int Channels> FINLINE bool rasterizeFixed(Float *dest,
+            size_t rowStride, int width, int height, const Float *value) {
+        switch (width) {
+            case 2: rasterizeFixed<2, Channels>(dest, rowStride, height, value); return true;
+            case 3: rasterizeFixed<3, Channels>(dest, rowStride, height, value); return true;
+            case 4: rasterizeFixed<4, Channels>(dest, rowStride, height, value); return true;
+            case 5: rasterizeFixed<5, Channels>(dest, rowStride, height, value); return true;
+            case 6: rasterizeFixed<6, Channels>(dest, rowStride, height, value); return true;
+            default: return false;
+        }
+    }
+
+    /// Acquire the spin locks of all stripes overlapping the given rows
+    inline void lockStripes(int minY, int maxY) {
+        /* Locks are always acquired in increasing order */
+        for (int i = minY >> MTS_IMAGEBLOCK_STRIPE_SHIFT,
+                 end = maxY >> MTS_IMAGEBLOCK_STRIPE_SHIFT; i <= end; ++i) {
+            if (EXPECT_NOT_TAKEN(!atomicCompareAndExchange(m_stripeLocks + i, 1, 0)))
+                waitStripe(i);
+        }
+    }
+
+    /// Release the spin locks of all stripes overlapping the given rows
+    inline void unlockStripes(int minY, int maxY) {
+        for (int i = minY >> MTS_IMAGEBLOCK_STRIPE_SHIFT,
+                 end = maxY >> MTS_IMAGEBLOCK_STRIPE_SHIFT; i <= end; ++i)
+            atomicCompareAndExchange(m_stripeLocks + i, 0, 1);
+    }
+
+    /// Spin until the lock of the given stripe could be acquired
+    void waitStripe(int stripe);
+
+    /// Allocate the stripe locks used by putConcurrent()
+    void allocateStripeLocks();
 protected:
     ref<Bitmap> m_bitmap;
     Point2i m_offset;
     Vector2i m_size;
     int m_borderSize;
     const ReconstructionFilter *m_filter;
-    Float *m_weightsX, *m_weightsY;
+    Float *m_weightsX, *m_weightsY, *m_rowValues;
+    volatile int32_t *m_stripeLocks;
     bool m_warn;
 };
 
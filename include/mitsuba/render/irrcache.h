@@ -25,6 +25,12 @@
 
 MTS_NAMESPACE_BEGIN
 
+/// Irradiance cache file version
+#define MTS_IRRCACHE_FILE_VERSION 0x01
+
+/// Make sure that the records in a cache file start on a cache line
+#define MTS_IRRCACHE_FILE_ALIGNMENT 64
+
 /* 3 (X, Y, and Z) components for each spectral sample */
 typedef Spectrum RotationalGradient[3];
 typedef Spectrum TranslationalGradient[3];
@@ -215,6 +221,34 @@ public:
     /// Manually insert an irradiance record
     void insert(Record *rec);
 
+    /// Insert copies of all records stored in another irradiance cache
+    void insert(const IrradianceCache *cache);
+
+    /// Return the number of stored records
+    inline size_t getRecordCount() const { return m_records.size(); }
+
+    /**
+     * \brief Write all records to a cache file on disk
+     *
+     * The records are stored as a flat array following a small header,
+     * which allows \ref load() to memory-map the file. This can be used
+     * to reuse the cache across several renderings of a static scene
+     * (e.g. the frames of a camera fly-through).
+     */
+    void save(const fs::path &filename) const;
+
+    /**
+     * \brief Add the records of a cache file created by \ref save()
+     *
+     * Each record is validated against the geometry of the given scene:
+     * records that lie outside of the cache bounds, or which no longer
+     * coincide with a surface of a matching orientation, are discarded.
+     * Invalid, incompatible, or truncated files are ignored with a warning.
+     *
+     * \return The number of records that were added to the cache
+     */
+    size_t load(const fs::path &filename, const Scene *scene);
+
     /**
      * Serialize an irradiance cache to a binary data stream
      */
@@ -324,18 +358,28 @@ public:
 protected:
     /// Release all memory
     virtual ~IrradianceCache();
+
+    /// Header of an irradiance cache file
+    struct IrradianceCacheHeader {
+        char identifier[3];
+        uint8_t version;
+        /// Size of a record in bytes (depends on the precision/spectral samples)
+        uint32_t recordSize;
+        uint64_t recordCount;
+    };
 protected:
     /* ===================================================================== */
     /*                        Protected attributes                           */
     /* ===================================================================== */
 
+    typedef LockFreeList<Record *> RecordList;
+
     DynamicOctree<Record *> m_octree;
-    std::vector<Record *> m_records;
+    RecordList m_records;
     Float m_kappa;
     Float m_sceneSize;
     Float m_minDist, m_maxDist;
     bool m_clampScreen, m_clampNeighbor, m_useGradients;
-    ref<Mutex> m_mutex;
 };
 
 MTS_NAMESPACE_END
@@ -26,6 +26,9 @@
 #include <mitsuba/core/mmap.h>
 #include <mitsuba/core/timer.h>
 #include <mitsuba/core/statistics.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/render/texcache.h>
+#include <mitsuba/render/texcomp.h>
 #include <boost/filesystem/fstream.hpp>
 
 MTS_NAMESPACE_BEGIN
@@ -37,16 +40,20 @@ MTS_NAMESPACE_BEGIN
 #define MTS_MIPMAP_LUT_SIZE 64
 
 /// MIP map cache file version
-#define MTS_MIPMAP_CACHE_VERSION 0x01
+#define MTS_MIPMAP_CACHE_VERSION 0x02
 
 /// Make sure that the actual cache contents start on a cache line
 #define MTS_MIPMAP_CACHE_ALIGNMENT 64
 
+/// Tiles of out-of-core MIP maps span 2^MTS_MIPMAP_TILE_LOG texels along each axis
+#define MTS_MIPMAP_TILE_LOG 6
+
 /* Some statistics counters */
 namespace stats {
     extern MTS_EXPORT_RENDER StatsCounter avgEWASamples;
     extern MTS_EXPORT_RENDER StatsCounter clampedAnisotropy;
     extern MTS_EXPORT_RENDER StatsCounter mipStorage;
+    extern MTS_EXPORT_RENDER StatsCounter mipMemory;
     extern MTS_EXPORT_RENDER StatsCounter filteredLookups;
 };
 
@@ -74,7 +81,14 @@ enum EMIPFilterType {
  * anisotropy of texture lookups in UV space.
  *
  * Generating good mip maps is costly, and therefore this class provides
- * the means to cache them on disk if desired.
+ * the means to cache them on disk if desired. Cache files can either be
+ * memory-mapped, or opened in tiled mode, where square tiles of each
+ * level are loaded on demand into the global \ref TextureTileCache.
+ *
+ * Optionally, the texels can be stored in the block-compressed
+ * \ref TCompressedBlock format, which reduces the memory footprint
+ * (and thus the cache pressure of texture lookups) by a factor of
+ * 2.7 (monochromatic) to 4.8 (RGB) over half precision storage.
  *
  * \tparam Value
  *    This class can be parameterized to yield MIP map classes for
@@ -88,7 +102,8 @@ enum EMIPFilterType {
  *
  * \ingroup librender
  */
-template <typename Value, typename QuantizedValue> class TMIPMap : public Object {
+template <typename Value, typename QuantizedValue> class TMIPMap
+        : public Object, public TextureTileCache::TileSource {
 public:
 #if MTS_MIPMAP_BLOCKED == 1
     /// Use a blocked array to store MIP map data
@@ -98,6 +113,9 @@ public:
     typedef LinearArray<QuantizedValue> Array2DType;
 #endif
 
+    /// Array type used to store block-compressed MIP map data
+    typedef CompressedArray<Value> CompressedArrayType;
+
     /// Shortcut
     typedef ReconstructionFilter::EBoundaryCondition EBoundaryCondition;
 
@@ -151,6 +169,10 @@ public:
      *    When an RGB image is transformed into a spectral representation,
      *    this parameter specifies what conversion method should be used.
      *    See \ref Spectrum::EConversionIntent for further details.
+     *
+     * \param compressed
+     *    Store the texels in the lossy block-compressed format
+     *    implemented by \ref TCompressedBlock?
      */
     TMIPMap(Bitmap *bitmap_,
             Bitmap::EPixelFormat pixelFormat,
@@ -163,9 +185,11 @@ public:
             fs::path cacheFilename = fs::path(),
             uint64_t timestamp = 0,
             Float maxValue = 1.0f,
-            Spectrum::EConversionIntent intent = Spectrum::EReflectance)
-        : m_pixelFormat(pixelFormat), m_bcu(bcu), m_bcv(bcv), m_filterType(filterType),
-          m_weightLut(NULL), m_maxAnisotropy(maxAnisotropy) {
+            Spectrum::EConversionIntent intent = Spectrum::EReflectance,
+            bool compressed = false)
+        : m_tileCache(NULL), m_pixelFormat(pixelFormat), m_bcu(bcu), m_bcv(bcv),
+          m_filterType(filterType), m_weightLut(NULL), m_maxAnisotropy(maxAnisotropy),
+          m_blocks(NULL), m_compressed(compressed) {
 
         /* Keep track of time */
         ref<Timer> timer = new Timer();
@@ -176,7 +200,7 @@ public:
         if (padding)
             padding = MTS_MIPMAP_CACHE_ALIGNMENT - padding;
         size_t cacheSize = sizeof(MIPMapHeader) + padding +
-            Array2DType::bufferSize(bitmap_->getSize());
+            levelBufferSize(bitmap_->getSize(), compressed);
 
         /* 1. Determine the number of MIP levels. The following
               code also handles non-power-of-2 input. */
@@ -186,7 +210,7 @@ public:
             while (size.x > 1 || size.y > 1) {
                 size.x = std::max(1, (size.x + 1) / 2);
                 size.y = std::max(1, (size.y + 1) / 2);
-                cacheSize += Array2DType::bufferSize(size);
+                cacheSize += levelBufferSize(size, compressed);
                 ++m_levels;
             }
         }
@@ -211,23 +235,20 @@ public:
         /* 2. Store the base image in a suitable memory layout */
         m_pyramid = new Array2DType[m_levels];
         m_sizeRatio = new Vector2[m_levels];
+        if (m_compressed)
+            m_blocks = new CompressedArrayType[m_levels];
 
         /* Allocate memory for the first MIP map level */
-        if (mmapPtr) {
+        if (mmapPtr)
             mmapPtr += sizeof(MIPMapHeader) + padding;
-            m_pyramid[0].map(mmapPtr, bitmap_->getSize());
-            mmapPtr += m_pyramid[0].getBufferSize();
-        } else {
-            m_pyramid[0].alloc(bitmap_->getSize());
-        }
+        allocLevel(0, bitmap_->getSize(), mmapPtr);
 
         /* Initialize the first mip map level and extract some general
            information (i.e. the minimum, maximum, and average texture value) */
         ref<Bitmap> bitmap = bitmap_->expand()->convert(pixelFormat,
             componentFormat, 1.0f, 1.0f, intent);
 
-        m_pyramid[0].cleanup();
-        m_pyramid[0].init((Value *) bitmap->getData(), m_minimum, m_maximum, m_average);
+        initLevel(0, (Value *) bitmap->getData(), true);
 
         if (m_minimum.min() < 0) {
             Log(EWarn, "The texture contains negative pixel values! These will be clamped!");
@@ -236,7 +257,7 @@ public:
             for (size_t i=0, count=bitmap->getPixelCount(); i<count; ++i)
                 (*value++).clampNegative();
 
-            m_pyramid[0].init((Value *) bitmap->getData(), m_minimum, m_maximum, m_average);
+            initLevel(0, (Value *) bitmap->getData(), true);
         }
 
         m_sizeRatio[0] = Vector2(1, 1);
@@ -251,16 +272,10 @@ public:
                 size.y = std::max(1, (size.y + 1) / 2);
 
                 /* Either allocate memory or index into the memory map file */
-                if (mmapPtr) {
-                    m_pyramid[m_levels].map(mmapPtr, size);
-                    mmapPtr += m_pyramid[m_levels].getBufferSize();
-                } else {
-                    m_pyramid[m_levels].alloc(size);
-                }
+                allocLevel(m_levels, size, mmapPtr);
 
                 bitmap = bitmap->resample(rfilter, bcu, bcv, size, 0.0f, maxValue);
-                m_pyramid[m_levels].cleanup();
-                m_pyramid[m_levels].init((Value *) bitmap->getData());
+                initLevel(m_levels, (Value *) bitmap->getData(), false);
                 m_sizeRatio[m_levels] = Vector2(
                     (Float) size.x / (Float) m_pyramid[0].getWidth(),
                     (Float) size.y / (Float) m_pyramid[0].getHeight());
@@ -280,6 +295,7 @@ public:
             header.bcu = (uint8_t) bcu;
             header.bcv = (uint8_t) bcv;
             header.filterType = (uint8_t) m_filterType;
+            header.compressed = (uint8_t) m_compressed;
             header.gamma = (float) bitmap_->getGamma();
             header.width = bitmap_->getWidth();
             header.height = bitmap_->getHeight();
@@ -293,6 +309,10 @@ public:
         Log(EDebug, "Created %s of MIP maps in %i ms", memString(
             getBufferSize()).c_str(), timer->getMilliseconds());
 
+        /* Memory-mapped levels are backed by the cache file */
+        if (!m_mmap)
+            stats::mipMemory.recordAllocation(getBufferSize());
+
         if (m_filterType == EEWA) {
             m_weightLut = static_cast<Float *>(allocAligned(sizeof(Float) * MTS_MIPMAP_LUT_SIZE));
             for (int i=0; i<MTS_MIPMAP_LUT_SIZE; ++i) {
@@ -315,19 +335,40 @@ public:
      *    kernel. This is necessary to bound the computational
      *    cost of filtered lookups. This parameter is independent of the
      *    cache file that was previously created.
+     *
+     * \param tiled
+     *    Instead of mapping the whole file into memory, load tiles of
+     *    \f$2^{\texttt{MTS\_MIPMAP\_TILE\_LOG}}\f$ texels squared on
+     *    demand and keep them in the global \ref TextureTileCache, whose
+     *    memory budget then bounds the footprint of the texture.
      */
-    TMIPMap(fs::path cacheFilename, Float maxAnisotropy = 20.0f)
-            : m_weightLut(NULL), m_maxAnisotropy(maxAnisotropy) {
-        m_mmap = new MemoryMappedFile(cacheFilename);
-        uint8_t *mmapPtr = (uint8_t *) m_mmap->getData();
-        Log(EInfo, "Mapped MIP map cache file \"%s\" into memory (%s).", cacheFilename.string().c_str(),
-            memString(m_mmap->getSize()).c_str());
-
-        stats::mipStorage += m_mmap->getSize();
-
+    TMIPMap(fs::path cacheFilename, Float maxAnisotropy = 20.0f, bool tiled = false)
+            : m_tileCache(NULL), m_weightLut(NULL), m_maxAnisotropy(maxAnisotropy),
+              m_blocks(NULL) {
         /* Load the file header, and run some santity checks */
         MIPMapHeader header;
-        memcpy(&header, mmapPtr, sizeof(MIPMapHeader));
+        uint8_t *mmapPtr = NULL;
+
+        if (tiled) {
+#if MTS_MIPMAP_BLOCKED != 1
+            Log(EError, "Tiled MIP map cache files require a blocked memory layout!");
+#endif
+            m_tileFile = new FileStream(cacheFilename, FileStream::EReadOnly);
+            m_tileFile->read(&header, sizeof(MIPMapHeader));
+            m_tileMutex = new Mutex();
+            m_tileCache = TextureTileCache::getInstance();
+            Log(EInfo, "Opened MIP map cache file \"%s\" for tiled access (%s).",
+                cacheFilename.string().c_str(), memString(m_tileFile->getSize()).c_str());
+        } else {
+            m_mmap = new MemoryMappedFile(cacheFilename);
+            mmapPtr = (uint8_t *) m_mmap->getData();
+            Log(EInfo, "Mapped MIP map cache file \"%s\" into memory (%s).", cacheFilename.string().c_str(),
+                memString(m_mmap->getSize()).c_str());
+
+            stats::mipStorage += m_mmap->getSize();
+            memcpy(&header, mmapPtr, sizeof(MIPMapHeader));
+        }
+
         Assert(header.identifier[0] == 'M' && header.identifier[1] == 'I'
             && header.identifier[2] == 'P' && header.version == MTS_MIPMAP_CACHE_VERSION);
         m_pixelFormat = (Bitmap::EPixelFormat) header.pixelFormat;
@@ -335,22 +376,28 @@ public:
         m_bcu = (EBoundaryCondition) header.bcu;
         m_bcv = (EBoundaryCondition) header.bcv;
         m_filterType = (EMIPFilterType) header.filterType;
+        m_compressed = header.compressed != 0;
         m_minimum = header.minimum;
         m_maximum = header.maximum;
         m_average = header.average;
 
-        /* Move the pointer to the beginning of the MIP map data */
+        /* Determine the offset of the MIP map data */
         size_t padding = sizeof(MIPMapHeader) % MTS_MIPMAP_CACHE_ALIGNMENT;
         if (padding)
             padding = MTS_MIPMAP_CACHE_ALIGNMENT - padding;
-        mmapPtr += sizeof(MIPMapHeader) + padding;
+        size_t offset = sizeof(MIPMapHeader) + padding;
 
-        /* Map the highest resolution level */
+        /* Map the highest resolution level (in tiled mode,
+           the arrays only keep track of the level sizes) */
         m_pyramid = new Array2DType[m_levels];
         m_sizeRatio = new Vector2[m_levels];
+        if (m_compressed)
+            m_blocks = new CompressedArrayType[m_levels];
+        m_levelOffsets.resize(m_levels);
         Vector2i size(header.width, header.height);
-        m_pyramid[0].map(mmapPtr, size);
-        mmapPtr += m_pyramid[0].getBufferSize();
+        mapLevel(0, size, mmapPtr ? mmapPtr + offset : NULL);
+        m_levelOffsets[0] = offset;
+        offset += levelBufferSize(size, m_compressed);
         m_sizeRatio[0] = Vector2(1, 1);
 
         if (m_filterType != ENearest && m_filterType != EBilinear) {
@@ -359,11 +406,13 @@ public:
             while (size.x > 1 || size.y > 1) {
                 size.x = std::max(1, (size.x + 1) / 2);
                 size.y = std::max(1, (size.y + 1) / 2);
-                m_pyramid[level].map(mmapPtr, size);
+                mapLevel(level, size, mmapPtr ? mmapPtr + offset : NULL);
                 m_sizeRatio[level] = Vector2(
                     (Float) size.x / (Float) m_pyramid[0].getWidth(),
                     (Float) size.y / (Float) m_pyramid[0].getHeight());
-                mmapPtr += m_pyramid[level++].getBufferSize();
+                m_levelOffsets[level] = offset;
+                offset += levelBufferSize(size, m_compressed);
+                ++level;
             }
             Assert(level == m_levels);
         }
@@ -379,7 +428,12 @@ public:
 
     /// Release all memory
     ~TMIPMap() {
+        if (m_tileCache)
+            m_tileCache->release(this);
+        else if (!m_mmap)
+            stats::mipMemory.recordRelease(getBufferSize());
         delete[] m_pyramid;
+        delete[] m_blocks;
         delete[] m_sizeRatio;
         if (m_weightLut)
             freeAligned(m_weightLut);
@@ -400,11 +454,14 @@ public:
      * \param gamma
      *    If nonzero, it is verified that the provided gamma value
      *    matches that of the cache file.
+     * \param compressed
+     *    Whether the cache file should contain block-compressed texels
      * \return \c true if the texture file is good for use
      */
     static bool validateCacheFile(const fs::path &path, uint64_t timestamp,
             Bitmap::EPixelFormat pixelFormat, EBoundaryCondition bcu,
-            EBoundaryCondition bcv, EMIPFilterType filterType, Float gamma) {
+            EBoundaryCondition bcv, EMIPFilterType filterType, Float gamma,
+            bool compressed = false) {
         fs::ifstream is(path);
         if (!is.good())
             return false;
@@ -419,7 +476,8 @@ public:
             || header.timestamp != timestamp
             || header.bcu != (uint8_t) bcu || header.bcv != (uint8_t) bcv
             || header.pixelFormat != (uint8_t) pixelFormat
-            || header.filterType != (uint8_t) filterType)
+            || header.filterType != (uint8_t) filterType
+            || header.compressed != (uint8_t) compressed)
             return false;
 
         if (gamma != 0 && (float) gamma != header.gamma)
@@ -432,13 +490,13 @@ public:
 
         Vector2i size(header.width, header.height);
         size_t expectedFileSize = sizeof(MIPMapHeader) + padding
-            + Array2DType::bufferSize(size);
+            + levelBufferSize(size, compressed);
 
         if (filterType != ENearest && filterType != EBilinear) {
             while (size.x > 1 || size.y > 1) {
                 size.x = std::max(1, (size.x + 1) / 2);
                 size.y = std::max(1, (size.y + 1) / 2);
-                expectedFileSize += Array2DType::bufferSize(size);
+                expectedFileSize += levelBufferSize(size, compressed);
             }
         }
 
@@ -449,7 +507,7 @@ public:
     size_t getBufferSize() const {
         size_t size = 0;
         for (int i=0; i<m_levels; ++i)
-            size += m_pyramid[i].getBufferSize();
+            size += levelBufferSize(m_pyramid[i].getSize(), m_compressed);
         return size;
     }
 
@@ -477,7 +535,18 @@ public:
     /// Get the component-wise average
     inline const Value &getAverage() const { return m_average; }
 
-    /// Return the blocked array used to store a given MIP level
+    /// Is the MIP map loaded on demand through the \ref TextureTileCache?
+    inline bool isTiled() const { return m_tileCache != NULL; }
+
+    /// Are the texels stored in a block-compressed format?
+    inline bool isCompressed() const { return m_compressed; }
+
+    /**
+     * \brief Return the blocked array used to store a given MIP level
+     *
+     * In tiled or compressed mode, the array does not provide access
+     * to the texel data.
+     */
     inline const Array2DType &getArray(int level = 0) const {
         return m_pyramid[level];
     }
@@ -491,7 +560,17 @@ public:
             array.getSize()
         );
 
-        array.copyTo((QuantizedValue *) result->getData());
+        if (m_tileCache) {
+            QuantizedValue *target = (QuantizedValue *) result->getData();
+            TextureTileCache::Cursor cursor;
+            for (int y=0; y<array.getHeight(); ++y)
+                for (int x=0; x<array.getWidth(); ++x)
+                    *target++ = QuantizedValue(fetchTile(level, x, y, cursor));
+        } else if (m_compressed) {
+            m_blocks[level].copyTo((QuantizedValue *) result->getData());
+        } else {
+            array.copyTo((QuantizedValue *) result->getData());
+        }
 
         return result;
     }
@@ -501,6 +580,18 @@ public:
      * coordinates, while accounting for boundary conditions
      */
     inline Value evalTexel(int level, int x, int y) const {
+        TextureTileCache::Cursor cursor;
+        return evalTexel(level, x, y, cursor);
+    }
+
+    /**
+     * \brief Return the texture value at a texel specified using integer
+     * coordinates, while accounting for boundary conditions
+     *
+     * In tiled mode, the last accessed tile remains pinned in \c cursor,
+     * so that lookups of neighboring texels do not lock the tile cache.
+     */
+    inline Value evalTexel(int level, int x, int y, TextureTileCache::Cursor &cursor) const {
         const Vector2i &size = m_pyramid[level].getSize();
 
         if (x < 0 || x >= size.x) {
@@ -559,9 +650,46 @@ public:
             }
         }
 
+        if (EXPECT_NOT_TAKEN(m_tileCache != NULL))
+            return fetchTile(level, x, y, cursor);
+        else if (m_compressed)
+            return m_blocks[level](x, y);
+
         return Value(m_pyramid[level](x, y));
     }
 
+    /// Return the size of an out-of-core tile in bytes
+    size_t getTileBytes() const {
+        const size_t tileBlocks = ((size_t) 1 << MTS_MIPMAP_TILE_LOG) / Array2DType::blockSize;
+        return tileBlocks * tileBlocks * getBlockBytes();
+    }
+
+    /**
+     * \brief Load a tile of a level from the cache file
+     *
+     * A tile holds a square region of blocks, which are stored in the same
+     * order as in the \ref BlockedArray of the level. Each row of blocks
+     * is contiguous in the file and read with a single call.
+     */
+    void loadTile(int level, int x, int y, uint8_t *target) const {
+        const size_t blockSize = Array2DType::blockSize,
+                     blockBytes = getBlockBytes(),
+                     tileBlocks = ((size_t) 1 << MTS_MIPMAP_TILE_LOG) / blockSize;
+
+        const Vector2i &size = m_pyramid[level].getSize();
+        size_t xBlocks = (size.x + blockSize - 1) / blockSize,
+               yBlocks = (size.y + blockSize - 1) / blockSize,
+               xb = x * tileBlocks, yb = y * tileBlocks,
+               nx = std::min(tileBlocks, xBlocks - xb),
+               ny = std::min(tileBlocks, yBlocks - yb);
+
+        LockGuard lock(m_tileMutex);
+        for (size_t i=0; i<ny; ++i) {
+            m_tileFile->seek(m_levelOffsets[level] + blockBytes * (xb + (yb + i) * xBlocks));
+            m_tileFile->read(target + i * tileBlocks * blockBytes, nx * blockBytes);
+        }
+    }
+
     /// Evaluate the texture at the given resolution using a box filter
     inline Value evalBox(int level, const Point2 &uv) const {
         const Vector2i &size = m_pyramid[level].getSize();
@@ -589,10 +717,11 @@ public:
         Float dx1 = u - xPos, dx2 = 1.0f - dx1,
               dy1 = v - yPos, dy2 = 1.0f - dy1;
 
-        return evalTexel(level, xPos, yPos) * dx2 * dy2
-             + evalTexel(level, xPos, yPos + 1) * dx2 * dy1
-             + evalTexel(level, xPos + 1, yPos) * dx1 * dy2
-             + evalTexel(level, xPos + 1, yPos + 1) * dx1 * dy1;
+        TextureTileCache::Cursor cursor;
+        return evalTexel(level, xPos, yPos, cursor) * dx2 * dy2
+             + evalTexel(level, xPos, yPos + 1, cursor) * dx2 * dy1
+             + evalTexel(level, xPos + 1, yPos, cursor) * dx1 * dy2
+             + evalTexel(level, xPos + 1, yPos + 1, cursor) * dx1 * dy1;
     }
 
     /**
@@ -615,10 +744,11 @@ public:
         int xPos = math::floorToInt(u), yPos = math::floorToInt(v);
         Float dx = u - xPos, dy = v - yPos;
 
-        const Value p00 = evalTexel(level, xPos,   yPos);
-        const Value p10 = evalTexel(level, xPos+1, yPos);
-        const Value p01 = evalTexel(level, xPos,   yPos+1);
-        const Value p11 = evalTexel(level, xPos+1, yPos+1);
+        TextureTileCache::Cursor cursor;
+        const Value p00 = evalTexel(level, xPos,   yPos,   cursor);
+        const Value p10 = evalTexel(level, xPos+1, yPos,   cursor);
+        const Value p01 = evalTexel(level, xPos,   yPos+1, cursor);
+        const Value p11 = evalTexel(level, xPos+1, yPos+1, cursor);
         Value tmp = p01 + p10 - p11;
 
         gradient[0] = (p10 + p00*(dy-1) - tmp*dy) * static_cast<Float> (size.x);
@@ -721,7 +851,8 @@ public:
             << "   pixelFormat = " << m_pixelFormat << "," << endl
             << "   size = " << memString(getBufferSize()) << "," << endl
             << "   levels = " << m_levels << "," << endl
-            << "   cached = " << (m_mmap.get() ? "yes" : "no") << "," << endl
+            << "   cached = " << (m_mmap.get() ? "yes" : (m_tileCache ? "tiled" : "no")) << "," << endl
+            << "   compressed = " << (m_compressed ? "yes" : "no") << "," << endl
             << "   filterType = ";
 
         switch (m_filterType) {
@@ -750,6 +881,7 @@ protected:
         uint8_t bcu:4;
         uint8_t bcv:4;
         uint8_t filterType;
+        uint8_t compressed;
         float gamma;
         int width;
         int height;
@@ -799,18 +931,37 @@ protected:
         Float ddq = 2*As, uu0 = (Float) u0 - u;
         int nSamples = 0;
 
+        /* With in-memory block compression, decode the texels of a block
+           row at once, since the footprint usually covers several of them */
+        const bool decodeRows = m_compressed && m_tileCache == NULL;
+        Value rowTexels[CompressedArrayType::blockSize];
+        TextureTileCache::Cursor cursor;
+
         for (int vt = v0; vt <= v1; ++vt) {
             const Float vv = (Float) vt - v;
 
             Float q  = As*uu0*uu0 + (Bs*uu0 + Cs*vv)*vv;
             Float dq = As*(2*uu0 + 1) + Bs*vv;
 
+            bool rowInside = decodeRows && vt >= 0 && vt < size.y;
+            int rowBlock = -1;
+
             for (int ut = u0; ut <= u1; ++ut) {
                 if (q < (Float) MTS_MIPMAP_LUT_SIZE) {
                     uint32_t qi = (uint32_t) q;
                     if (qi < MTS_MIPMAP_LUT_SIZE) {
                         const Float weight = m_weightLut[(int) q];
-                        result += evalTexel(level, ut, vt) * weight;
+                        if (rowInside && ut >= 0 && ut < size.x) {
+                            int block = ut / (int) CompressedArrayType::blockSize;
+                            if (block != rowBlock) {
+                                m_blocks[level].getBlock(ut, vt).decodeRow(
+                                    vt % (int) CompressedArrayType::blockSize, rowTexels);
+                                rowBlock = block;
+                            }
+                            result += rowTexels[ut % (int) CompressedArrayType::blockSize] * weight;
+                        } else {
+                            result += evalTexel(level, ut, vt, cursor) * weight;
+                        }
                         denominator += weight;
                         ++nSamples;
                     }
@@ -832,8 +983,97 @@ protected:
 
         return result / denominator;
     }
+
+    /// Fetch a texel of an out-of-core MIP map through the tile cache
+    inline Value fetchTile(int level, int x, int y, TextureTileCache::Cursor &cursor) const {
+        const int tileMask = (1 << MTS_MIPMAP_TILE_LOG) - 1;
+        const size_t blockSize = Array2DType::blockSize,
+                     tileBlocks = ((size_t) 1 << MTS_MIPMAP_TILE_LOG) / blockSize;
+        int xt = x & tileMask, yt = y & tileMask;
+
+        size_t block = xt / blockSize + (yt / blockSize) * tileBlocks,
+               texel = blockSize * (yt % blockSize) + (xt % blockSize);
+
+        const uint8_t *data = cursor.fetch(m_tileCache, this, level,
+            x >> MTS_MIPMAP_TILE_LOG, y >> MTS_MIPMAP_TILE_LOG);
+
+        if (m_compressed)
+            return reinterpret_cast<const typename CompressedArrayType::Block *>(
+                data)[block].decode((int) texel);
+
+        return Value(reinterpret_cast<const QuantizedValue *>(
+            data)[block * blockSize * blockSize + texel]);
+    }
+
+    /// Return the size of a block of texels in bytes
+    inline size_t getBlockBytes() const {
+        if (m_compressed)
+            return sizeof(typename CompressedArrayType::Block);
+        return Array2DType::blockSize * Array2DType::blockSize * sizeof(QuantizedValue);
+    }
+
+    /// Return the storage size of a MIP map level with the given resolution
+    static size_t levelBufferSize(const Vector2i &size, bool compressed) {
+        return compressed ? CompressedArrayType::bufferSize(size)
+                          : Array2DType::bufferSize(size);
+    }
+
+    /**
+     * \brief Allocate memory for a MIP map level, or place it in
+     * a memory-mapped cache file
+     *
+     * When \c mmapPtr is not \c NULL, it is advanced past the level
+     */
+    void allocLevel(int level, const Vector2i &size, uint8_t *&mmapPtr) {
+        if (mmapPtr) {
+            mapLevel(level, size, mmapPtr);
+            mmapPtr += levelBufferSize(size, m_compressed);
+        } else if (m_compressed) {
+            m_pyramid[level].map(NULL, size);
+            m_blocks[level].alloc(size);
+        } else {
+            m_pyramid[level].alloc(size);
+        }
+    }
+
+    /**
+     * \brief Map a MIP map level onto existing memory. When \c ptr is
+     * \c NULL, only the size of the level is recorded.
+     */
+    void mapLevel(int level, const Vector2i &size, uint8_t *ptr) {
+        if (m_compressed) {
+            m_pyramid[level].map(NULL, size);
+            m_blocks[level].map(ptr, size);
+        } else {
+            m_pyramid[level].map(ptr, size);
+        }
+    }
+
+    /**
+     * \brief Initialize a MIP map level from row-major data, and
+     * optionally compute the minimum, maximum, and average value
+     */
+    void initLevel(int level, const Value *data, bool statistics) {
+        if (!m_compressed) {
+            m_pyramid[level].cleanup();
+            if (statistics)
+                m_pyramid[level].init(data, m_minimum, m_maximum, m_average);
+            else
+                m_pyramid[level].init(data);
+            return;
+        }
+
+        m_blocks[level].init(data);
+        if (statistics)
+            computeArrayStatistics(data, m_pyramid[level].getSize(),
+                m_minimum, m_maximum, m_average);
+    }
 private:
     ref<MemoryMappedFile> m_mmap;
+    TextureTileCache *m_tileCache;
+    mutable ref<FileStream> m_tileFile;
+    mutable ref<Mutex> m_tileMutex;
+    std::vector<size_t> m_levelOffsets;
     Bitmap::EPixelFormat m_pixelFormat;
     EBoundaryCondition m_bcu, m_bcv;
     EMIPFilterType m_filterType;
@@ -841,6 +1081,8 @@ private:
     Float m_maxAnisotropy;
     Vector2 *m_sizeRatio;
     Array2DType *m_pyramid;
+    CompressedArrayType *m_blocks;
+    bool m_compressed;
     int m_levels;
     Value m_minimum;
     Value m_maximum;
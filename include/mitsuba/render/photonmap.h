@@ -58,9 +58,9 @@ public:
     /// Clear the kd-tree array
     inline void clear() { m_kdtree.clear(); }
     /// Resize the kd-tree array
-    inline void resize(size_t size) { m_kdtree.resize(size); }
+    inline void resize(size_t size) { m_kdtree.resize(size); updateMemoryUsage(); }
     /// Reserve a certain amount of memory for the kd-tree array
-    inline void reserve(size_t size) { m_kdtree.reserve(size); }
+    inline void reserve(size_t size) { m_kdtree.reserve(size); updateMemoryUsage(); }
     /// Return the size of the kd-tree
     inline size_t size() const { return m_kdtree.size(); }
     /// Return the capacity of the kd-tree
@@ -170,7 +170,10 @@ public:
      * This has to be done once after all photons have been stored,
      * but prior to executing any queries.
      */
-    inline void build(bool recomputeAABB = false) { m_kdtree.build(recomputeAABB); }
+    inline void build(bool recomputeAABB = false) {
+        m_kdtree.build(recomputeAABB);
+        updateMemoryUsage();
+    }
 
     /// Return the depth of the constructed KD-tree
     inline size_t getDepth() const { return m_kdtree.getDepth(); }
@@ -193,9 +196,13 @@ public:
 protected:
     /// Virtual destructor
     virtual ~PhotonMap();
+
+    /// Report changes of the photon array capacity to the memory usage statistics
+    void updateMemoryUsage();
 protected:
     PhotonTree m_kdtree;
     Float m_scale;
+    size_t m_memoryUsage;
 };
 
 MTS_NAMESPACE_END
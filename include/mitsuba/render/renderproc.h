@@ -69,7 +69,7 @@ public:
     ref<WorkProcessor> createWorkProcessor() const;
     void processResult(const WorkResult *result, bool cancelled);
     void bindResource(const std::string &name, int id);
-    EStatus generateWork(WorkUnit *unit, int worker);
+    void handleWorkBegin(const WorkUnit *unit, int worker);
 
     //! @}
     // ======================================================================
@@ -32,6 +32,9 @@ MTS_NAMESPACE_BEGIN
  */
 class MTS_EXPORT_RENDER RenderListener : public Object {
 public:
+    /// Called when a render job has been added to the queue
+    virtual void startJobEvent(const RenderJob *job);
+
     /// Called when work has begun in a rectangular image region
     virtual void workBeginEvent(const RenderJob *job, const RectangularWorkUnit *wu, int worker);
 
@@ -45,7 +48,12 @@ public:
     /// Called when the whole target image has been altered in some way.
     virtual void refreshEvent(const RenderJob *job);
 
-    /// Called when a render job has completed successfully or unsuccessfully
+    /**
+     * \brief Called when a render job has completed successfully or unsuccessfully
+     *
+     * The job is still part of the render queue at this point, hence
+     * \ref RenderQueue::getRenderTime() can be queried.
+     */
     virtual void finishJobEvent(const RenderJob *job, bool cancelled);
 
     MTS_DECLARE_CLASS()
@@ -98,6 +106,7 @@ public:
     void flush();
 
     /* Event distribution */
+    void signalStartJob(const RenderJob *job);
     void signalWorkBegin(const RenderJob *job, const RectangularWorkUnit *wu, int worker);
     void signalWorkEnd(const RenderJob *job, const ImageBlock *block, bool cancelled);
     void signalWorkCanceled(const RenderJob *job, const Point2i &offset, const Vector2i &size);
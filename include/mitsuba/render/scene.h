@@ -23,8 +23,10 @@
 #include <mitsuba/core/netobject.h>
 #include <mitsuba/core/pmf.h>
 #include <mitsuba/core/aabb.h>
+#include <mitsuba/core/profiler.h>
 #include <mitsuba/render/trimesh.h>
 #include <mitsuba/render/skdtree.h>
+#include <mitsuba/render/emittertree.h>
 #include <mitsuba/render/sensor.h>
 #include <mitsuba/render/integrator.h>
 #include <mitsuba/render/bsdf.h>
@@ -185,6 +187,7 @@ public:
      * \return \c true if an intersection was found
      */
     inline bool rayIntersect(const Ray &ray, Intersection &its) const {
+        MTS_PROFILE_SCOPE(EProfilerRayIntersect);
         return m_kdtree->rayIntersect(ray, its);
     }
 
@@ -219,6 +222,7 @@ public:
      */
     inline bool rayIntersect(const Ray &ray, Float &t,
             ConstShapePtr &shape, Normal &n, Point2 &uv) const {
+        MTS_PROFILE_SCOPE(EProfilerRayIntersect);
         return m_kdtree->rayIntersect(ray, t, shape, n, uv);
     }
 
@@ -239,6 +243,7 @@ public:
      * \return \c true if an intersection was found
      */
     inline bool rayIntersect(const Ray &ray) const {
+        MTS_PROFILE_SCOPE(EProfilerShadowRay);
         return m_kdtree->rayIntersect(ray);
     }
 
@@ -461,7 +466,9 @@ public:
      *
      * Ideally, the implementation should importance sample the product of
      * the emission profile and the geometry term between the reference point
-     * and the position on the emitter.
+     * and the position on the emitter. When the scene contains several emitters
+     * with a finite position, the emitter is chosen using an \ref EmitterTree,
+     * i.e. based on its estimated contribution at the reference point.
      *
      * \param dRec
      *    A direct illumination sampling record that specifies the
@@ -849,6 +856,17 @@ public:
         return emitter->getSamplingWeight() * m_emitterPDF.getNormalization();
     }
 
+    /**
+     * \brief Return the discrete probability of choosing a certain
+     * emitter in <tt>sample*EmitterDirect</tt> for the given reference point
+     */
+    inline Float pdfEmitterDiscrete(const Emitter *emitter, const Point &ref) const {
+        if (m_emitterTree.get())
+            return m_emitterTree->pdf(ref, emitter);
+        else
+            return pdfEmitterDiscrete(emitter);
+    }
+
     /**
      * \brief Importance sample a ray according to the emission profile
      * defined by the sensors in the scene
@@ -1152,6 +1170,15 @@ protected:
     /// Add a shape to the scene
     void addShape(Shape *shape);
     /// \endcond
+
+    /// Choose an emitter for direct illumination sampling at a reference point
+    inline const Emitter *sampleEmitterDiscrete(const Point &ref,
+            Float &sample, Float &pdf) const {
+        if (m_emitterTree.get())
+            return m_emitterTree->sampleReuse(ref, sample, pdf);
+        else
+            return m_emitters[m_emitterPDF.sampleReuse(sample, pdf)].get();
+    }
 private:
     ref<ShapeKDTree> m_kdtree;
     ref<Sensor> m_sensor;
@@ -1169,11 +1196,13 @@ private:
     std::vector<TriMesh *> m_meshes;
     fs::path *m_sourceFile;
     fs::path *m_destinationFile;
-    DiscreteDistribution m_emitterPDF;
+    AliasDistribution m_emitterPDF;
+    ref<EmitterTree> m_emitterTree;
     AABB m_aabb;
     uint32_t m_blockSize;
     bool m_degenerateSensor;
     bool m_degenerateEmitters;
+    bool m_useEmitterTree;
 
     ref_vector<BSDF> m_bsdfs;
     ref_vector<PhaseFunction> m_phases;
@@ -0,0 +1,109 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_TELEMETRY_H_)
+#define __MITSUBA_RENDER_TELEMETRY_H_
+
+#include <mitsuba/render/renderqueue.h>
+#include <mitsuba/core/statistics.h>
+#include <boost/filesystem/path.hpp>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Render listener, which writes machine-readable performance
+ * records of finished render jobs
+ *
+ * For every render job, one JSON object per line is appended to a file
+ * next to the output image (see \ref getTelemetryPath()). The record of
+ * type \c "render" contains the render time, work unit timings, ray
+ * throughput, kd-tree statistics, the memory high-water mark and the
+ * values of all \ref StatsCounter instances. Optionally, it is preceded
+ * by one record of type \c "workunit" per processed image block.
+ *
+ * Work unit times span from the moment a worker begins to process the
+ * unit until its result arrives, and hence exclude the time spent waiting
+ * in the scheduler's queue (see \ref ParallelProcess::handleWorkBegin()).
+ * Ray counts and accumulating counters only cover the reported job: they
+ * are relative to a snapshot taken when the job was added to the render
+ * queue, so concurrently rendered jobs are still included.
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER RenderTelemetry : public RenderListener {
+public:
+    /**
+     * \brief Create a new telemetry writer
+     *
+     * \param workUnitRecords
+     *    Also write a record for each processed work unit?
+     */
+    RenderTelemetry(bool workUnitRecords = false);
+
+    /**
+     * \brief Write the records of a render job and discard
+     * the work unit timings and counter values collected so far
+     *
+     * This is done automatically when the job finishes, but can also be
+     * triggered manually when a job renders several images.
+     */
+    void write(const RenderJob *job, bool cancelled);
+
+    /// Return the file, to which the records of a scene are appended
+    static fs::path getTelemetryPath(const Scene *scene);
+
+    /* RenderListener implementation */
+    void startJobEvent(const RenderJob *job);
+    void workBeginEvent(const RenderJob *job, const RectangularWorkUnit *wu, int worker);
+    void workEndEvent(const RenderJob *job, const ImageBlock *wr, bool cancelled);
+    void finishJobEvent(const RenderJob *job, bool cancelled);
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Virtual destructor
+    virtual ~RenderTelemetry() { }
+private:
+    struct WorkUnitRecord {
+        Point2i offset;
+        Vector2i size;
+        int worker;
+        Float time;
+        bool cancelled;
+    };
+
+    struct JobRecord {
+        /// Start time and worker of the work units in progress (by offset)
+        std::map<std::pair<int, int>, std::pair<unsigned int, int> > pending;
+        std::vector<WorkUnitRecord> finished;
+        /// Counter values when the job was started (or last written)
+        Statistics::Snapshot counters;
+        bool hasCounters;
+
+        inline JobRecord() : hasCounters(false) { }
+    };
+
+    std::map<const RenderJob *, JobRecord> m_jobs;
+    bool m_workUnitRecords;
+    ref<Timer> m_timer;
+    ref<Mutex> m_mutex;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_TELEMETRY_H_ */
@@ -43,6 +43,10 @@ MTS_NAMESPACE_BEGIN
  * the shutdown() method is called. See the files in 'mitsuba/src/tests'
  * for examples.
  *
+ * Time-consuming performance measurements can be declared using the
+ * MTS_DECLARE_BENCHMARK() macro. They are skipped unless the testcase
+ * is started with the '-b' argument (e.g. 'mtsutil test_texcomp -b').
+ *
  * \ingroup librender
  */
 class MTS_EXPORT_RENDER TestCase : public Utility {
@@ -138,11 +142,19 @@ MTS_NAMESPACE_END
     int run(int argc, char **argv) {\
         init(); \
         Log(EInfo, "Executing testcase \"%s\" ..", getClass()->getName().c_str()); \
-        m_executed = m_succeeded = 0;
+        m_executed = m_succeeded = 0; \
+        bool runBenchmarks = false; \
+        for (int i=1; i<argc; ++i) \
+            runBenchmarks |= strcmp(argv[i], "-b") == 0;
 
 #define MTS_DECLARE_TEST(name) \
         EXECUTE_GUARDED(name)
 
+#define MTS_DECLARE_BENCHMARK(name) \
+        if (runBenchmarks) { \
+            EXECUTE_GUARDED(name) \
+        }
+
 #define MTS_END_TESTCASE()\
         shutdown();\
         return m_executed - m_succeeded;\
@@ -0,0 +1,210 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_TEXCACHE_H_)
+#define __MITSUBA_RENDER_TEXCACHE_H_
+
+#include <mitsuba/core/lock.h>
+#include <mitsuba/core/atomic.h>
+#include <boost/unordered_map.hpp>
+
+/// Number of independently locked partitions of the texture tile cache
+#define MTS_TEXCACHE_SHARDS 64
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Process-wide cache of texture tiles with a global memory budget
+ *
+ * Textures that are kept out of core (e.g. \ref TMIPMap instances that
+ * were opened in tiled mode) do not hold any texel data themselves.
+ * Instead, they implement the \ref TileSource interface and fetch
+ * texels through this cache, which loads tiles on first access and
+ * evicts the least recently used ones once the memory budget is
+ * exceeded. Texture memory is thus bounded by the working set of the
+ * renderer rather than by the size of the assets.
+ *
+ * The cache is partitioned into \ref MTS_TEXCACHE_SHARDS independently
+ * locked shards (each with its own LRU list and an equal share of the
+ * budget), so that concurrent lookups from many rendering threads rarely
+ * contend. Tiles are loaded without holding any lock.
+ *
+ * Texture lookups usually access several texels of the same tile. Hence,
+ * tiles are fetched through a \ref Cursor, which keeps the last tile
+ * pinned so that the shard is only locked when a different tile is needed.
+ * Pinned tiles are never evicted.
+ */
+class MTS_EXPORT_RENDER TextureTileCache : public Object {
+public:
+    /// Interface of out-of-core textures that provide tiles to the cache
+    class MTS_EXPORT_RENDER TileSource {
+    public:
+        /// Return the size of a tile in bytes
+        virtual size_t getTileBytes() const = 0;
+
+        /**
+         * \brief Load the tile with index <tt>(x, y)</tt> on the given level
+         * into \c target, which holds \ref getTileBytes() bytes
+         *
+         * This function is called concurrently from multiple threads
+         */
+        virtual void loadTile(int level, int x, int y, uint8_t *target) const = 0;
+
+        /// Virtual destructor
+        virtual ~TileSource() { }
+    };
+
+    /// Identifies a tile of a source
+    struct TileKey {
+        const TileSource *source;
+        int level, x, y;
+
+        inline bool operator==(const TileKey &k) const {
+            return source == k.source && level == k.level && x == k.x && y == k.y;
+        }
+    };
+
+    /// Resident tile, linked into the LRU list of its shard
+    struct Tile {
+        TileKey key;
+        uint8_t *data;
+        size_t size;
+        mutable volatile int32_t pins;
+        Tile *prev, *next;
+    };
+
+    /**
+     * \brief Keeps the most recently fetched tile pinned, so that repeated
+     * accesses to the same tile do not lock the cache
+     *
+     * A cursor is meant to be used by a single thread for the duration
+     * of a texture lookup.
+     */
+    class Cursor {
+    public:
+        inline Cursor() : m_tile(NULL) { }
+
+        inline ~Cursor() {
+            if (m_tile)
+                unpin(m_tile);
+        }
+
+        /// Return the data of a tile, acquiring it if it is not the current one
+        inline const uint8_t *fetch(TextureTileCache *cache,
+                const TileSource *source, int level, int x, int y) {
+            if (!m_tile || m_tile->key.x != x || m_tile->key.y != y
+                    || m_tile->key.level != level || m_tile->key.source != source) {
+                if (m_tile) {
+                    unpin(m_tile);
+                    m_tile = NULL;
+                }
+                m_tile = cache->acquire(source, level, x, y);
+            }
+            return m_tile->data;
+        }
+    private:
+        const Tile *m_tile;
+    };
+
+    /// Return the global texture tile cache
+    static TextureTileCache *getInstance();
+
+    /**
+     * \brief Pin the tile with index <tt>(x, y)</tt> on the given level,
+     * loading it if it is not resident
+     *
+     * The tile cannot be evicted until it is released using \ref unpin().
+     */
+    const Tile *acquire(const TileSource *source, int level, int x, int y);
+
+    /// Release a tile that was pinned by \ref acquire()
+    static inline void unpin(const Tile *tile) {
+        atomicAdd(&tile->pins, -1);
+    }
+
+    /**
+     * \brief Copy \c size bytes at the given offset within a tile to \c target,
+     * loading the tile if it is not resident
+     */
+    void lookup(const TileSource *source, int level, int x, int y,
+            size_t offset, void *target, size_t size);
+
+    /**
+     * \brief Remove all tiles of a source from the cache
+     *
+     * Must be called before the source is destroyed, while
+     * none of its tiles are pinned
+     */
+    void release(const TileSource *source);
+
+    /// Set the memory budget in bytes
+    void setMemoryBudget(size_t budget);
+
+    /// Return the memory budget in bytes
+    inline size_t getMemoryBudget() const { return m_budget; }
+
+    /// Return the amount of memory currently occupied by tiles
+    size_t getMemoryUsage() const;
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Create a new tile cache (use \ref getInstance())
+    TextureTileCache();
+
+    /// Virtual destructor
+    virtual ~TextureTileCache();
+private:
+    struct TileKeyHash {
+        inline size_t operator()(const TileKey &k) const {
+            uint64_t hash = (uint64_t) (size_t) k.source;
+            hash ^= ((uint64_t) k.level << 56) ^ ((uint64_t) (uint32_t) k.y << 28)
+                ^ (uint64_t) (uint32_t) k.x;
+
+            /* 64-bit finalizer of MurmurHash3 */
+            hash ^= hash >> 33;
+            hash *= 0xff51afd7ed558ccdULL;
+            hash ^= hash >> 33;
+            hash *= 0xc4ceb9fe1a85ec53ULL;
+            hash ^= hash >> 33;
+            return (size_t) hash;
+        }
+    };
+
+    struct Shard {
+        mutable ref<Mutex> mutex;
+        boost::unordered_map<TileKey, Tile *, TileKeyHash> tiles;
+        Tile *head, *tail;
+        size_t usage;
+    };
+
+    /// Unlink a tile from the LRU list of a shard
+    void unlink(Shard &shard, Tile *tile);
+    /// Make a tile the most recently used one of a shard
+    void pushFront(Shard &shard, Tile *tile);
+    /// Evict unpinned tiles from a shard until it fits into its share of the budget
+    void evict(Shard &shard);
+private:
+    Shard m_shards[MTS_TEXCACHE_SHARDS];
+    size_t m_budget;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_TEXCACHE_H_ */
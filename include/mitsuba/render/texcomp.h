@@ -0,0 +1,458 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_TEXCOMP_H_)
+#define __MITSUBA_RENDER_TEXCOMP_H_
+
+#include <mitsuba/core/half.h>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Fixed-rate compressed block of 4x4 texels
+ *
+ * In the spirit of the BC6H/BC7 GPU formats, a block stores two
+ * half precision endpoints and a 4-bit palette index per texel, which
+ * selects one of 16 evenly spaced points on the segment between them.
+ * An RGB block occupies 20 bytes (4.8x less than half precision texels),
+ * and a monochromatic block occupies 12 bytes.
+ *
+ * Decoding a texel only involves two endpoint conversions and a linear
+ * interpolation, hence the format is cheap enough to be decoded on the
+ * CPU during every filtered texture lookup. To keep the endpoint conversion
+ * free of table lookups, the encoder flushes denormalized endpoints to zero.
+ *
+ * \tparam Value
+ *    A \ref TSpectrum instance (or a compatible type) with
+ *    nonnegative entries.
+ *
+ * \ingroup librender
+ */
+template <typename Value> struct TCompressedBlock {
+    typedef typename Value::Scalar Scalar;
+
+    /// Number of texels along each axis of a block
+    static const int blockSize = 4;
+
+    /// Number of texels per block
+    static const int texelCount = blockSize * blockSize;
+
+    /// Largest palette index
+    static const int maxIndex = 15;
+
+    /// Block endpoints (bit patterns of nonnegative half precision values)
+    uint16_t endpoints[2][Value::dim];
+
+    /// Packed 4-bit palette indices of the texels in row-major order
+    uint32_t indices[2];
+
+    /// Convert a nonnegative normalized (or zero) half precision value to single precision
+    static inline float halfToFloat(uint16_t value) {
+        union {
+            uint32_t i;
+            float f;
+        } result;
+        result.i = value ? (((uint32_t) value << 13) + 0x38000000u) : 0u;
+        return result.f;
+    }
+
+    /// Convert a nonnegative single precision value to half precision, flushing denormals to zero
+    static inline uint16_t floatToHalf(float value) {
+        uint16_t result = half(std::min(std::max(value, 0.0f), (float) HALF_MAX)).bits();
+        return result < 0x0400 ? 0 : result;
+    }
+
+    /// Return the palette index of a texel (in row-major order)
+    inline int getIndex(int texel) const {
+        return (int) ((indices[texel >> 3] >> (4 * (texel & 7))) & 0xF);
+    }
+
+    /// Decode a single texel (in row-major order)
+    inline Value decode(int texel) const {
+        Scalar weight = getIndex(texel) * ((Scalar) 1 / maxIndex);
+
+        Value result;
+        for (int i=0; i<Value::dim; ++i) {
+            Scalar e0 = halfToFloat(endpoints[0][i]),
+                   e1 = halfToFloat(endpoints[1][i]);
+            result[i] = e0 + (e1 - e0) * weight;
+        }
+        return result;
+    }
+
+    /// Decode the four texels of a row of the block
+    inline void decodeRow(int row, Value *target) const {
+        Scalar e0[Value::dim], delta[Value::dim], weights[blockSize];
+        uint32_t bits = indices[row >> 1] >> (16 * (row & 1));
+
+        for (int i=0; i<Value::dim; ++i) {
+            e0[i] = halfToFloat(endpoints[0][i]);
+            delta[i] = halfToFloat(endpoints[1][i]) - e0[i];
+        }
+
+        for (int j=0; j<blockSize; ++j)
+            weights[j] = (Scalar) ((bits >> (4 * j)) & 0xF) * ((Scalar) 1 / maxIndex);
+
+        for (int j=0; j<blockSize; ++j)
+            for (int i=0; i<Value::dim; ++i)
+                target[j][i] = e0[i] + delta[i] * weights[j];
+    }
+
+    /**
+     * \brief Decode all texels of the block (in row-major order)
+     *
+     * The endpoints are converted once, and the remainder is written
+     * as branch-free loops over the texels that the compiler can turn
+     * into SIMD code.
+     */
+    inline void decodeBlock(Value *target) const {
+        Scalar e0[Value::dim], delta[Value::dim], weights[texelCount];
+
+        for (int i=0; i<Value::dim; ++i) {
+            e0[i] = halfToFloat(endpoints[0][i]);
+            delta[i] = halfToFloat(endpoints[1][i]) - e0[i];
+        }
+
+        for (int j=0; j<texelCount; ++j)
+            weights[j] = (Scalar) ((indices[j >> 3] >> (4 * (j & 7))) & 0xF)
+                * ((Scalar) 1 / maxIndex);
+
+        for (int i=0; i<Value::dim; ++i) {
+            Scalar e = e0[i], d = delta[i];
+            for (int j=0; j<texelCount; ++j)
+                target[j][i] = e + d * weights[j];
+        }
+    }
+
+    /**
+     * \brief Encode a block of texels
+     *
+     * The endpoints are placed on the principal axis of the texel colors,
+     * then refined by a least-squares fit given the chosen palette indices.
+     *
+     * \param texels
+     *    Texels of the block in row-major order (4 texels per row)
+     * \param width
+     *    Number of valid texel columns (less than 4 along the right
+     *    edge of an image); the remaining texels are ignored
+     * \param height
+     *    Number of valid texel rows
+     */
+    void encode(const Value *texels, int width = blockSize, int height = blockSize) {
+        const int dim = Value::dim;
+        Scalar mean[dim], cov[dim][dim], axis[dim];
+        int count = width * height;
+
+        /* Compute the mean and covariance matrix of the valid texels */
+        for (int i=0; i<dim; ++i) {
+            mean[i] = 0;
+            for (int j=0; j<dim; ++j)
+                cov[i][j] = 0;
+        }
+
+        for (int y=0; y<height; ++y)
+            for (int x=0; x<width; ++x)
+                for (int i=0; i<dim; ++i)
+                    mean[i] += texels[y*blockSize + x][i];
+
+        for (int i=0; i<dim; ++i)
+            mean[i] /= count;
+
+        for (int y=0; y<height; ++y) {
+            for (int x=0; x<width; ++x) {
+                const Value &value = texels[y*blockSize + x];
+                for (int i=0; i<dim; ++i)
+                    for (int j=0; j<dim; ++j)
+                        cov[i][j] += (value[i] - mean[i]) * (value[j] - mean[j]);
+            }
+        }
+
+        /* Find the principal axis using power iteration, starting
+           from the row of the channel with the largest variance */
+        int start = 0;
+        for (int i=1; i<dim; ++i)
+            if (cov[i][i] > cov[start][start])
+                start = i;
+
+        for (int i=0; i<dim; ++i)
+            axis[i] = cov[start][i];
+
+        for (int it=0; it<8; ++it) {
+            Scalar tmp[dim], norm = 0;
+            for (int i=0; i<dim; ++i) {
+                tmp[i] = 0;
+                for (int j=0; j<dim; ++j)
+                    tmp[i] += cov[i][j] * axis[j];
+                norm = std::max(norm, std::abs(tmp[i]));
+            }
+            if (norm == 0)
+                break;
+            for (int i=0; i<dim; ++i)
+                axis[i] = tmp[i] / norm;
+        }
+
+        Scalar axisLength2 = 0;
+        for (int i=0; i<dim; ++i)
+            axisLength2 += axis[i] * axis[i];
+
+        /* Project the texels onto the axis to find the endpoints */
+        Scalar tMin = 0, tMax = 0;
+        if (axisLength2 > 0) {
+            tMin = std::numeric_limits<Scalar>::infinity();
+            tMax = -std::numeric_limits<Scalar>::infinity();
+            for (int y=0; y<height; ++y) {
+                for (int x=0; x<width; ++x) {
+                    const Value &value = texels[y*blockSize + x];
+                    Scalar t = 0;
+                    for (int i=0; i<dim; ++i)
+                        t += (value[i] - mean[i]) * axis[i];
+                    tMin = std::min(tMin, t);
+                    tMax = std::max(tMax, t);
+                }
+            }
+            tMin /= axisLength2;
+            tMax /= axisLength2;
+        }
+
+        Scalar e0[dim], e1[dim];
+        for (int i=0; i<dim; ++i) {
+            e0[i] = mean[i] + axis[i] * tMin;
+            e1[i] = mean[i] + axis[i] * tMax;
+        }
+
+        Scalar error = fit(texels, width, height, e0, e1);
+
+        /* Refine the endpoints by repeatedly solving the least-squares
+           problem that results from keeping the palette indices fixed */
+        for (int it=0; it<4 && error > 0; ++it) {
+            Scalar a = 0, b = 0, c = 0, rhs0[dim], rhs1[dim];
+            for (int i=0; i<dim; ++i)
+                rhs0[i] = rhs1[i] = 0;
+
+            for (int y=0; y<height; ++y) {
+                for (int x=0; x<width; ++x) {
+                    const Value &value = texels[y*blockSize + x];
+                    Scalar w1 = getIndex(y*blockSize + x) * ((Scalar) 1 / maxIndex),
+                           w0 = 1 - w1;
+                    a += w0 * w0; b += w0 * w1; c += w1 * w1;
+                    for (int i=0; i<dim; ++i) {
+                        rhs0[i] += w0 * value[i];
+                        rhs1[i] += w1 * value[i];
+                    }
+                }
+            }
+
+            Scalar det = a*c - b*b;
+            if (!(std::abs(det) > 1e-6f * std::max(a*c, (Scalar) 1e-6f)))
+                break;
+
+            Scalar invDet = 1 / det;
+            for (int i=0; i<dim; ++i) {
+                e0[i] = (c * rhs0[i] - b * rhs1[i]) * invDet;
+                e1[i] = (a * rhs1[i] - b * rhs0[i]) * invDet;
+            }
+
+            TCompressedBlock refined;
+            Scalar refinedError = refined.fit(texels, width, height, e0, e1);
+            if (!(refinedError < error))
+                break;
+            *this = refined;
+            error = refinedError;
+        }
+    }
+
+protected:
+    /**
+     * \brief Quantize the given endpoints and choose the best palette index
+     * for each texel. Returns the resulting squared error.
+     */
+    Scalar fit(const Value *texels, int width, int height,
+            const Scalar *e0, const Scalar *e1) {
+        const int dim = Value::dim;
+        Scalar q0[dim], delta[dim], deltaLength2 = 0;
+
+        for (int i=0; i<dim; ++i) {
+            endpoints[0][i] = floatToHalf((float) e0[i]);
+            endpoints[1][i] = floatToHalf((float) e1[i]);
+            q0[i] = halfToFloat(endpoints[0][i]);
+            delta[i] = halfToFloat(endpoints[1][i]) - q0[i];
+            deltaLength2 += delta[i] * delta[i];
+        }
+
+        Scalar scale = deltaLength2 > 0 ? maxIndex / deltaLength2 : 0,
+               error = 0;
+        indices[0] = indices[1] = 0;
+
+        for (int y=0; y<height; ++y) {
+            for (int x=0; x<width; ++x) {
+                const Value &value = texels[y*blockSize + x];
+                int texel = y*blockSize + x;
+
+                Scalar t = 0;
+                for (int i=0; i<dim; ++i)
+                    t += (value[i] - q0[i]) * delta[i];
+
+                int index = std::min(std::max((int) (t * scale + (Scalar) 0.5f), 0), maxIndex);
+                indices[texel >> 3] |= (uint32_t) index << (4 * (texel & 7));
+
+                Scalar weight = index * ((Scalar) 1 / maxIndex);
+                for (int i=0; i<dim; ++i) {
+                    Scalar diff = q0[i] + delta[i] * weight - value[i];
+                    error += diff * diff;
+                }
+            }
+        }
+
+        return error;
+    }
+};
+
+/**
+ * \brief 2D array of texels stored in the \ref TCompressedBlock format
+ *
+ * The interface mirrors that of \ref BlockedArray, except that
+ * texel lookups return decoded values by value.
+ *
+ * \ingroup librender
+ */
+template <typename Value> class CompressedArray {
+public:
+    typedef TCompressedBlock<Value> Block;
+    static const size_t blockSize = Block::blockSize;
+
+    /// Create an unitialized compressed array
+    CompressedArray() : m_data(NULL), m_size(-1), m_owner(false) { }
+
+    /// Allocate memory for a compressed array of the specified size
+    void alloc(const Vector2i &size) {
+        if (m_data && m_owner)
+            freeAligned(m_data);
+
+        m_xBlocks = (size.x + blockSize - 1) / blockSize;
+        m_yBlocks = (size.y + blockSize - 1) / blockSize;
+        m_data = (Block *) allocAligned(m_xBlocks * m_yBlocks * sizeof(Block));
+        m_size = size;
+        m_owner = true;
+    }
+
+    /**
+     * \brief Initialize the compressed array with a memory region
+     * specified by a pointer
+     */
+    void map(void *ptr, const Vector2i &size) {
+        if (m_data && m_owner)
+            freeAligned(m_data);
+
+        m_xBlocks = (size.x + blockSize - 1) / blockSize;
+        m_yBlocks = (size.y + blockSize - 1) / blockSize;
+        m_data = (Block *) ptr;
+        m_size = size;
+        m_owner = false;
+    }
+
+    /**
+     * \brief Compress the contents of a non-blocked source in
+     * row-major order into the array
+     */
+    template <typename AltValue> void init(const AltValue *data) {
+        int xBlocks = (int) m_xBlocks, yBlocks = (int) m_yBlocks;
+
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for if (yBlocks >= 16)
+        #endif
+        for (int yb=0; yb<yBlocks; ++yb) {
+            Value texels[Block::texelCount];
+            int height = std::min((int) blockSize, m_size.y - yb * (int) blockSize);
+
+            for (int xb=0; xb<xBlocks; ++xb) {
+                int width = std::min((int) blockSize, m_size.x - xb * (int) blockSize);
+
+                for (int y=0; y<height; ++y) {
+                    const AltValue *row = data + (size_t) (yb * blockSize + y)
+                        * (size_t) m_size.x + xb * blockSize;
+                    for (int x=0; x<width; ++x)
+                        texels[y * blockSize + x] = Value(row[x]);
+                }
+
+                m_data[xb + yb * m_xBlocks].encode(texels, width, height);
+            }
+        }
+    }
+
+    /**
+     * \brief Decompress the contents of the array to a non-blocked
+     * destination buffer in row-major order.
+     */
+    template <typename AltValue> void copyTo(AltValue *data) const {
+        for (int y=0; y<m_size.y; ++y)
+            for (int x=0; x<m_size.x; ++x)
+                *data++ = AltValue((*this)(x, y));
+    }
+
+    /// Return the size of the array
+    inline const Vector2i &getSize() const { return m_size; }
+
+    /// Return the size of the buffer required to store a compressed array of the given size
+    inline static size_t bufferSize(const Vector2i &size) {
+        size_t xBlocks = (size.x + blockSize - 1) / blockSize,
+               yBlocks = (size.y + blockSize - 1) / blockSize;
+        return xBlocks * yBlocks * sizeof(Block);
+    }
+
+    /// Return the size of the allocated buffer
+    inline size_t getBufferSize() const {
+        return m_xBlocks * m_yBlocks * sizeof(Block);
+    }
+
+    /// Return the width of the represented array
+    inline int getWidth() const { return m_size.x; }
+
+    /// Return the height of the represented array
+    inline int getHeight() const { return m_size.y; }
+
+    /// Release all memory
+    ~CompressedArray() {
+        if (m_data && m_owner)
+            freeAligned(m_data);
+    }
+
+    /// Decode the texel at the given position
+    inline Value operator()(int x, int y) const {
+        return getBlock(x, y).decode(
+            (int) (blockSize * (y & (blockSize - 1)) + (x & (blockSize - 1))));
+    }
+
+    /// Return the block containing the texel at the given position
+    inline const Block &getBlock(int x, int y) const {
+        return m_data[(size_t) (x / blockSize) + (size_t) (y / blockSize) * m_xBlocks];
+    }
+
+    /// Return a pointer to the internal representation
+    inline const Block *getData() const { return m_data; }
+private:
+    Block *m_data;
+    Vector2i m_size;
+    size_t m_xBlocks, m_yBlocks;
+    bool m_owner;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_TEXCOMP_H_ */
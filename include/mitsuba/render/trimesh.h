@@ -352,6 +352,9 @@ protected:
 
     /// Prepare internal tables for sampling uniformly wrt. area
     void prepareSamplingTable();
+protected:
+    /// Report changes of the buffer sizes to the memory usage statistics
+    void updateMemoryUsage();
 protected:
     AABB m_aabb;
     Triangle *m_triangles;
@@ -366,10 +369,13 @@ protected:
     bool m_faceNormals;
 
     /* Surface and distribution -- generated on demand */
-    DiscreteDistribution m_areaDistr;
+    AliasDistribution m_areaDistr;
     Float m_surfaceArea;
     Float m_invSurfaceArea;
     ref<Mutex> m_mutex;
+
+    /// Buffer size, which was last reported by \ref updateMemoryUsage()
+    size_t m_memoryUsage;
 };
 
 MTS_NAMESPACE_END
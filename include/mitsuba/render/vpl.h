@@ -37,7 +37,7 @@ enum EVPLType {
  */
 struct VPL {
     inline VPL(EVPLType type, const Spectrum &P)
-        : type(type), P(P) {
+        : type(type), P(P), emitter(NULL), emitterScale(1.0f) {
     }
     EVPLType type;
     Spectrum P;
@@ -65,6 +65,119 @@ extern MTS_EXPORT_RENDER size_t generateVPLs(const Scene *scene,
         size_t count, int maxDepth, bool prune,
         std::deque<VPL> &vpls);
 
+/**
+ * \brief Binary light tree over a set of VPLs in the spirit of Lightcuts
+ * [Walter et al. 2005]
+ *
+ * Each interior node represents a cluster of VPLs of the same type by one of
+ * its members, which is chosen proportional to luminance and carries the power
+ * of the entire cluster. For a given shading point, \ref computeCut() selects a
+ * set of nodes (a <em>cut</em>) by greedily refining the node with the largest
+ * error bound until all bounds fall below a threshold relative to the
+ * estimated total contribution. This makes the cost of evaluating a very large
+ * number of VPLs sublinear in their count.
+ *
+ * The error bound of a node only accounts for the inverse-squared distance
+ * and the emission cosine of its VPLs (assuming diffuse receivers and
+ * unoccluded visibility). Directional VPLs have no finite position; they are
+ * never clustered and always part of the cut.
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER VPLTree : public Object {
+public:
+    /**
+     * \brief Build a light tree over the given VPLs
+     *
+     * \param random
+     *    Pseudorandom number generator used to choose
+     *    the representative VPL of each cluster
+     */
+    VPLTree(const std::deque<VPL> &vpls, Random *random);
+
+    /// Return the number of VPLs
+    inline size_t getVPLCount() const { return m_vpls.size(); }
+
+    /// Return the number of tree nodes
+    inline size_t getNodeCount() const { return m_nodes.size(); }
+
+    /**
+     * \brief Select a cut of the light tree for the given shading point
+     *
+     * \param p
+     *    Position of the shading point
+     * \param maxError
+     *    Maximum error bound of each node in the cut, relative to
+     *    the estimated total contribution (e.g. 0.02)
+     * \param maxCutSize
+     *    Upper limit on the number of nodes in the cut
+     * \param cut
+     *    Will be filled with the indices of the selected nodes
+     */
+    void computeCut(const Point &p, Float maxError, size_t maxCutSize,
+        std::vector<uint32_t> &cut) const;
+
+    /**
+     * \brief Return the representative VPL of a node, whose power
+     * has been scaled to account for the entire cluster
+     */
+    VPL getRepresentative(uint32_t node) const;
+
+    /**
+     * \brief Compute a single cut that is simultaneously refined enough for
+     * all of the given shading points, and return its representative VPLs
+     *
+     * This is useful for renderers that process one VPL at a time for
+     * the entire image (e.g. the hardware-accelerated \c vpl integrator)
+     */
+    void computeSharedCut(const std::vector<Point> &points, Float maxError,
+        size_t maxCutSize, std::deque<VPL> &vpls) const;
+
+    /// Return a human-readable string representation
+    std::string toString() const;
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Node of the light tree (leaves have <tt>left == right == 0</tt>)
+    struct Node {
+        /// Bounds of the VPL positions
+        AABB aabb;
+        /// Axis of a double cone bounding the VPL normals
+        Vector axis;
+        /// Half angle of the normal cone (>= pi/2: unbounded)
+        Float angle;
+        /// Total power of the cluster
+        Spectrum P;
+        /// Total environment emitter scale of the cluster
+        Float emitterScale;
+        /// Luminance of \ref P
+        Float luminance;
+        /// Index of the representative VPL
+        uint32_t representative;
+        /// Child node indices
+        uint32_t left, right;
+
+        inline bool isLeaf() const { return left == 0 && right == 0; }
+    };
+
+    /// Recursively build the subtree over the given range of VPL indices
+    uint32_t build(uint32_t *start, uint32_t *end, Random *random);
+
+    /// Upper bound on the contribution of a node to a shading point
+    Float getBound(const Node &node, const Point &p) const;
+
+    /// Estimated contribution of a node's representative to a shading point
+    Float getEstimate(const Node &node, const Point &p) const;
+
+    /// Virtual destructor
+    virtual ~VPLTree() { }
+private:
+    std::vector<VPL> m_vpls;
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_roots;
+    Float m_minDistSqr;
+};
+
 MTS_NAMESPACE_END
 
 #endif /* __MITSUBA_RENDER_VPL_H_ */
@@ -103,7 +103,7 @@ public:
     typedef TMIPMap<Spectrum, SpectrumHalf> MIPMap;
 
     EnvironmentMap(const Properties &props) : Emitter(props),
-            m_mipmap(NULL), m_cdfRows(NULL), m_cdfCols(NULL), m_rowWeights(NULL) {
+            m_mipmap(NULL), m_rowWeights(NULL) {
         m_type |= EOnSurface | EEnvironmentEmitter;
         uint64_t timestamp = 0;
         bool tryReuseCache = false;
@@ -189,7 +189,7 @@ public:
     }
 
     EnvironmentMap(Stream *stream, InstanceManager *manager) : Emitter(stream, manager),
-            m_mipmap(NULL), m_cdfRows(NULL), m_cdfCols(NULL), m_rowWeights(NULL) {
+            m_mipmap(NULL), m_rowWeights(NULL) {
         m_filename = stream->readString();
         Log(EDebug, "Unserializing texture \"%s\"", m_filename.filename().string().c_str());
         m_gamma = stream->readFloat();
@@ -197,10 +197,9 @@ public:
         m_sceneBSphere = BSphere(stream);
         m_geoBSphere = BSphere(stream);
 
+        /* Decode the embedded image in place if possible */
         size_t size = stream->readSize();
-        ref<MemoryStream> mStream = new MemoryStream(size);
-        stream->copyTo(mStream, size);
-        mStream->seek(0);
+        ref<MemoryStream> mStream = MemoryStream::readView(stream, size);
         ref<Bitmap> bitmap = new Bitmap(Bitmap::EAuto, mStream);
         if (m_gamma != 0)
             bitmap->setGamma(m_gamma);
@@ -223,10 +222,6 @@ public:
     virtual ~EnvironmentMap() {
         if (m_mipmap)
             delete m_mipmap;
-        if (m_cdfRows)
-            delete[] m_cdfRows;
-        if (m_cdfCols)
-            delete[] m_cdfCols;
         if (m_rowWeights)
             delete[] m_rowWeights;
     }
@@ -261,54 +256,79 @@ public:
         Emitter::configure();
 
         if (!m_rowWeights) {
-            /// Build CDF tables to sample the environment map
+            /// Build a luminance quadtree to sample the environment map
             const MIPMap::Array2DType &array = m_mipmap->getArray();
             m_size = array.getSize();
 
-            size_t nEntries = (size_t) (m_size.x + 1) * (size_t) m_size.y,
-                totalStorage = sizeof(float) * (m_size.x + 1 + nEntries);
+            /* Level 0 corresponds to the pixels, and every coarser level halves
+               the resolution until a single root node remains. The nodes of
+               levels >= 2 store the summed weights of their (up to) four
+               children contiguously, so that each step of the descent touches
+               a single cache line. Pixel weights are not stored but computed
+               on demand, which keeps the table at about a third of the
+               number of pixels. */
+            m_levelSizes.clear();
+            m_levelOffsets.clear();
+            Vector2i size = m_size;
+            size_t nEntries = 0;
+            m_levelSizes.push_back(size);
+            m_levelOffsets.push_back(0);
+            while (size.x > 1 || size.y > 1) {
+                size = Vector2i((size.x + 1) / 2, (size.y + 1) / 2);
+                m_levelSizes.push_back(size);
+                m_levelOffsets.push_back(nEntries);
+                if (m_levelSizes.size() > 2)
+                    nEntries += 4 * (size_t) size.x * (size_t) size.y;
+            }
 
+            size_t totalStorage = sizeof(float) * nEntries + sizeof(Float) * m_size.y;
             Log(EInfo, "Precomputing data structures for environment map sampling (%s)",
                 memString(totalStorage).c_str());
 
             ref<Timer> timer = new Timer();
-            m_cdfCols = new float[nEntries];
-            m_cdfRows = new float[m_size.y + 1];
+            m_tree.resize(nEntries);
             m_rowWeights = new Float[m_size.y];
-
-            size_t colPos = 0, rowPos = 0;
-            Float rowSum = 0.0f;
-
-            /* Build a marginal & conditional cumulative distribution
-               function over luminances weighted by sin(theta) */
-            m_cdfRows[rowPos++] = 0;
-            for (int y=0; y<m_size.y; ++y) {
-                Float colSum = 0;
-
-                m_cdfCols[colPos++] = 0;
-                for (int x=0; x<m_size.x; ++x) {
-                    Spectrum value(array(x, y));
-
-                    colSum += value.getLuminance();
-                    m_cdfCols[colPos++] = (float) colSum;
+            for (int y=0; y<m_size.y; ++y)
+                m_rowWeights[y] = std::sin((y + 0.5f) * M_PI / m_size.y);
+
+            double rowSum = 0;
+            size_t topLevel = m_levelSizes.size() - 1;
+            if (topLevel < 2) {
+                /* Tiny image -- there are no stored levels */
+                for (int y=0; y<m_size.y; ++y)
+                    for (int x=0; x<m_size.x; ++x)
+                        rowSum += getPixelWeight(array, x, y);
+            } else {
+                /* Sum up the luminances weighted by sin(theta) over the 2x2
+                   pixel blocks of level 1 */
+                const Vector2i &size1 = m_levelSizes[1];
+                #if defined(MTS_OPENMP)
+                    #pragma omp parallel for
+                #endif
+                for (int y=0; y<size1.y; ++y) {
+                    for (int x=0; x<size1.x; ++x) {
+                        Float weight =
+                            getPixelWeight(array, 2*x,   2*y) + getPixelWeight(array, 2*x+1, 2*y) +
+                            getPixelWeight(array, 2*x, 2*y+1) + getPixelWeight(array, 2*x+1, 2*y+1);
+                        m_tree[getChildIndex(2, x, y)] = (float) weight;
+                    }
                 }
 
-                float normalization = 1.0f / (float) colSum;
-                for (int x=1; x<m_size.x; ++x)
-                    m_cdfCols[colPos-x-1] *= normalization;
-                m_cdfCols[colPos-1] = 1.0f;
+                /* Sum up the coarser levels */
+                for (size_t level=3; level<=topLevel; ++level) {
+                    const Vector2i &childSize = m_levelSizes[level-1];
+                    for (int y=0; y<childSize.y; ++y) {
+                        for (int x=0; x<childSize.x; ++x) {
+                            const float *q = &m_tree[getChildIndex(level-1, 2*x, 2*y)];
+                            m_tree[getChildIndex(level, x, y)] = q[0] + q[1] + q[2] + q[3];
+                        }
+                    }
+                }
 
-                Float weight = std::sin((y + 0.5f) * M_PI / m_size.y);
-                m_rowWeights[y] = weight;
-                rowSum += colSum * weight;
-                m_cdfRows[rowPos++] = (float) rowSum;
+                const float *root = &m_tree[m_levelOffsets[topLevel]];
+                rowSum = (double) root[0] + root[1] + root[2] + root[3];
             }
 
-            float normalization = 1.0f / (float) rowSum;
-            for (int y=1; y<m_size.y; ++y)
-                m_cdfRows[rowPos-y-1] *= normalization;
-            m_cdfRows[rowPos-1] = 1.0f;
-
             if (rowSum == 0)
                 Log(EError, "The environment map is completely black -- this is not allowed.");
             else if (!std::isfinite(rowSum))
@@ -565,9 +585,24 @@ public:
 
     /// Helper function that samples a direction from the environment map
     void internalSampleDirection(Point2 sample, Vector &d, Spectrum &value, Float &pdf) const {
-        /* Sample a discrete pixel position */
-        uint32_t row = sampleReuse(m_cdfRows, m_size.y, sample.y),
-                 col = sampleReuse(m_cdfCols + row * (m_size.x+1), m_size.x, sample.x);
+        /* Sample a discrete pixel position by descending the luminance quadtree */
+        int col = 0, row = 0, i, j;
+        for (size_t level = m_levelSizes.size() - 1; level > 1; --level) {
+            const float *q = &m_tree[getChildIndex(level, 2*col, 2*row)];
+            sampleQuad(q[0], q[1], q[2], q[3], sample, i, j);
+            col = 2 * col + i;
+            row = 2 * row + j;
+        }
+
+        /* The last step chooses among pixels, whose weights are not stored */
+        if (m_levelSizes.size() > 1) {
+            const MIPMap::Array2DType &array = m_mipmap->getArray();
+            sampleQuad(getPixelWeight(array, 2*col, 2*row), getPixelWeight(array, 2*col+1, 2*row),
+                getPixelWeight(array, 2*col, 2*row+1), getPixelWeight(array, 2*col+1, 2*row+1),
+                sample, i, j);
+            col = 2 * col + i;
+            row = 2 * row + j;
+        }
 
         /* Using the remaining bits of precision to shift the sample by an offset
            drawn from a tent function. This effectively creates a sampling strategy
@@ -654,16 +689,60 @@ public:
 
     MTS_DECLARE_CLASS()
 private:
-    /// Sample from an array using the inversion method
-    inline uint32_t sampleReuse(float *cdf, uint32_t size, Float &sample) const {
-        float *entry = std::lower_bound(cdf, cdf+size+1, (float) sample);
-        uint32_t index = std::min((uint32_t) std::max((ptrdiff_t) 0, entry - cdf - 1), size-1);
-        sample = (sample - (Float) cdf[index]) / (Float) (cdf[index+1] - cdf[index]);
-        return index;
+    /// Return the sampling weight of a pixel (zero outside of the image)
+    inline Float getPixelWeight(const MIPMap::Array2DType &array, int x, int y) const {
+        if (x >= m_size.x || y >= m_size.y)
+            return 0.0f;
+        return Spectrum(array(x, y)).getLuminance() * m_rowWeights[y];
+    }
+
+    /**
+     * \brief Return the index in \ref m_tree that stores the weight of the
+     * level-<tt>(level-1)</tt> node \c (x, y), i.e. a child of a node on
+     * level \c level (which must be at least 2)
+     */
+    inline size_t getChildIndex(size_t level, int x, int y) const {
+        return m_levelOffsets[level] + 4 * (size_t) ((x / 2) + (y / 2)
+            * m_levelSizes[level].x) + (x & 1) + 2 * (y & 1);
+    }
+
+    /**
+     * \brief Choose one of four quadtree children with the given weights
+     * (row-major order), and adjust the sample so that it can be reused.
+     *
+     * The row is chosen using the vertical and the column using the horizontal
+     * sample component, which preserves the stratification of the input.
+     */
+    inline void sampleQuad(Float q00, Float q10, Float q01, Float q11,
+            Point2 &sample, int &i, int &j) const {
+        Float top = q00 + q10, bottom = q01 + q11;
+        Float probTop = top / (top + bottom);
+        if (sample.y < probTop) {
+            sample.y /= probTop;
+            j = 0;
+        } else {
+            sample.y = (sample.y - probTop) / (1 - probTop);
+            top = bottom; q00 = q01; q10 = q11;
+            j = 1;
+        }
+
+        Float probLeft = q00 / top;
+        if (sample.x < probLeft) {
+            sample.x /= probLeft;
+            i = 0;
+        } else {
+            sample.x = (sample.x - probLeft) / (1 - probLeft);
+            i = 1;
+        }
+
+        sample.x = std::min(sample.x, ONE_MINUS_EPS);
+        sample.y = std::min(sample.y, ONE_MINUS_EPS);
     }
 private:
     MIPMap *m_mipmap;
-    float *m_cdfRows, *m_cdfCols;
+    std::vector<float> m_tree;
+    std::vector<Vector2i> m_levelSizes;
+    std::vector<size_t> m_levelOffsets;
     Float *m_rowWeights;
     fs::path m_filename;
     Float m_gamma, m_scale;
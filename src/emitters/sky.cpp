@@ -22,6 +22,7 @@
 #include <mitsuba/core/plugin.h>
 #include "sunsky/sunmodel.h"
 #include "sunsky/skymodel.h"
+#include "sunsky/skycache.h"
 
 MTS_NAMESPACE_BEGIN
 
@@ -67,6 +68,12 @@ MTS_NAMESPACE_BEGIN
  *         This parameter can be used to scale the amount of illumination
  *         emitted by the sky emitter. \default{1}
  *     }
+ *     \parameter{cachePath}{\String}{
+ *         Optional directory, in which rasterized sky maps are cached
+ *         between runs. Cache entries are keyed by all parameters that
+ *         influence the sky model (turbidity, albedo, sun position, etc.).
+ *         \default{none, i.e. caching is disabled}
+ *     }
  *     \parameter{samplingWeight}{\Float}{
  *         Specifies the relative amount of samples
  *         allocated to this emitter. \default{1}
@@ -161,7 +168,11 @@ MTS_NAMESPACE_BEGIN
  * \pluginref{envmap} plugin---this dramatically improves rendering
  * performance. This resolution is generally plenty since the sky radiance
  * distribution is so smooth, but it can be adjusted manually if
- * necessary using the \code{resolution} parameter.
+ * necessary using the \code{resolution} parameter. When rendering
+ * sequences that revisit the same sky configurations (for instance,
+ * repeated renderings of a time-of-day animation), the \code{cachePath}
+ * parameter can be used to store the rasterized maps on disk and skip
+ * this step altogether.
  *
  * Note that while the model encompasses sunrise and sunset configurations,
  * it does not extend to the night sky, where illumination from stars, galaxies,
@@ -226,6 +237,7 @@ public:
         m_albedo = props.getSpectrum("albedo", Spectrum(0.2f));
         m_sun = computeSunCoordinates(props);
         m_extend = props.getBoolean("extend", false);
+        m_cachePath = props.getString("cachePath", "");
 
         if (m_turbidity < 1 || m_turbidity > 10)
             Log(EError, "The turbidity parameter must be in the range [1,10]!");
@@ -263,6 +275,7 @@ public:
         m_extend = stream->readBool();
         m_albedo = Spectrum(stream);
         m_sun = SphericalCoordinates(stream);
+        m_cachePath = stream->readString();
 
         Float sunElevation = 0.5f * M_PI - m_sun.elevation;
         #if SPECTRUM_SAMPLES == 3
@@ -297,6 +310,7 @@ public:
         stream->writeBool(m_extend);
         m_albedo.serialize(stream);
         m_sun.serialize(stream);
+        stream->writeString(m_cachePath.string());
     }
 
     bool isCompound() const {
@@ -307,32 +321,24 @@ public:
         if (i != 0)
             return NULL;
 
-        ref<Timer> timer = new Timer();
-        Log(EDebug, "Rasterizing skylight emitter to an %ix%i environment map ..",
-                m_resolution, m_resolution/2);
-        ref<Bitmap> bitmap = new Bitmap(SKY_PIXELFORMAT, Bitmap::EFloat,
-            Vector2i(m_resolution, m_resolution/2));
-
-        Point2 factor((2*M_PI) / bitmap->getWidth(),
-            M_PI / bitmap->getHeight());
-
-        #if defined(MTS_OPENMP)
-            #pragma omp parallel for
-        #endif
-        for (int y=0; y<bitmap->getHeight(); ++y) {
-            Float theta = (y+.5f) * factor.y;
-            Spectrum *target = (Spectrum *) bitmap->getFloatData()
-                + y * bitmap->getWidth();
-
-            for (int x=0; x<bitmap->getWidth(); ++x) {
-                Float phi = (x+.5f) * factor.x;
-
-                *target++ = getSkyRadiance(SphericalCoordinates(theta, phi));
-            }
+        SkyMapCache cache(m_cachePath, m_resolution, m_turbidity,
+            m_albedo, m_sun, m_stretch, m_extend, m_scale);
+
+        ref<Bitmap> bitmap = cache.load(SKY_PIXELFORMAT);
+        if (bitmap) {
+            Log(EDebug, "Loaded skylight environment map from \"%s\"",
+                cache.getPath().string().c_str());
+        } else {
+            ref<Timer> timer = new Timer();
+            Log(EDebug, "Rasterizing skylight emitter to an %ix%i environment map ..",
+                    m_resolution, m_resolution/2);
+            bitmap = new Bitmap(SKY_PIXELFORMAT, Bitmap::EFloat,
+                Vector2i(m_resolution, m_resolution/2));
+            rasterize(bitmap);
+            Log(EDebug, "Done (took %i ms)", timer->getMilliseconds());
+            cache.store(bitmap);
         }
 
-        Log(EDebug, "Done (took %i ms)", timer->getMilliseconds());
-
         #if defined(MTS_DEBUG_SUNSKY)
         /* Write a debug image for inspection */
         {
@@ -425,8 +431,65 @@ protected:
             + std::sin(theta) * std::sin(m_sun.elevation)
             * std::cos(coords.azimuth - m_sun.azimuth);
 
-        Float gamma = math::safe_acos(cosGamma);
+        Spectrum result = evalModel(theta, math::safe_acos(cosGamma));
+
+        if (m_extend)
+            result *= math::smoothStep((Float) 0, (Float) 1, 2 - 2*coords.elevation*INV_PI);
+
+        return result * m_scale;
+    }
+
+    /**
+     * \brief Rasterize the sky into a latitude-longitude environment map
+     *
+     * Equivalent to calling \ref getSkyRadiance() for every pixel center,
+     * but all terms that only depend on the row or column are tabulated,
+     * which leaves the model evaluation itself in the inner loop. Rows
+     * below the horizon are skipped, and rows are distributed dynamically
+     * since their cost varies.
+     */
+    void rasterize(Bitmap *bitmap) const {
+        int width = bitmap->getWidth(), height = bitmap->getHeight();
+        Point2 factor((2*M_PI) / width, M_PI / height);
+
+        std::vector<Float> cosPhi(width);
+        for (int x=0; x<width; ++x)
+            cosPhi[x] = std::cos((x+.5f) * factor.x - m_sun.azimuth);
+
+        Float cosSunTheta = std::cos(m_sun.elevation),
+              sinSunTheta = std::sin(m_sun.elevation);
 
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for schedule(dynamic)
+        #endif
+        for (int y=0; y<height; ++y) {
+            Float elevation = (y+.5f) * factor.y;
+            Float theta = elevation / m_stretch;
+            Spectrum *target = (Spectrum *) bitmap->getFloatData() + y * width;
+
+            if (std::cos(theta) <= 0) {
+                if (!m_extend) {
+                    for (int x=0; x<width; ++x)
+                        target[x] = Spectrum(0.0f);
+                    continue;
+                }
+                theta = 0.5f * M_PI - Epsilon; /* super-unrealistic mode */
+            }
+
+            Float a = std::cos(theta) * cosSunTheta,
+                  b = std::sin(theta) * sinSunTheta,
+                  weight = m_scale;
+
+            if (m_extend)
+                weight *= math::smoothStep((Float) 0, (Float) 1, 2 - 2*elevation*INV_PI);
+
+            for (int x=0; x<width; ++x)
+                target[x] = evalModel(theta, math::safe_acos(a + b * cosPhi[x])) * weight;
+        }
+    }
+
+    /// Evaluate the sky model given the view zenith angle and the angle to the sun
+    inline Spectrum evalModel(Float theta, Float gamma) const {
         Spectrum result;
         for (int i=0; i<SPECTRUM_SAMPLES; i++) {
             #if SPECTRUM_SAMPLES == 3
@@ -440,11 +503,7 @@ protected:
         }
 
         result.clampNegative();
-
-        if (m_extend)
-            result *= math::smoothStep((Float) 0, (Float) 1, 2 - 2*coords.elevation*INV_PI);
-
-        return result * m_scale;
+        return result;
     }
 
     MTS_DECLARE_CLASS()
@@ -463,6 +522,8 @@ protected:
     bool m_extend;
     /// Ground albedo
     Spectrum m_albedo;
+    /// Directory for cached sky maps (empty: disabled)
+    fs::path m_cachePath;
 
     /// State vector for the sky model
     #if SPECTRUM_SAMPLES == 3
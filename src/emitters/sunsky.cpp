@@ -21,6 +21,7 @@
 #include <mitsuba/core/bitmap.h>
 #include <mitsuba/core/qmc.h>
 #include "sunsky/sunmodel.h"
+#include "sunsky/skycache.h"
 
 #if SPECTRUM_SAMPLES == 3
 # define SUNSKY_PIXELFORMAT Bitmap::ERGB
@@ -74,6 +75,12 @@ MTS_NAMESPACE_BEGIN
  *         This parameter can be used to separately scale the amount of illumination
  *         emitted by the sky.\default{1}
  *     }
+ *     \parameter{cachePath}{\String}{
+ *         Optional directory, in which the rasterized sky is cached
+ *         between runs (see \pluginref{sky}). The sun is always added
+ *         afterwards, so its parameters do not affect the cache.
+ *         \default{none, i.e. caching is disabled}
+ *     }
  *     \parameter{sunRadiusScale}{\Float}{
  *         Scale factor to adjust the radius of the sun, while preserving its power.
  *         Set to \code{0} to turn it into a directional light source.
@@ -113,43 +120,71 @@ public:
         skyProps.setPluginName("sky");
         skyProps.setFloat("scale", skyScale, false);
 
-        ref<Emitter> sky = static_cast<Emitter *>(
-            PluginManager::getInstance()->createObject(
-            MTS_CLASS(Emitter), skyProps));
-        sky->configure();
-        props.markQueried("albedo");
-
         int resolution = props.getInteger("resolution", 512);
-        ref<Bitmap> bitmap = new Bitmap(SUNSKY_PIXELFORMAT, Bitmap::EFloat,
-            Vector2i(resolution, resolution/2));
+        Float stretch = props.getFloat("stretch", 1.0f);
+        bool extend = props.getBoolean("extend", false);
 
-        Point2 factor((2*M_PI) / bitmap->getWidth(),
-            M_PI / bitmap->getHeight());
+        /* The key must match the one computed by the nested sky plugin */
+        SkyMapCache cache(props.getString("cachePath", ""), resolution,
+            props.getFloat("turbidity", 3.0f), props.getSpectrum("albedo", Spectrum(0.2f)),
+            computeSunCoordinates(skyProps), stretch, extend, skyScale);
 
         ref<Timer> timer = new Timer();
-        Log(EDebug, "Rasterizing sun & skylight emitter to an %ix%i environment map ..",
-                resolution, resolution/2);
-
-        Spectrum *data = (Spectrum *) bitmap->getFloatData();
-
-        /* First, rasterize the sky */
-        #if defined(MTS_OPENMP)
-            #pragma omp parallel for
-        #endif
-        for (int y=0; y<bitmap->getHeight(); ++y) {
-            Float theta = (y+.5f) * factor.y;
-            Spectrum *target = data + y * bitmap->getWidth();
+        ref<Bitmap> bitmap = cache.load(SUNSKY_PIXELFORMAT);
 
-            for (int x=0; x<bitmap->getWidth(); ++x) {
-                Float phi = (x+.5f) * factor.x;
-
-                RayDifferential ray(Point(0.0f),
-                    toSphere(SphericalCoordinates(theta, phi)), 0.0f);
-
-                *target++ = sky->evalEnvironment(ray);
+        if (bitmap) {
+            Log(EDebug, "Loaded skylight environment map from \"%s\"",
+                cache.getPath().string().c_str());
+        } else {
+            ref<Emitter> sky = static_cast<Emitter *>(
+                PluginManager::getInstance()->createObject(
+                MTS_CLASS(Emitter), skyProps));
+            sky->configure();
+
+            bitmap = new Bitmap(SUNSKY_PIXELFORMAT, Bitmap::EFloat,
+                Vector2i(resolution, resolution/2));
+
+            Log(EDebug, "Rasterizing sun & skylight emitter to an %ix%i environment map ..",
+                    resolution, resolution/2);
+
+            int width = bitmap->getWidth(), height = bitmap->getHeight();
+            Point2 factor((2*M_PI) / width, M_PI / height);
+
+            /* Tabulate the azimuthal terms, which are shared by all rows */
+            std::vector<Float> sinPhi(width), cosPhi(width);
+            for (int x=0; x<width; ++x)
+                math::sincos((x+.5f) * factor.x, &sinPhi[x], &cosPhi[x]);
+
+            /* First, rasterize the sky. Rows below the horizon are black
+               unless the sky is extended, and the remaining rows vary in
+               cost -- hence the dynamic schedule */
+            #if defined(MTS_OPENMP)
+                #pragma omp parallel for schedule(dynamic)
+            #endif
+            for (int y=0; y<height; ++y) {
+                Float theta = (y+.5f) * factor.y, sinTheta, cosTheta;
+                Spectrum *target = (Spectrum *) bitmap->getFloatData() + y * width;
+
+                if (!extend && std::cos(theta / stretch) <= 0) {
+                    for (int x=0; x<width; ++x)
+                        target[x] = Spectrum(0.0f);
+                    continue;
+                }
+
+                math::sincos(theta, &sinTheta, &cosTheta);
+                for (int x=0; x<width; ++x) {
+                    RayDifferential ray(Point(0.0f), Vector(sinPhi[x]*sinTheta,
+                        cosTheta, -cosPhi[x]*sinTheta), 0.0f);
+
+                    target[x] = sky->evalEnvironment(ray);
+                }
             }
+
+            cache.store(bitmap);
         }
 
+        Spectrum *data = (Spectrum *) bitmap->getFloatData();
+
         /* Rasterizing the sphere to an environment map and checking the
            individual pixels for coverage (which is what Mitsuba 0.3.0 did)
            was slow and not very effective; for instance the power varied
@@ -191,7 +226,7 @@ public:
             size_t nSamples = (size_t) std::max((Float) 100,
                 (pixelCount * coveredPortion * 1000));
 
-            factor = Point2(bitmap->getWidth() / (2*M_PI),
+            Point2 factor(bitmap->getWidth() / (2*M_PI),
                 bitmap->getHeight() / M_PI);
 
             Spectrum value =
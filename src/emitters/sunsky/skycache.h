@@ -0,0 +1,167 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(__SKYCACHE_H)
+#define __SKYCACHE_H
+
+#include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/mstream.h>
+#include <mitsuba/core/fresolver.h>
+#include <boost/filesystem/operations.hpp>
+#include "sunmodel.h"
+
+/// Cache file version -- increase when the sky model or the file layout changes
+#define MTS_SKYCACHE_VERSION 0x01
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Disk cache of rasterized Hosek-Wilkie sky maps
+ *
+ * The rasterized sky only depends on a handful of parameters, which
+ * are serialized into a binary key. Its hash determines the filename
+ * inside the cache directory, while the key itself is stored in the
+ * file header and compared on lookup to rule out collisions. This
+ * allows animations to reuse sky maps across frames and renders
+ * (e.g. when only the camera or the sun intensity changes, or when a
+ * time-of-day sequence is rendered repeatedly).
+ */
+class SkyMapCache {
+public:
+    /// Create a cache key from the parameters of the sky model
+    SkyMapCache(const fs::path &cachePath, int resolution, Float turbidity,
+            const Spectrum &albedo, const SphericalCoordinates &sun,
+            Float stretch, bool extend, Float scale) : m_path(cachePath) {
+        m_key = new MemoryStream();
+        m_key->setByteOrder(Stream::ELittleEndian);
+        m_key->writeInt(SPECTRUM_SAMPLES);
+        m_key->writeInt(resolution);
+        m_key->writeFloat(turbidity);
+        albedo.serialize(m_key);
+        sun.serialize(m_key);
+        m_key->writeFloat(stretch);
+        m_key->writeBool(extend);
+        m_key->writeFloat(scale);
+
+        /* 64-bit FNV-1a hash of the key */
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        const uint8_t *data = m_key->getData();
+        for (size_t i=0; i<m_key->getSize(); ++i)
+            hash = (hash ^ data[i]) * 0x100000001b3ULL;
+
+        if (!m_path.empty()) {
+            m_path = Thread::getThread()->getFileResolver()->resolve(m_path);
+            m_path /= formatString("sky_%016llx.bin", (unsigned long long) hash);
+        }
+    }
+
+    /// Is caching enabled?
+    inline bool isEnabled() const { return !m_path.empty(); }
+
+    /// Return the cache filename
+    inline const fs::path &getPath() const { return m_path; }
+
+    /**
+     * \brief Try to load a matching sky map from the cache
+     *
+     * Returns \c NULL if caching is disabled, or if there is no
+     * valid cache entry.
+     */
+    ref<Bitmap> load(Bitmap::EPixelFormat pixelFormat) const {
+        if (!isEnabled() || !fs::exists(m_path))
+            return NULL;
+
+        try {
+            ref<FileStream> fs = new FileStream(m_path, FileStream::EReadOnly);
+            fs->setByteOrder(Stream::ELittleEndian);
+
+            char identifier[3];
+            fs->read(identifier, 3);
+            uint8_t version = fs->readUChar();
+            if (identifier[0] != 'S' || identifier[1] != 'K' || identifier[2] != 'Y'
+                    || version != MTS_SKYCACHE_VERSION)
+                return NULL;
+
+            size_t keySize = fs->readSize();
+            if (keySize != m_key->getSize())
+                return NULL;
+            std::vector<uint8_t> key(keySize);
+            fs->read(&key[0], keySize);
+            if (memcmp(&key[0], m_key->getData(), keySize) != 0)
+                return NULL;
+
+            Vector2i size(fs);
+            ref<Bitmap> bitmap = new Bitmap(pixelFormat, Bitmap::EFloat, size);
+            if (fs->getSize() - fs->getPos() != bitmap->getBufferSize())
+                return NULL;
+            fs->readFloatArray(bitmap->getFloatData(),
+                bitmap->getBufferSize() / sizeof(Float));
+            return bitmap;
+        } catch (const std::exception &ex) {
+            SLog(EWarn, "Could not read sky cache file \"%s\": %s",
+                m_path.string().c_str(), ex.what());
+            return NULL;
+        }
+    }
+
+    /**
+     * \brief Store a sky map in the cache
+     *
+     * The file is first written to a temporary location and then
+     * renamed, so that concurrently running renderers never observe
+     * a partially written entry.
+     */
+    void store(const Bitmap *bitmap) const {
+        if (!isEnabled())
+            return;
+
+        fs::path tmpPath = m_path.parent_path()
+            / fs::unique_path("sky_%%%%%%%%%%%%.tmp");
+
+        try {
+            if (!fs::exists(m_path.parent_path()))
+                fs::create_directories(m_path.parent_path());
+
+            ref<FileStream> fs = new FileStream(tmpPath, FileStream::ETruncWrite);
+            fs->setByteOrder(Stream::ELittleEndian);
+            fs->write("SKY", 3);
+            fs->writeUChar(MTS_SKYCACHE_VERSION);
+            fs->writeSize(m_key->getSize());
+            fs->write(m_key->getData(), m_key->getSize());
+            bitmap->getSize().serialize(fs);
+            fs->writeFloatArray(bitmap->getFloatData(),
+                bitmap->getBufferSize() / sizeof(Float));
+            fs->close();
+            fs::rename(tmpPath, m_path);
+        } catch (const std::exception &ex) {
+            SLog(EWarn, "Could not write sky cache file \"%s\": %s",
+                m_path.string().c_str(), ex.what());
+            if (fs::exists(tmpPath))
+                fs::remove(tmpPath);
+        }
+    }
+private:
+    ref<MemoryStream> m_key;
+    fs::path m_path;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __SKYCACHE_H */
@@ -227,6 +227,10 @@ public:
         m_storage->put(block);
     }
 
+    void putConcurrent(const ImageBlock *block) {
+        m_storage->putConcurrent(block);
+    }
+
     void setBitmap(const Bitmap *bitmap, Float multiplier) {
         bitmap->convert(m_storage->getBitmap(), multiplier);
     }
@@ -0,0 +1,928 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <mitsuba/render/film.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/version.h>
+#include <mitsuba/core/lock.h>
+#include <boost/algorithm/string.hpp>
+#include <deque>
+
+#if defined(_MSC_VER)
+#pragma warning(disable : 4231) // nonstandard extension used : 'extern' before template explicit instantiation
+#endif
+
+#include <ImfTiledOutputFile.h>
+#include <ImfTiledInputFile.h>
+#include <ImfChannelList.h>
+#include <ImfStringAttribute.h>
+#include <ImfFrameBuffer.h>
+#include <ImfStandardAttributes.h>
+
+MTS_NAMESPACE_BEGIN
+
+/*!\plugin{streamhdrfilm}{Streaming high dynamic range film}
+ * \order{5}
+ * \parameters{
+ *     \parameter{width, height}{\Integer}{
+ *       Width and height of the camera sensor in pixels
+ *       \default{768, 576}
+ *     }
+ *     \parameter{cropOffsetX, cropOffsetY, cropWidth, cropHeight}{\Integer}{
+ *       These parameters can optionally be provided to select a sub-rectangle
+ *       of the output. In this case, Mitsuba will only render the requested
+ *       regions. \default{Unused}
+ *     }
+ *     \parameter{pixelFormat}{\String}{Specifies the desired pixel format
+ *         for OpenEXR output images. The options are \code{luminance},
+ *         \code{luminanceAlpha}, \code{rgb}, \code{rgba}, \code{xyz},
+ *         \code{xyza}, \code{spectrum}, and \code{spectrumAlpha}. In the latter two cases,
+ *         the number of written channels depends on the value assigned to
+ *         \code{SPECTRUM\_SAMPLES} during compilation (see Section~\ref{sec:compiling}
+ *         for details)
+ *         \default{\code{rgb}}
+ *     }
+ *     \parameter{componentFormat}{\String}{Specifies the desired floating
+ *         point component format used for the output. The options are
+ *         \code{float16}, \code{float32}, or \code{uint32}
+ *         \default{\code{float16}}
+ *     }
+ *     \parameter{writeQueueSize}{\Integer}{
+ *         Maximum number of finished tiles that may wait for the background
+ *         writer thread before rendering is throttled \default{64}
+ *     }
+ *
+ *     \parameter{\Unnamed}{\RFilter}{Reconstruction filter that should
+ *     be used by the film. \default{\code{gaussian}, a windowed Gaussian filter}}
+ * }
+ *
+ * Like \pluginref{tiledhdrfilm}, this plugin writes the rendered image
+ * as a \emph{tiled} high dynamic-range OpenEXR file and only keeps the image
+ * blocks that are currently being rendered (and their not yet finished
+ * neighbors) in memory. Finished tiles are converted to the output format
+ * and handed to a background thread that compresses and writes them, so
+ * that rendering does not stall on disk I/O.
+ *
+ * In contrast to \pluginref{tiledhdrfilm}, this film also supports rendering
+ * techniques that update the image as a whole, such as particle tracing
+ * and bidirectional path tracing with light image contributions. These
+ * updates are kept in a \emph{sparse overflow buffer} that only stores
+ * tiles with nonzero contents (in single precision and in the output
+ * pixel format). When the rendering finishes, any tiles of the output
+ * file that received such updates after they were written are rewritten
+ * in a second pass, which again streams one tile at a time.
+ *
+ * \remarks{
+ *    \item This film is only meant for command line-based rendering. When
+ *    used with \texttt{mtsgui}, the preview image will be black.
+ *    \item A global image update that overwrites the film (as done by particle
+ *    tracing) supersedes all tiles that were previously received.
+ *    \item Techniques that update the image as a whole typically keep a
+ *    full-resolution image of their own, hence the memory savings are
+ *    largest with block-based integrators.
+ * }
+ */
+
+/// Create an OpenEXR frame buffer that addresses a tile stored in a bitmap
+static Imf::FrameBuffer createFrameBuffer(Bitmap *tile, int x, int y,
+        const std::vector<std::string> &channelNames, Imf::PixelType pixelType,
+        size_t compStride) {
+    size_t pixelStride = channelNames.size() * compStride,
+           rowStride = pixelStride * (size_t) tile->getWidth();
+
+    /* The slices are indexed using absolute pixel coordinates */
+    char *ptr = (char *) tile->getUInt8Data()
+        - (size_t) x * tile->getWidth() * pixelStride
+        - (size_t) y * tile->getHeight() * rowStride;
+
+    Imf::FrameBuffer frameBuffer;
+    for (size_t i=0; i<channelNames.size(); ++i) {
+        frameBuffer.insert(channelNames[i].c_str(),
+            Imf::Slice(pixelType, ptr, pixelStride, rowStride));
+        ptr += compStride;
+    }
+    return frameBuffer;
+}
+
+/**
+ * \brief Background thread that writes finished tiles to a tiled OpenEXR file
+ *
+ * Tiles are queued in the pixel and component format of the file. The
+ * producer is throttled when the queue is full, which bounds the amount of
+ * memory used by tiles that are waiting to be written.
+ */
+class TileWriter : public Thread {
+public:
+    TileWriter(Imf::TiledOutputFile *output, const std::vector<std::string> &channelNames,
+            Imf::PixelType pixelType, size_t compStride, size_t maxQueued)
+        : Thread("exrw"), m_output(output), m_channelNames(channelNames),
+          m_pixelType(pixelType), m_compStride(compStride), m_maxQueued(maxQueued),
+          m_done(false), m_tileCount(0), m_peakQueued(0) {
+        m_mutex = new Mutex();
+        m_cond = new ConditionVariable(m_mutex);
+    }
+
+    /// Queue a tile for writing, waiting while the queue is full
+    void push(int x, int y, Bitmap *tile) {
+        UniqueLock lock(m_mutex);
+        while (m_queue.size() >= m_maxQueued)
+            m_cond->wait();
+        m_queue.push_back(QueuedTile(x, y, tile));
+        m_peakQueued = std::max(m_peakQueued, m_queue.size());
+        m_cond->broadcast();
+    }
+
+    /// Return a previously written tile bitmap for reuse (or \c NULL)
+    ref<Bitmap> recycle() {
+        LockGuard lock(m_mutex);
+        if (m_free.empty())
+            return NULL;
+        ref<Bitmap> tile = m_free.back();
+        m_free.pop_back();
+        return tile;
+    }
+
+    /// Write all queued tiles and wait for the thread to terminate
+    void finish() {
+        {
+            LockGuard lock(m_mutex);
+            m_done = true;
+            m_cond->broadcast();
+        }
+        join();
+
+        if (!m_error.empty())
+            Log(EError, "Unable to write the OpenEXR file: %s", m_error.c_str());
+    }
+
+    /// Return the number of written tiles
+    size_t getTileCount() const { return m_tileCount; }
+
+    /// Return the largest number of tiles that were waiting to be written
+    size_t getPeakQueued() const { return m_peakQueued; }
+
+    void run() {
+        while (true) {
+            UniqueLock lock(m_mutex);
+            while (m_queue.empty() && !m_done)
+                m_cond->wait();
+            if (m_queue.empty())
+                break;
+
+            QueuedTile tile = m_queue.front();
+            m_queue.pop_front();
+            m_cond->broadcast();
+            lock.unlock();
+
+            try {
+                m_output->setFrameBuffer(createFrameBuffer(tile.bitmap, tile.x, tile.y,
+                    m_channelNames, m_pixelType, m_compStride));
+                m_output->writeTile(tile.x, tile.y);
+            } catch (const std::exception &e) {
+                if (m_error.empty())
+                    m_error = e.what();
+            }
+
+            lock.lock();
+            m_free.push_back(tile.bitmap);
+            ++m_tileCount;
+        }
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    struct QueuedTile {
+        int x, y;
+        ref<Bitmap> bitmap;
+
+        inline QueuedTile(int x, int y, Bitmap *bitmap)
+            : x(x), y(y), bitmap(bitmap) { }
+    };
+
+    virtual ~TileWriter() { }
+private:
+    Imf::TiledOutputFile *m_output;
+    std::vector<std::string> m_channelNames;
+    Imf::PixelType m_pixelType;
+    size_t m_compStride, m_maxQueued;
+    ref<Mutex> m_mutex;
+    ref<ConditionVariable> m_cond;
+    std::deque<QueuedTile> m_queue;
+    std::vector<ref<Bitmap> > m_free;
+    std::string m_error;
+    bool m_done;
+    size_t m_tileCount, m_peakQueued;
+};
+
+class StreamingHDRFilm : public Film {
+public:
+    StreamingHDRFilm(const Properties &props) : Film(props), m_output(NULL) {
+        std::vector<std::string> pixelFormats = tokenize(boost::to_lower_copy(
+            props.getString("pixelFormat", "rgb")), " ,");
+        std::vector<std::string> channelNames = tokenize(
+            props.getString("channelNames", ""), ", ");
+        std::string componentFormat = boost::to_lower_copy(
+            props.getString("componentFormat", "float16"));
+
+        if (pixelFormats.empty())
+            Log(EError, "At least one pixel format must be specified!");
+
+        if ((pixelFormats.size() != 1 && channelNames.size() != pixelFormats.size()) ||
+            (pixelFormats.size() == 1 && channelNames.size() > 1))
+            Log(EError, "Number of channel names must match the number of specified pixel formats!");
+
+        for (size_t i=0; i<pixelFormats.size(); ++i) {
+            std::string pixelFormat = pixelFormats[i];
+            std::string name = i < channelNames.size() ? (channelNames[i] + std::string(".")) : "";
+
+            if (pixelFormat == "luminance") {
+                m_pixelFormats.push_back(Bitmap::ELuminance);
+                m_channelNames.push_back(name + "Y");
+            } else if (pixelFormat == "luminancealpha") {
+                m_pixelFormats.push_back(Bitmap::ELuminanceAlpha);
+                m_channelNames.push_back(name + "Y");
+                m_channelNames.push_back(name + "A");
+            } else if (pixelFormat == "rgb") {
+                m_pixelFormats.push_back(Bitmap::ERGB);
+                m_channelNames.push_back(name + "R");
+                m_channelNames.push_back(name + "G");
+                m_channelNames.push_back(name + "B");
+            } else if (pixelFormat == "rgba") {
+                m_pixelFormats.push_back(Bitmap::ERGBA);
+                m_channelNames.push_back(name + "R");
+                m_channelNames.push_back(name + "G");
+                m_channelNames.push_back(name + "B");
+                m_channelNames.push_back(name + "A");
+            } else if (pixelFormat == "xyz") {
+                m_pixelFormats.push_back(Bitmap::EXYZ);
+                m_channelNames.push_back(name + "X");
+                m_channelNames.push_back(name + "Y");
+                m_channelNames.push_back(name + "Z");
+            } else if (pixelFormat == "xyza") {
+                m_pixelFormats.push_back(Bitmap::EXYZA);
+                m_channelNames.push_back(name + "X");
+                m_channelNames.push_back(name + "Y");
+                m_channelNames.push_back(name + "Z");
+                m_channelNames.push_back(name + "A");
+            } else if (pixelFormat == "spectrum") {
+                m_pixelFormats.push_back(Bitmap::ESpectrum);
+                for (int i=0; i<SPECTRUM_SAMPLES; ++i) {
+                    std::pair<Float, Float> coverage = Spectrum::getBinCoverage(i);
+                    m_channelNames.push_back(name + formatString("%.2f-%.2fnm", coverage.first, coverage.second));
+                }
+            } else if (pixelFormat == "spectrumalpha") {
+                m_pixelFormats.push_back(Bitmap::ESpectrumAlpha);
+                for (int i=0; i<SPECTRUM_SAMPLES; ++i) {
+                    std::pair<Float, Float> coverage = Spectrum::getBinCoverage(i);
+                    m_channelNames.push_back(name + formatString("%.2f-%.2fnm", coverage.first, coverage.second));
+                }
+                m_channelNames.push_back(name + "A");
+            } else {
+                Log(EError, "The \"pixelFormat\" parameter must either be equal to "
+                    "\"luminance\", \"luminanceAlpha\", \"rgb\", \"rgba\", \"xyz\", \"xyza\", "
+                    "\"spectrum\", or \"spectrumAlpha\"!");
+            }
+        }
+
+        for (size_t i=0; i<m_pixelFormats.size(); ++i) {
+            if (SPECTRUM_SAMPLES == 3 && (m_pixelFormats[i] == Bitmap::ESpectrum || m_pixelFormats[i] == Bitmap::ESpectrumAlpha))
+                Log(EError, "You requested to render a spectral image, but Mitsuba is currently "
+                    "configured for a RGB flow (i.e. SPECTRUM_SAMPLES = 3). You will need to recompile "
+                    "it with a different configuration. Please see the documentation for details.");
+        }
+
+        if (componentFormat == "float16") {
+            m_componentFormat = Bitmap::EFloat16;
+        } else if (componentFormat == "float32") {
+            m_componentFormat = Bitmap::EFloat32;
+        } else if (componentFormat == "uint32") {
+            m_componentFormat = Bitmap::EUInt32;
+        } else {
+            Log(EError, "The \"componentFormat\" parameter must either be "
+                "equal to \"float16\", \"float32\", or \"uint32\"!");
+        }
+
+        m_writeQueueSize = props.getInteger("writeQueueSize", 64);
+        if (m_writeQueueSize < 1)
+            Log(EError, "The \"writeQueueSize\" parameter must be positive!");
+
+        if (m_highQualityEdges)
+            Log(EError, "The 'highQualityEdges' parameter is incompatible with the "
+                "streaming EXR film. Please disable it.");
+    }
+
+    StreamingHDRFilm(Stream *stream, InstanceManager *manager)
+        : Film(stream, manager), m_output(NULL) {
+        m_pixelFormats.resize((size_t) stream->readUInt());
+        for (size_t i=0; i<m_pixelFormats.size(); ++i)
+            m_pixelFormats[i] = (Bitmap::EPixelFormat) stream->readUInt();
+        m_channelNames.resize((size_t) stream->readUInt());
+        for (size_t i=0; i<m_channelNames.size(); ++i)
+            m_channelNames[i] = stream->readString();
+        m_componentFormat = (Bitmap::EComponentFormat) stream->readUInt();
+        m_writeQueueSize = stream->readInt();
+    }
+
+    virtual ~StreamingHDRFilm() {
+        develop(NULL, 0);
+    }
+
+    void serialize(Stream *stream, InstanceManager *manager) const {
+        Film::serialize(stream, manager);
+        stream->writeUInt((uint32_t) m_pixelFormats.size());
+        for (size_t i=0; i<m_pixelFormats.size(); ++i)
+            stream->writeUInt(m_pixelFormats[i]);
+        stream->writeUInt((uint32_t) m_channelNames.size());
+        for (size_t i=0; i<m_channelNames.size(); ++i)
+            stream->writeString(m_channelNames[i]);
+        stream->writeUInt(m_componentFormat);
+        stream->writeInt(m_writeQueueSize);
+    }
+
+    void setDestinationFile(const fs::path &destFile, uint32_t blockSize) {
+        if (m_output)
+            develop(NULL, 0);
+
+        m_filename = destFile;
+        std::string extension = boost::to_lower_copy(m_filename.extension().string());
+        if (extension != ".exr")
+            m_filename.replace_extension(".exr");
+
+        Log(EInfo, "Commencing creation of a tiled EXR image at \"%s\" ..",
+            m_filename.string().c_str());
+
+        if (m_componentFormat == Bitmap::EFloat16) {
+            m_compType = Imf::HALF;
+            m_compStride = 2;
+        } else if (m_componentFormat == Bitmap::EFloat32) {
+            m_compType = Imf::FLOAT;
+            m_compStride = 4;
+        } else if (m_componentFormat == Bitmap::EUInt32) {
+            m_compType = Imf::UINT;
+            m_compStride = 4;
+        } else {
+            Log(EError, "Invalid component type (must be "
+                "float16, float32, or uint32)");
+            return;
+        }
+
+        m_blockSize = (int) blockSize;
+        m_blocksH = (m_cropSize.x + m_blockSize - 1) / m_blockSize;
+        m_blocksV = (m_cropSize.y + m_blockSize - 1) / m_blockSize;
+        m_written.assign((size_t) m_blocksH * (size_t) m_blocksV, false);
+        m_overflow.clear();
+        m_replaced = false;
+        m_peakUsage = 0;
+        m_peakOverflow = 0;
+
+        m_output = new Imf::TiledOutputFile(m_filename.string().c_str(), createHeader());
+        m_writer = new TileWriter(m_output, m_channelNames, m_compType,
+            m_compStride, (size_t) m_writeQueueSize);
+        m_writer->start();
+    }
+
+    void put(const ImageBlock *block) {
+        Assert(m_output != NULL);
+
+        if ((block->getOffset().x % m_blockSize) != 0 ||
+            (block->getOffset().y % m_blockSize) != 0)
+            Log(EError, "Encountered an unaligned block!");
+
+        if (block->getSize().x > m_blockSize ||
+            block->getSize().y > m_blockSize)
+            Log(EError, "Encountered an oversized block!");
+
+        /* The image was overwritten as a whole, which supersedes all tiles */
+        if (m_replaced)
+            return;
+
+        int x = block->getOffset().x / (int) m_blockSize;
+        int y = block->getOffset().y / (int) m_blockSize;
+
+        /* Create two copies: a clean one, and one that is used for accumulation */
+        ref<ImageBlock> copy1, copy2;
+        if (m_freeBlocks.size() > 0) {
+            copy1 = m_freeBlocks.back();
+            block->copyTo(copy1);
+            m_freeBlocks.pop_back();
+        } else {
+            copy1 = block->clone();
+            copy1->incRef();
+            ++m_peakUsage;
+        }
+
+        if (m_freeBlocks.size() > 0) {
+            copy2 = m_freeBlocks.back();
+            block->copyTo(copy2);
+            m_freeBlocks.pop_back();
+        } else {
+            copy2 = block->clone();
+            copy2->incRef();
+            ++m_peakUsage;
+        }
+
+        uint32_t idx = (uint32_t) x + (uint32_t) y * m_blocksH;
+        m_origBlocks[idx]   = copy1;
+        m_mergedBlocks[idx] = copy2;
+
+        for (int yo = -1; yo <= 1; ++yo)
+            for (int xo = -1; xo <= 1; ++xo)
+                potentiallyWrite(x + xo, y + yo, false);
+    }
+
+    void setBitmap(const Bitmap *bitmap, Float multiplier) {
+        Assert(m_output != NULL);
+        if (bitmap->getSize() != m_cropSize)
+            Log(EError, "setBitmap(): Bitmap size mismatch!");
+
+        /* The overflow buffer is also accessed by putConcurrent() */
+        LockGuard lock(m_putMutex);
+
+        /* Replace the contents of the entire film */
+        m_overflow.clear();
+        m_replaced = true;
+
+        for (int y=0; y<m_blocksV; ++y) {
+            for (int x=0; x<m_blocksH; ++x) {
+                Point2i offset(x * m_blockSize, y * m_blockSize);
+                Vector2i size(
+                    std::min(m_blockSize, m_cropSize.x - offset.x),
+                    std::min(m_blockSize, m_cropSize.y - offset.y));
+
+                ref<Bitmap> region = bitmap->crop(offset, size);
+                ref<Bitmap> storage;
+                if (m_pixelFormats.size() == 1)
+                    storage = new Bitmap(Bitmap::ESpectrumAlphaWeight, Bitmap::EFloat, size);
+                else
+                    storage = new Bitmap(Bitmap::EMultiSpectrumAlphaWeight, Bitmap::EFloat, size,
+                        (int) (SPECTRUM_SAMPLES * m_pixelFormats.size() + 2));
+                region->convert(storage, multiplier);
+
+                ref<Bitmap> tile;
+                if (m_pixelFormats.size() == 1)
+                    tile = storage->convert(m_pixelFormats[0], Bitmap::EFloat32);
+                else
+                    tile = storage->convertMultiSpectrumAlphaWeight(m_pixelFormats,
+                        Bitmap::EFloat32, m_channelNames);
+
+                if (!isZero(tile))
+                    m_overflow[(uint32_t) x + (uint32_t) y * m_blocksH] = tile;
+            }
+        }
+
+        m_peakOverflow = std::max(m_peakOverflow, m_overflow.size());
+    }
+
+    void addBitmap(const Bitmap *bitmap, Float multiplier) {
+        /* Only accumulating spectrum-valued floating point images is
+           supported (see the 'hdrfilm' plugin for details) */
+        Assert(m_output != NULL);
+        if (bitmap->getPixelFormat() != Bitmap::ESpectrum ||
+            bitmap->getComponentFormat() != Bitmap::EFloat ||
+            bitmap->getGamma() != 1.0f ||
+            bitmap->getSize() != m_cropSize ||
+            m_pixelFormats.size() != 1) {
+            Log(EError, "addBitmap(): Unsupported bitmap format!");
+        }
+
+        LockGuard lock(m_putMutex);
+
+        for (int y=0; y<m_blocksV; ++y) {
+            for (int x=0; x<m_blocksH; ++x) {
+                Point2i offset(x * m_blockSize, y * m_blockSize);
+                Vector2i size(
+                    std::min(m_blockSize, m_cropSize.x - offset.x),
+                    std::min(m_blockSize, m_cropSize.y - offset.y));
+
+                ref<Bitmap> region = bitmap->crop(offset, size);
+                if (isZero(region))
+                    continue;
+
+                /* Accumulate the contribution without affecting the alpha channel */
+                ref<Bitmap> tile = region->convert(m_pixelFormats[0],
+                    Bitmap::EFloat32, 1.0f, multiplier);
+                clearAlpha(tile);
+
+                uint32_t idx = (uint32_t) x + (uint32_t) y * m_blocksH;
+                std::map<uint32_t, ref<Bitmap> >::iterator it = m_overflow.find(idx);
+                if (it == m_overflow.end())
+                    m_overflow[idx] = tile;
+                else
+                    it->second->accumulate(tile);
+            }
+        }
+
+        m_peakOverflow = std::max(m_peakOverflow, m_overflow.size());
+    }
+
+    /**
+     * \brief Write a tile once all of its neighbors are available, or
+     * unconditionally when \c force is set (e.g. when the rendering
+     * was stopped before all blocks were rendered)
+     */
+    void potentiallyWrite(int x, int y, bool force) {
+        if (x < 0 || y < 0 || x >= m_blocksH || y >= m_blocksV)
+            return;
+
+        uint32_t idx = (uint32_t) x + (uint32_t) y * m_blocksH;
+        std::map<uint32_t, ImageBlock *>::iterator it = m_origBlocks.find(idx);
+        if (it == m_origBlocks.end())
+            return;
+
+        ImageBlock *origBlock = it->second;
+        if (origBlock == NULL)
+            return;
+
+        /* This could be accelerated using some counters */
+        for (int yo = -1; yo <= 1 && !force; ++yo) {
+            for (int xo = -1; xo <= 1; ++xo) {
+                int xp = x + xo, yp = y + yo;
+                if (xp < 0 || yp < 0 || xp >= m_blocksH || yp >= m_blocksV
+                   || (xp == x && yp == y))
+                    continue;
+
+                uint32_t idx2 = (uint32_t) xp + (uint32_t) yp * m_blocksH;
+                if (m_origBlocks.find(idx2) == m_origBlocks.end())
+                    return; /* Not all neighboring blocks are there yet */
+            }
+        }
+
+        ImageBlock *mergedBlock = m_mergedBlocks[idx];
+        if (mergedBlock == NULL)
+            return;
+
+        /* All neighboring blocks are there -- join overlapping regions */
+        for (int yo = -1; yo <= 1; ++yo) {
+            for (int xo = -1; xo <= 1; ++xo) {
+                int xp = x + xo, yp = y + yo;
+                if (xp < 0 || yp < 0 || xp >= m_blocksH || yp >= m_blocksV
+                   || (xp == x && yp == y))
+                    continue;
+                uint32_t idx2 = (uint32_t) xp + (uint32_t) yp * m_blocksH;
+                std::map<uint32_t, ImageBlock *>::iterator it2 = m_origBlocks.find(idx2);
+                if (it2 == m_origBlocks.end())
+                    continue;
+                ImageBlock *origBlock2   = it2->second;
+                ImageBlock *mergedBlock2 = m_mergedBlocks[idx2];
+                if (!origBlock2 || !mergedBlock2)
+                    continue;
+
+                mergedBlock->put(origBlock2);
+                mergedBlock2->put(origBlock);
+            }
+        }
+
+        writeTile(x, y, mergedBlock);
+
+        /* Release the block */
+        m_freeBlocks.push_back(origBlock);
+        m_freeBlocks.push_back(mergedBlock);
+        m_origBlocks[idx] = NULL;
+        m_mergedBlocks[idx] = NULL;
+    }
+
+    bool develop(const Point2i &sourceOffset, const Vector2i &size,
+            const Point2i &targetOffset, Bitmap *target) const {
+        target->fillRect(targetOffset, size, Spectrum(0.0f));
+        return false; /* Not supported by the streaming EXR film! */
+    }
+
+    void develop(const Scene *scene, Float renderTime) {
+        if (!m_output)
+            return;
+
+        if (!m_replaced) {
+            /* Write all remaining tiles, including those that
+               were never rendered (e.g. due to cancellation) */
+            for (int y=0; y<m_blocksV; ++y) {
+                for (int x=0; x<m_blocksH; ++x) {
+                    uint32_t idx = (uint32_t) x + (uint32_t) y * m_blocksH;
+                    potentiallyWrite(x, y, true);
+                    if (!m_written[idx])
+                        writeTile(x, y, NULL);
+                }
+            }
+        }
+
+        m_writer->finish();
+        size_t peakQueued = m_writer->getPeakQueued();
+        m_writer = NULL;
+        delete m_output;
+        m_output = NULL;
+
+        /* Global image updates that arrived after the affected
+           tiles were written require a second pass */
+        if (m_replaced || !m_overflow.empty())
+            rewrite();
+
+        Log(EInfo, "Closed EXR file (%i tiles in total, peak memory usage: %i "
+            "blocks in flight, " SIZE_T_FMT " queued tiles, " SIZE_T_FMT " overflow tiles)",
+            m_blocksH * m_blocksV, m_peakUsage, peakQueued, m_peakOverflow);
+
+        for (std::vector<ImageBlock *>::iterator it = m_freeBlocks.begin();
+            it != m_freeBlocks.end(); ++it)
+            (*it)->decRef();
+        m_freeBlocks.clear();
+
+        for (std::map<uint32_t, ImageBlock *>::iterator it = m_origBlocks.begin();
+            it != m_origBlocks.end(); ++it) {
+            if ((*it).second)
+                (*it).second->decRef();
+        }
+        m_origBlocks.clear();
+
+        for (std::map<uint32_t, ImageBlock *>::iterator it = m_mergedBlocks.begin();
+            it != m_mergedBlocks.end(); ++it) {
+            if ((*it).second)
+                (*it).second->decRef();
+        }
+        m_mergedBlocks.clear();
+        m_overflow.clear();
+    }
+
+    void clear() { /* Do nothing */ }
+
+    bool hasAlpha() const {
+        for (size_t i=0; i<m_pixelFormats.size(); ++i) {
+            if (m_pixelFormats[i] == Bitmap::ELuminanceAlpha ||
+                m_pixelFormats[i] == Bitmap::ERGBA ||
+                m_pixelFormats[i] == Bitmap::EXYZA ||
+                m_pixelFormats[i] == Bitmap::ESpectrumAlpha)
+                return true;
+        }
+        return false;
+    }
+
+    bool destinationExists(const fs::path &baseName) const {
+        fs::path filename = baseName;
+        if (boost::to_lower_copy(filename.extension().string()) != ".exr")
+            filename.replace_extension(".exr");
+        return fs::exists(filename);
+    }
+
+    std::string toString() const {
+        std::ostringstream oss;
+        oss << "StreamingHDRFilm[" << endl
+            << "  size = " << m_size.toString() << "," << endl
+            << "  pixelFormat = ";
+        for (size_t i=0; i<m_pixelFormats.size(); ++i)
+            oss << m_pixelFormats[i] << ", ";
+        oss << endl
+            << "  channelNames = ";
+        for (size_t i=0; i<m_channelNames.size(); ++i)
+            oss << "\"" << m_channelNames[i] << "\"" << ", ";
+        oss << endl
+            << "  componentFormat = " << m_componentFormat << "," << endl
+            << "  writeQueueSize = " << m_writeQueueSize << "," << endl
+            << "  cropOffset = " << m_cropOffset.toString() << "," << endl
+            << "  cropSize = " << m_cropSize.toString() << "," << endl
+            << "  filter = " << indent(m_filter->toString()) << endl
+            << "]";
+        return oss.str();
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Create the header of the output file
+    Imf::Header createHeader() const {
+        Imf::Header header(m_cropSize.x, m_cropSize.y);
+        header.setTileDescription(Imf::TileDescription(m_blockSize, m_blockSize, Imf::ONE_LEVEL));
+        header.insert("generated-by", Imf::StringAttribute("Mitsuba version " MTS_VERSION));
+
+        if (m_pixelFormats.size() == 1) {
+            /* Write a chromaticity tag when this is possible */
+            Bitmap::EPixelFormat pixelFormat = m_pixelFormats[0];
+            if (pixelFormat == Bitmap::EXYZ || pixelFormat == Bitmap::EXYZA) {
+                Imf::addChromaticities(header, Imf::Chromaticities(
+                    Imath::V2f(1.0f, 0.0f),
+                    Imath::V2f(0.0f, 1.0f),
+                    Imath::V2f(0.0f, 0.0f),
+                    Imath::V2f(1.0f/3.0f, 1.0f/3.0f)));
+            } else if (pixelFormat == Bitmap::ERGB || pixelFormat == Bitmap::ERGBA) {
+                Imf::addChromaticities(header, Imf::Chromaticities());
+            }
+        }
+
+        Imf::ChannelList &channels = header.channels();
+        for (size_t i=0; i<m_channelNames.size(); ++i)
+            channels.insert(m_channelNames[i].c_str(), Imf::Channel(m_compType));
+
+        return header;
+    }
+
+    /// Create a tile bitmap in the output pixel format(s)
+    ref<Bitmap> createTile(Bitmap::EComponentFormat componentFormat) const {
+        Vector2i size(m_blockSize, m_blockSize);
+        ref<Bitmap> tile;
+        if (m_pixelFormats.size() == 1) {
+            tile = new Bitmap(m_pixelFormats[0], componentFormat, size);
+        } else {
+            tile = new Bitmap(Bitmap::EMultiChannel, componentFormat, size,
+                (uint8_t) m_channelNames.size());
+            tile->setChannelNames(m_channelNames);
+        }
+        return tile;
+    }
+
+    /// Develop the interior of an image block into a tile bitmap
+    void developBlock(const ImageBlock *block, Bitmap *tile) const {
+        const Bitmap *source = block->getBitmap();
+
+        size_t sourceBpp = source->getBytesPerPixel();
+        size_t targetBpp = tile->getBytesPerPixel();
+
+        const uint8_t *sourceData = source->getUInt8Data()
+            + block->getBorderSize() * sourceBpp * (1 + source->getWidth());
+        uint8_t *targetData = tile->getUInt8Data();
+
+        const FormatConverter *cvt = FormatConverter::getInstance(
+            std::make_pair(Bitmap::EFloat, tile->getComponentFormat())
+        );
+
+        for (int i=0; i<m_blockSize; ++i) {
+            if (m_pixelFormats.size() == 1)
+                cvt->convert(source->getPixelFormat(), 1.0f, sourceData,
+                    tile->getPixelFormat(), tile->getGamma(), targetData,
+                    tile->getWidth());
+            else
+                Bitmap::convertMultiSpectrumAlphaWeight(source, sourceData,
+                    tile, targetData, m_pixelFormats, tile->getComponentFormat(),
+                    tile->getWidth());
+
+            sourceData += source->getWidth() * sourceBpp;
+            targetData += tile->getWidth() * targetBpp;
+        }
+    }
+
+    /**
+     * \brief Develop a tile, add pending contributions from the overflow
+     * buffer, and queue it for writing. When \c block is \c NULL, the
+     * tile only receives the overflow contributions.
+     */
+    void writeTile(int x, int y, const ImageBlock *block) {
+        uint32_t idx = (uint32_t) x + (uint32_t) y * m_blocksH;
+        ref<Bitmap> tile = m_writer->recycle();
+        if (!tile)
+            tile = createTile(m_componentFormat);
+
+        std::map<uint32_t, ref<Bitmap> >::iterator it = m_overflow.find(idx);
+        if (it == m_overflow.end()) {
+            if (block)
+                developBlock(block, tile);
+            else
+                tile->clear();
+        } else {
+            ref<Bitmap> floatTile = createTile(Bitmap::EFloat32);
+            if (block)
+                developBlock(block, floatTile);
+            else
+                floatTile->clear();
+            floatTile->accumulate(it->second);
+            floatTile->convert(tile);
+            m_overflow.erase(it);
+        }
+
+        m_written[idx] = true;
+        m_writer->push(x, y, tile);
+    }
+
+    /**
+     * \brief Rewrite the output file while merging the contents
+     * of the overflow buffer, one tile at a time
+     */
+    void rewrite() {
+        fs::path tempFile = m_filename;
+        tempFile.replace_extension(".partial.exr");
+
+        Log(EInfo, "Merging " SIZE_T_FMT " tiles of global image updates into \"%s\" ..",
+            m_overflow.size(), m_filename.string().c_str());
+
+        Imf::TiledInputFile *input = NULL;
+        if (!m_replaced) {
+            fs::rename(m_filename, tempFile);
+            input = new Imf::TiledInputFile(tempFile.string().c_str());
+        }
+
+        m_output = new Imf::TiledOutputFile(m_filename.string().c_str(), createHeader());
+        m_writer = new TileWriter(m_output, m_channelNames, m_compType,
+            m_compStride, (size_t) m_writeQueueSize);
+        m_writer->start();
+
+        ref<Bitmap> inputTile = createTile(m_componentFormat);
+        for (int y=0; y<m_blocksV; ++y) {
+            for (int x=0; x<m_blocksH; ++x) {
+                uint32_t idx = (uint32_t) x + (uint32_t) y * m_blocksH;
+                std::map<uint32_t, ref<Bitmap> >::iterator it = m_overflow.find(idx);
+
+                ref<Bitmap> tile = m_writer->recycle();
+                if (!tile)
+                    tile = createTile(m_componentFormat);
+
+                if (input) {
+                    input->setFrameBuffer(createFrameBuffer(inputTile, x, y,
+                        m_channelNames, m_compType, m_compStride));
+                    input->readTile(x, y);
+                }
+
+                if (it == m_overflow.end()) {
+                    if (input)
+                        tile->copyFrom(inputTile);
+                    else
+                        tile->clear();
+                } else {
+                    ref<Bitmap> floatTile = createTile(Bitmap::EFloat32);
+                    if (input)
+                        inputTile->convert(floatTile);
+                    else
+                        floatTile->clear();
+                    floatTile->accumulate(it->second);
+                    floatTile->convert(tile);
+                }
+
+                m_writer->push(x, y, tile);
+            }
+        }
+
+        m_writer->finish();
+        m_writer = NULL;
+        delete m_output;
+        m_output = NULL;
+
+        if (input) {
+            delete input;
+            fs::remove(tempFile);
+        }
+    }
+
+    /// Check if all components of a floating point bitmap are zero
+    static bool isZero(const Bitmap *bitmap) {
+        size_t count = bitmap->getPixelCount() * bitmap->getChannelCount();
+        if (bitmap->getComponentFormat() == Bitmap::EFloat32) {
+            const float *data = bitmap->getFloat32Data();
+            for (size_t i=0; i<count; ++i)
+                if (data[i] != 0)
+                    return false;
+        } else {
+            const double *data = bitmap->getFloat64Data();
+            for (size_t i=0; i<count; ++i)
+                if (data[i] != 0)
+                    return false;
+        }
+        return true;
+    }
+
+    /// Set the alpha channel of a single precision bitmap to zero
+    static void clearAlpha(Bitmap *bitmap) {
+        if (!bitmap->hasAlpha())
+            return;
+        size_t channels = (size_t) bitmap->getChannelCount();
+        float *data = bitmap->getFloat32Data() + channels - 1;
+        for (size_t i=0, count=bitmap->getPixelCount(); i<count; ++i)
+            data[i * channels] = 0.0f;
+    }
+protected:
+    std::vector<Bitmap::EPixelFormat> m_pixelFormats;
+    std::vector<std::string> m_channelNames;
+    Bitmap::EComponentFormat m_componentFormat;
+    Imf::PixelType m_compType;
+    size_t m_compStride;
+    int m_writeQueueSize;
+    fs::path m_filename;
+    Imf::TiledOutputFile *m_output;
+    ref<TileWriter> m_writer;
+
+    /* Image blocks of tiles that are currently in flight */
+    std::vector<ImageBlock *> m_freeBlocks;
+    std::map<uint32_t, ImageBlock *> m_origBlocks, m_mergedBlocks;
+    std::vector<bool> m_written;
+
+    /* Sparse overflow buffer with global image updates */
+    std::map<uint32_t, ref<Bitmap> > m_overflow;
+    bool m_replaced;
+
+    int m_blocksH, m_blocksV, m_peakUsage;
+    size_t m_peakOverflow;
+    int m_blockSize;
+};
+
+MTS_IMPLEMENT_CLASS(TileWriter, false, Thread)
+MTS_IMPLEMENT_CLASS_S(StreamingHDRFilm, false, Film)
+MTS_EXPORT_PLUGIN(StreamingHDRFilm, "Streaming high dynamic range film");
+MTS_NAMESPACE_END
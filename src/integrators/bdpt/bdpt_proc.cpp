@@ -23,13 +23,17 @@
 
 MTS_NAMESPACE_BEGIN
 
+static StatsCounter occludedConnections("Bidirectional path tracer",
+    "Occluded connections", EPercentage);
+
 /* ==================================================================== */
 /*                         Worker implementation                        */
 /* ==================================================================== */
 
 class BDPTRenderer : public WorkProcessor {
 public:
-    BDPTRenderer(const BDPTConfiguration &config) : m_config(config) { }
+    BDPTRenderer(const BDPTConfiguration &config, ImageBlock *lightImage)
+        : m_config(config), m_lightImage(lightImage) { }
 
     BDPTRenderer(Stream *stream, InstanceManager *manager)
         : WorkProcessor(stream, manager), m_config(stream) { }
@@ -46,7 +50,7 @@ public:
 
     ref<WorkResult> createWorkResult() const {
         return new BDPTWorkResult(m_config, m_rfilter.get(),
-            Vector2i(m_config.blockSize));
+            Vector2i(m_config.blockSize), const_cast<ImageBlock *>(m_lightImage.get()));
     }
 
     void prepare() {
@@ -131,13 +135,46 @@ public:
         Assert(m_pool.unused());
     }
 
-    /// Evaluate the contributions of the given eye and light paths
+    /**
+     * \brief Connection strategy that has been set up by \ref gather()
+     * and which still awaits its visibility test and MIS weight
+     */
+    struct Connection {
+        /// Strategy indices
+        int s, t;
+        /// Set to true if a direct sampling strategy was used
+        bool sampleDirect;
+        /// Temporarily force the endpoint measures to \c EArea?
+        bool forceAreaS, forceAreaT;
+        /// Path weight of the (s, t)-connection (excl. the connection edge)
+        Spectrum value;
+        /// Pixel sample position associated with this connection
+        Point2 samplePos;
+        /// Connection endpoints and their predecessors
+        PathVertex *vsPred, *vtPred, *vs, *vt;
+        PathEdge *vsEdge, *vtEdge;
+        /// Storage for the endpoints created by direct sampling
+        PathVertex tempEndpoint, tempSample;
+        PathEdge tempEdge, connectionEdge;
+    };
+
+    /**
+     * \brief Evaluate the contributions of the given eye and light paths
+     *
+     * The (s, t) strategies are processed in stages: all regular
+     * connections are first gathered along with their unoccluded path
+     * weights. Next, the shadow rays of the surviving candidates are
+     * traced back to back, and only then are the MIS weights computed.
+     * This keeps the BSDF evaluation, the kd-tree traversal, and the MIS
+     * computations in tight loops of their own.
+     *
+     * Strategies involving a supernode (s==0 or t==0) permanently
+     * cast a subpath vertex into an emitter or sensor sample; they are
+     * therefore evaluated at the very end and one at a time.
+     */
     void evaluate(BDPTWorkResult *wr,
             Path &emitterSubpath, Path &sensorSubpath) {
         Point2 initialSamplePos = sensorSubpath.vertex(1)->getSamplePosition();
-        const Scene *scene = m_scene;
-        PathVertex tempEndpoint, tempSample;
-        PathEdge tempEdge, connectionEdge;
 
         /* Compute the combined weights along the two subpaths */
         Spectrum *importanceWeights = (Spectrum *) alloca(emitterSubpath.vertexCount() * sizeof(Spectrum)),
@@ -156,165 +193,265 @@ public:
                 sensorSubpath.vertex(i-1)->rrWeight *
                 sensorSubpath.edge(i-1)->weight[ERadiance];
 
+        /* Reserve enough space so that the connection records (which may
+           point to their own temporary vertices) are never relocated */
+        m_connections.clear();
+        m_connections.reserve(emitterSubpath.vertexCount() * sensorSubpath.vertexCount());
+
+        /* Stage 1: set up all regular connections */
+        for (int s = (int) emitterSubpath.vertexCount()-1; s >= 1; --s) {
+            int minT = std::max(2-s, m_config.lightImage ? 1 : 2),
+                maxT = (int) sensorSubpath.vertexCount() - 1;
+            if (m_config.maxDepth != -1)
+                maxT = std::min(maxT, m_config.maxDepth + 1 - s);
+
+            for (int t = maxT; t >= minT; --t) {
+                m_connections.push_back(Connection());
+                if (!gather(m_connections.back(), emitterSubpath, sensorSubpath,
+                        importanceWeights, radianceWeights, s, t, initialSamplePos))
+                    m_connections.pop_back();
+            }
+        }
+
+        /* Stage 2: trace the shadow rays of the gathered connections */
+        size_t nOccluded = 0;
+        for (size_t i=0; i<m_connections.size(); ++i) {
+            Connection &conn = m_connections[i];
+            if (!connect(conn)) {
+                conn.value = Spectrum(0.0f);
+                nOccluded++;
+            }
+        }
+        occludedConnections.incrementBase(m_connections.size());
+        occludedConnections += nOccluded;
+
+        /* Stage 3: compute MIS weights and accumulate the contributions */
         Spectrum sampleValue(0.0f);
+        for (size_t i=0; i<m_connections.size(); ++i) {
+            if (!m_connections[i].value.isZero())
+                splat(wr, m_connections[i], emitterSubpath, sensorSubpath, sampleValue);
+        }
+
+        /* Finally, handle the strategies that involve a supernode */
+        Connection conn;
         for (int s = (int) emitterSubpath.vertexCount()-1; s >= 0; --s) {
-            /* Determine the range of sensor vertices to be traversed,
-               while respecting the specified maximum path length */
             int minT = std::max(2-s, m_config.lightImage ? 0 : 2),
                 maxT = (int) sensorSubpath.vertexCount() - 1;
             if (m_config.maxDepth != -1)
                 maxT = std::min(maxT, m_config.maxDepth + 1 - s);
 
             for (int t = maxT; t >= minT; --t) {
-                PathVertex
-                    *vsPred = emitterSubpath.vertexOrNull(s-1),
-                    *vtPred = sensorSubpath.vertexOrNull(t-1),
-                    *vs = emitterSubpath.vertex(s),
-                    *vt = sensorSubpath.vertex(t);
-                PathEdge
-                    *vsEdge = emitterSubpath.edgeOrNull(s-1),
-                    *vtEdge = sensorSubpath.edgeOrNull(t-1);
-
-                RestoreMeasureHelper rmh0(vs), rmh1(vt);
-
-                /* Will be set to true if direct sampling was used */
-                bool sampleDirect = false;
-
-                /* Stores the pixel position associated with this sample */
-                Point2 samplePos = initialSamplePos;
-
-                /* Allowed remaining number of ENull vertices that can
-                   be bridged via pathConnect (negative=arbitrarily many) */
-                int remaining = m_config.maxDepth - s - t + 1;
-
-                /* Will receive the path weight of the (s, t)-connection */
-                Spectrum value;
-
-                /* Account for the terms of the measurement contribution
-                   function that are coupled to the connection endpoints */
-                if (vs->isEmitterSupernode()) {
-                    /* If possible, convert 'vt' into an emitter sample */
-                    if (!vt->cast(scene, PathVertex::EEmitterSample) || vt->isDegenerate())
-                        continue;
-
-                    value = radianceWeights[t] *
-                        vs->eval(scene, vsPred, vt, EImportance) *
-                        vt->eval(scene, vtPred, vs, ERadiance);
-                } else if (vt->isSensorSupernode()) {
-                    /* If possible, convert 'vs' into an sensor sample */
-                    if (!vs->cast(scene, PathVertex::ESensorSample) || vs->isDegenerate())
-                        continue;
-
-                    /* Make note of the changed pixel sample position */
-                    if (!vs->getSamplePosition(vsPred, samplePos))
-                        continue;
-
-                    value = importanceWeights[s] *
-                        vs->eval(scene, vsPred, vt, EImportance) *
-                        vt->eval(scene, vtPred, vs, ERadiance);
-                } else if (m_config.sampleDirect && ((t == 1 && s > 1) || (s == 1 && t > 1))) {
-                    /* s==1/t==1 path: use a direct sampling strategy if requested */
-                    if (s == 1) {
-                        if (vt->isDegenerate())
-                            continue;
-                        /* Generate a position on an emitter using direct sampling */
-                        value = radianceWeights[t] * vt->sampleDirect(scene, m_sampler,
-                            &tempEndpoint, &tempEdge, &tempSample, EImportance);
-                        if (value.isZero())
-                            continue;
-                        vs = &tempSample; vsPred = &tempEndpoint; vsEdge = &tempEdge;
-                        value *= vt->eval(scene, vtPred, vs, ERadiance);
-                        vt->measure = EArea;
-                    } else {
-                        if (vs->isDegenerate())
-                            continue;
-                        /* Generate a position on the sensor using direct sampling */
-                        value = importanceWeights[s] * vs->sampleDirect(scene, m_sampler,
-                            &tempEndpoint, &tempEdge, &tempSample, ERadiance);
-                        if (value.isZero())
-                            continue;
-                        vt = &tempSample; vtPred = &tempEndpoint; vtEdge = &tempEdge;
-                        value *= vs->eval(scene, vsPred, vt, EImportance);
-                        vs->measure = EArea;
-                    }
-
-                    sampleDirect = true;
-                } else {
-                    /* Can't connect degenerate endpoints */
-                    if (vs->isDegenerate() || vt->isDegenerate())
-                        continue;
-
-                    value = importanceWeights[s] * radianceWeights[t] *
-                        vs->eval(scene, vsPred, vt, EImportance) *
-                        vt->eval(scene, vtPred, vs, ERadiance);
-
-                    /* Temporarily force vertex measure to EArea. Needed to
-                       handle BSDFs with diffuse + specular components */
-                    vs->measure = vt->measure = EArea;
-                }
-
-                /* Attempt to connect the two endpoints, which could result in
-                   the creation of additional vertices (index-matched boundaries etc.) */
-                int interactions = remaining; // backup
-                if (value.isZero() || !connectionEdge.pathConnectAndCollapse(
-                        scene, vsEdge, vs, vt, vtEdge, interactions))
+                if (s != 0 && t != 0)
                     continue;
 
-                /* Account for the terms of the measurement contribution
-                   function that are coupled to the connection edge */
-                if (!sampleDirect)
-                    value *= connectionEdge.evalCached(vs, vt, PathEdge::EGeneralizedGeometricTerm);
-                else
-                    value *= connectionEdge.evalCached(vs, vt, PathEdge::ETransmittance |
-                            (s == 1 ? PathEdge::ECosineRad : PathEdge::ECosineImp));
-
-                if (sampleDirect) {
-                    /* A direct sampling strategy was used, which generated
-                       two new vertices at one of the path ends. Temporarily
-                       modify the path to reflect this change */
-                    if (t == 1)
-                        sensorSubpath.swapEndpoints(vtPred, vtEdge, vt);
-                    else
-                        emitterSubpath.swapEndpoints(vsPred, vsEdge, vs);
-                }
-
-                /* Compute the multiple importance sampling weight */
-                Float miWeight = Path::miWeight(scene, emitterSubpath, &connectionEdge,
-                    sensorSubpath, s, t, m_config.sampleDirect, m_config.lightImage);
+                RestoreMeasureHelper rmh0(emitterSubpath.vertex(s)),
+                                     rmh1(sensorSubpath.vertex(t));
 
-                if (sampleDirect) {
-                    /* Now undo the previous change */
-                    if (t == 1)
-                        sensorSubpath.swapEndpoints(vtPred, vtEdge, vt);
-                    else
-                        emitterSubpath.swapEndpoints(vsPred, vsEdge, vs);
-                }
+                if (gather(conn, emitterSubpath, sensorSubpath, importanceWeights,
+                           radianceWeights, s, t, initialSamplePos) && connect(conn))
+                    splat(wr, conn, emitterSubpath, sensorSubpath, sampleValue);
+            }
+        }
 
-                /* Determine the pixel sample position when necessary */
-                if (vt->isSensorSample() && !vt->getSamplePosition(vs, samplePos))
-                    continue;
+        wr->putSample(initialSamplePos, sampleValue);
+    }
 
-                #if BDPT_DEBUG == 1
-                    /* When the debug mode is on, collect samples
-                       separately for each sampling strategy. Note: the
-                       following piece of code artificially increases the
-                       exposure of longer paths */
-                    Spectrum splatValue = value * (m_config.showWeighted
-                        ? miWeight : 1.0f);// * std::pow(2.0f, s+t-3.0f));
-                    wr->putDebugSample(s, t, samplePos, splatValue);
-                #endif
-
-                if (t >= 2)
-                    sampleValue += value * miWeight;
-                else
-                    wr->putLightSample(samplePos, value * miWeight);
+    /**
+     * \brief Set up the (s, t) connection strategy and compute the terms of
+     * the measurement contribution function that are coupled to its endpoints
+     *
+     * \return \c false if the strategy cannot produce a nonzero contribution
+     */
+    bool gather(Connection &conn, Path &emitterSubpath, Path &sensorSubpath,
+            const Spectrum *importanceWeights, const Spectrum *radianceWeights,
+            int s, int t, const Point2 &initialSamplePos) {
+        const Scene *scene = m_scene;
+        PathVertex
+            *vsPred = emitterSubpath.vertexOrNull(s-1),
+            *vtPred = sensorSubpath.vertexOrNull(t-1),
+            *vs = emitterSubpath.vertex(s),
+            *vt = sensorSubpath.vertex(t);
+        PathEdge
+            *vsEdge = emitterSubpath.edgeOrNull(s-1),
+            *vtEdge = sensorSubpath.edgeOrNull(t-1);
+
+        conn.s = s;
+        conn.t = t;
+
+        /* Will be set to true if direct sampling was used */
+        conn.sampleDirect = false;
+        conn.forceAreaS = conn.forceAreaT = false;
+
+        /* Stores the pixel position associated with this sample */
+        conn.samplePos = initialSamplePos;
+
+        /* Will receive the path weight of the (s, t)-connection */
+        Spectrum value;
+
+        if (vs->isEmitterSupernode()) {
+            /* If possible, convert 'vt' into an emitter sample */
+            if (!vt->cast(scene, PathVertex::EEmitterSample) || vt->isDegenerate())
+                return false;
+
+            value = radianceWeights[t] *
+                vs->eval(scene, vsPred, vt, EImportance) *
+                vt->eval(scene, vtPred, vs, ERadiance);
+        } else if (vt->isSensorSupernode()) {
+            /* If possible, convert 'vs' into an sensor sample */
+            if (!vs->cast(scene, PathVertex::ESensorSample) || vs->isDegenerate())
+                return false;
+
+            /* Make note of the changed pixel sample position */
+            if (!vs->getSamplePosition(vsPred, conn.samplePos))
+                return false;
+
+            value = importanceWeights[s] *
+                vs->eval(scene, vsPred, vt, EImportance) *
+                vt->eval(scene, vtPred, vs, ERadiance);
+        } else if (m_config.sampleDirect && ((t == 1 && s > 1) || (s == 1 && t > 1))) {
+            /* s==1/t==1 path: use a direct sampling strategy if requested */
+            if (s == 1) {
+                if (vt->isDegenerate())
+                    return false;
+                /* Generate a position on an emitter using direct sampling */
+                value = radianceWeights[t] * vt->sampleDirect(scene, m_sampler,
+                    &conn.tempEndpoint, &conn.tempEdge, &conn.tempSample, EImportance);
+                if (value.isZero())
+                    return false;
+                vs = &conn.tempSample; vsPred = &conn.tempEndpoint; vsEdge = &conn.tempEdge;
+                value *= vt->eval(scene, vtPred, vs, ERadiance);
+                conn.forceAreaT = true;
+            } else {
+                if (vs->isDegenerate())
+                    return false;
+                /* Generate a position on the sensor using direct sampling */
+                value = importanceWeights[s] * vs->sampleDirect(scene, m_sampler,
+                    &conn.tempEndpoint, &conn.tempEdge, &conn.tempSample, ERadiance);
+                if (value.isZero())
+                    return false;
+                vt = &conn.tempSample; vtPred = &conn.tempEndpoint; vtEdge = &conn.tempEdge;
+                value *= vs->eval(scene, vsPred, vt, EImportance);
+                conn.forceAreaS = true;
             }
+
+            conn.sampleDirect = true;
+        } else {
+            /* Can't connect degenerate endpoints */
+            if (vs->isDegenerate() || vt->isDegenerate())
+                return false;
+
+            value = importanceWeights[s] * radianceWeights[t] *
+                vs->eval(scene, vsPred, vt, EImportance) *
+                vt->eval(scene, vtPred, vs, ERadiance);
+
+            /* Temporarily force vertex measure to EArea. Needed to
+               handle BSDFs with diffuse + specular components */
+            conn.forceAreaS = conn.forceAreaT = true;
         }
-        wr->putSample(initialSamplePos, sampleValue);
+
+        if (value.isZero())
+            return false;
+
+        conn.value = value;
+        conn.vsPred = vsPred; conn.vs = vs; conn.vsEdge = vsEdge;
+        conn.vtPred = vtPred; conn.vt = vt; conn.vtEdge = vtEdge;
+        return true;
+    }
+
+    /**
+     * \brief Attempt to connect the two endpoints of a gathered strategy,
+     * and account for the terms that are coupled to the connection edge
+     *
+     * \return \c false if the endpoints are mutually invisible
+     */
+    bool connect(Connection &conn) {
+        RestoreMeasureHelper rmh0(conn.vs), rmh1(conn.vt);
+        if (conn.forceAreaS)
+            conn.vs->measure = EArea;
+        if (conn.forceAreaT)
+            conn.vt->measure = EArea;
+
+        /* Allowed remaining number of ENull vertices that can
+           be bridged via pathConnect (negative=arbitrarily many) */
+        int interactions = m_config.maxDepth - conn.s - conn.t + 1;
+
+        /* Attempt to connect the two endpoints, which could result in
+           the creation of additional vertices (index-matched boundaries etc.) */
+        if (!conn.connectionEdge.pathConnectAndCollapse(m_scene,
+                conn.vsEdge, conn.vs, conn.vt, conn.vtEdge, interactions))
+            return false;
+
+        /* Account for the terms of the measurement contribution
+           function that are coupled to the connection edge */
+        if (!conn.sampleDirect)
+            conn.value *= conn.connectionEdge.evalCached(conn.vs, conn.vt,
+                PathEdge::EGeneralizedGeometricTerm);
+        else
+            conn.value *= conn.connectionEdge.evalCached(conn.vs, conn.vt,
+                PathEdge::ETransmittance | (conn.s == 1 ? PathEdge::ECosineRad
+                                                        : PathEdge::ECosineImp));
+
+        return !conn.value.isZero();
+    }
+
+    /// Compute the MIS weight of a connected strategy and record its contribution
+    void splat(BDPTWorkResult *wr, Connection &conn, Path &emitterSubpath,
+            Path &sensorSubpath, Spectrum &sampleValue) {
+        RestoreMeasureHelper rmh0(conn.vs), rmh1(conn.vt);
+        if (conn.forceAreaS)
+            conn.vs->measure = EArea;
+        if (conn.forceAreaT)
+            conn.vt->measure = EArea;
+
+        int s = conn.s, t = conn.t;
+        PathVertex *vsPred = conn.vsPred, *vtPred = conn.vtPred,
+                   *vs = conn.vs, *vt = conn.vt;
+        PathEdge *vsEdge = conn.vsEdge, *vtEdge = conn.vtEdge;
+
+        if (conn.sampleDirect) {
+            /* A direct sampling strategy was used, which generated
+               two new vertices at one of the path ends. Temporarily
+               modify the path to reflect this change */
+            if (t == 1)
+                sensorSubpath.swapEndpoints(vtPred, vtEdge, vt);
+            else
+                emitterSubpath.swapEndpoints(vsPred, vsEdge, vs);
+        }
+
+        /* Compute the multiple importance sampling weight */
+        Float miWeight = Path::miWeight(m_scene, emitterSubpath, &conn.connectionEdge,
+            sensorSubpath, s, t, m_config.sampleDirect, m_config.lightImage);
+
+        if (conn.sampleDirect) {
+            /* Now undo the previous change */
+            if (t == 1)
+                sensorSubpath.swapEndpoints(vtPred, vtEdge, vt);
+            else
+                emitterSubpath.swapEndpoints(vsPred, vsEdge, vs);
+        }
+
+        /* Determine the pixel sample position when necessary */
+        if (vt->isSensorSample() && !vt->getSamplePosition(vs, conn.samplePos))
+            return;
+
+        #if BDPT_DEBUG == 1
+            /* When the debug mode is on, collect samples
+               separately for each sampling strategy. Note: the
+               following piece of code artificially increases the
+               exposure of longer paths */
+            Spectrum splatValue = conn.value * (m_config.showWeighted
+                ? miWeight : 1.0f);// * std::pow(2.0f, s+t-3.0f));
+            wr->putDebugSample(s, t, conn.samplePos, splatValue);
+        #endif
+
+        if (t >= 2)
+            sampleValue += conn.value * miWeight;
+        else
+            wr->putLightSample(conn.samplePos, conn.value * miWeight);
     }
 
     ref<WorkProcessor> clone() const {
-        return new BDPTRenderer(m_config);
+        return new BDPTRenderer(m_config, const_cast<ImageBlock *>(m_lightImage.get()));
     }
 
     MTS_DECLARE_CLASS()
@@ -325,7 +462,10 @@ private:
     ref<ReconstructionFilter> m_rfilter;
     MemoryPool m_pool;
     BDPTConfiguration m_config;
+    /* Light image shared by all local workers (not serialized) */
+    ref<ImageBlock> m_lightImage;
     HilbertCurve2D<uint8_t> m_hilbertCurve;
+    std::vector<Connection> m_connections;
 };
 
 
@@ -340,16 +480,19 @@ BDPTProcess::BDPTProcess(const RenderJob *parent, RenderQueue *queue,
 }
 
 ref<WorkProcessor> BDPTProcess::createWorkProcessor() const {
-    return new BDPTRenderer(m_config);
+    return new BDPTRenderer(m_config, const_cast<ImageBlock *>(m_lightImage.get()));
 }
 
 void BDPTProcess::develop() {
     if (!m_config.lightImage)
         return;
     LockGuard lock(m_resultMutex);
-    const ImageBlock *lightImage = m_result->getLightImage();
+    ref<Bitmap> lightImage = m_lightImage->getBitmap();
+    if (m_lightImage->getBorderSize() > 0)
+        lightImage = lightImage->crop(Point2i(m_lightImage->getBorderSize()),
+            m_lightImage->getSize());
     m_film->setBitmap(m_result->getImageBlock()->getBitmap());
-    m_film->addBitmap(lightImage->getBitmap(), 1.0f / m_config.sampleCount);
+    m_film->addBitmap(lightImage, 1.0f / m_config.sampleCount);
     m_refreshTimer->reset();
     m_queue->signalRefresh(m_parent);
 }
@@ -359,11 +502,13 @@ void BDPTProcess::processResult(const WorkResult *wr, bool cancelled) {
         return;
     const BDPTWorkResult *result = static_cast<const BDPTWorkResult *>(wr);
     ImageBlock *block = const_cast<ImageBlock *>(result->getImageBlock());
-    LockGuard lock(m_resultMutex);
-    m_progress->update(++m_resultCount);
+
+    /* Results are merged concurrently, with locks that only cover
+       the image rows touched by the block */
     if (m_config.lightImage) {
         const ImageBlock *lightImage = m_result->getLightImage();
-        m_result->put(result);
+        int lightBorderSize = lightImage->getBorderSize();
+        m_result->putConcurrent(result);
         if (m_parent->isInteractive()) {
             /* Modify the finished image block so that it includes the light image contributions,
                which creates a more intuitive preview of the rendering process. This is
@@ -379,7 +524,8 @@ void BDPTProcess::processResult(const WorkResult *wr, bool cancelled) {
 
             for (int y=0; y<size.y; ++y) {
                 const Float *source = sourceBitmap->getFloatData()
-                    + (offset.x + (y+offset.y) * sourceBitmap->getWidth()) * SPECTRUM_SAMPLES;
+                    + (offset.x + lightBorderSize + (y + offset.y + lightBorderSize)
+                        * sourceBitmap->getWidth()) * SPECTRUM_SAMPLES;
                 Float *dest = destBitmap->getFloatData()
                     + (borderSize + (y + borderSize) * destBitmap->getWidth()) * (SPECTRUM_SAMPLES + 2);
 
@@ -393,13 +539,18 @@ void BDPTProcess::processResult(const WorkResult *wr, bool cancelled) {
         }
     }
 
-    m_film->put(block);
+    m_film->putConcurrent(block);
 
     /* Re-develop the entire image every two seconds if partial results are
        visible (e.g. in a graphical user interface). This only applies when
        there is a light image. */
+    UniqueLock lock(m_resultMutex);
+    m_progress->update(++m_resultCount);
     bool developFilm = m_config.lightImage &&
         (m_parent->isInteractive() && m_refreshTimer->getMilliseconds() > 2000);
+    if (developFilm)
+        m_refreshTimer->reset();
+    lock.unlock();
 
     m_queue->signalWorkEnd(m_parent, result->getImageBlock(), false);
 
@@ -410,8 +561,12 @@ void BDPTProcess::processResult(const WorkResult *wr, bool cancelled) {
 void BDPTProcess::bindResource(const std::string &name, int id) {
     BlockedRenderProcess::bindResource(name, id);
     if (name == "sensor" && m_config.lightImage) {
-        /* If needed, allocate memory for the light image */
-        m_result = new BDPTWorkResult(m_config, NULL, m_film->getCropSize());
+        /* If needed, allocate memory for the light image. It is shared
+           with all local workers, which splat into it concurrently */
+        m_lightImage = new ImageBlock(Bitmap::ESpectrum, m_film->getCropSize(),
+            m_film->getReconstructionFilter());
+        m_lightImage->clear();
+        m_result = new BDPTWorkResult(m_config, NULL, m_film->getCropSize(), m_lightImage);
         m_result->clear();
     }
 }
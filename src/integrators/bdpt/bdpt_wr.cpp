@@ -27,7 +27,8 @@ MTS_NAMESPACE_BEGIN
 /* ==================================================================== */
 
 BDPTWorkResult::BDPTWorkResult(const BDPTConfiguration &conf,
-        const ReconstructionFilter *rfilter, Vector2i blockSize) {
+        const ReconstructionFilter *rfilter, Vector2i blockSize,
+        ImageBlock *sharedLightImage) : m_sharedLightImage(false) {
     /* Stores the 'camera image' -- this can be blocked when
        spreading out work to multiple workers */
     if (blockSize == Vector2i(-1, -1))
@@ -37,7 +38,11 @@ BDPTWorkResult::BDPTWorkResult(const BDPTConfiguration &conf,
     m_block->setOffset(Point2i(0, 0));
     m_block->setSize(blockSize);
 
-    if (conf.lightImage) {
+    if (conf.lightImage && sharedLightImage) {
+        /* Local workers splat into a light image that is shared by all of them */
+        m_lightImage = sharedLightImage;
+        m_sharedLightImage = true;
+    } else if (conf.lightImage) {
         /* Stores the 'light image' -- every worker requires a
            full-resolution version, since contributions of s==0
            and s==1 paths can affect any pixel of this bitmap */
@@ -71,8 +76,23 @@ void BDPTWorkResult::put(const BDPTWorkResult *workResult) {
         m_debugBlocks[i]->put(workResult->m_debugBlocks[i].get());
 #endif
     m_block->put(workResult->m_block.get());
-    if (m_lightImage)
-        m_lightImage->put(workResult->m_lightImage.get());
+    if (m_lightImage && !workResult->m_sharedLightImage) {
+        /* Other workers may be splatting into a shared light image */
+        if (m_sharedLightImage)
+            m_lightImage->putConcurrent(workResult->m_lightImage.get());
+        else
+            m_lightImage->put(workResult->m_lightImage.get());
+    }
+}
+
+void BDPTWorkResult::putConcurrent(const BDPTWorkResult *workResult) {
+#if BDPT_DEBUG == 1
+    for (size_t i=0; i<m_debugBlocks.size(); ++i)
+        m_debugBlocks[i]->putConcurrent(workResult->m_debugBlocks[i].get());
+#endif
+    m_block->putConcurrent(workResult->m_block.get());
+    if (m_lightImage && !workResult->m_sharedLightImage)
+        m_lightImage->putConcurrent(workResult->m_lightImage.get());
 }
 
 void BDPTWorkResult::clear() {
@@ -80,7 +100,7 @@ void BDPTWorkResult::clear() {
     for (size_t i=0; i<m_debugBlocks.size(); ++i)
         m_debugBlocks[i]->clear();
 #endif
-    if (m_lightImage)
+    if (m_lightImage && !m_sharedLightImage)
         m_lightImage->clear();
     m_block->clear();
 }
@@ -111,8 +131,15 @@ void BDPTWorkResult::load(Stream *stream) {
     for (size_t i=0; i<m_debugBlocks.size(); ++i)
         m_debugBlocks[i]->load(stream);
 #endif
-    if (m_lightImage)
+    if (m_lightImage) {
+        if (m_sharedLightImage) {
+            /* This result receives the output of a remote worker, which
+               can't access the shared light image -- use private storage */
+            m_lightImage = m_lightImage->clone();
+            m_sharedLightImage = false;
+        }
         m_lightImage->load(stream);
+    }
     m_block->load(stream);
 }
 
@@ -121,8 +148,11 @@ void BDPTWorkResult::save(Stream *stream) const {
     for (size_t i=0; i<m_debugBlocks.size(); ++i)
         m_debugBlocks[i]->save(stream);
 #endif
-    if (m_lightImage.get())
+    if (m_lightImage.get()) {
+        /* Local results that splat into a shared light image are never sent */
+        Assert(!m_sharedLightImage);
         m_lightImage->save(stream);
+    }
     m_block->save(stream);
 }
 
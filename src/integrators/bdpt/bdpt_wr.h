@@ -36,8 +36,14 @@ MTS_NAMESPACE_BEGIN
 */
 class BDPTWorkResult : public WorkResult {
 public:
+    /**
+     * \param sharedLightImage
+     *    Optional full-resolution light image that is shared with other
+     *    work results. Light samples are then splatted into it using
+     *    atomic operations instead of allocating a private light image.
+     */
     BDPTWorkResult(const BDPTConfiguration &conf, const ReconstructionFilter *filter,
-            Vector2i blockSize = Vector2i(-1, -1));
+            Vector2i blockSize = Vector2i(-1, -1), ImageBlock *sharedLightImage = NULL);
 
     // Clear the contents of the work result
     void clear();
@@ -51,6 +57,9 @@ public:
     /// Aaccumulate another work result into this one
     void put(const BDPTWorkResult *workResult);
 
+    /// Like \ref put(), but other threads may be accumulating at the same time
+    void putConcurrent(const BDPTWorkResult *workResult);
+
 #if BDPT_DEBUG == 1
     /* In debug mode, this function allows to dump the contributions of
        the individual sampling strategies to a series of images */
@@ -68,7 +77,10 @@ public:
     }
 
     inline void putLightSample(const Point2 &sample, const Spectrum &spec) {
-        m_lightImage->put(sample, spec, 1.0f);
+        if (m_sharedLightImage)
+            m_lightImage->putConcurrent(sample, (const Float *) &spec);
+        else
+            m_lightImage->put(sample, spec, 1.0f);
     }
 
     inline const ImageBlock *getImageBlock() const {
@@ -104,6 +116,7 @@ protected:
     ref_vector<ImageBlock> m_debugBlocks;
 #endif
     ref<ImageBlock> m_block, m_lightImage;
+    bool m_sharedLightImage;
 };
 
 MTS_NAMESPACE_END
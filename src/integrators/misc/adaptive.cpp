@@ -19,6 +19,7 @@
 #include <mitsuba/render/scene.h>
 #include <mitsuba/core/statistics.h>
 #include <boost/math/distributions/normal.hpp>
+#include "adaptive_proc.h"
 
 MTS_NAMESPACE_BEGIN
 
@@ -40,6 +41,11 @@ MTS_NAMESPACE_BEGIN
  *         the \code{sampler}, this means that the adaptive integrator
  *         will give up after 32*64=2048 samples}
  *     }
+ *     \parameter{rebalance}{\Boolean}{
+ *         When set to \code{true}, the image is rendered in a sequence of
+ *         rounds, each of which only reissues work units for pixels that
+ *         have not converged yet (see below). \default{\code{false}}
+ *     }
  * }
  *
  * This ``meta-integrator'' repeatedly invokes a provided sub-integrator
@@ -63,6 +69,20 @@ MTS_NAMESPACE_BEGIN
  *    \item This plugin uses a relatively simplistic error heuristic that does not
  *    share information between pixels and only reasons about variance in image space.
  *    In the future, it will likely be replaced with something more robust.
+ *    \item By default, each pixel is sampled until convergence within a fixed
+ *    work unit, hence processor cores that were assigned easy image blocks may
+ *    sit idle while others are still working on difficult ones. With
+ *    \code{rebalance} enabled, all pixels first receive the sample count
+ *    of the \code{sampler}. In subsequent rounds, the sample count of every
+ *    unconverged pixel is doubled, and only blocks containing such pixels are
+ *    scheduled---the block size is reduced when too few of them are left to keep
+ *    all cores busy. Samples are splatted with uniform weight in this mode,
+ *    hence a heavily sampled pixel contributes slightly more to the
+ *    reconstruction filter footprint of its neighbors. Once a pixel has
+ *    consumed all samples of the \code{sampler}, a new batch is generated;
+ *    samplers whose patterns only depend on the pixel (e.g. \pluginref{halton})
+ *    then repeat their sample points, hence a randomized sampler
+ *    such as \pluginref{ldsampler} is preferable.
  * }
  */
 class AdaptiveIntegrator : public SamplingIntegrator {
@@ -78,6 +98,8 @@ public:
         /* Required P-value to accept a sample. */
         m_pValue = props.getFloat("pValue", 0.05f);
         m_verbose = props.getBoolean("verbose", false);
+        /* Render in rounds that only reissue unconverged pixels? */
+        m_rebalance = props.getBoolean("rebalance", false);
     }
 
     AdaptiveIntegrator(Stream *stream, InstanceManager *manager)
@@ -88,6 +110,7 @@ public:
         m_quantile = stream->readFloat();
         m_averageLuminance = stream->readFloat();
         m_pValue = stream->readFloat();
+        m_rebalance = stream->readBool();
         m_verbose = false;
     }
 
@@ -284,6 +307,102 @@ public:
         }
     }
 
+    bool render(Scene *scene, RenderQueue *queue, const RenderJob *job,
+            int sceneResID, int sensorResID, int samplerResID) {
+        if (!m_rebalance)
+            return SamplingIntegrator::render(scene, queue, job,
+                sceneResID, sensorResID, samplerResID);
+
+        ref<Scheduler> sched = Scheduler::getInstance();
+        ref<Sensor> sensor = static_cast<Sensor *>(sched->getResource(sensorResID));
+        ref<Film> film = sensor->getFilm();
+        const Sampler *sampler = static_cast<const Sampler *>(sched->getResource(samplerResID, 0));
+
+        if (sampler->getSampleCount() < 8)
+            Log(EError, "Starting the adaptive integrator with less than 8 "
+                "samples per pixel does not make much sense -- giving up.");
+
+        size_t nCores = sched->getCoreCount();
+        uint32_t sampleCount = (uint32_t) sampler->getSampleCount();
+        uint32_t maxSampleCount = m_maxSampleFactor >= 0
+            ? (uint32_t) m_maxSampleFactor * sampleCount
+            : std::numeric_limits<uint32_t>::max();
+
+        /* Determine the rendered image region (same as in BlockedRenderProcess) */
+        int borderSize = film->getReconstructionFilter()->getBorderSize();
+        Point2i offset(0, 0);
+        Vector2i size = film->getCropSize();
+        if (film->hasHighQualityEdges()) {
+            offset -= Vector2i(borderSize);
+            size += Vector2i(2 * borderSize);
+        }
+
+        Log(EInfo, "Starting adaptive render job (%ix%i, %i initial samples, "
+            SIZE_T_FMT " %s, " SSE_STR ") ..", film->getCropSize().x, film->getCropSize().y,
+            sampleCount, nCores, nCores == 1 ? "core" : "cores");
+
+        size_t pixelCount = (size_t) size.x * (size_t) size.y;
+        std::vector<uint32_t> budget(pixelCount, sampleCount);
+        std::vector<AdaptivePixelStatistics> stats(pixelCount);
+        int blockSize = scene->getBlockSize();
+        int minBlockSize = std::max(borderSize, 4);
+        size_t activePixels = pixelCount;
+        bool success = true;
+
+        int integratorResID = sched->registerResource(this);
+        for (int round = 0; activePixels > 0; ++round) {
+            /* Use smaller blocks when there is too little work to go around */
+            while (blockSize / 2 >= minBlockSize &&
+                AdaptiveRenderProcess::countActiveBlocks(size, blockSize, budget) < (int) (4 * nCores))
+                blockSize /= 2;
+
+            Log(EInfo, "Round %i: sampling " SIZE_T_FMT " pixels (block size %i)",
+                round + 1, activePixels, blockSize);
+
+            ref<AdaptiveRenderProcess> proc = new AdaptiveRenderProcess(job,
+                queue, blockSize, offset, size, budget, stats, round);
+            proc->bindResource("integrator", integratorResID);
+            proc->bindResource("scene", sceneResID);
+            proc->bindResource("sensor", sensorResID);
+            proc->bindResource("sampler", samplerResID);
+            scene->bindUsedResources(proc);
+            bindUsedResources(proc);
+            sched->schedule(proc);
+
+            m_process = proc;
+            sched->wait(proc);
+            m_process = NULL;
+
+            if (proc->getReturnStatus() != ParallelProcess::ESuccess) {
+                success = false;
+                break;
+            }
+
+            /* Double the sample count of pixels that have not converged yet */
+            activePixels = 0;
+            for (size_t i=0; i<pixelCount; ++i) {
+                const AdaptivePixelStatistics &s = stats[i];
+                budget[i] = 0;
+                if (s.sampleCount >= maxSampleCount)
+                    continue;
+
+                /* Half width of the confidence interval */
+                Float ciWidth = std::sqrt(s.getVariance() / s.sampleCount) * m_quantile;
+
+                /* Relative error heuristic */
+                Float base = std::max(s.mean, m_averageLuminance * 0.01f);
+
+                if (ciWidth > m_maxError * base)
+                    budget[i] = std::min(s.sampleCount, maxSampleCount - s.sampleCount);
+                if (budget[i] > 0)
+                    ++activePixels;
+            }
+        }
+        sched->unregisterResource(integratorResID);
+
+        return success;
+    }
+
     Spectrum Li(const RayDifferential &ray, RadianceQueryRecord &rRec) const {
         return m_subIntegrator->Li(ray, rRec);
     }
@@ -303,6 +422,7 @@ public:
         stream->writeFloat(m_quantile);
         stream->writeFloat(m_averageLuminance);
         stream->writeFloat(m_pValue);
+        stream->writeBool(m_rebalance);
     }
 
     void bindUsedResources(ParallelProcess *proc) const {
@@ -332,6 +452,7 @@ public:
             << "  maxError = " << m_maxError << "," << endl
             << "  quantile = " << m_quantile << "," << endl
             << "  pvalue = " << m_pValue << "," << endl
+            << "  rebalance = " << m_rebalance << "," << endl
             << "  subIntegrator = " << indent(m_subIntegrator->toString()) << endl
             << "]";
         return oss.str();
@@ -342,7 +463,7 @@ private:
     ref<SamplingIntegrator> m_subIntegrator;
     Float m_maxError, m_quantile, m_pValue, m_averageLuminance;
     int m_maxSampleFactor;
-    bool m_verbose;
+    bool m_verbose, m_rebalance;
 };
 
 MTS_IMPLEMENT_CLASS_S(AdaptiveIntegrator, false, SamplingIntegrator)
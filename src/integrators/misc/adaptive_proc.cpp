@@ -0,0 +1,341 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/statistics.h>
+#include <mitsuba/core/sfcurve.h>
+#include "adaptive_proc.h"
+
+MTS_NAMESPACE_BEGIN
+
+/* ==================================================================== */
+/*                           AdaptiveWorkUnit                           */
+/* ==================================================================== */
+
+void AdaptiveWorkUnit::set(const WorkUnit *wu) {
+    const AdaptiveWorkUnit *awu = static_cast<const AdaptiveWorkUnit *>(wu);
+    RectangularWorkUnit::set(wu);
+    m_sampleCounts = awu->m_sampleCounts;
+    m_sampleOffsets = awu->m_sampleOffsets;
+}
+
+void AdaptiveWorkUnit::load(Stream *stream) {
+    RectangularWorkUnit::load(stream);
+    initialize();
+    stream->readUIntArray(&m_sampleCounts[0], m_sampleCounts.size());
+    stream->readUIntArray(&m_sampleOffsets[0], m_sampleOffsets.size());
+}
+
+void AdaptiveWorkUnit::save(Stream *stream) const {
+    RectangularWorkUnit::save(stream);
+    stream->writeUIntArray(&m_sampleCounts[0], m_sampleCounts.size());
+    stream->writeUIntArray(&m_sampleOffsets[0], m_sampleOffsets.size());
+}
+
+std::string AdaptiveWorkUnit::toString() const {
+    std::ostringstream oss;
+    oss << "AdaptiveWorkUnit[offset=" << getOffset().toString()
+        << ", size=" << getSize().toString() << "]";
+    return oss.str();
+}
+
+/* ==================================================================== */
+/*                          AdaptiveWorkResult                          */
+/* ==================================================================== */
+
+AdaptiveWorkResult::AdaptiveWorkResult(Bitmap::EPixelFormat fmt,
+        const Vector2i &maxBlockSize, const ReconstructionFilter *filter) {
+    m_block = new ImageBlock(fmt, maxBlockSize, filter);
+    m_stats.resize(maxBlockSize.x * maxBlockSize.y);
+}
+
+void AdaptiveWorkResult::initialize(const AdaptiveWorkUnit *wu) {
+    m_block->setOffset(wu->getOffset());
+    m_block->setSize(wu->getSize());
+    m_block->clear();
+    for (size_t i=0; i<m_stats.size(); ++i)
+        m_stats[i] = AdaptivePixelStatistics();
+}
+
+void AdaptiveWorkResult::load(Stream *stream) {
+    m_block->load(stream);
+    const Vector2i &size = m_block->getSize();
+    for (int i=0; i<size.x*size.y; ++i) {
+        m_stats[i].sampleCount = stream->readUInt();
+        m_stats[i].mean = stream->readFloat();
+        m_stats[i].m2 = stream->readFloat();
+    }
+}
+
+void AdaptiveWorkResult::save(Stream *stream) const {
+    m_block->save(stream);
+    const Vector2i &size = m_block->getSize();
+    for (int i=0; i<size.x*size.y; ++i) {
+        stream->writeUInt(m_stats[i].sampleCount);
+        stream->writeFloat(m_stats[i].mean);
+        stream->writeFloat(m_stats[i].m2);
+    }
+}
+
+std::string AdaptiveWorkResult::toString() const {
+    std::ostringstream oss;
+    oss << "AdaptiveWorkResult[block=" << m_block->toString() << "]";
+    return oss.str();
+}
+
+/* ==================================================================== */
+/*                    Adaptive rendering pass (worker)                  */
+/* ==================================================================== */
+
+class AdaptiveRenderer : public WorkProcessor {
+public:
+    AdaptiveRenderer(Bitmap::EPixelFormat pixelFormat, int blockSize)
+        : m_pixelFormat(pixelFormat), m_blockSize(blockSize) { }
+
+    AdaptiveRenderer(Stream *stream, InstanceManager *manager) {
+        m_pixelFormat = (Bitmap::EPixelFormat) stream->readInt();
+        m_blockSize = stream->readInt();
+    }
+
+    void serialize(Stream *stream, InstanceManager *manager) const {
+        stream->writeInt(m_pixelFormat);
+        stream->writeInt(m_blockSize);
+    }
+
+    ref<WorkUnit> createWorkUnit() const {
+        return new AdaptiveWorkUnit();
+    }
+
+    ref<WorkResult> createWorkResult() const {
+        return new AdaptiveWorkResult(m_pixelFormat, Vector2i(m_blockSize),
+            m_sensor->getFilm()->getReconstructionFilter());
+    }
+
+    void prepare() {
+        Scene *scene = static_cast<Scene *>(getResource("scene"));
+        m_scene = new Scene(scene);
+        m_sampler = static_cast<Sampler *>(getResource("sampler"));
+        m_sensor = static_cast<Sensor *>(getResource("sensor"));
+        m_integrator = static_cast<SamplingIntegrator *>(getResource("integrator"));
+        m_scene->removeSensor(scene->getSensor());
+        m_scene->addSensor(m_sensor);
+        m_scene->setSensor(m_sensor);
+        m_scene->setSampler(m_sampler);
+        m_scene->setIntegrator(m_integrator);
+        m_integrator->wakeup(m_scene, m_resources);
+        m_scene->wakeup(m_scene, m_resources);
+        m_scene->initializeBidirectional();
+    }
+
+    void process(const WorkUnit *workUnit, WorkResult *workResult,
+        const bool &stop) {
+        const AdaptiveWorkUnit *wu = static_cast<const AdaptiveWorkUnit *>(workUnit);
+        AdaptiveWorkResult *result = static_cast<AdaptiveWorkResult *>(workResult);
+        ImageBlock *block = result->getImageBlock();
+
+#ifdef MTS_DEBUG_FP
+        enableFPExceptions();
+#endif
+
+        result->initialize(wu);
+        m_hilbertCurve.initialize(TVector2<uint8_t>(wu->getSize()));
+        const std::vector< TPoint2<uint8_t> > &points = m_hilbertCurve.getPoints();
+
+        bool needsApertureSample = m_sensor->needsApertureSample();
+        bool needsTimeSample = m_sensor->needsTimeSample();
+        size_t sampleCount = m_sampler->getSampleCount();
+        Float diffScaleFactor = 1.0f /
+            std::sqrt((Float) sampleCount);
+
+        RayDifferential eyeRay;
+        RadianceQueryRecord rRec(m_scene, m_sampler);
+        Point2 apertureSample(0.5f);
+        Float timeSample = 0.5f;
+
+        for (size_t i=0; i<points.size(); ++i) {
+            Point2i p(points[i]);
+            uint32_t budget = wu->getSampleCount(p);
+            if (budget == 0)
+                continue;
+
+            AdaptivePixelStatistics &stats = result->getStatistics(p);
+            Point2i offset = p + Vector2i(wu->getOffset());
+            m_sampler->generate(offset);
+
+            /* Continue the sample sequence of this pixel where the
+               previous round left off (generate() rewinds it). Samplers
+               only provide getSampleCount() samples per batch, hence a
+               new batch is generated whenever the index wraps around */
+            size_t sampleIndex = wu->getSampleOffset(p);
+            m_sampler->setSampleIndex(sampleIndex % sampleCount);
+
+            for (uint32_t j=0; j<budget; ++j) {
+                if (stop)
+                    break;
+
+                rRec.newQuery(RadianceQueryRecord::ESensorRay, m_sensor->getMedium());
+                rRec.extra = RadianceQueryRecord::EAdaptiveQuery;
+
+                Point2 samplePos(Point2(offset) + Vector2(rRec.nextSample2D()));
+                if (needsApertureSample)
+                    apertureSample = rRec.nextSample2D();
+                if (needsTimeSample)
+                    timeSample = rRec.nextSample1D();
+
+                Spectrum sampleValue = m_sensor->sampleRayDifferential(
+                    eyeRay, samplePos, apertureSample, timeSample);
+                eyeRay.scaleDifferential(diffScaleFactor);
+
+                sampleValue *= m_integrator->Li(eyeRay, rRec);
+
+                /* Samples that were rejected by the image block (NaN, etc.)
+                   still count towards the pixel statistics */
+                if (block->put(samplePos, sampleValue, rRec.alpha))
+                    stats.put(sampleValue.getLuminance());
+                else
+                    stats.put(0.0f);
+
+                if (++sampleIndex % sampleCount == 0)
+                    m_sampler->generate(offset);
+                else
+                    m_sampler->advance();
+            }
+        }
+
+#ifdef MTS_DEBUG_FP
+        disableFPExceptions();
+#endif
+    }
+
+    ref<WorkProcessor> clone() const {
+        return new AdaptiveRenderer(m_pixelFormat, m_blockSize);
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~AdaptiveRenderer() { }
+private:
+    ref<Scene> m_scene;
+    ref<Sensor> m_sensor;
+    ref<Sampler> m_sampler;
+    ref<SamplingIntegrator> m_integrator;
+    Bitmap::EPixelFormat m_pixelFormat;
+    int m_blockSize;
+    HilbertCurve2D<uint8_t> m_hilbertCurve;
+};
+
+/* ==================================================================== */
+/*                         AdaptiveRenderProcess                        */
+/* ==================================================================== */
+
+AdaptiveRenderProcess::AdaptiveRenderProcess(const RenderJob *parent,
+        RenderQueue *queue, int blockSize, const Point2i &offset,
+        const Vector2i &size, const std::vector<uint32_t> &budget,
+        std::vector<AdaptivePixelStatistics> &stats, int round)
+    : BlockedRenderProcess(parent, queue, blockSize), m_regionOffset(offset),
+      m_regionSize(size), m_budget(budget), m_stats(stats), m_round(round) {
+}
+
+int AdaptiveRenderProcess::countActiveBlocks(const Vector2i &size,
+        int blockSize, const std::vector<uint32_t> &budget) {
+    int count = 0;
+    for (int by=0; by<size.y; by += blockSize) {
+        for (int bx=0; bx<size.x; bx += blockSize) {
+            int ex = std::min(bx + blockSize, size.x),
+                ey = std::min(by + blockSize, size.y);
+            bool active = false;
+            for (int y=by; y<ey && !active; ++y)
+                for (int x=bx; x<ex && !active; ++x)
+                    active = budget[x + y * size.x] > 0;
+            if (active)
+                ++count;
+        }
+    }
+    return count;
+}
+
+ref<WorkProcessor> AdaptiveRenderProcess::createWorkProcessor() const {
+    return new AdaptiveRenderer(m_pixelFormat, m_blockSize);
+}
+
+ParallelProcess::EStatus AdaptiveRenderProcess::generateWork(WorkUnit *unit, int worker) {
+    AdaptiveWorkUnit *wu = static_cast<AdaptiveWorkUnit *>(unit);
+
+    /* Skip over blocks whose pixels have all converged */
+    while (true) {
+        EStatus status = BlockedImageProcess::generateWork(unit, worker);
+        if (status != ESuccess)
+            return status;
+
+        const Vector2i &size = wu->getSize();
+        Point2i offset = wu->getOffset() - Vector2i(m_regionOffset);
+        wu->initialize();
+
+        /* The statistics of this block are not modified before its result
+           arrives, hence they can be read without holding m_resultMutex */
+        bool active = false;
+        for (int y=0; y<size.y; ++y) {
+            for (int x=0; x<size.x; ++x) {
+                size_t index = (offset.x + x) + (offset.y + y) * m_regionSize.x;
+                uint32_t count = m_budget[index];
+                wu->setSampleCount(Point2i(x, y), count);
+                wu->setSampleOffset(Point2i(x, y), m_stats[index].sampleCount);
+                active |= count > 0;
+            }
+        }
+
+        if (active)
+            break;
+    }
+
+    return ESuccess;
+}
+
+void AdaptiveRenderProcess::processResult(const WorkResult *workResult, bool cancelled) {
+    const AdaptiveWorkResult *result = static_cast<const AdaptiveWorkResult *>(workResult);
+    const ImageBlock *block = result->getImageBlock();
+    m_film->putConcurrent(block);
+    UniqueLock lock(m_resultMutex);
+    if (!cancelled) {
+        const Vector2i &size = block->getSize();
+        Point2i offset = block->getOffset() - Vector2i(m_regionOffset);
+        for (int y=0; y<size.y; ++y)
+            for (int x=0; x<size.x; ++x)
+                m_stats[(offset.x + x) + (offset.y + y) * m_regionSize.x]
+                    .merge(result->getStatistics(Point2i(x, y)));
+    }
+    m_progress->update(++m_resultCount);
+    lock.unlock();
+    m_queue->signalWorkEnd(m_parent, block, cancelled);
+}
+
+void AdaptiveRenderProcess::bindResource(const std::string &name, int id) {
+    BlockedRenderProcess::bindResource(name, id);
+    if (name == "sensor") {
+        if (m_offset != m_regionOffset || m_size != m_regionSize)
+            Log(EError, "The adaptive rendering region does not match the film!");
+        delete m_progress;
+        m_progress = new ProgressReporter(formatString("Rendering (round %i)", m_round + 1),
+            countActiveBlocks(m_regionSize, m_blockSize, m_budget), m_parent);
+    }
+}
+
+MTS_IMPLEMENT_CLASS(AdaptiveWorkUnit, false, RectangularWorkUnit)
+MTS_IMPLEMENT_CLASS(AdaptiveWorkResult, false, WorkResult)
+MTS_IMPLEMENT_CLASS(AdaptiveRenderProcess, false, BlockedRenderProcess)
+MTS_IMPLEMENT_CLASS_S(AdaptiveRenderer, false, WorkProcessor)
+MTS_NAMESPACE_END
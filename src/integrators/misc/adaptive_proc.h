@@ -0,0 +1,226 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(__ADAPTIVE_PROC_H)
+#define __ADAPTIVE_PROC_H
+
+#include <mitsuba/render/renderproc.h>
+#include <mitsuba/render/rectwu.h>
+#include <mitsuba/render/imageblock.h>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Running luminance statistics of a single pixel, which are used
+ * to decide when the adaptive rendering process can stop sampling it
+ */
+struct AdaptivePixelStatistics {
+    /// Number of samples taken so far
+    uint32_t sampleCount;
+    /// Sample mean of the luminance
+    Float mean;
+    /// Sum of squared deviations from the mean
+    Float m2;
+
+    inline AdaptivePixelStatistics() : sampleCount(0), mean(0.0f), m2(0.0f) { }
+
+    /**
+     * \brief Add a luminance sample. Uses a numerically robust online variance
+     * estimation algorithm proposed by Donald Knuth (TAOCP vol.2, 3rd ed., p.232)
+     */
+    inline void put(Float value) {
+        ++sampleCount;
+        const Float delta = value - mean;
+        mean += delta / sampleCount;
+        m2 += delta * (value - mean);
+    }
+
+    /**
+     * \brief Merge with the statistics of a disjoint set of samples
+     * (Chan et al., "Updating Formulae and a Pairwise Algorithm for
+     * Computing Sample Variances", 1979)
+     */
+    inline void merge(const AdaptivePixelStatistics &other) {
+        if (other.sampleCount == 0)
+            return;
+        uint32_t total = sampleCount + other.sampleCount;
+        const Float delta = other.mean - mean;
+        mean += delta * other.sampleCount / total;
+        m2 += other.m2 + delta * delta * ((Float) sampleCount * other.sampleCount / total);
+        sampleCount = total;
+    }
+
+    /// Return the variance of the primary estimator
+    inline Float getVariance() const {
+        return sampleCount > 1 ? m2 / (sampleCount - 1)
+            : std::numeric_limits<Float>::infinity();
+    }
+};
+
+/**
+ * \brief Rectangular work unit, which additionally specifies
+ * the number of samples to be taken in each of its pixels
+ *
+ * The number of samples taken during previous rounds is also
+ * stored, so that the sampler can continue its sample sequence
+ * instead of repeating it.
+ */
+class AdaptiveWorkUnit : public RectangularWorkUnit {
+public:
+    inline AdaptiveWorkUnit() { }
+
+    /// Return the number of samples that should be taken in a pixel
+    inline uint32_t getSampleCount(const Point2i &p) const {
+        return m_sampleCounts[p.x + p.y * getSize().x];
+    }
+
+    /// Set the number of samples that should be taken in a pixel
+    inline void setSampleCount(const Point2i &p, uint32_t count) {
+        m_sampleCounts[p.x + p.y * getSize().x] = count;
+    }
+
+    /// Return the number of samples that were taken in a pixel during previous rounds
+    inline uint32_t getSampleOffset(const Point2i &p) const {
+        return m_sampleOffsets[p.x + p.y * getSize().x];
+    }
+
+    /// Set the number of samples that were taken in a pixel during previous rounds
+    inline void setSampleOffset(const Point2i &p, uint32_t offset) {
+        m_sampleOffsets[p.x + p.y * getSize().x] = offset;
+    }
+
+    /// Allocate storage for the per-pixel sample counts (call after \ref setSize())
+    inline void initialize() {
+        m_sampleCounts.resize(getSize().x * getSize().y);
+        m_sampleOffsets.resize(getSize().x * getSize().y);
+    }
+
+    /* WorkUnit implementation */
+    void set(const WorkUnit *wu);
+    void load(Stream *stream);
+    void save(Stream *stream) const;
+    std::string toString() const;
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Virtual destructor
+    virtual ~AdaptiveWorkUnit() { }
+private:
+    std::vector<uint32_t> m_sampleCounts;
+    std::vector<uint32_t> m_sampleOffsets;
+};
+
+/**
+ * \brief Work result of the adaptive rendering process: an image
+ * block along with updated luminance statistics of its pixels
+ */
+class AdaptiveWorkResult : public WorkResult {
+public:
+    AdaptiveWorkResult(Bitmap::EPixelFormat fmt, const Vector2i &maxBlockSize,
+        const ReconstructionFilter *filter);
+
+    /// Prepare for rendering the given work unit
+    void initialize(const AdaptiveWorkUnit *wu);
+
+    inline ImageBlock *getImageBlock() { return m_block.get(); }
+    inline const ImageBlock *getImageBlock() const { return m_block.get(); }
+
+    /// Access the statistics of a pixel (relative to the block offset)
+    inline AdaptivePixelStatistics &getStatistics(const Point2i &p) {
+        return m_stats[p.x + p.y * m_block->getSize().x];
+    }
+
+    /// Access the statistics of a pixel (relative to the block offset, const version)
+    inline const AdaptivePixelStatistics &getStatistics(const Point2i &p) const {
+        return m_stats[p.x + p.y * m_block->getSize().x];
+    }
+
+    /* WorkResult implementation */
+    void load(Stream *stream);
+    void save(Stream *stream) const;
+    std::string toString() const;
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Virtual destructor
+    virtual ~AdaptiveWorkResult() { }
+private:
+    ref<ImageBlock> m_block;
+    std::vector<AdaptivePixelStatistics> m_stats;
+};
+
+/**
+ * \brief Parallel process that performs one round of adaptive sampling
+ *
+ * Only blocks that contain at least one unconverged pixel are issued
+ * as work units, and each of them only takes samples in its unconverged
+ * pixels. The per-pixel statistics of the finished blocks are merged
+ * into a global buffer, which the integrator uses to determine the
+ * sample budget of the next round.
+ */
+class AdaptiveRenderProcess : public BlockedRenderProcess {
+public:
+    /**
+     * \param offset
+     *    Offset of the rendered image region
+     * \param size
+     *    Size of the rendered image region
+     * \param budget
+     *    Number of samples to be taken in each pixel of the region
+     *    during this round (row-major order)
+     * \param stats
+     *    Statistics of each pixel of the region (updated by this process)
+     * \param round
+     *    Index of the current round (for progress reporting)
+     */
+    AdaptiveRenderProcess(const RenderJob *parent, RenderQueue *queue,
+        int blockSize, const Point2i &offset, const Vector2i &size,
+        const std::vector<uint32_t> &budget,
+        std::vector<AdaptivePixelStatistics> &stats, int round);
+
+    /// Count the blocks of the given size that contain pixels with a nonzero budget
+    static int countActiveBlocks(const Vector2i &size, int blockSize,
+        const std::vector<uint32_t> &budget);
+
+    // ======================================================================
+    //! @{ \name Implementation of the ParallelProcess interface
+    // ======================================================================
+
+    ref<WorkProcessor> createWorkProcessor() const;
+    void processResult(const WorkResult *result, bool cancelled);
+    void bindResource(const std::string &name, int id);
+    EStatus generateWork(WorkUnit *unit, int worker);
+
+    //! @}
+    // ======================================================================
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Virtual destructor
+    virtual ~AdaptiveRenderProcess() { }
+private:
+    Point2i m_regionOffset;
+    Vector2i m_regionSize;
+    const std::vector<uint32_t> &m_budget;
+    std::vector<AdaptivePixelStatistics> &m_stats;
+    int m_round;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __ADAPTIVE_PROC_H */
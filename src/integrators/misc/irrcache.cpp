@@ -39,6 +39,9 @@ MTS_NAMESPACE_BEGIN
  *     \parameter{indirectOnly}{\Boolean}{Only show the indirect illumination? This can be useful to check
  *      the interpolation quality. \default{\code{false}}}
  *     \parameter{debug}{\Boolean}{Visualize the sample placement? \default{\code{false}}}
+ *     \parameter{cacheFile}{\String}{When specified, irradiance records are loaded from this
+ *      file before rendering (if it exists), and the extended cache is written back to it afterwards.
+ *      \default{none}}
  * }
  * \renderings{
  *  \unframedbigrendering{Illustration of the effect of the different optimizatations
@@ -78,6 +81,13 @@ MTS_NAMESPACE_BEGIN
  * improve the achieved interpolation quality, namely irradiance gradients
  * \cite{Ward1992Irradiance}, neighbor clamping \cite{Krivanek2006Making}, a screen-space
  * clamping metric and an improved error function \cite{Tabellion2004Approximate}.
+ *
+ * When rendering a sequence of frames of a static scene (e.g. a camera
+ * fly-through), the \code{cacheFile} parameter can be used to carry the
+ * cache over from one frame to the next. Loaded records are validated against
+ * the scene geometry, and records that no longer lie on a surface are discarded.
+ * The overture pass and the rendering process then only need to add records
+ * in regions that were not visible in the previous frames.
  */
 
 class IrradianceCacheIntegrator : public SamplingIntegrator {
@@ -115,6 +125,9 @@ public:
         /* If set to true, direct illumination will be suppressed -
            useful for checking the interpolation quality */
         m_indirectOnly = props.getBoolean("indirectOnly", false);
+        /* Optional file, which is used to persist the irradiance cache
+           between subsequent renderings of a static scene */
+        m_cacheFile = props.getString("cacheFile", "");
 
         if (m_debug)
             m_overture = false;
@@ -215,17 +228,24 @@ public:
         Log(EDebug, "  - Gather resolution   : %ix%i = %i samples", m_resolution, 2*m_resolution, 2*m_resolution*m_resolution);
         Log(EDebug, "  - Quality setting     : %.2f (adjustment: %.2f)", m_quality, m_qualityAdjustment);
 
+        if (!m_cacheFile.empty() && fs::exists(m_cacheFile))
+            m_irrCache->load(m_cacheFile, scene);
+
         if (m_overture) {
             int subIntegratorResID = sched->registerResource(m_subIntegrator);
+            /* Seed the overture pass with any previously loaded records */
+            int irrCacheResID = sched->registerResource(m_irrCache);
             ref<OvertureProcess> proc = new OvertureProcess(job, m_resolution, m_gradients,
                 m_clampNeighbor, m_clampScreen, m_quality);
             m_proc = proc;
             proc->bindResource("scene", sceneResID);
             proc->bindResource("sensor", sensorResID);
             proc->bindResource("subIntegrator", subIntegratorResID);
+            proc->bindResource("irrCache", irrCacheResID);
             bindUsedResources(proc);
             sched->schedule(proc);
             sched->unregisterResource(subIntegratorResID);
+            sched->unregisterResource(irrCacheResID);
             sched->wait(proc);
             m_proc = NULL;
 
@@ -244,6 +264,14 @@ public:
         return true;
     }
 
+    void postprocess(const Scene *scene, RenderQueue *queue, const RenderJob *job,
+            int sceneResID, int sensorResID, int samplerResID) {
+        SamplingIntegrator::postprocess(scene, queue, job, sceneResID, sensorResID, samplerResID);
+
+        if (!m_cacheFile.empty() && m_irrCache)
+            m_irrCache->save(m_cacheFile);
+    }
+
     void cancel() {
         if (m_proc) {
             Scheduler::getInstance()->cancel(m_proc);
@@ -382,6 +410,7 @@ private:
     bool m_clampScreen, m_clampNeighbor;
     bool m_overture, m_gradients, m_debug, m_indirectOnly;
     int m_resolution;
+    fs::path m_cacheFile;
 };
 
 MTS_IMPLEMENT_CLASS_S(IrradianceCacheIntegrator, false, SamplingIntegrator)
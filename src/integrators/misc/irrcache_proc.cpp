@@ -70,6 +70,7 @@ public:
         m_irrCache->clampScreen(m_clampScreen);
         m_irrCache->useGradients(m_gradients);
         m_irrCache->setQuality(m_quality);
+        m_irrCache->insert(static_cast<IrradianceCache *>(getResource("irrCache")));
         m_hs = new HemisphereSampler(m_resolution, 3*m_resolution);
     }
 
@@ -381,9 +381,11 @@ void MLTProcess::develop() {
 }
 
 void MLTProcess::processResult(const WorkResult *wr, bool cancelled) {
-    LockGuard lock(m_resultMutex);
     const ImageBlock *result = static_cast<const ImageBlock *>(wr);
-    m_accum->put(result);
+    /* Merge outside of the process-wide lock; concurrent merges
+       only wait for each other on the rows they are both writing */
+    m_accum->putConcurrent(result);
+    LockGuard lock(m_resultMutex);
     m_progress->update(++m_resultCounter);
     m_refreshTimeout = std::min(2000U, m_refreshTimeout * 2);
 
@@ -181,7 +181,11 @@ public:
                     BSDFSamplingRecord bRec(its, its.toLocal(dRec.d), ERadiance);
 
                     /* Evaluate BSDF * cos(theta) */
-                    const Spectrum bsdfVal = bsdf->eval(bRec);
+                    Spectrum bsdfVal;
+                    {
+                        MTS_PROFILE_SCOPE(EProfilerBSDFEval);
+                        bsdfVal = bsdf->eval(bRec);
+                    }
 
                     /* Prevent light leaks due to the use of shading normals */
                     if (!bsdfVal.isZero() && (!m_strictNormals
@@ -206,7 +210,11 @@ public:
             /* Sample BSDF * cos(theta) */
             Float bsdfPdf;
             BSDFSamplingRecord bRec(its, rRec.sampler, ERadiance);
-            Spectrum bsdfWeight = bsdf->sample(bRec, bsdfPdf, rRec.nextSample2D());
+            Spectrum bsdfWeight;
+            {
+                MTS_PROFILE_SCOPE(EProfilerBSDFSample);
+                bsdfWeight = bsdf->sample(bRec, bsdfPdf, rRec.nextSample2D());
+            }
             if (bsdfWeight.isZero())
                 break;
 
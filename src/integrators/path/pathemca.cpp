@@ -211,7 +211,11 @@ public:
                     BSDFSamplingRecord bRec(its, its.toLocal(dRec.d), ERadiance);
 
                     /* Evaluate BSDF * cos(theta) */
-                    const Spectrum bsdfVal = bsdf->eval(bRec);
+                    Spectrum bsdfVal;
+                    {
+                        MTS_PROFILE_SCOPE(EProfilerBSDFEval);
+                        bsdfVal = bsdf->eval(bRec);
+                    }
 
                     /* Prevent light leaks due to the use of shading normals */
                     if (!bsdfVal.isZero() && (!m_strictNormals
@@ -244,7 +248,11 @@ public:
             Float bsdfPdf;
             BSDFSamplingRecord bRec(its, rRec.sampler, ERadiance);
             Point2f sample = rRec.nextSample2D();
-            Spectrum bsdfWeight = bsdf->sample(bRec, bsdfPdf, sample);
+            Spectrum bsdfWeight;
+            {
+                MTS_PROFILE_SCOPE(EProfilerBSDFSample);
+                bsdfWeight = bsdf->sample(bRec, bsdfPdf, sample);
+            }
             // throughput visualization
             //emca->addHeatmapData(its.shape, its.primIndex, its.p, throughput*bsdfWeight);
             if (bsdfWeight.isZero()) {
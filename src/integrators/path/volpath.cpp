@@ -241,7 +241,11 @@ public:
 
                         /* Evaluate BSDF * cos(theta) */
                         BSDFSamplingRecord bRec(its, its.toLocal(dRec.d));
-                        const Spectrum bsdfVal = bsdf->eval(bRec);
+                        Spectrum bsdfVal;
+                        {
+                            MTS_PROFILE_SCOPE(EProfilerBSDFEval);
+                            bsdfVal = bsdf->eval(bRec);
+                        }
 
                         Float woDotGeoN = dot(its.geoFrame.n, dRec.d);
 
@@ -269,7 +273,11 @@ public:
                 /* Sample BSDF * cos(theta) */
                 BSDFSamplingRecord bRec(its, rRec.sampler, ERadiance);
                 Float bsdfPdf;
-                Spectrum bsdfWeight = bsdf->sample(bRec, bsdfPdf, rRec.nextSample2D());
+                Spectrum bsdfWeight;
+                {
+                    MTS_PROFILE_SCOPE(EProfilerBSDFSample);
+                    bsdfWeight = bsdf->sample(bRec, bsdfPdf, rRec.nextSample2D());
+                }
                 if (bsdfWeight.isZero())
                     break;
 
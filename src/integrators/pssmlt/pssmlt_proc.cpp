@@ -38,8 +38,8 @@ StatsCounter forcedAcceptance("Primary sample space MLT",
 
 class PSSMLTRenderer : public WorkProcessor {
 public:
-    PSSMLTRenderer(const PSSMLTConfiguration &conf)
-        : m_config(conf) {
+    PSSMLTRenderer(const PSSMLTConfiguration &conf, ImageBlock *accum)
+        : m_config(conf), m_accum(accum) {
     }
 
     PSSMLTRenderer(Stream *stream, InstanceManager *manager)
@@ -56,8 +56,9 @@ public:
     }
 
     ref<WorkResult> createWorkResult() const {
-        return new ImageBlock(Bitmap::ESpectrum,
-            m_film->getCropSize(), m_film->getReconstructionFilter());
+        /* Workers that splat into the shared buffer only need a placeholder */
+        return new ImageBlock(Bitmap::ESpectrum, m_accum.get() ? Vector2i(1)
+            : m_film->getCropSize(), m_film->getReconstructionFilter());
     }
 
     void prepare() {
@@ -184,7 +185,7 @@ public:
                 for (size_t k=0; k<current->size(); ++k) {
                     Spectrum value = current->getValue(k) * cumulativeWeight;
                     if (!value.isZero())
-                        result->put(current->getPosition(k), &value[0]);
+                        splat(result, current->getPosition(k), value);
                 }
 
                 cumulativeWeight = proposedWeight;
@@ -206,7 +207,7 @@ public:
                 for (size_t k=0; k<proposed->size(); ++k) {
                     Spectrum value = proposed->getValue(k) * proposedWeight;
                     if (!value.isZero())
-                        result->put(proposed->getPosition(k), &value[0]);
+                        splat(result, proposed->getPosition(k), value);
                 }
 
                 m_sensorSampler->reject();
@@ -224,7 +225,7 @@ public:
         for (size_t k=0; k<current->size(); ++k) {
             Spectrum value = current->getValue(k) * cumulativeWeight;
             if (!value.isZero())
-                result->put(current->getPosition(k), &value[0]);
+                splat(result, current->getPosition(k), value);
         }
 
 
@@ -233,10 +234,18 @@ public:
     }
 
     ref<WorkProcessor> clone() const {
-        return new PSSMLTRenderer(m_config);
+        return new PSSMLTRenderer(m_config, const_cast<ImageBlock *>(m_accum.get()));
     }
 
     MTS_DECLARE_CLASS()
+protected:
+    /// Splat a sample into the shared or private accumulation buffer
+    inline void splat(ImageBlock *result, const Point2 &pos, Spectrum &value) {
+        if (m_accum)
+            m_accum->putConcurrent(pos, &value[0]);
+        else
+            result->put(pos, &value[0]);
+    }
 private:
     PSSMLTConfiguration m_config;
     ref<Scene> m_scene;
@@ -248,6 +257,8 @@ private:
     ref<PSSMLTSampler> m_emitterSampler;
     ref<PSSMLTSampler> m_directSampler;
     ref<ReplayableSampler> m_rplSampler;
+    /* Accumulation buffer shared by all local workers (not serialized) */
+    ref<ImageBlock> m_accum;
 };
 
 /* ==================================================================== */
@@ -268,13 +279,16 @@ PSSMLTProcess::PSSMLTProcess(const RenderJob *parent, RenderQueue *queue,
 }
 
 ref<WorkProcessor> PSSMLTProcess::createWorkProcessor() const {
-    return new PSSMLTRenderer(m_config);
+    return new PSSMLTRenderer(m_config, const_cast<ImageBlock *>(m_accum.get()));
 }
 
 void PSSMLTProcess::develop() {
     LockGuard lock(m_resultMutex);
-    size_t pixelCount = m_accum->getBitmap()->getPixelCount();
-    const Spectrum *accum = (Spectrum *) m_accum->getBitmap()->getData();
+    ref<Bitmap> accumBitmap = m_accum->getBitmap();
+    if (m_accum->getBorderSize() > 0)
+        accumBitmap = accumBitmap->crop(Point2i(m_accum->getBorderSize()), m_accum->getSize());
+    size_t pixelCount = accumBitmap->getPixelCount();
+    const Spectrum *accum = (Spectrum *) accumBitmap->getData();
     const Spectrum *direct = m_directImage != NULL ?
         (Spectrum *) m_directImage->getData() : NULL;
     const Float *importanceMap = m_config.importanceMap != NULL ?
@@ -310,9 +324,11 @@ void PSSMLTProcess::develop() {
 }
 
 void PSSMLTProcess::processResult(const WorkResult *wr, bool cancelled) {
-    LockGuard lock(m_resultMutex);
     const ImageBlock *result = static_cast<const ImageBlock *>(wr);
-    m_accum->put(result);
+    /* Local workers splat into the accumulation buffer directly and only
+       report placeholder blocks, but they may still be running */
+    m_accum->putConcurrent(result);
+    LockGuard lock(m_resultMutex);
     m_progress->update(++m_resultCounter);
     m_refreshTimeout = std::min(2000U, m_refreshTimeout * 2);
 
@@ -345,7 +361,8 @@ void PSSMLTProcess::bindResource(const std::string &name, int id) {
         if (m_progress)
             delete m_progress;
         m_progress = new ProgressReporter("Rendering", m_config.workUnits, m_job);
-        m_accum = new ImageBlock(Bitmap::ESpectrum, m_film->getCropSize());
+        m_accum = new ImageBlock(Bitmap::ESpectrum, m_film->getCropSize(),
+            m_film->getReconstructionFilter());
         m_accum->clear();
         m_developBuffer = new Bitmap(Bitmap::ESpectrum, Bitmap::EFloat, m_film->getCropSize());
     }
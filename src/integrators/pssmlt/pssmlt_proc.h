@@ -55,7 +55,7 @@ private:
     const PSSMLTConfiguration &m_config;
     const Bitmap *m_directImage;
     ref<Bitmap> m_developBuffer;
-    ImageBlock *m_accum;
+    ref<ImageBlock> m_accum;
     ProgressReporter *m_progress;
     const std::vector<PathSeed> &m_seeds;
     ref<Mutex> m_resultMutex;
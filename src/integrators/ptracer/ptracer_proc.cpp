@@ -25,16 +25,12 @@ MTS_NAMESPACE_BEGIN
 /* ==================================================================== */
 
 void CaptureParticleWorkResult::load(Stream *stream) {
-    size_t nEntries = (size_t) m_size.x * (size_t) m_size.y;
-    stream->readFloatArray(reinterpret_cast<Float *>(m_bitmap->getFloatData()),
-        nEntries * SPECTRUM_SAMPLES);
+    ImageBlock::load(stream);
     m_range->load(stream);
 }
 
 void CaptureParticleWorkResult::save(Stream *stream) const {
-    size_t nEntries = (size_t) m_size.x * (size_t) m_size.y;
-    stream->writeFloatArray(reinterpret_cast<const Float *>(m_bitmap->getFloatData()),
-        nEntries * SPECTRUM_SAMPLES);
+    ImageBlock::save(stream);
     m_range->save(stream);
 }
 
@@ -62,12 +58,16 @@ void CaptureParticleWorker::prepare() {
 
 ref<WorkProcessor> CaptureParticleWorker::clone() const {
     return new CaptureParticleWorker(m_maxDepth,
-        m_maxPathDepth, m_rrDepth, m_bruteForce);
+        m_maxPathDepth, m_rrDepth, m_bruteForce,
+        const_cast<ImageBlock *>(m_accum.get()));
 }
 
 ref<WorkResult> CaptureParticleWorker::createWorkResult() const {
+    /* Workers that splat into the shared buffer only need a minimal
+       placeholder image (their results are still used to count particles) */
     const Film *film = m_sensor->getFilm();
-    return new CaptureParticleWorkResult(film->getCropSize(), m_rfilter.get());
+    return new CaptureParticleWorkResult(m_accum.get() ? Vector2i(1)
+        : film->getCropSize(), m_rfilter.get());
 }
 
 void CaptureParticleWorker::process(const WorkUnit *workUnit, WorkResult *workResult,
@@ -103,7 +103,7 @@ void CaptureParticleWorker::handleEmission(const PositionSamplingRecord &pRec,
     value *= emitter->evalDirection(DirectionSamplingRecord(dRec.d), pRec);
 
     /* Splat onto the accumulation buffer */
-    m_workResult->put(dRec.uv, (Float *) &value[0]);
+    splat(dRec.uv, value);
 }
 
 void CaptureParticleWorker::handleSurfaceInteraction(int depth, int nullInteractions,
@@ -124,7 +124,7 @@ void CaptureParticleWorker::handleSurfaceInteraction(int depth, int nullInteract
         if (value.isZero())
             return;
 
-        m_workResult->put(uv, (Float *) &value[0]);
+        splat(uv, value);
         return;
     }
 
@@ -161,7 +161,7 @@ void CaptureParticleWorker::handleSurfaceInteraction(int depth, int nullInteract
     value *= bsdf->eval(bRec) * correction;
 
     /* Splat onto the accumulation buffer */
-    m_workResult->put(dRec.uv, (Float *) &value[0]);
+    splat(dRec.uv, value);
 }
 
 void CaptureParticleWorker::handleMediumInteraction(int depth, int nullInteractions, bool caustic,
@@ -190,7 +190,7 @@ void CaptureParticleWorker::handleMediumInteraction(int depth, int nullInteracti
         return;
 
     /* Splat onto the accumulation buffer */
-    m_workResult->put(dRec.uv, (Float *) &value[0]);
+    splat(dRec.uv, value);
 }
 
 /* ==================================================================== */
@@ -198,9 +198,14 @@ void CaptureParticleWorker::handleMediumInteraction(int depth, int nullInteracti
 /* ==================================================================== */
 
 void CaptureParticleProcess::develop() {
+    /* Local workers splat into the accumulation buffer while they run, hence
+       intermediate results may include particles that are not counted yet */
     Float weight = (m_accum->getWidth() * m_accum->getHeight())
         / (Float) m_receivedResultCount;
-    m_film->setBitmap(m_accum->getBitmap(), weight);
+    ref<Bitmap> bitmap = m_accum->getBitmap();
+    if (m_accum->getBorderSize() > 0)
+        bitmap = bitmap->crop(Point2i(m_accum->getBorderSize()), m_accum->getSize());
+    m_film->setBitmap(bitmap, weight);
     m_queue->signalRefresh(m_job);
 }
 
@@ -211,9 +216,11 @@ void CaptureParticleProcess::processResult(const WorkResult *wr, bool cancelled)
     if (cancelled)
         return;
 
+    /* Results of remote workers are merged while local workers may still be
+       splatting into the shared buffer (results of local workers are empty) */
+    m_accum->putConcurrent(result);
     LockGuard lock(m_resultMutex);
     increaseResultCount(range->getSize());
-    m_accum->put(result);
     if (m_job->isInteractive() || m_receivedResultCount == m_workCount)
         develop();
 }
@@ -222,7 +229,8 @@ void CaptureParticleProcess::bindResource(const std::string &name, int id) {
     if (name == "sensor") {
         Sensor *sensor = static_cast<Sensor *>(Scheduler::getInstance()->getResource(id));
         m_film = sensor->getFilm();
-        m_accum = new ImageBlock(Bitmap::ESpectrum, m_film->getCropSize(), NULL);
+        m_accum = new ImageBlock(Bitmap::ESpectrum, m_film->getCropSize(),
+            m_film->getReconstructionFilter());
         m_accum->clear();
     }
     ParticleProcess::bindResource(name, id);
@@ -230,7 +238,7 @@ void CaptureParticleProcess::bindResource(const std::string &name, int id) {
 
 ref<WorkProcessor> CaptureParticleProcess::createWorkProcessor() const {
     return new CaptureParticleWorker(m_maxDepth, m_maxPathDepth,
-            m_rrDepth, m_bruteForce);
+            m_rrDepth, m_bruteForce, const_cast<ImageBlock *>(m_accum.get()));
 }
 
 MTS_IMPLEMENT_CLASS(CaptureParticleProcess, false, ParticleProcess)
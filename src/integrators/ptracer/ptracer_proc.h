@@ -74,8 +74,17 @@ protected:
  */
 class CaptureParticleWorker : public ParticleTracer {
 public:
+    /**
+     * \param accum
+     *    Optional accumulation buffer shared by all local workers. When
+     *    specified, samples are splatted into it using atomic operations,
+     *    and the work results only track the range of traced particles.
+     *    This pointer is not serialized, hence remote workers always
+     *    fall back to private full-resolution work results.
+     */
     inline CaptureParticleWorker(int maxDepth, int maxPathDepth,
-        int rrDepth, bool bruteForce) : ParticleTracer(maxDepth, rrDepth, true),
+        int rrDepth, bool bruteForce, ImageBlock *accum = NULL)
+        : ParticleTracer(maxDepth, rrDepth, true), m_accum(accum),
         m_maxPathDepth(maxPathDepth), m_bruteForce(bruteForce) { }
 
     CaptureParticleWorker(Stream *stream, InstanceManager *manager);
@@ -121,10 +130,19 @@ public:
 protected:
     /// Virtual destructor
     virtual ~CaptureParticleWorker() { }
+
+    /// Splat a sample into the shared or private accumulation buffer
+    inline void splat(const Point2 &uv, Spectrum &value) {
+        if (m_accum)
+            m_accum->putConcurrent(uv, (Float *) &value[0]);
+        else
+            m_workResult->put(uv, (Float *) &value[0]);
+    }
 private:
     ref<const Sensor> m_sensor;
     ref<const ReconstructionFilter> m_rfilter;
     ref<CaptureParticleWorkResult> m_workResult;
+    ref<ImageBlock> m_accum;
     int m_maxPathDepth;
     bool m_bruteForce;
 };
@@ -43,6 +43,21 @@ MTS_NAMESPACE_BEGIN
  *       used to control the rendering artifact discussed below.
  *       \default{0.1}
  *     }
+ *     \parameter{cutError}{\Float}{
+ *       When set to a positive value, the generated VPLs are organized
+ *       into a light tree and replaced by a much smaller set of clusters
+ *       (a \emph{light cut}). The value specifies the maximum error bound
+ *       of each cluster relative to the total illumination at a
+ *       shading point. \default{0, i.e. disabled}
+ *     }
+ *     \parameter{maxCutSize}{\Integer}{
+ *       Maximum number of clusters that are used to illuminate each
+ *       shading point when \code{cutError} is enabled \default{1000}
+ *     }
+ *     \parameter{cutResolution}{\Integer}{
+ *       Number of shading points per image axis that are used to
+ *       select the light cut \default{32}
+ *     }
  * }
  *
  * This integrator implements a hardware-accelerated global illumination
@@ -67,6 +82,15 @@ MTS_NAMESPACE_BEGIN
  * (see the figure below). The number of samples per pixel specified to
  * the sampler is interpreted as the number of VPLs that should be rendered.
  *
+ * Since every VPL requires a separate rendering pass, the cost of this method
+ * is linear in the number of VPLs. The \code{cutError} parameter enables a
+ * clustering approach in the spirit of Lightcuts \cite{Walter2005Lightcuts}:
+ * the sampler's sample count then specifies the number of VPLs to be
+ * \emph{generated}, and the renderer only draws one representative per
+ * cluster. The clusters are selected so that their error bounds are satisfied
+ * at a grid of shading points seen from the camera. This makes it possible to
+ * use a very large number of VPLs at a fraction of the cost.
+ *
  * \renderings{
  *     \rendering{\code{clamping=0}: With clamping fully disabled, bright
  *     blotches appear in corners and creases.}{integrator_vpl_clamping0}
@@ -85,6 +109,12 @@ public:
         m_maxDepth = props.getInteger("maxDepth", 5);
         /* Relative clamping factor (0=no clamping, 1=full clamping) */
         m_clamping = props.getFloat("clamping", 0.1f);
+        /* Relative error bound of light tree clusters (0=no clustering) */
+        m_cutError = props.getFloat("cutError", 0.0f);
+        /* Max. number of clusters per shading point */
+        m_maxCutSize = props.getSize("maxCutSize", 1000);
+        /* Shading points per axis used to select the light cut */
+        m_cutResolution = props.getInteger("cutResolution", 32);
 
         m_session = Session::create();
         m_device = Device::create(m_session);
@@ -133,9 +163,43 @@ public:
         }
         Log(EInfo, "Generated %i virtual point lights", m_vpls.size());
 
+        if (m_cutError > 0)
+            clusterVPLs(scene);
+
         return true;
     }
 
+    /// Replace the VPLs by a light cut that is shared by a grid of shading points
+    void clusterVPLs(const Scene *scene) {
+        ref<Timer> timer = new Timer();
+        ref<VPLTree> tree = new VPLTree(m_vpls, m_random);
+
+        const Sensor *sensor = scene->getSensor();
+        Vector2i size = sensor->getFilm()->getCropSize();
+        std::vector<Point> points;
+        points.reserve(m_cutResolution * m_cutResolution);
+
+        for (int y=0; y<m_cutResolution; ++y) {
+            for (int x=0; x<m_cutResolution; ++x) {
+                Point2 samplePos(
+                    (x + 0.5f) * size.x / (Float) m_cutResolution,
+                    (y + 0.5f) * size.y / (Float) m_cutResolution);
+                Ray ray;
+                sensor->sampleRay(ray, samplePos, Point2(0.5f),
+                    sensor->getShutterOpen() + 0.5f * sensor->getShutterOpenTime());
+
+                Intersection its;
+                if (scene->rayIntersect(ray, its))
+                    points.push_back(its.p);
+            }
+        }
+
+        tree->computeSharedCut(points, m_cutError, m_maxCutSize, m_vpls);
+        Log(EInfo, "Clustered " SIZE_T_FMT " virtual point lights into a cut of "
+            SIZE_T_FMT " representatives (took %i ms)", tree->getVPLCount(),
+            m_vpls.size(), timer->getMilliseconds());
+    }
+
     void cancel() {
         m_cancel = true;
     }
@@ -260,6 +324,9 @@ private:
     int m_maxDepth;
     int m_shadowMapResolution;
     Float m_clamping;
+    Float m_cutError;
+    size_t m_maxCutSize;
+    int m_cutResolution;
     bool m_cancel;
 };
 
@@ -69,7 +69,7 @@ ref<Bitmap> BidirectionalUtils::renderDirectComponent(Scene *scene, int sceneRes
         clonedSampler->incRef();
         samplers[i] = clonedSampler.get();
     }
-    int ldSamplerResID = scheduler->registerMultiResource(samplers);
+    int ldSamplerResID = scheduler->registerMultiResource(samplers, true);
     for (size_t i=0; i<scheduler->getCoreCount(); ++i)
         samplers[i]->decRef();
 
@@ -139,7 +139,7 @@ ref<Bitmap> BidirectionalUtils::mltLuminancePass(Scene *scene, int sceneResID,
         clonedSampler->incRef();
         samplers[i] = clonedSampler.get();
     }
-    int nestedSamplerResID = scheduler->registerMultiResource(samplers);
+    int nestedSamplerResID = scheduler->registerMultiResource(samplers, true);
     for (size_t i=0; i<scheduler->getCoreCount(); ++i)
         samplers[i]->decRef();
 
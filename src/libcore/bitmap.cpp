@@ -1532,6 +1532,34 @@ Spectrum Bitmap::getPixel(const Point2i &pos) const {
     return result;
 }
 
+/**
+ * Run a format conversion between two bitmaps of the same size in parallel.
+ * The pixels are split into large chunks, since converters may precompute
+ * a lookup table on every call.
+ */
+static void convertParallel(const FormatConverter *cvt, const Bitmap *source,
+        Bitmap *target, Float multiplier, Spectrum::EConversionIntent intent) {
+    const size_t chunkSize = 256 * 1024;
+    size_t pixelCount = source->getPixelCount(),
+           chunks = (pixelCount + chunkSize - 1) / chunkSize,
+           sourceBpp = (size_t) source->getBytesPerPixel(),
+           targetBpp = (size_t) target->getBytesPerPixel();
+
+    #if defined(MTS_OPENMP)
+        #pragma omp parallel for schedule(dynamic) if (chunks > 1)
+    #endif
+    for (int i=0; i<(int) chunks; ++i) {
+        size_t start = (size_t) i * chunkSize,
+               count = std::min(chunkSize, pixelCount - start);
+
+        cvt->convert(source->getPixelFormat(), source->getGamma(),
+            source->getUInt8Data() + start * sourceBpp,
+            target->getPixelFormat(), target->getGamma(),
+            target->getUInt8Data() + start * targetBpp,
+            count, multiplier, intent, source->getChannelCount());
+    }
+}
+
 void Bitmap::convert(Bitmap *target, Float multiplier, Spectrum::EConversionIntent intent) const {
     if (m_componentFormat == EBitmask || target->getComponentFormat() == EBitmask)
         Log(EError, "Conversions involving bitmasks are currently not supported!");
@@ -1552,10 +1580,7 @@ void Bitmap::convert(Bitmap *target, Float multiplier, Spectrum::EConversionInte
 
     Assert(cvt != NULL);
 
-    cvt->convert(m_pixelFormat, m_gamma, m_data,
-        target->getPixelFormat(), target->getGamma(), target->getData(),
-        (size_t) m_size.x * (size_t) m_size.y, multiplier, intent,
-        m_channelCount);
+    convertParallel(cvt, this, target, multiplier, intent);
 }
 
 ref<Bitmap> Bitmap::convert(EPixelFormat pixelFormat,
@@ -1584,10 +1609,7 @@ ref<Bitmap> Bitmap::convert(EPixelFormat pixelFormat,
         target->setChannelNames(m_channelNames);
     target->setGamma(gamma);
 
-    cvt->convert(m_pixelFormat, m_gamma, m_data,
-        pixelFormat, gamma, target->getData(),
-        (size_t) m_size.x * (size_t) m_size.y, multiplier, intent,
-        m_channelCount);
+    convertParallel(cvt, this, target, multiplier, intent);
 
     return target;
 }
@@ -2300,29 +2322,30 @@ template <typename Scalar> static void resample(ref<const ReconstructionFilter>
     }
 
     if (source->getHeight() != target->getHeight() || filter) {
-        /* Re-sample along the Y direction */
+        /* Re-sample along the Y direction. This processes entire rows
+           at a time, which streams through memory and vectorizes */
         Resampler<Scalar> r(rfilter, bcv, source->getHeight(), target->getHeight());
+        size_t rowSize = (size_t) target->getWidth() * channels;
+        const Scalar *srcPtr = (const Scalar *) source->getUInt8Data();
 
         if (clamp) {
             #if defined(MTS_OPENMP)
                 #pragma omp parallel for
             #endif
-            for (int x=0; x<source->getWidth(); ++x) {
-                const Scalar *srcPtr = (Scalar *) source->getUInt8Data() + x * channels;
-                Scalar *trgPtr = (Scalar *) target->getUInt8Data() + x * channels;
+            for (int y=0; y<target->getHeight(); ++y) {
+                Scalar *trgPtr = (Scalar *) target->getUInt8Data() + y * rowSize;
 
-                r.resampleAndClamp(srcPtr, source->getWidth(), trgPtr, target->getWidth(),
-                    channels, safe_cast<Scalar>(minValue), safe_cast<Scalar>(maxValue));
+                r.resampleRowAndClamp(srcPtr, rowSize, trgPtr, y,
+                    safe_cast<Scalar>(minValue), safe_cast<Scalar>(maxValue));
             }
         } else {
             #if defined(MTS_OPENMP)
                 #pragma omp parallel for
             #endif
-            for (int x=0; x<source->getWidth(); ++x) {
-                const Scalar *srcPtr = (Scalar *) source->getUInt8Data() + x * channels;
-                Scalar *trgPtr = (Scalar *) target->getUInt8Data() + x * channels;
+            for (int y=0; y<target->getHeight(); ++y) {
+                Scalar *trgPtr = (Scalar *) target->getUInt8Data() + y * rowSize;
 
-                r.resample(srcPtr, source->getWidth(), trgPtr, target->getWidth(), channels);
+                r.resampleRow(srcPtr, rowSize, trgPtr, y);
             }
         }
     }
@@ -57,6 +57,29 @@ void MemoryStream::resize(size_t size) {
     m_capacity = size;
 }
 
+void MemoryStream::reserve(size_t size) {
+    if (size > m_capacity)
+        resize(size);
+}
+
+ref<MemoryStream> MemoryStream::readView(Stream *stream, size_t size) {
+    ref<MemoryStream> result;
+    if (stream->getClass()->derivesFrom(MTS_CLASS(MemoryStream))) {
+        MemoryStream *source = static_cast<MemoryStream *>(stream);
+        size_t pos = source->getPos();
+        if (size > source->getSize() - pos)
+            Log(EError, "readView(): attempted to read %s beyond the end "
+                "of the stream!", memString(size - (source->getSize() - pos)).c_str());
+        result = new MemoryStream(source->getCurrentData(), size);
+        source->seek(pos + size);
+    } else {
+        result = new MemoryStream(size);
+        stream->copyTo(result, size);
+        result->seek(0);
+    }
+    return result;
+}
+
 void MemoryStream::flush() {
     /* Ignore */
 }
@@ -101,8 +124,10 @@ void MemoryStream::read(void *ptr, size_t size) {
 void MemoryStream::write(const void *ptr, size_t size) {
     size_t endPos = m_pos + size;
     if (endPos > m_size) {
+        /* Grow geometrically so that a sequence of small writes
+           (e.g. when serializing a scene) runs in linear time */
         if (endPos > m_capacity)
-            resize(endPos);
+            resize(std::max(endPos, m_capacity + m_capacity / 2));
         m_size = endPos;
     }
     memcpy(m_data + m_pos, ptr, size);
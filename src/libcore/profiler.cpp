@@ -0,0 +1,233 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/profiler.h>
+#include <mitsuba/core/timer.h>
+#include <iomanip>
+
+MTS_NAMESPACE_BEGIN
+
+/// Call tree of a single thread. Only ever modified by its owner.
+struct Profiler::ThreadRecord {
+    struct Node {
+        /// Accumulated timestamp counter ticks and number of calls
+        uint64_t ticks, calls;
+        /// Timestamp of the most recent entry
+        uint64_t start;
+        /// Child nodes (0 = not yet visited)
+        uint16_t children[EProfilerPhaseCount];
+        uint16_t parent;
+        uint16_t phase;
+    };
+
+    Node nodes[MTS_PROFILER_MAX_NODES];
+    volatile uint32_t nodeCount;
+    uint32_t current;
+    /// Nesting depth of regions, which did not fit into the tree
+    uint32_t overflow;
+};
+
+#if defined(__WINDOWS__)
+static __declspec(thread) Profiler::ThreadRecord *__profiler_record = NULL;
+#else
+static __thread Profiler::ThreadRecord *__profiler_record = NULL;
+#endif
+
+ref<Profiler> Profiler::m_instance = new Profiler();
+
+Profiler::Profiler() {
+    m_mutex = new Mutex();
+    m_timer = new Timer();
+    m_startTicks = rdtsc();
+}
+
+Profiler::~Profiler() {
+    for (size_t i=0; i<m_threads.size(); ++i)
+        freeAligned(m_threads[i]);
+}
+
+Profiler::ThreadRecord *Profiler::registerThread() {
+    ThreadRecord *record = (ThreadRecord *) allocAligned(sizeof(ThreadRecord));
+    memset(record, 0, sizeof(ThreadRecord));
+    record->nodeCount = 1; /* Root node */
+
+    LockGuard lock(m_mutex);
+    m_threads.push_back(record);
+    return record;
+}
+
+void Profiler::enter(EProfilerPhase phase) {
+    ThreadRecord *record = __profiler_record;
+    if (EXPECT_NOT_TAKEN(record == NULL))
+        record = __profiler_record = m_instance->registerThread();
+
+    if (EXPECT_NOT_TAKEN(record->overflow > 0)) {
+        record->overflow++;
+        return;
+    }
+
+    ThreadRecord::Node &current = record->nodes[record->current];
+    uint16_t index = current.children[phase];
+    if (EXPECT_NOT_TAKEN(index == 0)) {
+        if (record->nodeCount == MTS_PROFILER_MAX_NODES) {
+            record->overflow++;
+            return;
+        }
+        index = (uint16_t) record->nodeCount;
+        ThreadRecord::Node &node = record->nodes[index];
+        node.parent = (uint16_t) record->current;
+        node.phase = (uint16_t) phase;
+        current.children[phase] = index;
+        record->nodeCount = index + 1;
+    }
+
+    record->current = index;
+    record->nodes[index].start = rdtsc();
+}
+
+void Profiler::leave() {
+    ThreadRecord *record = __profiler_record;
+    if (EXPECT_NOT_TAKEN(record->overflow > 0)) {
+        record->overflow--;
+        return;
+    }
+
+    ThreadRecord::Node &node = record->nodes[record->current];
+    node.ticks += rdtsc() - node.start;
+    node.calls++;
+    record->current = node.parent;
+}
+
+const char *Profiler::getPhaseName(EProfilerPhase phase) {
+    switch (phase) {
+        case EProfilerRender: return "Rendering";
+        case EProfilerRayIntersect: return "Ray intersection";
+        case EProfilerShadowRay: return "Shadow rays";
+        case EProfilerEmitterSample: return "Emitter sampling";
+        case EProfilerBSDFEval: return "BSDF evaluation";
+        case EProfilerBSDFSample: return "BSDF sampling";
+        case EProfilerTextureEval: return "Texture lookups";
+        case EProfilerFilm: return "Film";
+        default: return "Unknown";
+    }
+}
+
+void Profiler::reset() {
+    LockGuard lock(m_mutex);
+    for (size_t i=0; i<m_threads.size(); ++i) {
+        ThreadRecord *record = m_threads[i];
+        for (uint32_t j=0; j<record->nodeCount; ++j)
+            record->nodes[j].ticks = record->nodes[j].calls = 0;
+    }
+}
+
+namespace {
+    /// Call tree node merged over all threads
+    struct MergedNode {
+        uint64_t ticks, calls;
+        int children[EProfilerPhaseCount];
+
+        MergedNode() : ticks(0), calls(0) {
+            for (int i=0; i<EProfilerPhaseCount; ++i)
+                children[i] = -1;
+        }
+    };
+
+    void merge(const Profiler::ThreadRecord::Node *nodes, uint32_t nodeCount,
+            uint32_t index, std::vector<MergedNode> &merged, int target) {
+        merged[target].ticks += nodes[index].ticks;
+        merged[target].calls += nodes[index].calls;
+
+        for (int i=0; i<EProfilerPhaseCount; ++i) {
+            uint32_t child = nodes[index].children[i];
+            if (child == 0 || child >= nodeCount)
+                continue;
+            if (merged[target].children[i] < 0) {
+                merged[target].children[i] = (int) merged.size();
+                merged.push_back(MergedNode());
+            }
+            merge(nodes, nodeCount, child, merged, merged[target].children[i]);
+        }
+    }
+
+    void print(std::ostream &os, const std::vector<MergedNode> &merged,
+            int index, int depth, Float secondsPerTick, uint64_t total) {
+        for (int i=0; i<EProfilerPhaseCount; ++i) {
+            int child = merged[index].children[i];
+            if (child < 0 || merged[child].calls == 0)
+                continue;
+
+            const MergedNode &node = merged[child];
+            uint64_t childTicks = 0;
+            for (int j=0; j<EProfilerPhaseCount; ++j) {
+                if (node.children[j] >= 0)
+                    childTicks += merged[node.children[j]].ticks;
+            }
+            uint64_t selfTicks = node.ticks > childTicks ? node.ticks - childTicks : 0;
+
+            std::string name = std::string(2*depth, ' ')
+                + Profiler::getPhaseName((EProfilerPhase) i);
+            os << "    " << std::left << std::setw(30) << name << std::right
+               << std::setw(10) << timeString(node.ticks * secondsPerTick, true)
+               << std::setw(8) << std::fixed << std::setprecision(1)
+               << (total > 0 ? node.ticks * 100.0 / total : 0.0) << " %"
+               << "  (self " << timeString(selfTicks * secondsPerTick, true)
+               << ", " << node.calls << " calls)" << endl;
+
+            print(os, merged, child, depth + 1, secondsPerTick, total);
+        }
+    }
+}
+
+std::string Profiler::getReport() const {
+    std::vector<MergedNode> merged(1);
+    {
+        LockGuard lock(m_mutex);
+        for (size_t i=0; i<m_threads.size(); ++i) {
+            const ThreadRecord *record = m_threads[i];
+            merge(record->nodes, record->nodeCount, 0, merged, 0);
+        }
+    }
+
+    /* Calibrate the timestamp counter against the system timer */
+    uint64_t elapsedTicks = rdtsc() - m_startTicks;
+    uint64_t elapsedNs = m_timer->getNanoseconds();
+    Float secondsPerTick = elapsedTicks > 0 ?
+        (Float) (elapsedNs * 1e-9 / elapsedTicks) : (Float) 0;
+
+    uint64_t total = 0;
+    for (int i=0; i<EProfilerPhaseCount; ++i) {
+        if (merged[0].children[i] >= 0)
+            total += merged[merged[0].children[i]].ticks;
+    }
+
+    std::ostringstream oss;
+    oss << "Time breakdown (summed over all threads):" << endl;
+    if (total == 0)
+        oss << "    none." << endl;
+    else
+        print(oss, merged, 0, 0, secondsPerTick, total);
+    return oss.str();
+}
+
+void Profiler::printReport() const {
+    Log(EInfo, "Profiler report:\n%s", getReport().c_str());
+}
+
+MTS_IMPLEMENT_CLASS(Profiler, false, Object)
+MTS_NAMESPACE_END
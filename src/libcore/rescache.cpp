@@ -0,0 +1,299 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/rescache.h>
+#include <mitsuba/core/fstream.h>
+#include <boost/filesystem/operations.hpp>
+#include <ctime>
+
+/* Chunk size limits of the content-defined chunking scheme */
+#define MTS_RESCACHE_MIN_CHUNK (32 * 1024)
+#define MTS_RESCACHE_MAX_CHUNK (1024 * 1024)
+
+/* Cut whenever the top 17 bits of the rolling hash are zero
+   (i.e. on average every 128 KiB after the minimum chunk size) */
+#define MTS_RESCACHE_CUT_MASK (0x1FFFFULL << 47)
+
+MTS_NAMESPACE_BEGIN
+
+namespace {
+    inline uint64_t rotl64(uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    inline uint64_t fmix64(uint64_t k) {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+        return k;
+    }
+
+    /// Random lookup table of the "gear" rolling hash used for chunking
+    struct GearTable {
+        uint64_t values[256];
+
+        GearTable() {
+            /* SplitMix64 sequence -- must never change, since
+               it determines the chunk boundaries */
+            uint64_t state = 0x6d697473756261ULL;
+            for (int i=0; i<256; ++i) {
+                uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                values[i] = z ^ (z >> 31);
+            }
+        }
+
+        static const GearTable &get() {
+            static GearTable table;
+            return table;
+        }
+    };
+}
+
+std::string ResourceCache::Hash::toString() const {
+    return formatString("%016llx%016llx", (unsigned long long) hi,
+        (unsigned long long) lo);
+}
+
+/* MurmurHash3 (x64, 128 bit variant) by Austin Appleby */
+ResourceCache::Hash ResourceCache::hash(const void *_data, size_t size) {
+    const uint8_t *data = (const uint8_t *) _data;
+    const size_t nblocks = size / 16;
+    const uint64_t c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+    uint64_t h1 = 0, h2 = 0;
+
+    for (size_t i=0; i<nblocks; ++i) {
+        uint64_t k1, k2;
+        memcpy(&k1, data + 16*i, sizeof(uint64_t));
+        memcpy(&k2, data + 16*i + 8, sizeof(uint64_t));
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1*5 + 0x52dce729;
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2*5 + 0x38495ab5;
+    }
+
+    const uint8_t *tail = data + nblocks*16;
+    uint64_t k1 = 0, k2 = 0;
+    switch (size & 15) {
+        case 15: k2 ^= ((uint64_t) tail[14]) << 48;
+        case 14: k2 ^= ((uint64_t) tail[13]) << 40;
+        case 13: k2 ^= ((uint64_t) tail[12]) << 32;
+        case 12: k2 ^= ((uint64_t) tail[11]) << 24;
+        case 11: k2 ^= ((uint64_t) tail[10]) << 16;
+        case 10: k2 ^= ((uint64_t) tail[ 9]) << 8;
+        case  9: k2 ^= ((uint64_t) tail[ 8]);
+                 k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        case  8: k1 ^= ((uint64_t) tail[ 7]) << 56;
+        case  7: k1 ^= ((uint64_t) tail[ 6]) << 48;
+        case  6: k1 ^= ((uint64_t) tail[ 5]) << 40;
+        case  5: k1 ^= ((uint64_t) tail[ 4]) << 32;
+        case  4: k1 ^= ((uint64_t) tail[ 3]) << 24;
+        case  3: k1 ^= ((uint64_t) tail[ 2]) << 16;
+        case  2: k1 ^= ((uint64_t) tail[ 1]) << 8;
+        case  1: k1 ^= ((uint64_t) tail[ 0]);
+                 k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    };
+
+    h1 ^= (uint64_t) size; h2 ^= (uint64_t) size;
+    h1 += h2; h2 += h1;
+    h1 = fmix64(h1); h2 = fmix64(h2);
+    h1 += h2; h2 += h1;
+
+    Hash result;
+    result.lo = h1;
+    result.hi = h2;
+    return result;
+}
+
+void ResourceCache::split(const void *_data, size_t size, std::vector<Chunk> &chunks) {
+    const uint8_t *data = (const uint8_t *) _data;
+    const uint64_t *gear = GearTable::get().values;
+    size_t start = 0;
+
+    chunks.clear();
+    while (start < size) {
+        size_t remaining = size - start,
+               end = start + std::min(remaining, (size_t) MTS_RESCACHE_MAX_CHUNK),
+               pos = start + std::min(remaining, (size_t) MTS_RESCACHE_MIN_CHUNK);
+
+        uint64_t h = 0;
+        for (; pos < end; ++pos) {
+            h = (h << 1) + gear[data[pos]];
+            if ((h & MTS_RESCACHE_CUT_MASK) == 0) {
+                ++pos;
+                break;
+            }
+        }
+
+        Chunk chunk;
+        chunk.offset = start;
+        chunk.size = pos - start;
+        chunk.hash = hash(data + start, chunk.size);
+        chunks.push_back(chunk);
+        start = pos;
+    }
+}
+
+ResourceCache::ResourceCache(const fs::path &path, size_t maxSize)
+        : m_path(path), m_maxSize(maxSize), m_size(0) {
+    m_mutex = new Mutex();
+
+    if (!fs::exists(m_path))
+        fs::create_directories(m_path);
+    if (!fs::is_directory(m_path))
+        Log(EError, "Resource cache path \"%s\" is not a directory!",
+            m_path.string().c_str());
+
+    trim();
+    Log(EInfo, "Using resource cache \"%s\" (%s of %s used)",
+        m_path.string().c_str(), memString(m_size).c_str(),
+        memString(m_maxSize).c_str());
+}
+
+fs::path ResourceCache::getChunkPath(const Hash &hash) const {
+    std::string name = hash.toString();
+    return m_path / name.substr(0, 2) / (name + ".chunk");
+}
+
+bool ResourceCache::load(const Hash &hash, std::vector<uint8_t> &data) {
+    fs::path path = getChunkPath(hash);
+    if (!fs::exists(path))
+        return false;
+
+    try {
+        ref<FileStream> file = new FileStream(path, FileStream::EReadOnly);
+        file->setByteOrder(Stream::ELittleEndian);
+
+        char identifier[3];
+        file->read(identifier, 3);
+        uint8_t version = file->readUChar();
+        if (identifier[0] != 'R' || identifier[1] != 'E' || identifier[2] != 'S'
+                || version != MTS_RESCACHE_VERSION || Hash(file) != hash)
+            return false;
+
+        size_t size = file->readSize();
+        if (file->getSize() - file->getPos() != size)
+            return false;
+        data.resize(size);
+        if (size > 0)
+            file->read(&data[0], size);
+        file->close();
+
+        /* Guard against silently corrupted files */
+        if (ResourceCache::hash(data.empty() ? NULL : &data[0], size) != hash) {
+            Log(EWarn, "Removing corrupted cache entry \"%s\"", path.string().c_str());
+            fs::remove(path);
+            return false;
+        }
+
+        /* Mark as recently used */
+        fs::last_write_time(path, std::time(NULL));
+        return true;
+    } catch (const std::exception &ex) {
+        Log(EWarn, "Could not read cache entry \"%s\": %s",
+            path.string().c_str(), ex.what());
+        return false;
+    }
+}
+
+void ResourceCache::store(const Hash &hash, const void *data, size_t size) {
+    fs::path path = getChunkPath(hash);
+    if (fs::exists(path))
+        return;
+
+    fs::path tmpPath = path.parent_path()
+        / fs::unique_path("chunk_%%%%%%%%%%%%.tmp");
+
+    try {
+        if (!fs::exists(path.parent_path()))
+            fs::create_directories(path.parent_path());
+
+        ref<FileStream> file = new FileStream(tmpPath, FileStream::ETruncWrite);
+        file->setByteOrder(Stream::ELittleEndian);
+        file->write("RES", 3);
+        file->writeUChar(MTS_RESCACHE_VERSION);
+        hash.serialize(file);
+        file->writeSize(size);
+        file->write(data, size);
+        size_t fileSize = (size_t) file->getPos();
+        file->close();
+        fs::rename(tmpPath, path);
+
+        LockGuard lock(m_mutex);
+        m_size += fileSize;
+        if (m_size > m_maxSize)
+            trim();
+    } catch (const std::exception &ex) {
+        Log(EWarn, "Could not write cache entry \"%s\": %s",
+            path.string().c_str(), ex.what());
+        if (fs::exists(tmpPath))
+            fs::remove(tmpPath);
+    }
+}
+
+void ResourceCache::trim() {
+    LockGuard lock(m_mutex);
+    typedef std::pair<std::time_t, std::pair<fs::path, size_t> > Entry;
+    std::vector<Entry> entries;
+    size_t totalSize = 0;
+
+    for (fs::recursive_directory_iterator it(m_path), end; it != end; ++it) {
+        const fs::path &path = it->path();
+        if (!fs::is_regular_file(path) || path.extension() != ".chunk")
+            continue;
+        size_t size = (size_t) fs::file_size(path);
+        entries.push_back(Entry(fs::last_write_time(path),
+            std::make_pair(path, size)));
+        totalSize += size;
+    }
+
+    if (totalSize > m_maxSize) {
+        /* Evict the least recently used entries. Leave some headroom so
+           that the cache is not trimmed again after every insertion */
+        size_t target = m_maxSize - m_maxSize / 10, removed = 0;
+        std::sort(entries.begin(), entries.end());
+        for (size_t i=0; i<entries.size() && totalSize > target; ++i) {
+            boost::system::error_code ec;
+            fs::remove(entries[i].second.first, ec);
+            if (ec)
+                continue;
+            totalSize -= entries[i].second.second;
+            ++removed;
+        }
+        Log(EDebug, "Evicted %i entries from the resource cache (%s remaining)",
+            (int) removed, memString(totalSize).c_str());
+    }
+    m_size = totalSize;
+}
+
+std::string ResourceCache::toString() const {
+    std::ostringstream oss;
+    oss << "ResourceCache[" << endl
+        << "  path = \"" << m_path.string() << "\"," << endl
+        << "  size = " << memString(getSize()) << "," << endl
+        << "  maxSize = " << memString(m_maxSize) << endl
+        << "]";
+    return oss.str();
+}
+
+MTS_IMPLEMENT_CLASS(ResourceCache, false, Object)
+MTS_NAMESPACE_END
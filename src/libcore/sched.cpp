@@ -19,11 +19,53 @@
 #include <mitsuba/core/sched.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/mstream.h>
+#include <mitsuba/core/statistics.h>
+#include <mitsuba/core/atomic.h>
+#include <mitsuba/core/timer.h>
 
 #include <boost/thread/thread.hpp>
 
 MTS_NAMESPACE_BEGIN
 
+/* Scheduling overheads. These are created on first use, since libcore's
+   static Statistics instance might not exist yet when this file's static
+   initializers run. */
+struct SchedulerStatistics {
+    StatsCounter acquireTime;
+    StatsCounter releaseTime;
+    StatsCounter stolenUnits;
+    StatsCounter batchSize;
+
+    SchedulerStatistics()
+        : acquireTime("Scheduler", "Avg. time to acquire a local work unit (ns)", EAverage),
+          releaseTime("Scheduler", "Avg. time to release a local work unit (ns)", EAverage),
+          stolenUnits("Scheduler", "Stolen work units", EPercentage),
+          batchSize("Scheduler", "Avg. work units per central queue access", EAverage) { }
+
+    static SchedulerStatistics &get() {
+        static SchedulerStatistics stats;
+        return stats;
+    }
+};
+
+/// Spin lock protecting a local work queue (these are rarely contended)
+static inline void lockQueue(Scheduler::LocalQueue *queue) {
+    int spins = 0;
+    while (queue->lock != 0 || !atomicCompareAndExchange(&queue->lock, 1, 0)) {
+        if (++spins < 64) {
+            #if (defined(__i386__) || defined(__amd64__))
+                __asm__ __volatile__ ("pause\n");
+            #endif
+        } else {
+            Thread::yield();
+        }
+    }
+}
+
+static inline void unlockQueue(Scheduler::LocalQueue *queue) {
+    atomicCompareAndExchange(&queue->lock, 0, 1);
+}
+
 SerializableObject *WorkProcessor::getResource(const std::string &name) {
     if (m_resources.find(name) == m_resources.end())
         Log(EError, "Could not find a resource named \"%s\"!", name.c_str());
@@ -41,6 +83,9 @@ std::vector<std::string> ParallelProcess::getRequiredPlugins() {
 void ParallelProcess::handleCancellation() {
 }
 
+void ParallelProcess::handleWorkBegin(const WorkUnit *unit, int worker) {
+}
+
 bool ParallelProcess::isLocal() const {
     return false;
 }
@@ -56,7 +101,11 @@ Scheduler::Scheduler() {
     m_workAvailable = new ConditionVariable(m_mutex);
     m_resourceCounter = 0;
     m_processCounter = 0;
+    m_queuedUnits = 0;
+    m_idleWorkers = 0;
+    m_batchSize = 4;
     m_running = false;
+    m_resourceReplication = false;
 }
 
 Scheduler::~Scheduler() {
@@ -105,6 +154,13 @@ size_t Scheduler::getLocalWorkerCount() const {
     return count;
 }
 
+void Scheduler::setBatchSize(int batchSize) {
+    if (batchSize < 1)
+        Log(EError, "setBatchSize(): the batch size must be at least 1!");
+    LockGuard lock(m_mutex);
+    m_batchSize = batchSize;
+}
+
 bool Scheduler::isBusy() const {
     bool result;
     LockGuard lock(m_mutex); // make valgrind/helgrind happy
@@ -119,7 +175,7 @@ int Scheduler::registerResource(SerializableObject *object) {
     if (hasRemoteWorkers()) {
         ref<InstanceManager> manager = new InstanceManager();
         rec->stream = new MemoryStream();
-        rec->stream->setByteOrder(Stream::ENetworkByteOrder);
+        rec->stream->setByteOrder(MTS_RESOURCE_BYTE_ORDER);
         manager->serialize(rec->stream, rec->resources[0]);
     }
     m_resources[resourceID] = rec;
@@ -135,11 +191,17 @@ int Scheduler::registerResource(SerializableObject *object) {
 }
 
 int Scheduler::registerMultiResource(std::vector<SerializableObject *> &objects) {
+    return registerMultiResource(objects, false);
+}
+
+int Scheduler::registerMultiResource(std::vector<SerializableObject *> &objects, bool nodeLocal) {
     if (objects.size() != getCoreCount())
         Log(EError, "registerMultiResource() : resource vector does not have the right size!");
     LockGuard lock(m_mutex);
     int resourceID = m_resourceCounter++;
     ResourceRecord *rec = new ResourceRecord(objects);
+    rec->nodeLocal = nodeLocal;
+    rec->localized.resize(objects.size(), false);
     m_resources[resourceID] = rec;
     for (size_t i=0; i<objects.size(); ++i)
         objects[i]->incRef();
@@ -149,6 +211,13 @@ int Scheduler::registerMultiResource(std::vector<SerializableObject *> &objects)
     return resourceID;
 }
 
+int Scheduler::registerReplicatedResource(SerializableObject *object) {
+    int resourceID = registerResource(object);
+    LockGuard lock(m_mutex);
+    m_resources[resourceID]->replicated = true;
+    return resourceID;
+}
+
 void Scheduler::retainResource(int id) {
     LockGuard lock(m_mutex);
     if (m_resources.find(id) == m_resources.end()) {
@@ -171,6 +240,10 @@ bool Scheduler::unregisterResource(int id) {
 #endif
         for (size_t i=0; i<rec->resources.size(); ++i)
             rec->resources[i]->decRef();
+        for (size_t i=0; i<rec->replicas.size(); ++i) {
+            if (rec->replicas[i])
+                rec->replicas[i]->decRef();
+        }
         m_resources.erase(id);
         delete rec;
         for (size_t i=0; i<m_workers.size(); ++i)
@@ -199,6 +272,68 @@ SerializableObject *Scheduler::getResource(int id, int coreIndex) {
     return result;
 }
 
+/// Create a deep copy of a resource, which is allocated by the calling thread
+static ref<SerializableObject> copyResource(SerializableObject *resource) {
+    ref<MemoryStream> mstream = new MemoryStream();
+    ref<InstanceManager> manager = new InstanceManager();
+    manager->serialize(mstream, resource);
+    mstream->seek(0);
+    manager = new InstanceManager();
+    /* The instance manager releases its references when destroyed */
+    ref<SerializableObject> copy = manager->getInstance(mstream);
+    return copy;
+}
+
+SerializableObject *Scheduler::getLocalResource(int id, int coreIndex, int node) {
+    UniqueLock lock(m_mutex);
+    std::map<int, ResourceRecord *>::iterator it = m_resources.find(id);
+    if (it == m_resources.end())
+        Log(EError, "getLocalResource(): could not find the resource with ID %i!", id);
+    ResourceRecord *rec = (*it).second;
+
+    bool replicate = node >= 0 && (rec->multi ? (rec->nodeLocal && !rec->localized.at(coreIndex))
+        : (rec->replicated && m_resourceReplication));
+    if (!replicate)
+        return getResource(id, coreIndex);
+
+    if (rec->multi) {
+        /* Only this worker uses the instance -- copy it right away */
+        ref<SerializableObject> copyRef = copyResource(rec->resources[coreIndex]);
+        SerializableObject *copy = copyRef.get();
+        copy->incRef();
+        rec->resources[coreIndex]->decRef();
+        rec->resources[coreIndex] = copy;
+        rec->localized[coreIndex] = true;
+        return copy;
+    }
+
+    if (rec->replicas.size() <= (size_t) node)
+        rec->replicas.resize(node + 1, NULL);
+    if (rec->replicas[node])
+        return rec->replicas[node];
+
+    /* Unserializing e.g. a scene can take a while -- release the lock.
+       The calling process holds a reference to the resource. */
+    SerializableObject *original = rec->resources[0];
+    original->incRef();
+    lock.unlock();
+    Log(EDebug, "Replicating resource %i (%s) on NUMA node %i", id,
+        original->getClass()->getName().c_str(), node);
+    ref<SerializableObject> copyRef = copyResource(original);
+    SerializableObject *copy = copyRef.get();
+    copy->incRef();
+    lock.lock();
+    original->decRef();
+
+    if (rec->replicas[node]) {
+        /* Another worker of this node was faster */
+        copy->decRef();
+        return rec->replicas[node];
+    }
+    rec->replicas[node] = copy;
+    return copy;
+}
+
 bool Scheduler::isMultiResource(int id) const {
     LockGuard lock(m_mutex);
     std::map<int, ResourceRecord *>::const_iterator it = m_resources.find(id);
@@ -223,7 +358,7 @@ const MemoryStream *Scheduler::getResourceStream(int id) {
     if (!rec->stream) {
         ref<InstanceManager> manager = new InstanceManager();
         rec->stream = new MemoryStream();
-        rec->stream->setByteOrder(Stream::ENetworkByteOrder);
+        rec->stream->setByteOrder(MTS_RESOURCE_BYTE_ORDER);
         manager->serialize(rec->stream, rec->resources[0]);
     }
     return rec->stream;
@@ -375,9 +510,15 @@ bool Scheduler::cancel(ParallelProcess *process, bool reduceInflight) {
     Log(rec->logLevel, "Cancelling process %i (%i work units in flight)..", rec->id, rec->inflight);
 #endif
 
+    /* Local workers check this flag before starting a queued work unit */
+    rec->cancelled = true;
+
     for (size_t i=0; i<m_workers.size(); ++i)
         m_workers[i]->signalProcessCancellation(rec->id);
 
+    /* Drop work units that were generated ahead of time */
+    purgeLocalWork(rec);
+
     /* Ensure that this process won't be scheduled again */
     m_localQueue.erase(std::remove(m_localQueue.begin(), m_localQueue.end(), rec->id),
         m_localQueue.end());
@@ -387,7 +528,6 @@ bool Scheduler::cancel(ParallelProcess *process, bool reduceInflight) {
     /* Ensure that the process won't be considered 'done' when the
        last in-flight work unit is returned */
     rec->morework = true;
-    rec->cancelled = true;
 
     /* Now wait until no more work from this process circulates and release
        the lock while waiting. */
@@ -426,6 +566,9 @@ bool Scheduler::cancel(ParallelProcess *process, bool reduceInflight) {
 
 Scheduler::EStatus Scheduler::acquireWork(Item &item,
         bool local, bool onlyTry, bool keepLock) {
+    if (local && item.queue && !keepLock)
+        return acquireLocalWork(item);
+
     UniqueLock lock(m_mutex);
     std::deque<int> &queue = local ? m_localQueue : m_remoteQueue;
     while (true) {
@@ -495,6 +638,261 @@ Scheduler::EStatus Scheduler::acquireWork(Item &item,
     return EOK;
 }
 
+Scheduler::EStatus Scheduler::acquireLocalWork(Item &item) {
+    SchedulerStatistics &stats = SchedulerStatistics::get();
+    item.idleTime = 0;
+
+    /* Recycle the previous work unit */
+    if (item.workUnit && item.unitPool.size() < (size_t) (2 * m_batchSize))
+        item.unitPool.push_back(item.workUnit);
+    item.workUnit = NULL;
+
+    while (true) {
+        QueuedUnit unit;
+        LocalQueue *queue = item.queue;
+
+        /* Units in the worker's own queue are already in flight and
+           must be processed even when the scheduler is shutting down */
+        if (queue->size > 0) {
+            lockQueue(queue);
+            if (!queue->units.empty()) {
+                unit = queue->units.front();
+                queue->units.pop_front();
+                queue->size = (int32_t) queue->units.size();
+            }
+            unlockQueue(queue);
+        }
+
+        if (unit.workUnit) {
+            atomicAdd(&m_queuedUnits, -1);
+            stats.stolenUnits.incrementBase();
+        } else if (!m_running) {
+            return EStop;
+        } else if (stealLocalWork(item, unit)) {
+            ++stats.stolenUnits;
+            stats.stolenUnits.incrementBase();
+        } else {
+            EStatus status = generateLocalWork(item, unit);
+            if (status == ENone) {
+                /* Another worker still has queued units -- try to steal them */
+                Thread::yield();
+                continue;
+            } else if (status != EOK) {
+                return status;
+            }
+            stats.stolenUnits.incrementBase();
+        }
+
+        if (unit.id != item.id) {
+            /* The unit belongs to a different process -- prepare a matching
+               work processor. The process can't disappear while one of
+               its work units is still in flight. */
+            UniqueLock lock(m_mutex);
+            ParallelProcess *proc = m_idToProcess[unit.id];
+            ProcessRecord *rec = m_processes[proc];
+            if (!rec->cancelled) {
+                try {
+                    setProcessByID(item, unit.id);
+                    item.unitPool.clear();
+                } catch (const std::exception &ex) {
+                    Log(EWarn, "Caught an exception - canceling process %i: %s",
+                        unit.id, ex.what());
+                    item.id = -1;
+                    --rec->inflight;
+                    lock.unlock();
+                    cancel(proc);
+                    continue;
+                }
+            }
+            if (rec->cancelled) {
+                --rec->inflight;
+                rec->cond->signal();
+                continue;
+            }
+        } else if (item.rec->cancelled) {
+            /* Discard units of processes that were cancelled in the meantime */
+            LockGuard lock(m_mutex);
+            --item.rec->inflight;
+            item.rec->cond->signal();
+            continue;
+        }
+
+        item.workUnit = unit.workUnit;
+        item.stop = false;
+        return EOK;
+    }
+}
+
+Scheduler::EStatus Scheduler::generateLocalWork(Item &item, QueuedUnit &unit) {
+    UniqueLock lock(m_mutex);
+    std::vector<QueuedUnit> batch;
+
+    while (true) {
+        /* Wait until work is available and return if stop() is called */
+        if (m_localQueue.size() == 0 && m_queuedUnits == 0 && m_running) {
+            ref<Timer> timer = new Timer();
+            m_idleWorkers++;
+            while (m_localQueue.size() == 0 && m_queuedUnits == 0 && m_running)
+                m_workAvailable->wait();
+            m_idleWorkers--;
+            item.idleTime += timer->getNanoseconds();
+        }
+
+        if (!m_running)
+            return EStop;
+        else if (m_localQueue.size() == 0)
+            return ENone;
+
+        ParallelProcess::EStatus wStatus = ParallelProcess::ESuccess;
+        try {
+            int id = m_localQueue.front();
+            if (item.id != id) {
+                setProcessByID(item, id);
+                item.unitPool.clear();
+                item.unitPool.push_back(item.workUnit);
+                item.workUnit = NULL;
+            }
+
+            while ((int) batch.size() < m_batchSize) {
+                ref<WorkUnit> workUnit;
+                if (item.unitPool.empty()) {
+                    workUnit = item.wp->createWorkUnit();
+                } else {
+                    workUnit = item.unitPool.back();
+                    item.unitPool.pop_back();
+                }
+
+                wStatus = item.proc->generateWork(workUnit, item.workerIndex);
+                if (wStatus != ParallelProcess::ESuccess) {
+                    item.unitPool.push_back(workUnit);
+                    break;
+                }
+                item.rec->inflight++;
+                batch.push_back(QueuedUnit(id, workUnit));
+            }
+        } catch (const std::exception &ex) {
+            Log(EWarn, "Caught an exception - canceling process %i: %s",
+                item.id, ex.what());
+            /* Park the units generated so far in the worker's own
+               queue, where the cancellation will find them */
+            lockQueue(item.queue);
+            item.queue->units.insert(item.queue->units.end(), batch.begin(), batch.end());
+            item.queue->size = (int32_t) item.queue->units.size();
+            unlockQueue(item.queue);
+            atomicAdd(&m_queuedUnits, (int32_t) batch.size());
+            batch.clear();
+            cancel(item.proc);
+            continue;
+        }
+
+        if (wStatus == ParallelProcess::EFailure) {
+#if defined(DEBUG_SCHED)
+            if (item.rec->morework)
+                Log(item.rec->logLevel, "Process %i has finished generating work", item.rec->id);
+#endif
+            item.rec->morework = false;
+            item.rec->active = false;
+            m_localQueue.pop_front();
+            if (item.rec->inflight == 0)
+                signalProcessTermination(item.proc, item.rec);
+        } else if (wStatus == ParallelProcess::EPause) {
+#if defined(DEBUG_SCHED)
+            Log(item.rec->logLevel, "Pausing process %i", item.rec->id);
+#endif
+            item.rec->active = false;
+            m_localQueue.pop_front();
+        }
+
+        if (!batch.empty())
+            break;
+    }
+
+    SchedulerStatistics &stats = SchedulerStatistics::get();
+    stats.batchSize += batch.size();
+    stats.batchSize.incrementBase();
+
+    unit = batch[0];
+    if (batch.size() > 1) {
+        lockQueue(item.queue);
+        item.queue->units.insert(item.queue->units.end(), batch.begin() + 1, batch.end());
+        item.queue->size = (int32_t) item.queue->units.size();
+        unlockQueue(item.queue);
+        atomicAdd(&m_queuedUnits, (int32_t) batch.size() - 1);
+
+        /* Let idle workers steal the surplus */
+        if (m_idleWorkers > 0)
+            m_workAvailable->broadcast();
+    }
+
+    return EOK;
+}
+
+bool Scheduler::stealLocalWork(Item &item, QueuedUnit &unit) {
+    size_t queueCount = m_localWorkQueues.size();
+    if (m_queuedUnits == 0 || queueCount < 2)
+        return false;
+
+    /* Visit the other queues starting from a random victim (xorshift) */
+    uint32_t &state = item.stealState;
+    state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+    size_t start = state % queueCount;
+
+    std::vector<QueuedUnit> stolen;
+    for (size_t i=0; i<queueCount; ++i) {
+        LocalQueue *victim = m_localWorkQueues[(start + i) % queueCount];
+        if (victim == item.queue || victim->size == 0)
+            continue;
+
+        lockQueue(victim);
+        size_t count = (victim->units.size() + 1) / 2;
+        if (count > 0) {
+            stolen.insert(stolen.end(), victim->units.end() - count, victim->units.end());
+            victim->units.erase(victim->units.end() - count, victim->units.end());
+            victim->size = (int32_t) victim->units.size();
+        }
+        unlockQueue(victim);
+
+        if (count > 0)
+            break;
+    }
+
+    if (stolen.empty())
+        return false;
+
+    unit = stolen[0];
+    atomicAdd(&m_queuedUnits, -1);
+    if (stolen.size() > 1) {
+        lockQueue(item.queue);
+        item.queue->units.insert(item.queue->units.end(), stolen.begin() + 1, stolen.end());
+        item.queue->size = (int32_t) item.queue->units.size();
+        unlockQueue(item.queue);
+    }
+    return true;
+}
+
+void Scheduler::purgeLocalWork(ProcessRecord *rec) {
+    for (size_t i=0; i<m_localWorkQueues.size(); ++i) {
+        LocalQueue *queue = m_localWorkQueues[i];
+        lockQueue(queue);
+        size_t size = queue->units.size();
+        for (std::deque<QueuedUnit>::iterator it = queue->units.begin();
+                it != queue->units.end();) {
+            if (it->id == rec->id)
+                it = queue->units.erase(it);
+            else
+                ++it;
+        }
+        int32_t removed = (int32_t) (size - queue->units.size());
+        queue->size = (int32_t) queue->units.size();
+        unlockQueue(queue);
+
+        if (removed > 0) {
+            rec->inflight -= removed;
+            atomicAdd(&m_queuedUnits, -removed);
+        }
+    }
+}
+
 void Scheduler::signalProcessTermination(ParallelProcess *proc, ProcessRecord *rec) {
 #if defined(DEBUG_SCHED)
     Log(rec->logLevel, "Process %i is complete.", rec->id);
@@ -529,6 +927,38 @@ void Scheduler::start() {
     if (m_workers.size() == 0)
         Log(EError, "Cannot start the scheduler - there are no registered workers!");
 
+    /* Create a work queue for each local worker. On NUMA machines, also
+       restrict each worker to a node, unless it is pinned to a core.
+       Unpinned workers are assigned to the nodes in round-robin order. */
+    UniqueLock lock(m_mutex);
+    int nodeCount = getNUMANodeCount(), unpinnedIndex = 0;
+    m_queuedUnits = 0;
+    for (size_t i=0; i<m_workers.size(); ++i) {
+        Worker *worker = m_workers[i];
+        if (worker->isRemoteWorker())
+            continue;
+        LocalQueue *queue = new LocalQueue();
+        m_localWorkQueues.push_back(queue);
+        worker->m_schedItem.queue = queue;
+        worker->m_schedItem.stealState = 2654435761U * (uint32_t) (i + 1);
+        worker->m_schedItem.node = -1;
+
+        if (nodeCount > 1) {
+            int core = worker->getCoreAffinity(), node;
+            if (core != -1) {
+                node = getCoreNUMANode(core);
+            } else {
+                node = unpinnedIndex++ % nodeCount;
+                if (worker->getNUMANode() == -1)
+                    worker->setNUMANode(node);
+                else
+                    node = worker->getNUMANode();
+            }
+            worker->m_schedItem.node = node;
+        }
+    }
+    lock.unlock();
+
     int coreIndex = 0;
     for (size_t i=0; i<m_workers.size(); ++i) {
         m_workers[i]->start(this, (int) i, coreIndex);
@@ -552,6 +982,11 @@ void Scheduler::pause() {
     /* Decrement reference counts to any referenced objects */
     for (size_t i=0; i<m_workers.size(); ++i)
         m_workers[i]->clear();
+    /* The workers drained their queues before exiting */
+    lock.lock();
+    for (size_t i=0; i<m_localWorkQueues.size(); ++i)
+        delete m_localWorkQueues[i];
+    m_localWorkQueues.clear();
 }
 
 void Scheduler::stop() {
@@ -576,6 +1011,10 @@ void Scheduler::stop() {
         ResourceRecord *rec = (*it).second;
         for (size_t i=0; i<rec->resources.size(); ++i)
             rec->resources[i]->decRef();
+        for (size_t i=0; i<rec->replicas.size(); ++i) {
+            if (rec->replicas[i])
+                rec->replicas[i]->decRef();
+        }
         delete rec;
     }
     m_resources.clear();
@@ -622,6 +1061,8 @@ void Worker::clear() {
     m_schedItem.workUnit = NULL;
     m_schedItem.workResult = NULL;
     m_schedItem.id = -1;
+    m_schedItem.queue = NULL;
+    m_schedItem.unitPool.clear();
 }
 
 void Worker::start(Scheduler *scheduler, int workerIndex, int coreOffset) {
@@ -647,8 +1088,17 @@ LocalWorker::~LocalWorker() {
 }
 
 void LocalWorker::run() {
-    while (acquireWork(true) != Scheduler::EStop) {
+    SchedulerStatistics &stats = SchedulerStatistics::get();
+    ref<Timer> timer = new Timer();
+    while (true) {
+        timer->reset();
+        if (acquireWork(true) == Scheduler::EStop)
+            break;
+        stats.acquireTime += (size_t) (timer->getNanoseconds() - m_schedItem.idleTime);
+        stats.acquireTime.incrementBase();
+
         try {
+            m_schedItem.proc->handleWorkBegin(m_schedItem.workUnit, m_schedItem.workerIndex);
             m_schedItem.wp->process(m_schedItem.workUnit, m_schedItem.workResult, m_schedItem.stop);
         } catch (const std::exception &ex) {
             m_schedItem.stop = true;
@@ -660,7 +1110,10 @@ void LocalWorker::run() {
             cancel(false);
             continue;
         }
+        timer->reset();
         releaseWork(m_schedItem);
+        stats.releaseTime += (size_t) timer->getNanoseconds();
+        stats.releaseTime.incrementBase();
     }
 }
 
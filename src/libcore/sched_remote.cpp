@@ -19,6 +19,7 @@
 #include <mitsuba/core/sched_remote.h>
 #include <mitsuba/core/sstream.h>
 #include <mitsuba/core/mstream.h>
+#include <mitsuba/core/zstream.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/version.h>
 
@@ -38,18 +39,99 @@ private:
     ref<ParallelProcess> m_proc;
 };
 
-RemoteWorker::RemoteWorker(const std::string &name, Stream *stream) : Worker(name), m_stream(stream) {
-    const size_t dataLength = strlen(MTS_VERSION)+3;
-    char *data = (char *) alloca(dataLength);
-    strncpy(data, MTS_VERSION, strlen(MTS_VERSION)+1);
-    data[dataLength-2] = SPECTRUM_SAMPLES;
+/// Transmits the messages queued by a \ref StreamBackend
+class StreamBackendWriter : public Thread {
+public:
+    StreamBackendWriter(StreamBackend *backend)
+        : Thread(formatString("%s_w", backend->getName().c_str())), m_backend(backend) { }
+
+    void run() {
+        m_backend->writeMessages();
+    }
+protected:
+    virtual ~StreamBackendWriter() { }
+private:
+    StreamBackend *m_backend;
+};
+
+/**
+ * Data sent by a client after \c EHello: the program version and protocol
+ * revision (fixed width) followed by the spectral and floating point
+ * configuration. Peers which predate the protocol revision send the version
+ * string directly followed by a null character, hence they already differ
+ * within the first <tt>strlen(MTS_VERSION)+1</tt> bytes.
+ */
+static std::string getHandshakeData() {
+    std::string data = formatString("%s/%04i", MTS_VERSION, MTS_PROTOCOL_VERSION);
+    data.push_back('\0');
+    data.push_back((char) SPECTRUM_SAMPLES);
 #ifdef DOUBLE_PRECISION
-    data[dataLength-1] = 1;
+    data.push_back(1);
 #else
-    data[dataLength-1] = 0;
+    data.push_back(0);
 #endif
+    return data;
+}
+
+/* Work results mostly consist of floating point values. Grouping
+   their bytes by significance makes them much more compressible */
+static void shuffleBytes(const uint8_t *src, uint8_t *dst, size_t size, bool inverse) {
+    const size_t stride = sizeof(Float), count = size / stride;
+    for (size_t i=0; i<count; ++i) {
+        for (size_t j=0; j<stride; ++j) {
+            if (!inverse)
+                dst[j*count + i] = src[i*stride + j];
+            else
+                dst[i*stride + j] = src[j*count + i];
+        }
+    }
+    memcpy(dst + count*stride, src + count*stride, size - count*stride);
+}
+
+/// Compress a work result -- returns \c NULL if this does not pay off
+static ref<MemoryStream> compressPayload(const MemoryStream *payload, int level) {
+    size_t size = payload->getPos();
+    if (size < 256)
+        return NULL;
+
+    std::vector<uint8_t> shuffled(size);
+    shuffleBytes(payload->getData(), &shuffled[0], size, false);
+
+    ref<MemoryStream> compressed = new MemoryStream(size / 2);
+    ref<ZStream> zstream = new ZStream(compressed, ZStream::EDeflateStream, level);
+    zstream->write(&shuffled[0], size);
+    zstream = NULL; /* Finishes the deflate stream */
+
+    if (compressed->getPos() >= size)
+        return NULL;
+    return compressed;
+}
+
+/// Read and decompress a work result created by \ref compressPayload()
+static ref<MemoryStream> decompressPayload(Stream *stream) {
+    size_t size = stream->readSize(),
+           compressedSize = stream->readSize();
+
+    ref<MemoryStream> compressed = new MemoryStream(compressedSize);
+    stream->copyTo(compressed, compressedSize);
+    compressed->seek(0);
+
+    std::vector<uint8_t> shuffled(size), data(size);
+    ref<ZStream> zstream = new ZStream(compressed);
+    zstream->read(&shuffled[0], size);
+    shuffleBytes(&shuffled[0], &data[0], size, true);
+
+    ref<MemoryStream> payload = new MemoryStream(size);
+    payload->setByteOrder(Stream::ENetworkByteOrder);
+    payload->write(&data[0], size);
+    payload->seek(0);
+    return payload;
+}
+
+RemoteWorker::RemoteWorker(const std::string &name, Stream *stream) : Worker(name), m_stream(stream) {
+    std::string data = getHandshakeData();
     m_stream->writeShort(StreamBackend::EHello);
-    m_stream->write(data, dataLength);
+    m_stream->write(data.c_str(), data.length());
     m_stream->flush();
 
     int msg = m_stream->readShort();
@@ -61,11 +143,15 @@ RemoteWorker::RemoteWorker(const std::string &name, Stream *stream) : Worker(nam
     m_nodeName = m_stream->readString();
     m_mutex = new Mutex();
     m_finishCond = new ConditionVariable(m_mutex);
+    m_chunkCond = new ConditionVariable(m_mutex);
     m_memStream = new MemoryStream();
     m_memStream->setByteOrder(Stream::ENetworkByteOrder);
     m_reader = new RemoteWorkerReader(this);
     m_reader->start();
     m_inFlight = 0;
+    m_backlogFactor = MTS_BACKLOG_FACTOR;
+    m_compressionLevel = 0;
+    m_connectionLost = false;
     m_isRemote = true;
     Log(EDebug, "Connection to \"%s\" established (%i cores).",
         m_nodeName.c_str(), m_coreCount);
@@ -92,9 +178,21 @@ void RemoteWorker::start(Scheduler *scheduler, int workerIndex, int coreOffset)
     m_reader->m_schedItem.coreOffset = coreOffset;
 }
 
+void RemoteWorker::setCompressionLevel(int level) {
+    LockGuard lock(m_mutex);
+    m_compressionLevel = std::max(0, std::min(level, 9));
+    /* Sent along with the next batch of work units */
+    m_memStream->writeShort(StreamBackend::ESetCompression);
+    m_memStream->writeInt(m_compressionLevel);
+}
+
+void RemoteWorker::setBacklogFactor(int factor) {
+    LockGuard lock(m_mutex);
+    m_backlogFactor = (size_t) std::max(factor, 1);
+}
+
 void RemoteWorker::flush() {
-    m_memStream->seek(0);
-    m_memStream->copyTo(m_stream);
+    m_stream->write(m_memStream->getData(), m_memStream->getPos());
     m_memStream->reset();
     m_stream->flush();
 }
@@ -161,22 +259,13 @@ void RemoteWorker::run() {
             manager->serialize(m_memStream, m_schedItem.wp);
             m_processes.insert(id);
 
-            for (size_t i=0; i<resources.size(); ++i) {
-                int resID = resources[i].first;
-                const MemoryStream *resStream = resources[i].second;
-                Log(EDebug, "Sending resource %i to \"%s\" (%i KB)", resID, m_nodeName.c_str(),
-                    resStream->getPos() / 1024);
-                m_memStream->writeShort(StreamBackend::ENewResource);
-                m_memStream->writeInt(resID);
-                m_memStream->writeSize(resStream->getPos());
-                m_memStream->write(resStream->getData(), resStream->getPos());
-            }
+            sendResources(resources);
 
             for (size_t i=0; i<multiResources.size(); i += m_coreCount) {
                 int resID = multiResources[i].first;
                 ref<MemoryStream> resStream = new MemoryStream();
                 ref<InstanceManager> manager = new InstanceManager();
-                resStream->setByteOrder(Stream::ENetworkByteOrder);
+                resStream->setByteOrder(MTS_RESOURCE_BYTE_ORDER);
                 for (size_t j=0; j<m_coreCount; ++j)
                     manager->serialize(resStream, multiResources[i+j].second);
                 Log(EDebug, "Sending multi resource %i to \"%s\" (%i KB)", resID, m_nodeName.c_str(),
@@ -198,23 +287,119 @@ void RemoteWorker::run() {
             releaseSchedulerLock();
         }
 
+        m_schedItem.proc->handleWorkBegin(m_schedItem.workUnit, m_schedItem.workerIndex);
         m_memStream->writeShort(StreamBackend::EWorkUnit);
         m_memStream->writeInt(id);
         m_schedItem.workUnit->save(m_memStream);
 
-        if (++m_inFlight == MTS_BACKLOG_FACTOR * m_coreCount) {
+        if (++m_inFlight >= m_backlogFactor * m_coreCount) {
             flush();
             /* There are now too many packets in transit. Wait
                until this clears up a bit before attempting to
                send more work */
-            while (m_inFlight > MTS_CONTINUE_FACTOR * m_coreCount)
+            size_t continueFactor = m_backlogFactor * MTS_CONTINUE_FACTOR / MTS_BACKLOG_FACTOR;
+            while (m_inFlight > continueFactor * m_coreCount) {
+                if (m_connectionLost)
+                    Log(EError, "Lost the connection to \"%s\"!", m_nodeName.c_str());
                 m_finishCond->wait();
+            }
         }
     }
     LockGuard lock(m_mutex);
     flush();
 }
 
+void RemoteWorker::sendResources(const std::vector<std::pair<int, const MemoryStream *> > &resources) {
+    std::vector<std::vector<ResourceCache::Chunk> > chunks(resources.size());
+    bool query = false;
+
+    /* Ask the remote side which chunks of the larger resources are missing */
+    for (size_t i=0; i<resources.size(); ++i) {
+        int resID = resources[i].first;
+        const MemoryStream *resStream = resources[i].second;
+        if (resStream->getPos() < MTS_RESCACHE_MIN_RESOURCE_SIZE)
+            continue;
+        ResourceCache::split(resStream->getData(), resStream->getPos(), chunks[i]);
+        m_memStream->writeShort(StreamBackend::EQueryResourceChunks);
+        m_memStream->writeInt(resID);
+        m_memStream->writeInt((int) chunks[i].size());
+        for (size_t j=0; j<chunks[i].size(); ++j)
+            chunks[i][j].hash.serialize(m_memStream);
+        query = true;
+    }
+
+    if (query) {
+        flush();
+        for (size_t i=0; i<resources.size(); ++i) {
+            while (!chunks[i].empty() && m_chunkRequests.find(resources[i].first) == m_chunkRequests.end()) {
+                if (m_connectionLost)
+                    Log(EError, "Lost the connection to \"%s\" while waiting for "
+                        "its list of missing resource chunks!", m_nodeName.c_str());
+                m_chunkCond->wait();
+            }
+        }
+    }
+
+    for (size_t i=0; i<resources.size(); ++i) {
+        int resID = resources[i].first;
+        const MemoryStream *resStream = resources[i].second;
+
+        if (chunks[i].empty()) {
+            Log(EDebug, "Sending resource %i to \"%s\" (%i KB)", resID, m_nodeName.c_str(),
+                resStream->getPos() / 1024);
+            m_memStream->writeShort(StreamBackend::ENewResource);
+            m_memStream->writeInt(resID);
+            m_memStream->writeSize(resStream->getPos());
+            m_memStream->write(resStream->getData(), resStream->getPos());
+            continue;
+        }
+
+        std::map<int, std::vector<int> >::iterator it = m_chunkRequests.find(resID);
+        const std::vector<int> &missing = (*it).second;
+        size_t sentBytes = 0;
+
+        m_memStream->writeShort(StreamBackend::ENewChunkedResource);
+        m_memStream->writeInt(resID);
+        m_memStream->writeSize(resStream->getPos());
+        m_memStream->writeInt((int) chunks[i].size());
+        for (size_t j=0, k=0; j<chunks[i].size(); ++j) {
+            const ResourceCache::Chunk &chunk = chunks[i][j];
+            bool send = k < missing.size() && missing[k] == (int) j;
+            chunk.hash.serialize(m_memStream);
+            m_memStream->writeUInt((uint32_t) chunk.size);
+            m_memStream->writeBool(send);
+            if (send) {
+                m_memStream->write(resStream->getData() + chunk.offset, chunk.size);
+                sentBytes += chunk.size;
+                ++k;
+            }
+        }
+
+        Log(EDebug, "Sending resource %i to \"%s\" (%i KB, %i of %i chunks were "
+            "cached remotely, sent %i KB)", resID, m_nodeName.c_str(),
+            resStream->getPos() / 1024, (int) (chunks[i].size() - missing.size()),
+            (int) chunks[i].size(), (int) (sentBytes / 1024));
+        m_chunkRequests.erase(it);
+    }
+}
+
+void RemoteWorker::receiveChunkRequest(int id, Stream *stream) {
+    std::vector<int> missing(stream->readInt());
+    if (!missing.empty())
+        stream->readIntArray(&missing[0], missing.size());
+
+    LockGuard lock(m_mutex);
+    m_chunkRequests[id] = missing;
+    m_chunkCond->broadcast();
+}
+
+void RemoteWorker::signalConnectionLoss() {
+    LockGuard lock(m_mutex);
+    m_connectionLost = true;
+    m_chunkCond->broadcast();
+    m_finishCond->broadcast();
+}
+
 void RemoteWorker::signalResourceExpiration(int id) {
     LockGuard lock(m_mutex);
     if (m_resources.find(id) == m_resources.end()) {
@@ -272,6 +457,12 @@ void RemoteWorkerReader::run() {
             msg = m_stream->readShort();
             id = m_stream->readInt();
 
+            if (msg == StreamBackend::EResourceChunkRequest) {
+                /* Not associated with a process: 'id' refers to a resource */
+                m_parent->receiveChunkRequest(id, m_stream);
+                continue;
+            }
+
             if (id != m_currentID) {
                 m_parent->setProcessByID(m_schedItem, id);
                 m_currentID = id;
@@ -284,6 +475,14 @@ void RemoteWorkerReader::run() {
                     m_parent->releaseWork(m_schedItem);
                     m_parent->signalCompletion();
                     break;
+                case StreamBackend::ECompressedWorkResult: {
+                        ref<MemoryStream> payload = decompressPayload(m_stream);
+                        m_schedItem.workResult->load(payload);
+                        m_schedItem.stop = false;
+                        m_parent->releaseWork(m_schedItem);
+                        m_parent->signalCompletion();
+                    }
+                    break;
                 case StreamBackend::ECancelledWorkResult:
                     m_schedItem.stop = true;
                     m_parent->releaseWork(m_schedItem);
@@ -305,8 +504,11 @@ void RemoteWorkerReader::run() {
                     Log(EError, "Received an unknown message (type %i)", id);
             };
         } catch (std::runtime_error &e) {
-            if (!m_shutdown)
+            if (!m_shutdown) {
+                /* Wake up the worker thread if it is waiting for a reply */
+                m_parent->signalConnectionLoss();
                 throw e;
+            }
             break;
         }
     }
@@ -321,9 +523,11 @@ void RemoteWorkerReader::run() {
 /* ==================================================================== */
 
 StreamBackend::StreamBackend(const std::string &thrName, Scheduler *scheduler,
-        const std::string &nodeName, Stream *stream, bool detach) : Thread(thrName),
-        m_scheduler(scheduler), m_nodeName(nodeName), m_stream(stream), m_detach(detach) {
+        const std::string &nodeName, Stream *stream, bool detach, ResourceCache *cache)
+        : Thread(thrName), m_scheduler(scheduler), m_nodeName(nodeName), m_stream(stream),
+          m_cache(cache), m_writerShutdown(false), m_compressionLevel(0), m_detach(detach) {
     m_sendMutex = new Mutex();
+    m_sendCond = new ConditionVariable(m_sendMutex);
     m_memStream = new MemoryStream();
     m_memStream->setByteOrder(Stream::ENetworkByteOrder);
 }
@@ -345,23 +549,25 @@ void StreamBackend::run() {
         return;
     }
 
-    const size_t dataLength = strlen(MTS_VERSION)+3;
-    char *data    = (char *) alloca(dataLength),
-         *refData = (char *) alloca(dataLength);
-    strncpy(refData, MTS_VERSION, strlen(MTS_VERSION)+1);
-    refData[dataLength-2] = SPECTRUM_SAMPLES;
-#ifdef DOUBLE_PRECISION
-    refData[dataLength-1] = 1;
-#else
-    refData[dataLength-1] = 0;
-#endif
-    m_stream->read(data, dataLength);
+    /* Compare the part that every client sends before reading the
+       remainder, so that outdated clients are rejected instead of
+       blocking the connection */
+    std::string refData = getHandshakeData();
+    const size_t prefixLength = strlen(MTS_VERSION) + 1;
+    std::vector<char> data(refData.length());
+    m_stream->read(&data[0], prefixLength);
+    bool compatible = memcmp(&data[0], refData.c_str(), prefixLength) == 0;
+    if (compatible) {
+        m_stream->read(&data[prefixLength], refData.length() - prefixLength);
+        compatible = memcmp(&data[0], refData.c_str(), refData.length()) == 0;
+    }
 
-    if (memcmp(data, refData, dataLength) != 0) {
+    if (!compatible) {
         m_stream->writeShort(EIncompatible);
         m_stream->flush();
-        Log(EWarn, "The client either the wrong version, or it is compiled "
-            "using different configuration flags -- dropping the connection!");
+        Log(EWarn, "The client either uses a different version or protocol "
+            "revision, or it is compiled using different configuration flags "
+            "-- dropping the connection!");
         return;
     }
 
@@ -374,6 +580,11 @@ void StreamBackend::run() {
     m_stream->flush();
     bool running = true;
 
+    /* From now on, all outgoing messages are sent by a separate thread so
+       that local workers never wait for the network */
+    m_writer = new StreamBackendWriter(this);
+    m_writer->start();
+
     try {
         while (running) {
             msg = m_stream->readShort();
@@ -391,13 +602,66 @@ void StreamBackend::run() {
                 case ENewResource: {
                         int id = m_stream->readInt();
                         size_t size = m_stream->readSize();
-                        ref<InstanceManager> manager = new InstanceManager();
                         ref<MemoryStream> mstream = new MemoryStream(size);
-                        mstream->setByteOrder(Stream::ENetworkByteOrder);
                         m_stream->copyTo(mstream, size);
-                        mstream->seek(0);
-                        ref<SerializableObject> res = static_cast<SerializableObject *>(manager->getInstance(mstream));
-                        m_resources[id] = m_scheduler->registerResource(res);
+                        receiveResource(id, mstream);
+                    }
+                    break;
+                case EQueryResourceChunks: {
+                        int id = m_stream->readInt();
+                        int count = m_stream->readInt();
+                        std::vector<int> missing;
+                        for (int i=0; i<count; ++i) {
+                            ResourceCache::Hash hash(m_stream);
+                            std::map<ResourceCache::Hash, PendingChunk>::iterator it
+                                = m_pendingChunks.find(hash);
+                            if (it != m_pendingChunks.end()) {
+                                (*it).second.uses++;
+                                continue;
+                            }
+                            PendingChunk chunk;
+                            if (m_cache && m_cache->load(hash, chunk.data)) {
+                                chunk.uses = 1;
+                                m_pendingChunks[hash] = chunk;
+                            } else {
+                                missing.push_back(i);
+                            }
+                        }
+                        sendChunkRequest(id, missing);
+                    }
+                    break;
+                case ENewChunkedResource: {
+                        int id = m_stream->readInt();
+                        size_t size = m_stream->readSize(), cached = 0;
+                        int count = m_stream->readInt();
+                        ref<MemoryStream> mstream = new MemoryStream(size);
+                        std::vector<uint8_t> buffer;
+                        for (int i=0; i<count; ++i) {
+                            ResourceCache::Hash hash(m_stream);
+                            uint32_t chunkSize = m_stream->readUInt();
+                            if (m_stream->readBool()) {
+                                buffer.resize(chunkSize);
+                                m_stream->read(&buffer[0], chunkSize);
+                                if (ResourceCache::hash(&buffer[0], chunkSize) != hash)
+                                    Log(EError, "Received a corrupted chunk of resource %i!", id);
+                                mstream->write(&buffer[0], chunkSize);
+                                if (m_cache)
+                                    m_cache->store(hash, &buffer[0], chunkSize);
+                            } else {
+                                std::map<ResourceCache::Hash, PendingChunk>::iterator it
+                                    = m_pendingChunks.find(hash);
+                                if (it == m_pendingChunks.end() || (*it).second.data.size() != chunkSize)
+                                    Log(EError, "Chunk %s of resource %i is unavailable!",
+                                        hash.toString().c_str(), id);
+                                mstream->write(&(*it).second.data[0], chunkSize);
+                                cached += chunkSize;
+                                if (--(*it).second.uses == 0)
+                                    m_pendingChunks.erase(it);
+                            }
+                        }
+                        Log(EDebug, "Received resource %i (%i KB, %i KB of which were cached)",
+                            id, (int) (size / 1024), (int) (cached / 1024));
+                        receiveResource(id, mstream);
                     }
                     break;
                 case ENewMultiResource: {
@@ -405,7 +669,7 @@ void StreamBackend::run() {
                         size_t size = m_stream->readSize();
                         ref<InstanceManager> manager = new InstanceManager();
                         ref<MemoryStream> mstream = new MemoryStream(size);
-                        mstream->setByteOrder(Stream::ENetworkByteOrder);
+                        mstream->setByteOrder(MTS_RESOURCE_BYTE_ORDER);
                         m_stream->copyTo(mstream, size);
                         mstream->seek(0);
                         size_t coreCount = m_scheduler->getCoreCount();
@@ -461,6 +725,10 @@ void StreamBackend::run() {
                         m_resources.erase(id);
                     }
                     break;
+                case ESetCompression:
+                    m_compressionLevel = std::max(0, std::min(m_stream->readInt(), 9));
+                    Log(EDebug, "Work results will be compressed (level %i)", m_compressionLevel);
+                    break;
                 case EQuit: running = false; break;
                 default: Log(EError, "Received an unknown message type: %i", msg);
             }
@@ -486,6 +754,14 @@ void StreamBackend::run() {
         m_scheduler->unregisterResource((*it).second);
     }
 
+    /* Send any remaining messages and shut down the writer thread */
+    {
+        LockGuard lock(m_sendMutex);
+        m_writerShutdown = true;
+        m_sendCond->broadcast();
+    }
+    m_writer->join();
+
     if (m_stream->getClass()->derivesFrom(MTS_CLASS(SocketStream))) {
         SocketStream *sstream = static_cast<SocketStream *>(m_stream.get());
         Log(EInfo, "Closing connection to %s - received %i KB / sent %i KB",
@@ -494,43 +770,119 @@ void StreamBackend::run() {
     }
 }
 
+void StreamBackend::receiveResource(int id, MemoryStream *mstream) {
+    ref<InstanceManager> manager = new InstanceManager();
+    mstream->setByteOrder(MTS_RESOURCE_BYTE_ORDER);
+    mstream->seek(0);
+    ref<SerializableObject> res = static_cast<SerializableObject *>(manager->getInstance(mstream));
+    m_resources[id] = m_scheduler->registerResource(res);
+}
+
+void StreamBackend::sendChunkRequest(int id, const std::vector<int> &missing) {
+    ref<MemoryStream> message = new MemoryStream();
+    message->setByteOrder(Stream::ENetworkByteOrder);
+    message->writeShort(EResourceChunkRequest);
+    message->writeInt(id);
+    message->writeInt((int) missing.size());
+    if (!missing.empty())
+        message->writeIntArray(&missing[0], missing.size());
+    enqueueMessage(message, false);
+}
+
 void StreamBackend::sendCancellation(int id, int numLost) {
     Log(EInfo, "Notifying the remote side about the cancellation of process %i", id);
 
-    LockGuard lock(m_sendMutex);
-    m_memStream->reset();
-    m_memStream->writeShort(EProcessCancelled);
-    m_memStream->writeInt(id);
+    ref<MemoryStream> message = new MemoryStream();
+    message->setByteOrder(Stream::ENetworkByteOrder);
+    message->writeShort(EProcessCancelled);
+    message->writeInt(id);
     for (int i=0; i<numLost; ++i) {
-        m_memStream->writeShort(ECancelledWorkResult);
-        m_memStream->writeInt(id);
-    }
-    try {
-        m_memStream->seek(0);
-        m_memStream->copyTo(m_stream);
-        m_stream->flush();
-    } catch (std::exception &) {
-        Log(EWarn, "Connection error - could not submit cancellation notification");
-        /* A connection failure occurred - this will eventually be
-           caught and handled in run() and is therefore ignored for now */
+        message->writeShort(ECancelledWorkResult);
+        message->writeInt(id);
     }
+    enqueueMessage(message, false);
 }
 
 void StreamBackend::sendWorkResult(int id, const WorkResult *result, bool cancelled) {
+    ref<MemoryStream> message = new MemoryStream();
+    message->setByteOrder(Stream::ENetworkByteOrder);
+
+    if (cancelled) {
+        message->writeShort(ECancelledWorkResult);
+        message->writeInt(id);
+    } else if (m_compressionLevel > 0) {
+        ref<MemoryStream> payload = new MemoryStream();
+        payload->setByteOrder(Stream::ENetworkByteOrder);
+        result->save(payload);
+
+        /* Compress on the worker thread, which scales with the core count */
+        ref<MemoryStream> compressed = compressPayload(payload, m_compressionLevel);
+        if (compressed) {
+            message->writeShort(ECompressedWorkResult);
+            message->writeInt(id);
+            message->writeSize(payload->getPos());
+            message->writeSize(compressed->getPos());
+            message->write(compressed->getData(), compressed->getPos());
+        } else {
+            message->writeShort(EWorkResult);
+            message->writeInt(id);
+            message->write(payload->getData(), payload->getPos());
+        }
+    } else {
+        message->writeShort(EWorkResult);
+        message->writeInt(id);
+        result->save(message);
+    }
+
+    /* Throttle the workers if the network cannot keep up */
+    enqueueMessage(message, true);
+}
+
+void StreamBackend::enqueueMessage(MemoryStream *message, bool throttle) {
     LockGuard lock(m_sendMutex);
-    m_memStream->reset();
-    m_memStream->writeShort(cancelled ? ECancelledWorkResult : EWorkResult);
-    m_memStream->writeInt(id);
-    if (!cancelled)
-        result->save(m_memStream);
-    try {
-        m_memStream->seek(0);
-        m_memStream->copyTo(m_stream);
-        m_stream->flush();
-    } catch (std::exception &) {
-        Log(EWarn, "Connection error - could not submit work result");
-        /* A connection failure occurred - this will eventually be
-           caught and handled in run() and is therefore ignored for now */
+    if (throttle) {
+        size_t maxQueued = 2 * std::max(m_scheduler->getCoreCount(), (size_t) 1);
+        while (m_sendQueue.size() >= maxQueued && !m_writerShutdown)
+            m_sendCond->wait();
+    }
+    if (m_writerShutdown)
+        return;
+    m_sendQueue.push_back(message);
+    m_sendCond->broadcast();
+}
+
+void StreamBackend::writeMessages() {
+    bool failed = false;
+
+    while (true) {
+        ref<MemoryStream> message;
+        bool more;
+        {
+            LockGuard lock(m_sendMutex);
+            while (m_sendQueue.empty() && !m_writerShutdown)
+                m_sendCond->wait();
+            if (m_sendQueue.empty())
+                break;
+            message = m_sendQueue.front();
+            m_sendQueue.pop_front();
+            more = !m_sendQueue.empty();
+            m_sendCond->broadcast();
+        }
+
+        if (failed)
+            continue;
+
+        try {
+            m_stream->write(message->getData(), message->getPos());
+            /* Batch up messages while the queue is not empty */
+            if (!more)
+                m_stream->flush();
+        } catch (std::exception &) {
+            Log(EWarn, "Connection error - could not submit a message");
+            /* A connection failure occurred - this will eventually be
+               caught and handled in run(). Drop all further messages */
+            failed = true;
+        }
     }
 }
 
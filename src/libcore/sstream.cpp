@@ -25,6 +25,7 @@
 # include <sys/types.h>
 # include <sys/socket.h>
 # include <netinet/in.h>
+# include <netinet/tcp.h>
 # include <netdb.h>
 # include <arpa/inet.h>
 # include <sys/wait.h>
@@ -74,6 +75,15 @@ void *get_in_addr(struct sockaddr_storage *sa)
     return &(((struct sockaddr_in6*)sa)->sin6_addr);
 }
 
+/* Messages are assembled in memory and written all at once. Disable
+   Nagle's algorithm, which would otherwise delay short messages (e.g.
+   batches of work units) until the previous packet is acknowledged */
+void disable_nagle(SocketStream::socket_t socket)
+{
+    int on = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char *) &on, sizeof(int));
+}
+
 } // namespace
 
 SocketStream::SocketStream(socket_t socket)
@@ -89,6 +99,7 @@ SocketStream::SocketStream(socket_t socket)
     if (inet_ntop(sockaddr.ss_family, get_in_addr(&sockaddr), s, sizeof(s)) == NULL)
         handleError("inet_ntop");
 
+    disable_nagle(m_socket);
     m_peer = s;
 }
 
@@ -141,6 +152,7 @@ SocketStream::SocketStream(const std::string &host, int port)
         handleError("setsockopt");
 #endif
 
+    disable_nagle(m_socket);
     m_peer = s;
 }
 
@@ -18,6 +18,7 @@
 
 #include <mitsuba/mitsuba.h>
 #include <mitsuba/core/statistics.h>
+#include <mitsuba/core/profiler.h>
 #include <mitsuba/core/lock.h>
 
 MTS_NAMESPACE_BEGIN
@@ -147,6 +148,9 @@ void Statistics::resetAll() {
     LockGuard lock(m_mutex);
     for (size_t i=0; i<m_counters.size(); ++i)
         const_cast<StatsCounter *>(m_counters[i])->reset();
+#if defined(MTS_ENABLE_PROFILER)
+    Profiler::getInstance()->reset();
+#endif
 }
 
 std::string Statistics::getStats() {
@@ -188,8 +192,8 @@ std::string Statistics::getStats() {
         else
             value = (float) counter->getValue();
 
-        if ((type != EPercentage && value == 0) ||
-            (type == EPercentage && baseValue == 0))
+        if ((type != EPercentage && type != EMemoryUsage && value == 0) ||
+            ((type == EPercentage || type == EMemoryUsage) && baseValue == 0))
             continue;
 
         if (category != counter->getCategory()) {
@@ -256,6 +260,12 @@ std::string Statistics::getStats() {
                         value3, suffixesNumber[suffixIndex2].c_str());
                     break;
                 }
+            case EMemoryUsage:
+                snprintf(temp, sizeof(temp), "    -  %s : %s (peak: %s)",
+                    counter->getName().c_str(),
+                    memString((size_t) counter->getValue()).c_str(),
+                    memString((size_t) counter->getBase()).c_str());
+                break;
             default:
                 Log(EError, "Unknown counter type!");
         }
@@ -268,9 +278,107 @@ std::string Statistics::getStats() {
             << "     none." << endl;
     }
 
+    oss << endl << "  * Process memory :" << endl
+        << "    -  Current : " << memString(getPrivateMemoryUsage()) << endl
+        << "    -  Peak : " << memString(getPeakMemoryUsage()) << endl;
+
+#if defined(MTS_ENABLE_PROFILER)
+    oss << endl << "  * Profiler :" << endl
+        << Profiler::getInstance()->getReport();
+#endif
+
     oss << "------------------------------------------------------------";
     return oss.str();
 }
 
+Statistics::Snapshot Statistics::getSnapshot() {
+    Snapshot snapshot;
+    LockGuard lock(m_mutex);
+    for (size_t i=0; i<m_counters.size(); ++i)
+        snapshot[m_counters[i]] = std::make_pair(
+            m_counters[i]->getValue(), m_counters[i]->getBase());
+    return snapshot;
+}
+
+/// Return the increase from \c old to \c value, or \c value if the counter was reset
+static inline uint64_t counterIncrease(uint64_t value, uint64_t old) {
+    return value >= old ? value - old : value;
+}
+
+uint64_t Statistics::getIncrease(const StatsCounter *counter, const Snapshot &since) {
+    Snapshot::const_iterator it = since.find(counter);
+    if (it == since.end())
+        return counter->getValue();
+    return counterIncrease(counter->getValue(), it->second.first);
+}
+
+std::string Statistics::getStatsJSON(const Snapshot *since) {
+    std::ostringstream oss;
+    LockGuard lock(m_mutex);
+    std::sort(m_counters.begin(), m_counters.end(), compareCategory());
+
+    oss << "{";
+    for (size_t i=0; i<m_counters.size(); ) {
+        const StatsCounter *counter = m_counters[i];
+        EStatsType type = counter->getType();
+        uint64_t value = 0, base = 0;
+
+        /* Different plugins may register counters of the same name -- merge them */
+        size_t j = i;
+        for (; j<m_counters.size() && m_counters[j]->getCategory() == counter->getCategory()
+                && m_counters[j]->getName() == counter->getName(); ++j) {
+            const StatsCounter *c = m_counters[j];
+            if (type == EMinimumValue) {
+                value = (j == i) ? c->getMinimum() : std::min(value, c->getMinimum());
+                base += c->getBase();
+            } else if (type == EMaximumValue) {
+                value = std::max(value, c->getMaximum());
+                base += c->getBase();
+            } else if (type == EMemoryUsage || !since) {
+                value += c->getValue();
+                base += c->getBase();
+            } else {
+                Snapshot::const_iterator it = since->find(c);
+                std::pair<uint64_t, uint64_t> old = (it != since->end())
+                    ? it->second : std::make_pair((uint64_t) 0, (uint64_t) 0);
+                value += counterIncrease(c->getValue(), old.first);
+                base += counterIncrease(c->getBase(), old.second);
+            }
+        }
+
+        if (i == 0 || m_counters[i-1]->getCategory() != counter->getCategory()) {
+            if (i != 0)
+                oss << "}, ";
+            oss << jsonString(counter->getCategory()) << ": {";
+        } else {
+            oss << ", ";
+        }
+        oss << jsonString(counter->getName()) << ": ";
+
+        if (type == EPercentage || type == EAverage)
+            oss << "{\"value\": " << value << ", \"base\": " << base << "}";
+        else if (type == EMemoryUsage)
+            oss << "{\"live\": " << value << ", \"peak\": " << base << "}";
+        else
+            oss << value;
+        i = j;
+    }
+    if (!m_counters.empty())
+        oss << "}";
+    oss << "}";
+    return oss.str();
+}
+
+const StatsCounter *Statistics::getCounter(const std::string &category,
+        const std::string &name) {
+    LockGuard lock(m_mutex);
+    for (size_t i=0; i<m_counters.size(); ++i) {
+        if (m_counters[i]->getCategory() == category &&
+            m_counters[i]->getName() == name)
+            return m_counters[i];
+    }
+    return NULL;
+}
+
 MTS_IMPLEMENT_CLASS(Statistics, false, Object)
 MTS_NAMESPACE_END
@@ -18,6 +18,7 @@
 
 #include <mitsuba/mitsuba.h>
 #include <mitsuba/core/stream.h>
+#include <mitsuba/core/mstream.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -37,6 +38,20 @@ static Stream::EByteOrder getByteOrder() {
 
 Stream::EByteOrder Stream::m_hostByteOrder = mitsuba::getByteOrder();
 
+/* Byte-swap and write an array in blocks of bounded size instead
+   of creating a swapped copy of the entire (possibly huge) array */
+template <typename T> static void writeSwapped(Stream *stream, const T *data, size_t size) {
+    const size_t blockSize = 2048;
+    T temp[blockSize];
+
+    for (size_t i=0; i<size; i += blockSize) {
+        size_t count = std::min(blockSize, size - i);
+        for (size_t j=0; j<count; ++j)
+            temp[j] = endianness_swap(data[i+j]);
+        stream->write(temp, sizeof(T) * count);
+    }
+}
+
 Stream::Stream() : m_byteOrder(m_hostByteOrder) { }
 
 void Stream::setByteOrder(EByteOrder value) {
@@ -55,11 +70,7 @@ void Stream::writeInt(int value) {
 
 void Stream::writeIntArray(const int *data, size_t size) {
     if (m_byteOrder != m_hostByteOrder) {
-        int *temp = new int[size];
-        for (size_t i=0; i<size; ++i)
-            temp[i] = endianness_swap(data[i]);
-        write(temp, sizeof(int)*size);
-        delete[] temp;
+        writeSwapped(this, data, size);
     } else {
         write(data, sizeof(int)*size);
     }
@@ -73,11 +84,7 @@ void Stream::writeUInt(unsigned int value) {
 
 void Stream::writeUIntArray(const unsigned int *data, size_t size) {
     if (m_byteOrder != m_hostByteOrder) {
-        unsigned int *temp = new unsigned int[size];
-        for (size_t i=0; i<size; ++i)
-            temp[i] = endianness_swap(data[i]);
-        write(temp, sizeof(unsigned int)*size);
-        delete[] temp;
+        writeSwapped(this, data, size);
     } else {
         write(data, sizeof(unsigned int)*size);
     }
@@ -91,11 +98,7 @@ void Stream::writeLong(int64_t value) {
 
 void Stream::writeLongArray(const int64_t *data, size_t size) {
     if (m_byteOrder != m_hostByteOrder) {
-        int64_t *temp = new int64_t[size];
-        for (size_t i=0; i<size; ++i)
-            temp[i] = endianness_swap(data[i]);
-        write(temp, sizeof(int64_t)*size);
-        delete[] temp;
+        writeSwapped(this, data, size);
     } else {
         write(data, sizeof(int64_t)*size);
     }
@@ -109,11 +112,7 @@ void Stream::writeULong(uint64_t value) {
 
 void Stream::writeULongArray(const uint64_t *data, size_t size) {
     if (m_byteOrder != m_hostByteOrder) {
-        uint64_t *temp = new uint64_t[size];
-        for (size_t i=0; i<size; ++i)
-            temp[i] = endianness_swap(data[i]);
-        write(temp, sizeof(uint64_t)*size);
-        delete[] temp;
+        writeSwapped(this, data, size);
     } else {
         write(data, sizeof(uint64_t)*size);
     }
@@ -127,11 +126,7 @@ void Stream::writeShort(short value) {
 
 void Stream::writeShortArray(const short *data, size_t size) {
     if (m_byteOrder != m_hostByteOrder) {
-        short *temp = new short[size];
-        for (size_t i=0; i<size; ++i)
-            temp[i] = endianness_swap(data[i]);
-        write(temp, sizeof(short)*size);
-        delete[] temp;
+        writeSwapped(this, data, size);
     } else {
         write(data, sizeof(short)*size);
     }
@@ -145,11 +140,7 @@ void Stream::writeUShort(unsigned short value) {
 
 void Stream::writeUShortArray(const unsigned short *data, size_t size) {
     if (m_byteOrder != m_hostByteOrder) {
-        unsigned short *temp = new unsigned short[size];
-        for (size_t i=0; i<size; ++i)
-            temp[i] = endianness_swap(data[i]);
-        write(temp, sizeof(unsigned short)*size);
-        delete[] temp;
+        writeSwapped(this, data, size);
     } else {
         write(data, sizeof(unsigned short)*size);
     }
@@ -173,11 +164,7 @@ void Stream::writeHalf(half halfValue) {
 void Stream::writeHalfArray(const half *data, size_t size) {
     BOOST_STATIC_ASSERT(sizeof(half) == 2);
     if (m_byteOrder != m_hostByteOrder) {
-        short *temp = new short[size];
-        for (size_t i=0; i<size; ++i)
-            temp[i] = endianness_swap(data[i].bits());
-        write(temp, sizeof(short)*size);
-        delete[] temp;
+        writeSwapped(this, reinterpret_cast<const short *>(data), size);
     } else {
         write(data, sizeof(half)*size);
     }
@@ -191,11 +178,7 @@ void Stream::writeSingle(float value) {
 
 void Stream::writeSingleArray(const float *data, size_t size) {
     if (m_byteOrder != m_hostByteOrder) {
-        float *temp = new float[size];
-        for (size_t i=0; i<size; ++i)
-            temp[i] = endianness_swap(data[i]);
-        write(temp, sizeof(float)*size);
-        delete[] temp;
+        writeSwapped(this, data, size);
     } else {
         write(data, sizeof(float)*size);
     }
@@ -203,11 +186,7 @@ void Stream::writeSingleArray(const float *data, size_t size) {
 
 void Stream::writeDoubleArray(const double *data, size_t size) {
     if (m_byteOrder != m_hostByteOrder) {
-        double *temp = new double[size];
-        for (size_t i=0; i<size; ++i)
-            temp[i] = endianness_swap(data[i]);
-        write(temp, sizeof(double)*size);
-        delete[] temp;
+        writeSwapped(this, data, size);
     } else {
         write(data, sizeof(double)*size);
     }
@@ -426,17 +405,32 @@ std::string Stream::readString() {
 }
 
 void Stream::copyTo(Stream *stream, int64_t numBytes) {
-    const int block_size = 512;
-    char data[block_size];
-    size_t copied = 0;
-
     size_t amount = (numBytes == -1) ? (getSize() - getPos()) : (size_t) numBytes;
-    for (size_t i=0; i<amount; i+=block_size) {
-        size_t blockSize = (i + block_size) <= amount ? block_size : amount-i;
 
-        read(data, blockSize);
-        copied += blockSize;
-        stream->write(data, blockSize);
+    if (getClass()->derivesFrom(MTS_CLASS(MemoryStream))) {
+        /* Write directly from the source buffer */
+        MemoryStream *source = static_cast<MemoryStream *>(this);
+        size_t pos = source->getPos();
+        if (amount <= source->getSize() - pos) {
+            stream->write(source->getCurrentData(), amount);
+            source->seek(pos + amount);
+            return;
+        }
+    } else if (stream->getClass()->derivesFrom(MTS_CLASS(MemoryStream))) {
+        /* Read directly into the target buffer */
+        MemoryStream *target = static_cast<MemoryStream *>(stream);
+        size_t pos = target->getPos();
+        target->seek(pos + amount);
+        read(target->getData() + pos, amount);
+        return;
+    }
+
+    const size_t blockSize = 65536;
+    std::vector<char> data(std::min(amount, blockSize));
+    for (size_t i=0; i<amount; i+=blockSize) {
+        size_t size = std::min(blockSize, amount - i);
+        read(&data[0], size);
+        stream->write(&data[0], size);
     }
 }
 
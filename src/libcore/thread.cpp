@@ -87,6 +87,7 @@ struct Thread::ThreadPrivate {
     bool running, joined;
     Thread::EThreadPriority priority;
     int coreAffinity;
+    int numaNode;
     static ThreadLocal<Thread> *self;
     bool critical;
     boost::thread thread;
@@ -97,7 +98,7 @@ struct Thread::ThreadPrivate {
     ThreadPrivate(const std::string & name_) :
         name(name_), running(false), joined(false),
         priority(Thread::ENormalPriority), coreAffinity(-1),
-        critical(false) { }
+        numaNode(-1), critical(false) { }
 };
 
 static std::vector<bool (*)(void)> __crashHandlers;
@@ -411,6 +412,40 @@ int Thread::getCoreAffinity() const {
     return d->coreAffinity;
 }
 
+void Thread::setNUMANode(int node) {
+    d->numaNode = node;
+    if (!d->running || node == -1)
+        return;
+
+#if defined(__LINUX__)
+    std::vector<int> cpus = getNUMANodeCPUs(node);
+    if (cpus.empty()) {
+        Log(EWarn, "Thread::setNUMANode(): node %i has no available cores!", node);
+        return;
+    }
+
+    int nCores = *std::max_element(cpus.begin(), cpus.end()) + 1;
+    size_t size = CPU_ALLOC_SIZE(nCores);
+    cpu_set_t *cpuset = CPU_ALLOC(nCores);
+    if (!cpuset) {
+        Log(EWarn, "Thread::setNUMANode(): could not allocate cpu_set_t");
+        return;
+    }
+    CPU_ZERO_S(size, cpuset);
+    for (size_t i=0; i<cpus.size(); ++i)
+        CPU_SET_S(cpus[i], size, cpuset);
+
+    int retval = pthread_setaffinity_np(d->native_handle, size, cpuset);
+    if (retval)
+        Log(EWarn, "Thread::setNUMANode(): pthread_setaffinity_np: failed: %s", strerror(retval));
+    CPU_FREE(cpuset);
+#endif
+}
+
+int Thread::getNUMANode() const {
+    return d->numaNode;
+}
+
 void Thread::dispatch(Thread *thread) {
     detail::initializeLocalTLS();
 
@@ -449,6 +484,8 @@ void Thread::dispatch(Thread *thread) {
 
     if (thread->getCoreAffinity() != -1)
         thread->setCoreAffinity(thread->getCoreAffinity());
+    else if (thread->getNUMANode() != -1)
+        thread->setNUMANode(thread->getNUMANode());
 
     try {
         thread->run();
@@ -23,12 +23,15 @@
 #include <mitsuba/core/sse.h>
 #include <mitsuba/core/frame.h>
 #include <boost/bind.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
 #include <stdarg.h>
 #include <iomanip>
 #include <errno.h>
 
 #if defined(__OSX__)
 #include <sys/sysctl.h>
+#include <sys/resource.h>
 #include <mach/mach.h>
 #elif defined(__WINDOWS__)
 #include <windows.h>
@@ -216,6 +219,128 @@ done:
 #endif
 }
 
+/// Processor topology of this machine (only the cores available to the process)
+struct NUMATopology {
+    /// NUMA node of every available core
+    std::vector<int> coreNodes;
+    /// OS CPU IDs of the available cores of every node
+    std::vector<std::vector<int> > nodeCPUs;
+
+    NUMATopology() {
+#if defined(__LINUX__)
+        /* Determine the OS IDs of all available cores (in the
+           same order that Thread::setCoreAffinity() uses) */
+        std::vector<int> available;
+        int nLogicalCores = sysconf(_SC_NPROCESSORS_CONF);
+        for (int i = 0; i<6; ++i) {
+            size_t size = CPU_ALLOC_SIZE(nLogicalCores);
+            cpu_set_t *cpuset = CPU_ALLOC(nLogicalCores);
+            if (!cpuset)
+                break;
+            CPU_ZERO_S(size, cpuset);
+            int retval = pthread_getaffinity_np(pthread_self(), size, cpuset);
+            if (retval == 0) {
+                for (int j=0; j<nLogicalCores; ++j) {
+                    if (CPU_ISSET_S(j, size, cpuset))
+                        available.push_back(j);
+                }
+            }
+            CPU_FREE(cpuset);
+            if (retval != EINVAL)
+                break;
+            nLogicalCores *= 2;
+        }
+
+        /* Read the CPU list of every node from sysfs */
+        std::map<int, std::vector<int> > nodes;
+        fs::path nodePath("/sys/devices/system/node");
+        try {
+            if (fs::is_directory(nodePath)) {
+                for (fs::directory_iterator it(nodePath), end; it != end; ++it) {
+                    std::string name = it->path().filename().string();
+                    if (name.length() < 5 || name.compare(0, 4, "node") != 0
+                        || name.find_first_not_of("0123456789", 4) != std::string::npos)
+                        continue;
+                    fs::ifstream is(it->path() / "cpulist");
+                    std::string cpuList;
+                    if (!is.good() || !std::getline(is, cpuList))
+                        continue;
+                    std::vector<int> &cpus = nodes[atoi(name.c_str() + 4)];
+                    std::vector<std::string> ranges = tokenize(cpuList, ", \n");
+                    for (size_t i=0; i<ranges.size(); ++i) {
+                        int first = 0, last = 0;
+                        int count = sscanf(ranges[i].c_str(), "%i-%i", &first, &last);
+                        if (count == 1)
+                            last = first;
+                        else if (count != 2)
+                            continue;
+                        for (int cpu = first; cpu <= last; ++cpu)
+                            cpus.push_back(cpu);
+                    }
+                }
+            }
+        } catch (const std::exception &ex) {
+            SLog(EWarn, "Unable to determine the NUMA topology: %s", ex.what());
+            nodes.clear();
+        }
+
+        /* Number the nodes with available cores consecutively */
+        std::map<int, int> cpuNode;
+        for (std::map<int, std::vector<int> >::const_iterator it = nodes.begin();
+                it != nodes.end(); ++it) {
+            bool used = false;
+            for (size_t i=0; i<it->second.size(); ++i) {
+                if (std::find(available.begin(), available.end(), it->second[i]) != available.end()) {
+                    cpuNode[it->second[i]] = (int) nodeCPUs.size();
+                    used = true;
+                }
+            }
+            if (used)
+                nodeCPUs.push_back(std::vector<int>());
+        }
+
+        if (nodeCPUs.size() > 1) {
+            for (size_t i=0; i<available.size(); ++i) {
+                std::map<int, int>::const_iterator it = cpuNode.find(available[i]);
+                int node = it != cpuNode.end() ? it->second : 0;
+                coreNodes.push_back(node);
+                nodeCPUs[node].push_back(available[i]);
+            }
+            return;
+        }
+        nodeCPUs.clear();
+        nodeCPUs.push_back(available);
+#endif
+        /* Single node (or unknown topology) */
+        if (nodeCPUs.empty())
+            nodeCPUs.push_back(std::vector<int>());
+        coreNodes.assign(getCoreCount(), 0);
+    }
+
+    static const NUMATopology &getInstance() {
+        static NUMATopology topology;
+        return topology;
+    }
+};
+
+int getNUMANodeCount() {
+    return (int) NUMATopology::getInstance().nodeCPUs.size();
+}
+
+int getCoreNUMANode(int coreID) {
+    const NUMATopology &topology = NUMATopology::getInstance();
+    if (coreID < 0 || coreID >= (int) topology.coreNodes.size())
+        return 0;
+    return topology.coreNodes[coreID];
+}
+
+std::vector<int> getNUMANodeCPUs(int node) {
+    const NUMATopology &topology = NUMATopology::getInstance();
+    if (node < 0 || node >= (int) topology.nodeCPUs.size())
+        return std::vector<int>();
+    return topology.nodeCPUs[node];
+}
+
 size_t getTotalSystemMemory() {
 #if defined(__WINDOWS__)
     MEMORYSTATUSEX status;
@@ -274,6 +399,36 @@ size_t getPrivateMemoryUsage() {
 #endif
 }
 
+size_t getPeakMemoryUsage() {
+#if defined(__WINDOWS__)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+    return (size_t) pmc.PeakWorkingSetSize;
+#elif defined(__OSX__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (size_t) usage.ru_maxrss; /* Reported in bytes on OSX */
+#else
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file)
+        return 0;
+
+    char buffer[128];
+    size_t result = 0;
+    while (fgets(buffer, sizeof(buffer), file) != NULL) {
+        if (strncmp(buffer, "VmHWM:", 6) != 0) /* Peak resident set size */
+            continue;
+        result = (size_t) strtoull(buffer + 6, NULL, 10) * 1024;
+        break;
+    }
+
+    fclose(file);
+    return result;
+#endif
+}
+
 #if defined(__WINDOWS__)
 std::string lastErrorText() {
     DWORD errCode = GetLastError();
@@ -900,4 +1055,26 @@ std::string memString(size_t size, bool precise) {
     return os.str();
 }
 
+std::string jsonString(const std::string &string) {
+    std::ostringstream os;
+    os << '"';
+    for (size_t i=0; i<string.length(); ++i) {
+        char c = string[i];
+        switch (c) {
+            case '"': os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\n': os << "\\n"; break;
+            case '\r': os << "\\r"; break;
+            case '\t': os << "\\t"; break;
+            default:
+                if ((unsigned char) c < 0x20)
+                    os << formatString("\\u%04x", (int) c);
+                else
+                    os << c;
+        }
+    }
+    os << '"';
+    return os.str();
+}
+
 MTS_NAMESPACE_END
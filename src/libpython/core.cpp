@@ -1369,7 +1369,9 @@ void export_core() {
     BP_SETSCOPE(coreModule);
 
     BP_CLASS(MemoryStream, Stream, (bp::init<bp::optional<size_t> >()))
-        .def("reset", &MemoryStream::reset);
+        .def("reset", &MemoryStream::reset)
+        .def("reserve", &MemoryStream::reserve)
+        .def("getCapacity", &MemoryStream::getCapacity);
 
     BP_CLASS(SerializableObject, Object, bp::no_init)
         .def("serialize", &SerializableObject::serialize);
@@ -1778,17 +1780,28 @@ void export_core() {
         .def(bp::init<int, const std::string, Thread::EThreadPriority>());
 
     BP_CLASS(RemoteWorker, Worker, (bp::init<const std::string, Stream *>()))
-        .def("getNodeName", &RemoteWorker::getNodeName, BP_RETURN_VALUE);
+        .def("getNodeName", &RemoteWorker::getNodeName, BP_RETURN_VALUE)
+        .def("setCompressionLevel", &RemoteWorker::setCompressionLevel)
+        .def("getCompressionLevel", &RemoteWorker::getCompressionLevel)
+        .def("setBacklogFactor", &RemoteWorker::setBacklogFactor)
+        .def("getBacklogFactor", &RemoteWorker::getBacklogFactor);
 
     bp::class_<SerializableObjectVector>("SerializableObjectVector")
         .def(bp::vector_indexing_suite<SerializableObjectVector>());
 
+    int (Scheduler::*scheduler_registerMultiResource1)(std::vector<SerializableObject *> &) = &Scheduler::registerMultiResource;
+    int (Scheduler::*scheduler_registerMultiResource2)(std::vector<SerializableObject *> &, bool) = &Scheduler::registerMultiResource;
+
     BP_CLASS(Scheduler, Object, bp::no_init)
         .def("schedule", &Scheduler::schedule)
         .def("wait", scheduler_wait)
         .def("cancel", scheduler_cancel)
         .def("registerResource", &Scheduler::registerResource)
-        .def("registerMultiResource", &Scheduler::registerMultiResource)
+        .def("registerMultiResource", scheduler_registerMultiResource1)
+        .def("registerMultiResource", scheduler_registerMultiResource2)
+        .def("registerReplicatedResource", &Scheduler::registerReplicatedResource)
+        .def("setResourceReplication", &Scheduler::setResourceReplication)
+        .def("getResourceReplication", &Scheduler::getResourceReplication)
         .def("retainResource", &Scheduler::retainResource)
         .def("unregisterResource", &Scheduler::unregisterResource)
         .def("getResourceID", &Scheduler::getResourceID)
@@ -1806,6 +1819,8 @@ void export_core() {
         .def("getInstance", &Scheduler::getInstance, BP_RETURN_VALUE)
         .def("isRunning", &Scheduler::isRunning)
         .def("isBusy", &Scheduler::isBusy)
+        .def("setBatchSize", &Scheduler::setBatchSize)
+        .def("getBatchSize", &Scheduler::getBatchSize)
         .staticmethod("getInstance");
 
     BP_CLASS(AbstractAnimationTrack, Object, bp::no_init)
@@ -245,6 +245,13 @@ class RenderListenerWrapper : public RenderListener {
 public:
     RenderListenerWrapper(PyObject *self) : m_self(self), m_locked(false) { Py_INCREF(m_self); }
 
+    void startJobEvent(const RenderJob *job) {
+        CALLBACK_SYNC_GIL();
+        try {
+            bp::call_method<void>(m_self, "startJobEvent", bp::ptr(job));
+        } catch (bp::error_already_set &) { check_python_exception(); }
+    }
+
     void workBeginEvent(const RenderJob *job, const RectangularWorkUnit *wu, int worker) {
         CALLBACK_SYNC_GIL();
         try {
@@ -863,7 +870,8 @@ void export_render() {
     bp::register_ptr_to_python<RenderListener*>();
     bp::implicitly_convertible<ref<RenderListenerWrapper>, ref<RenderListener> >();
 
-    RenderListener_class.def("workBeginEvent", &RenderListener::workBeginEvent)
+    RenderListener_class.def("startJobEvent", &RenderListener::startJobEvent)
+        .def("workBeginEvent", &RenderListener::workBeginEvent)
         .def("workEndEvent", &RenderListener::workEndEvent)
         .def("workCanceledEvent", &RenderListener::workCanceledEvent)
         .def("refreshEvent", &RenderListener::refreshEvent)
@@ -0,0 +1,291 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/emittertree.h>
+#include <mitsuba/render/trimesh.h>
+
+MTS_NAMESPACE_BEGIN
+
+namespace {
+    /// Sorts emitter indices by the center of their bounds along an axis
+    struct EmitterAxisOrder {
+        EmitterAxisOrder(const std::vector<AABB> &bounds, int axis)
+            : bounds(bounds), axis(axis) { }
+
+        inline bool operator()(uint32_t a, uint32_t b) const {
+            return bounds[a].min[axis] + bounds[a].max[axis]
+                 < bounds[b].min[axis] + bounds[b].max[axis];
+        }
+
+        const std::vector<AABB> &bounds;
+        int axis;
+    };
+
+    /// Compute a cone bounding the emission normals of an area emitter
+    bool computeNormalCone(const Emitter *emitter, Vector &axis, Float &angle) {
+        if (emitter->getClass()->getName() != "AreaLight" || !emitter->getShape())
+            return false;
+
+        ref<TriMesh> mesh = const_cast<Shape *>(emitter->getShape())->createTriMesh();
+        if (!mesh || mesh->getTriangleCount() == 0)
+            return false;
+
+        const Point *positions = mesh->getVertexPositions();
+        const Normal *normals = mesh->getVertexNormals();
+        const Triangle *triangles = mesh->getTriangles();
+        std::vector<Vector> dirs;
+
+        if (normals) {
+            for (size_t i=0; i<mesh->getVertexCount(); ++i)
+                dirs.push_back(normalize(Vector(normals[i])));
+        } else {
+            for (size_t i=0; i<mesh->getTriangleCount(); ++i) {
+                const Triangle &tri = triangles[i];
+                Vector n = cross(positions[tri.idx[1]] - positions[tri.idx[0]],
+                    positions[tri.idx[2]] - positions[tri.idx[0]]);
+                if (!n.isZero())
+                    dirs.push_back(normalize(n));
+            }
+        }
+
+        Vector sum(0.0f);
+        for (size_t i=0; i<dirs.size(); ++i)
+            sum += dirs[i];
+        if (dirs.empty() || sum.length() < Epsilon)
+            return false;
+
+        axis = normalize(sum);
+        Float minCos = 1;
+        for (size_t i=0; i<dirs.size(); ++i)
+            minCos = std::min(minCos, dot(axis, dirs[i]));
+        angle = math::safe_acos(minCos);
+        return true;
+    }
+}
+
+EmitterTree::EmitterTree(const ref_vector<Emitter> &emitters) {
+    /* When all sampling weights are zero, fall back to choosing
+       the emitters uniformly instead of producing NaNs */
+    Float totalWeight = 0;
+    for (size_t i=0; i<emitters.size(); ++i)
+        totalWeight += emitters[i]->getSamplingWeight();
+    m_uniform = !(totalWeight > 0);
+
+    for (size_t i=0; i<emitters.size(); ++i) {
+        const Emitter *emitter = emitters[i].get();
+        if (emitter->isEnvironmentEmitter() ||
+            (emitter->getType() & Emitter::EDeltaDirection)) {
+            m_leaves[emitter] = -(int32_t) m_infiniteEmitters.size() - 1;
+            m_infiniteEmitters.push_back(emitter);
+            m_infinitePDF.append(getWeight(emitter));
+        } else {
+            m_emitters.push_back(emitter);
+            m_bounds.push_back(emitter->getAABB());
+        }
+    }
+
+    Float finiteWeight = 0;
+    for (size_t i=0; i<m_emitters.size(); ++i)
+        finiteWeight += getWeight(m_emitters[i]);
+    Float infiniteWeight = m_infiniteEmitters.empty() ? 0 : m_infinitePDF.normalize();
+    Float weight = finiteWeight + infiniteWeight;
+    m_infiniteProb = weight > 0 ? infiniteWeight / weight : 0.0f;
+
+    if (m_emitters.empty())
+        return;
+
+    std::vector<uint32_t> indices(m_emitters.size());
+    for (size_t i=0; i<m_emitters.size(); ++i)
+        indices[i] = (uint32_t) i;
+
+    m_nodes.reserve(2 * m_emitters.size());
+    build(&indices[0], &indices[0] + indices.size(), -1);
+    m_bounds.clear();
+}
+
+int32_t EmitterTree::build(uint32_t *start, uint32_t *end, int32_t parent) {
+    int32_t index = (int32_t) m_nodes.size();
+    m_nodes.push_back(Node());
+
+    if (end - start == 1) {
+        const Emitter *emitter = m_emitters[*start];
+        Node &node = m_nodes[index];
+        node.aabb = m_bounds[*start];
+        node.weight = getWeight(emitter);
+        node.parent = parent;
+        node.left = -1;
+        node.right = (int32_t) *start;
+        if (computeNormalCone(emitter, node.axis, node.normalAngle)) {
+            node.emissionAngle = M_PI * 0.5f;
+        } else {
+            node.axis = Vector(0.0f, 0.0f, 1.0f);
+            node.normalAngle = M_PI;
+            node.emissionAngle = M_PI;
+        }
+        m_leaves[emitter] = index;
+        return index;
+    }
+
+    /* Split at the median along the largest axis of the centroid bounds */
+    AABB centroids;
+    for (uint32_t *it = start; it != end; ++it)
+        centroids.expandBy(m_bounds[*it].getCenter());
+    uint32_t *mid = start + (end - start) / 2;
+    std::nth_element(start, mid, end, EmitterAxisOrder(m_bounds, centroids.getLargestAxis()));
+
+    int32_t left = build(start, mid, index);
+    int32_t right = build(mid, end, index);
+
+    /* Note: 'm_nodes' may have been reallocated by the recursive calls */
+    const Node &l = m_nodes[left], &r = m_nodes[right];
+    Node &node = m_nodes[index];
+    node.aabb = l.aabb;
+    node.aabb.expandBy(r.aabb);
+    node.weight = l.weight + r.weight;
+    node.parent = parent;
+    node.left = left;
+    node.right = right;
+    node.emissionAngle = std::max(l.emissionAngle, r.emissionAngle);
+
+    /* Merge the normal cones */
+    Float psi = unitAngle(l.axis, r.axis);
+    if (l.normalAngle >= M_PI || r.normalAngle >= M_PI) {
+        node.axis = l.axis;
+        node.normalAngle = M_PI;
+    } else if (l.normalAngle >= psi + r.normalAngle) {
+        node.axis = l.axis;
+        node.normalAngle = l.normalAngle;
+    } else if (r.normalAngle >= psi + l.normalAngle) {
+        node.axis = r.axis;
+        node.normalAngle = r.normalAngle;
+    } else {
+        node.normalAngle = (l.normalAngle + psi + r.normalAngle) * 0.5f;
+        if (node.normalAngle >= M_PI || std::sin(psi) < Epsilon) {
+            node.axis = l.axis;
+            node.normalAngle = M_PI;
+        } else {
+            /* Rotate the left axis towards the right one */
+            Float rot = node.normalAngle - l.normalAngle;
+            node.axis = normalize(l.axis * std::sin(psi - rot) + r.axis * std::sin(rot));
+        }
+    }
+
+    return index;
+}
+
+Float EmitterTree::importance(const Node &node, const Point &ref) const {
+    Vector d = ref - node.aabb.getCenter();
+    Float distSqr = d.lengthSquared();
+    Float radiusSqr = node.aabb.getExtents().lengthSquared() * 0.25f;
+
+    Float cosTheta = 1.0f;
+    if (node.normalAngle < M_PI && distSqr > radiusSqr) {
+        /* Bound the angle between the normals and the direction towards
+           'ref' over all points in the box */
+        Float dist = std::sqrt(distSqr);
+        Float theta = unitAngle(node.axis, d / dist);
+        Float thetaU = math::safe_asin(std::sqrt(radiusSqr) / dist);
+        Float thetaPrime = std::max((Float) 0, theta - node.normalAngle - thetaU);
+        if (thetaPrime >= node.emissionAngle)
+            return 0.0f;
+        cosTheta = std::cos(thetaPrime);
+    }
+
+    /* Avoid the singularity when the reference point is close to the node */
+    return node.weight * cosTheta / std::max(distSqr,
+        std::max(radiusSqr, std::numeric_limits<Float>::min()));
+}
+
+Float EmitterTree::leftProbability(const Node &node, const Point &ref) const {
+    Float l = importance(m_nodes[node.left], ref),
+          r = importance(m_nodes[node.right], ref);
+
+    /* Neither child is expected to contribute -- fall back to the weights */
+    if (!(l + r > 0)) {
+        l = m_nodes[node.left].weight;
+        r = m_nodes[node.right].weight;
+        if (!(l + r > 0))
+            return 0.5f;
+    }
+
+    return l / (l + r);
+}
+
+const Emitter *EmitterTree::sampleReuse(const Point &ref, Float &sample, Float &pdf) const {
+    if (m_nodes.empty() || sample < m_infiniteProb) {
+        sample /= m_infiniteProb;
+        size_t index = m_infinitePDF.sampleReuse(sample, pdf);
+        pdf *= m_infiniteProb;
+        return m_infiniteEmitters[index];
+    }
+
+    sample = (sample - m_infiniteProb) / (1 - m_infiniteProb);
+    pdf = 1 - m_infiniteProb;
+
+    const Node *node = &m_nodes[0];
+    while (!node->isLeaf()) {
+        Float prob = leftProbability(*node, ref);
+        if (sample < prob) {
+            sample /= prob;
+            pdf *= prob;
+            node = &m_nodes[node->left];
+        } else {
+            sample = (sample - prob) / (1 - prob);
+            pdf *= 1 - prob;
+            node = &m_nodes[node->right];
+        }
+        sample = std::min(sample, ONE_MINUS_EPS);
+    }
+
+    return m_emitters[node->right];
+}
+
+Float EmitterTree::pdf(const Point &ref, const Emitter *emitter) const {
+    boost::unordered_map<const Emitter *, int32_t>::const_iterator it
+        = m_leaves.find(emitter);
+    if (it == m_leaves.end())
+        return 0.0f;
+
+    int32_t index = it->second;
+    if (index < 0)
+        return m_infiniteProb * m_infinitePDF[-index - 1];
+
+    /* Walk up to the root and multiply the probabilities of all decisions */
+    Float pdf = 1 - m_infiniteProb;
+    while (m_nodes[index].parent >= 0) {
+        const Node &parent = m_nodes[m_nodes[index].parent];
+        Float prob = leftProbability(parent, ref);
+        pdf *= parent.left == index ? prob : 1 - prob;
+        index = m_nodes[index].parent;
+    }
+
+    return pdf;
+}
+
+std::string EmitterTree::toString() const {
+    std::ostringstream oss;
+    oss << "EmitterTree[" << endl
+        << "  emitterCount = " << m_emitters.size() << "," << endl
+        << "  infiniteEmitterCount = " << m_infiniteEmitters.size() << "," << endl
+        << "  nodeCount = " << m_nodes.size() << endl
+        << "]";
+    return oss.str();
+}
+
+MTS_IMPLEMENT_CLASS(EmitterTree, false, Object)
+MTS_NAMESPACE_END
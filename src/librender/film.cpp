@@ -52,6 +52,7 @@ Film::Film(const Properties &props)
        quality at the edges especially with large reconstruction
        filters. */
     m_highQualityEdges = props.getBoolean("highQualityEdges", false);
+    m_putMutex = new Mutex();
 }
 
 Film::Film(Stream *stream, InstanceManager *manager)
@@ -61,10 +62,16 @@ Film::Film(Stream *stream, InstanceManager *manager)
     m_cropSize = Vector2i(stream);
     m_highQualityEdges = stream->readBool();
     m_filter = static_cast<ReconstructionFilter *>(manager->getInstance(stream));
+    m_putMutex = new Mutex();
 }
 
 Film::~Film() { }
 
+void Film::putConcurrent(const ImageBlock *block) {
+    LockGuard lock(m_putMutex);
+    put(block);
+}
+
 void Film::serialize(Stream *stream, InstanceManager *manager) const {
     ConfigurableObject::serialize(stream, manager);
     m_size.serialize(stream);
@@ -17,34 +17,139 @@
 */
 
 #include <mitsuba/render/imageblock.h>
+#include <mitsuba/core/statistics.h>
 
 MTS_NAMESPACE_BEGIN
 
+static StatsCounter blockMemory("Memory usage", "Image blocks", EMemoryUsage);
+
 ImageBlock::ImageBlock(Bitmap::EPixelFormat fmt, const Vector2i &size,
         const ReconstructionFilter *filter, int channels, bool warn) : m_offset(0),
-        m_size(size), m_filter(filter), m_weightsX(NULL), m_weightsY(NULL), m_warn(warn) {
+        m_size(size), m_filter(filter), m_weightsX(NULL), m_weightsY(NULL),
+        m_rowValues(NULL), m_stripeLocks(NULL), m_warn(warn) {
     m_borderSize = filter ? filter->getBorderSize() : 0;
 
     /* Allocate a small bitmap data structure for the block */
     m_bitmap = new Bitmap(fmt, Bitmap::EFloat,
         size + Vector2i(2 * m_borderSize), channels);
+    blockMemory.recordAllocation(m_bitmap->getBufferSize());
 
     if (filter) {
         /* Temporary buffers used in put() */
         int tempBufferSize = (int) std::ceil(2*filter->getRadius()) + 1;
-        m_weightsX = new Float[2*tempBufferSize];
+        m_weightsX = new Float[(2 + m_bitmap->getChannelCount()) * tempBufferSize];
         m_weightsY = m_weightsX + tempBufferSize;
+        m_rowValues = m_weightsY + tempBufferSize;
     }
+
+    allocateStripeLocks();
 }
 
 ImageBlock::~ImageBlock() {
+    blockMemory.recordRelease(m_bitmap->getBufferSize());
     if (m_weightsX)
         delete[] m_weightsX;
+    delete[] m_stripeLocks;
+}
+
+void ImageBlock::allocateStripeLocks() {
+    int stripeCount = (m_bitmap->getHeight() >> MTS_IMAGEBLOCK_STRIPE_SHIFT) + 1;
+    delete[] m_stripeLocks;
+    m_stripeLocks = new int32_t[stripeCount];
+    for (int i=0; i<stripeCount; ++i)
+        m_stripeLocks[i] = 0;
+}
+
+void ImageBlock::waitStripe(int stripe) {
+    for (int i=0; ; ++i) {
+        if (*(m_stripeLocks + stripe) == 0 &&
+            atomicCompareAndExchange(m_stripeLocks + stripe, 1, 0))
+            return;
+
+        /* The lock holder might have been preempted -- back off */
+        if (i < 64) {
+#if (defined(__i386__) || defined(__amd64__))
+            __asm__ __volatile__ ("pause\n");
+#endif
+        } else {
+            Thread::yield();
+        }
+    }
+}
+
+void ImageBlock::putConcurrent(const ImageBlock *block) {
+    const Bitmap *source = block->getBitmap();
+    const int channels = m_bitmap->getChannelCount();
+
+    /* Same placement as in put(const ImageBlock *) */
+    Point2i targetOffset(block->getOffset() - m_offset
+        - Vector2i(block->getBorderSize() - m_borderSize));
+    Point2i sourceOffset(0);
+    Vector2i size = source->getSize();
+
+    for (int i=0; i<2; ++i) {
+        if (targetOffset[i] < 0) {
+            sourceOffset[i] -= targetOffset[i];
+            size[i] += targetOffset[i];
+            targetOffset[i] = 0;
+        }
+        size[i] = std::min(size[i], m_bitmap->getSize()[i] - targetOffset[i]);
+    }
+
+    if (size.x <= 0 || size.y <= 0)
+        return;
+
+    Assert(source->getChannelCount() == channels);
+
+    /* Merge one stripe of rows at a time */
+    const int stripeHeight = 1 << MTS_IMAGEBLOCK_STRIPE_SHIFT;
+    for (int y=0; y<size.y; ) {
+        int targetY = y + targetOffset.y,
+            rows = std::min(size.y - y, stripeHeight - (targetY & (stripeHeight - 1)));
+
+        lockStripes(targetY, targetY);
+        for (int i=0; i<rows; ++i, ++y) {
+            const Float *src = source->getFloatData() + (sourceOffset.x
+                + (y + sourceOffset.y) * (size_t) source->getWidth()) * channels;
+            Float *dest = m_bitmap->getFloatData() + (targetOffset.x
+                + (y + targetOffset.y) * (size_t) m_bitmap->getWidth()) * channels;
+
+            for (size_t j=0, count=(size_t) size.x * channels; j<count; ++j)
+                dest[j] += src[j];
+        }
+        unlockStripes(targetY, targetY);
+    }
+}
+
+void ImageBlock::warnInvalidSample(const Float *value) const {
+    const int channels = m_bitmap->getChannelCount();
+    std::ostringstream oss;
+    oss << "Invalid sample value : [";
+    for (int i=0; i<channels; ++i) {
+        oss << value[i];
+        if (i+1 < channels)
+            oss << ", ";
+    }
+    oss << "]";
+    Log(EWarn, "%s", oss.str().c_str());
 }
 
 void ImageBlock::load(Stream *stream) {
     m_offset = Point2i(stream);
     m_size = Vector2i(stream);
+
+    /* Grow the storage if necessary. This happens when a block that was
+       created as a placeholder (e.g. by a worker that splats into a shared
+       buffer using putConcurrent()) receives the image of a remote worker */
+    Vector2i bitmapSize = m_size + Vector2i(2 * m_borderSize);
+    if (bitmapSize.x > m_bitmap->getWidth() || bitmapSize.y > m_bitmap->getHeight()) {
+        blockMemory.recordRelease(m_bitmap->getBufferSize());
+        m_bitmap = new Bitmap(m_bitmap->getPixelFormat(), Bitmap::EFloat,
+            bitmapSize, (uint8_t) m_bitmap->getChannelCount());
+        blockMemory.recordAllocation(m_bitmap->getBufferSize());
+        allocateStripeLocks();
+    }
+
     stream->readFloatArray(
         m_bitmap->getFloatData(),
         (size_t) m_bitmap->getSize().x *
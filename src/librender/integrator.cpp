@@ -17,6 +17,7 @@
 */
 
 #include <mitsuba/core/statistics.h>
+#include <mitsuba/core/profiler.h>
 #include <mitsuba/render/integrator.h>
 #include <mitsuba/render/renderproc.h>
 
@@ -140,6 +141,7 @@ void SamplingIntegrator::wakeup(ConfigurableObject *parent,
 void SamplingIntegrator::renderBlock(const Scene *scene,
         const Sensor *sensor, Sampler *sampler, ImageBlock *block,
         const bool &stop, const std::vector< TPoint2<uint8_t> > &points) const {
+    MTS_PROFILE_SCOPE(EProfilerRender);
 
     Float diffScaleFactor = 1.0f /
         std::sqrt((Float) sampler->getSampleCount());
@@ -186,7 +188,10 @@ void SamplingIntegrator::renderBlock(const Scene *scene,
             sensorRay.scaleDifferential(diffScaleFactor);
 
             spec *= Li(sensorRay, rRec);
-            block->put(samplePos, spec, rRec.alpha);
+            {
+                MTS_PROFILE_SCOPE(EProfilerFilm);
+                block->put(samplePos, spec, rRec.alpha);
+            }
             sampler->advance();
         }
     }
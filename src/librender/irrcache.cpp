@@ -18,6 +18,8 @@
 
 #include <mitsuba/render/irrcache.h>
 #include <mitsuba/core/statistics.h>
+#include <mitsuba/core/mmap.h>
+#include <mitsuba/core/timer.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -221,7 +223,6 @@ IrradianceCache::IrradianceCache(const AABB &aabb)
  : m_octree(aabb) {
     /* Use the longest AABB axis as an estimate of the scene dimensions */
     m_sceneSize = (aabb.max-aabb.min)[aabb.getLargestAxis()];
-    m_mutex = new Mutex();
 
     /* Reasonable default settings */
     setQuality(1.0f);
@@ -232,28 +233,19 @@ IrradianceCache::IrradianceCache(const AABB &aabb)
 
 IrradianceCache::IrradianceCache(Stream *stream, InstanceManager *manager) :
     m_octree(AABB(stream)) {
-    m_mutex = new Mutex();
     m_kappa = stream->readFloat();
     m_sceneSize = stream->readFloat();
     m_clampScreen = stream->readBool();
     m_clampNeighbor = stream->readBool();
     m_useGradients = stream->readBool();
     size_t recordCount = stream->readSize();
-    m_records.reserve(recordCount);
-    for (size_t i=0; i<recordCount; ++i) {
-        Record *sample = new Record(stream);
-        Float validRadius = sample->R0 / (2*m_kappa);
-        m_octree.insert(sample, AABB(
-            sample->p-Vector(1,1,1)*validRadius,
-            sample->p+Vector(1,1,1)*validRadius
-        ));
-        m_records.push_back(sample);
-    }
+    for (size_t i=0; i<recordCount; ++i)
+        insert(new Record(stream));
 }
 
 IrradianceCache::~IrradianceCache() {
-    for (size_t i=0; i<m_records.size(); ++i)
-        delete m_records[i];
+    for (const RecordList::ListItem *item = m_records.head(); item; item = item->next)
+        delete item->value;
 }
 
 void IrradianceCache::serialize(Stream *stream, InstanceManager *manager) const {
@@ -264,8 +256,8 @@ void IrradianceCache::serialize(Stream *stream, InstanceManager *manager) const
     stream->writeBool(m_clampNeighbor);
     stream->writeBool(m_useGradients);
     stream->writeSize(m_records.size());
-    for (uint32_t i=0; i<m_records.size(); ++i)
-        m_records[i]->serialize(stream);
+    for (const RecordList::ListItem *item = m_records.head(); item; item = item->next)
+        item->value->serialize(stream);
 }
 
 IrradianceCache::Record *IrradianceCache::put(const RayDifferential &ray, const Intersection &its,
@@ -348,8 +340,118 @@ void IrradianceCache::insert(Record *record) {
         record->p-Vector(1,1,1)*validRadius,
         record->p+Vector(1,1,1)*validRadius
     ));
-    LockGuard lock(m_mutex);
-    m_records.push_back(record);
+    m_records.prepend(record);
+}
+
+void IrradianceCache::insert(const IrradianceCache *cache) {
+    for (const RecordList::ListItem *item = cache->m_records.head(); item; item = item->next)
+        insert(new Record(item->value));
+}
+
+void IrradianceCache::save(const fs::path &filename) const {
+    size_t padding = sizeof(IrradianceCacheHeader) % MTS_IRRCACHE_FILE_ALIGNMENT;
+    if (padding)
+        padding = MTS_IRRCACHE_FILE_ALIGNMENT - padding;
+    size_t fileSize = sizeof(IrradianceCacheHeader) + padding
+        + m_records.size() * sizeof(Record);
+
+    Log(EInfo, "Writing %s irradiance cache with " SIZE_T_FMT " records to \"%s\" ..",
+        memString(fileSize).c_str(), m_records.size(), filename.string().c_str());
+
+    ref<MemoryMappedFile> mmap = new MemoryMappedFile(filename, fileSize);
+    uint8_t *ptr = (uint8_t *) mmap->getData();
+
+    IrradianceCacheHeader header;
+    memcpy(header.identifier, "IRC", 3);
+    header.version = MTS_IRRCACHE_FILE_VERSION;
+    header.recordSize = (uint32_t) sizeof(Record);
+    header.recordCount = (uint64_t) m_records.size();
+    memcpy(ptr, &header, sizeof(IrradianceCacheHeader));
+    memset(ptr + sizeof(IrradianceCacheHeader), 0, padding);
+    ptr += sizeof(IrradianceCacheHeader) + padding;
+
+    for (const RecordList::ListItem *item = m_records.head(); item; item = item->next) {
+        memcpy(ptr, item->value, sizeof(Record));
+        ptr += sizeof(Record);
+    }
+}
+
+static StatsCounter irradLoaded("Irradiance cache", "Reused records", EPercentage);
+
+size_t IrradianceCache::load(const fs::path &filename, const Scene *scene) {
+    ref<MemoryMappedFile> mmap = new MemoryMappedFile(filename);
+    const uint8_t *ptr = (const uint8_t *) mmap->getData();
+
+    size_t padding = sizeof(IrradianceCacheHeader) % MTS_IRRCACHE_FILE_ALIGNMENT;
+    if (padding)
+        padding = MTS_IRRCACHE_FILE_ALIGNMENT - padding;
+
+    const size_t offset = sizeof(IrradianceCacheHeader) + padding;
+    if (mmap->getSize() < offset) {
+        Log(EWarn, "Irradiance cache file \"%s\" is truncated -- ignoring.",
+            filename.string().c_str());
+        return 0;
+    }
+
+    IrradianceCacheHeader header;
+    memcpy(&header, ptr, sizeof(IrradianceCacheHeader));
+    ptr += offset;
+
+    if (header.identifier[0] != 'I' || header.identifier[1] != 'R' ||
+        header.identifier[2] != 'C' || header.version != MTS_IRRCACHE_FILE_VERSION) {
+        Log(EWarn, "\"%s\" is not a valid irradiance cache file -- ignoring.",
+            filename.string().c_str());
+        return 0;
+    } else if (header.recordSize != sizeof(Record)) {
+        Log(EWarn, "Irradiance cache file \"%s\" was created by a build with a different "
+            "floating point precision or spectral resolution -- ignoring.",
+            filename.string().c_str());
+        return 0;
+    } else if (header.recordCount > (mmap->getSize() - offset) / header.recordSize) {
+        /* Compare by division, since the product may overflow */
+        Log(EWarn, "Irradiance cache file \"%s\" is truncated -- ignoring.",
+            filename.string().c_str());
+        return 0;
+    }
+
+    /* Tolerance for the surface validation below */
+    const Float tolerance = m_sceneSize * 1e-4f;
+    const AABB &aabb = m_octree.getAABB();
+
+    ref<Timer> timer = new Timer();
+    size_t added = 0;
+    Intersection its;
+    for (size_t i=0; i<header.recordCount; ++i) {
+        Record *record = new Record();
+        memcpy(record, ptr, sizeof(Record));
+        ptr += sizeof(Record);
+
+        /* Check that the record still lies on a surface with a matching
+           orientation. Otherwise, the geometry has changed since the cache
+           file was created, and the record must be discarded */
+        bool valid = aabb.contains(record->p) && record->E.isValid();
+        if (valid) {
+            Ray ray(record->p + Vector(record->n) * tolerance,
+                -Vector(record->n), 0.0f, 2 * tolerance, 0.0f);
+            valid = scene->rayIntersect(ray, its) &&
+                dot(its.shFrame.n, record->n) > 1 - 1e-3f;
+        }
+
+        if (valid) {
+            insert(record);
+            ++added;
+        } else {
+            delete record;
+        }
+    }
+
+    irradLoaded.incrementBase(header.recordCount);
+    irradLoaded += added;
+
+    Log(EInfo, "Loaded " SIZE_T_FMT "/" SIZE_T_FMT " irradiance records from \"%s\" (took %i ms)",
+        added, (size_t) header.recordCount, filename.string().c_str(), timer->getMilliseconds());
+
+    return added;
 }
 
 static StatsCounter irradHits("Irradiance cache", "Hits");
@@ -19,22 +19,27 @@
 #include <mitsuba/render/photonmap.h>
 #include <mitsuba/render/scene.h>
 #include <mitsuba/render/phase.h>
+#include <mitsuba/core/statistics.h>
 #include <fstream>
 
 MTS_NAMESPACE_BEGIN
 
+static StatsCounter photonMemory("Memory usage", "Photon maps", EMemoryUsage);
+
 PhotonMap::PhotonMap(size_t photonCount)
-        : m_kdtree(0, PhotonTree::ESlidingMidpoint), m_scale(1.0f) {
+        : m_kdtree(0, PhotonTree::ESlidingMidpoint), m_scale(1.0f), m_memoryUsage(0) {
     m_kdtree.reserve(photonCount);
+    updateMemoryUsage();
     Assert(Photon::m_precompTableReady);
 }
 
 PhotonMap::PhotonMap(Stream *stream, InstanceManager *manager)
     : SerializableObject(stream, manager),
-      m_kdtree(0, PhotonTree::ESlidingMidpoint) {
+      m_kdtree(0, PhotonTree::ESlidingMidpoint), m_memoryUsage(0) {
     Assert(Photon::m_precompTableReady);
     m_scale = (Float) stream->readFloat();
     m_kdtree.resize(stream->readSize());
+    updateMemoryUsage();
     m_kdtree.setDepth(stream->readSize());
     m_kdtree.setAABB(AABB(stream));
     for (size_t i=0; i<m_kdtree.size(); ++i)
@@ -53,6 +58,16 @@ void PhotonMap::serialize(Stream *stream, InstanceManager *manager) const {
 }
 
 PhotonMap::~PhotonMap() {
+    photonMemory.recordRelease(m_memoryUsage);
+}
+
+void PhotonMap::updateMemoryUsage() {
+    size_t usage = m_kdtree.capacity() * sizeof(Photon);
+    if (usage > m_memoryUsage)
+        photonMemory.recordAllocation(usage - m_memoryUsage);
+    else
+        photonMemory.recordRelease(m_memoryUsage - usage);
+    m_memoryUsage = usage;
 }
 
 std::string PhotonMap::toString() const {
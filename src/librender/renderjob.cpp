@@ -38,7 +38,7 @@ RenderJob::RenderJob(const std::string &threadName,
 
     /* Register the scene with the scheduler if needed */
     if (sceneResID == -1) {
-        m_sceneResID = sched->registerResource(m_scene);
+        m_sceneResID = sched->registerReplicatedResource(m_scene);
         m_ownsSceneResource = true;
     } else {
         m_sceneResID = sceneResID;
@@ -63,7 +63,7 @@ RenderJob::RenderJob(const std::string &threadName,
             clonedSampler->incRef();
             samplers[i] = clonedSampler.get();
         }
-        m_samplerResID = sched->registerMultiResource(samplers);
+        m_samplerResID = sched->registerMultiResource(samplers, true);
         for (size_t i=0; i<sched->getCoreCount(); ++i)
             samplers[i]->decRef();
         m_ownsSamplerResource = true;
@@ -17,6 +17,7 @@
 */
 
 #include <mitsuba/core/statistics.h>
+#include <mitsuba/core/profiler.h>
 #include <mitsuba/core/sfcurve.h>
 #include <mitsuba/render/renderproc.h>
 #include <mitsuba/render/rectwu.h>
@@ -141,18 +142,20 @@ ref<WorkProcessor> BlockedRenderProcess::createWorkProcessor() const {
 
 void BlockedRenderProcess::processResult(const WorkResult *result, bool cancelled) {
     const ImageBlock *block = static_cast<const ImageBlock *>(result);
+    /* Neighboring blocks only overlap along their borders, hence the
+       film can merge them without holding the process-wide lock */
+    {
+        MTS_PROFILE_SCOPE(EProfilerFilm);
+        m_film->putConcurrent(block);
+    }
     UniqueLock lock(m_resultMutex);
-    m_film->put(block);
     m_progress->update(++m_resultCount);
     lock.unlock();
     m_queue->signalWorkEnd(m_parent, block, cancelled);
 }
 
-ParallelProcess::EStatus BlockedRenderProcess::generateWork(WorkUnit *unit, int worker) {
-    EStatus status = BlockedImageProcess::generateWork(unit, worker);
-    if (status == ESuccess)
-        m_queue->signalWorkBegin(m_parent, static_cast<RectangularWorkUnit *>(unit), worker);
-    return status;
+void BlockedRenderProcess::handleWorkBegin(const WorkUnit *unit, int worker) {
+    m_queue->signalWorkBegin(m_parent, static_cast<const RectangularWorkUnit *>(unit), worker);
 }
 
 void BlockedRenderProcess::bindResource(const std::string &name, int id) {
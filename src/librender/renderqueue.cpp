@@ -21,6 +21,7 @@
 
 MTS_NAMESPACE_BEGIN
 
+void RenderListener::startJobEvent(const RenderJob *job) { }
 void RenderListener::workBeginEvent(const RenderJob *job, const RectangularWorkUnit *wu, int worker) { }
 void RenderListener::workEndEvent(const RenderJob *job, const ImageBlock *wr, bool cancelled) { }
 void RenderListener::workCanceledEvent(const RenderJob *job, const Point2i &offset, const Vector2i &size) { }
@@ -43,6 +44,7 @@ void RenderQueue::addJob(RenderJob *job) {
     LockGuard lock(m_mutex);
     m_jobs[job] = JobRecord(m_timer->getMilliseconds());
     job->incRef();
+    signalStartJob(job);
 }
 
 void RenderQueue::registerListener(RenderListener *listener) {
@@ -82,13 +84,14 @@ void RenderQueue::removeJob(RenderJob *job, bool cancelled) {
     std::map<RenderJob *, JobRecord>::iterator it = m_jobs.find(job);
     if (it == m_jobs.end())
         Log(EError, "RenderQueue::removeRenderJob() - job not found!");
+    /* Notify listeners while the job is still known (e.g. to query its render time) */
+    signalFinishJob(job, cancelled);
     m_jobs.erase(job);
     m_cond->broadcast();
     {
         LockGuard lockJoin(m_joinMutex);
         m_joinList.push_back(job);
     }
-    signalFinishJob(job, cancelled);
 }
 
 void RenderQueue::waitLeft(size_t njobs) const {
@@ -110,6 +113,12 @@ void RenderQueue::join() const {
     m_joinList.clear();
 }
 
+void RenderQueue::signalStartJob(const RenderJob *job) {
+    LockGuard lock(m_mutex);
+    for (size_t i=0; i<m_listeners.size(); ++i)
+        m_listeners[i]->startJobEvent(job);
+}
+
 void RenderQueue::signalWorkBegin(const RenderJob *job, const RectangularWorkUnit *wu, int worker) {
     LockGuard lock(m_mutex);
     for (size_t i=0; i<m_listeners.size(); ++i)
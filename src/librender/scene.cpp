@@ -30,7 +30,8 @@ MTS_NAMESPACE_BEGIN
 // ===========================================================================
 
 Scene::Scene()
- : NetworkedObject(Properties()), m_blockSize(DEFAULT_BLOCKSIZE) {
+ : NetworkedObject(Properties()), m_blockSize(DEFAULT_BLOCKSIZE),
+   m_useEmitterTree(true) {
     m_kdtree = new ShapeKDTree();
     m_sourceFile = new fs::path();
     m_destinationFile = new fs::path();
@@ -76,6 +77,9 @@ Scene::Scene(const Properties &props)
        in succession before a leaf node will be created.*/
     if (props.hasProperty("kdMaxBadRefines"))
         m_kdtree->setMaxBadRefines(props.getInteger("kdMaxBadRefines"));
+    /* Choose emitters for direct illumination sampling based on their
+       estimated contribution at the reference point? */
+    m_useEmitterTree = props.getBoolean("emitterTree", true);
     m_sourceFile = new fs::path();
     m_destinationFile = new fs::path();
 }
@@ -90,6 +94,8 @@ Scene::Scene(Scene *scene) : NetworkedObject(Properties()) {
     m_sourceFile = new fs::path(*scene->m_sourceFile);
     m_destinationFile = new fs::path(*scene->m_destinationFile);
     m_emitterPDF = scene->m_emitterPDF;
+    m_emitterTree = scene->m_emitterTree;
+    m_useEmitterTree = scene->m_useEmitterTree;
     m_shapes = scene->m_shapes;
     m_sensors = scene->m_sensors;
     m_meshes = scene->m_meshes;
@@ -119,6 +125,7 @@ Scene::Scene(Stream *stream, InstanceManager *manager)
     m_blockSize = stream->readUInt();
     m_degenerateSensor = stream->readBool();
     m_degenerateEmitters = stream->readBool();
+    m_useEmitterTree = stream->readBool();
     m_aabb = AABB(stream);
     m_environmentEmitter = static_cast<Emitter *>(manager->getInstance(stream));
     m_sourceFile = new fs::path(stream->readString());
@@ -185,6 +192,7 @@ void Scene::serialize(Stream *stream, InstanceManager *manager) const {
     stream->writeUInt(m_blockSize);
     stream->writeBool(m_degenerateSensor);
     stream->writeBool(m_degenerateEmitters);
+    stream->writeBool(m_useEmitterTree);
     m_aabb.serialize(stream);
     manager->serialize(stream, m_environmentEmitter.get());
     stream->writeString(m_sourceFile->string());
@@ -419,6 +427,21 @@ void Scene::initialize() {
             m_emitterPDF.append(it->get()->getSamplingWeight());
 
         m_emitterPDF.normalize();
+
+        /* Build a hierarchy to choose among many emitters based on their
+           estimated contribution at the reference point */
+        size_t finiteEmitters = 0;
+        for (ref_vector<Emitter>::iterator it = m_emitters.begin();
+                it != m_emitters.end(); ++it) {
+            if (!(*it)->isEnvironmentEmitter() &&
+                !((*it)->getType() & Emitter::EDeltaDirection))
+                ++finiteEmitters;
+        }
+        if (m_useEmitterTree && finiteEmitters > 1) {
+            m_emitterTree = new EmitterTree(m_emitters);
+            Log(EDebug, "Built an emitter hierarchy over " SIZE_T_FMT " emitters",
+                m_emitterTree->getEmitterCount());
+        }
     }
 
     initializeBidirectional();
@@ -485,8 +508,16 @@ bool Scene::preprocess(RenderQueue *queue, const RenderJob *job,
 bool Scene::render(RenderQueue *queue, const RenderJob *job,
         int sceneResID, int sensorResID, int samplerResID) {
     m_sensor->getFilm()->clear();
+#if defined(MTS_ENABLE_PROFILER)
+    Profiler::getInstance()->reset();
+    bool success = m_integrator->render(this, queue, job, sceneResID,
+        sensorResID, samplerResID);
+    Profiler::getInstance()->printReport();
+    return success;
+#else
     return m_integrator->render(this, queue, job, sceneResID,
         sensorResID, samplerResID);
+#endif
 }
 
 void Scene::cancel() {
@@ -868,19 +899,19 @@ Spectrum Scene::evalTransmittanceAll(const Point &p1, bool p1OnSurface, const Po
 
 Spectrum Scene::sampleEmitterDirect(DirectSamplingRecord &dRec,
         const Point2 &_sample, bool testVisibility) const {
+    MTS_PROFILE_SCOPE(EProfilerEmitterSample);
     Point2 sample(_sample);
 
     /* Randomly pick an emitter */
     Float emPdf;
-    size_t index = m_emitterPDF.sampleReuse(sample.x, emPdf);
-    const Emitter *emitter = m_emitters[index].get();
+    const Emitter *emitter = sampleEmitterDiscrete(dRec.ref, sample.x, emPdf);
     Spectrum value = emitter->sampleDirect(dRec, sample);
 
     if (dRec.pdf != 0) {
         if (testVisibility) {
             Ray ray(dRec.ref, dRec.d, Epsilon,
                     dRec.dist*(1-ShadowEpsilon), dRec.time);
-            if (m_kdtree->rayIntersect(ray))
+            if (rayIntersect(ray))
                 return Spectrum(0.0f);
         }
         dRec.object = emitter;
@@ -894,12 +925,12 @@ Spectrum Scene::sampleEmitterDirect(DirectSamplingRecord &dRec,
 
 Spectrum Scene::sampleAttenuatedEmitterDirect(DirectSamplingRecord &dRec,
         const Medium *medium, int &interactions, const Point2 &_sample, Sampler *sampler) const {
+    MTS_PROFILE_SCOPE(EProfilerEmitterSample);
     Point2 sample(_sample);
 
     /* Randomly pick an emitter */
     Float emPdf;
-    size_t index = m_emitterPDF.sampleReuse(sample.x, emPdf);
-    const Emitter *emitter = m_emitters[index].get();
+    const Emitter *emitter = sampleEmitterDiscrete(dRec.ref, sample.x, emPdf);
     Spectrum value = emitter->sampleDirect(dRec, sample);
 
     if (dRec.pdf != 0) {
@@ -917,12 +948,12 @@ Spectrum Scene::sampleAttenuatedEmitterDirect(DirectSamplingRecord &dRec,
 Spectrum Scene::sampleAttenuatedEmitterDirect(DirectSamplingRecord &dRec,
         const Intersection &its, const Medium *medium, int &interactions,
         const Point2 &_sample, Sampler *sampler) const {
+    MTS_PROFILE_SCOPE(EProfilerEmitterSample);
     Point2 sample(_sample);
 
     /* Randomly pick an emitter */
     Float emPdf;
-    size_t index = m_emitterPDF.sampleReuse(sample.x, emPdf);
-    const Emitter *emitter = m_emitters[index].get();
+    const Emitter *emitter = sampleEmitterDiscrete(dRec.ref, sample.x, emPdf);
     Spectrum value = emitter->sampleDirect(dRec, sample);
 
     if (dRec.pdf != 0) {
@@ -946,7 +977,7 @@ Spectrum Scene::sampleSensorDirect(DirectSamplingRecord &dRec,
         if (testVisibility) {
             Ray ray(dRec.ref, dRec.d, Epsilon,
                     dRec.dist*(1-ShadowEpsilon), dRec.time);
-            if (m_kdtree->rayIntersect(ray))
+            if (rayIntersect(ray))
                 return Spectrum(0.0f);
         }
         dRec.object = m_sensor.get();
@@ -989,7 +1020,7 @@ Spectrum Scene::sampleAttenuatedSensorDirect(DirectSamplingRecord &dRec,
 
 Float Scene::pdfEmitterDirect(const DirectSamplingRecord &dRec) const {
     const Emitter *emitter = static_cast<const Emitter *>(dRec.object);
-    return emitter->pdfDirect(dRec) * pdfEmitterDiscrete(emitter);
+    return emitter->pdfDirect(dRec) * pdfEmitterDiscrete(emitter, dRec.ref);
 }
 
 Float Scene::pdfSensorDirect(const DirectSamplingRecord &dRec) const {
@@ -27,6 +27,11 @@
 
 MTS_NAMESPACE_BEGIN
 
+namespace stats {
+    StatsCounter kdtreeMemory("Memory usage", "Kd-trees", EMemoryUsage);
+    StatsCounter kdtreeBuildMemory("Memory usage", "Kd-tree construction", EMemoryUsage);
+}
+
 ShapeKDTree::ShapeKDTree() {
 #if !defined(MTS_KD_CONSERVE_MEMORY)
     m_triAccel = NULL;
@@ -36,8 +41,10 @@ ShapeKDTree::ShapeKDTree() {
 
 ShapeKDTree::~ShapeKDTree() {
 #if !defined(MTS_KD_CONSERVE_MEMORY)
-    if (m_triAccel)
+    if (m_triAccel) {
         freeAligned(m_triAccel);
+        stats::kdtreeMemory.recordRelease(sizeof(TriAccel) * getPrimitiveCount());
+    }
 #endif
     for (size_t i=0; i<m_shapes.size(); ++i)
         m_shapes[i]->decRef();
@@ -77,6 +84,7 @@ void ShapeKDTree::build() {
     Log(EDebug, "Precomputing triangle intersection information (%s)",
             memString(sizeof(TriAccel)*primCount).c_str());
     m_triAccel = static_cast<TriAccel *>(allocAligned(primCount * sizeof(TriAccel)));
+    stats::kdtreeMemory.recordAllocation(primCount * sizeof(TriAccel));
 
     IndexType idx = 0;
     for (IndexType i=0; i<m_shapes.size(); ++i) {
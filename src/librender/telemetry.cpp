@@ -0,0 +1,191 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/telemetry.h>
+#include <mitsuba/render/renderjob.h>
+#include <mitsuba/render/scene.h>
+#include <mitsuba/render/imageblock.h>
+#include <mitsuba/core/statistics.h>
+#include <mitsuba/core/version.h>
+#include <boost/filesystem/fstream.hpp>
+#include <ctime>
+
+MTS_NAMESPACE_BEGIN
+
+RenderTelemetry::RenderTelemetry(bool workUnitRecords)
+        : m_workUnitRecords(workUnitRecords) {
+    m_timer = new Timer();
+    m_mutex = new Mutex();
+}
+
+fs::path RenderTelemetry::getTelemetryPath(const Scene *scene) {
+    fs::path path = scene->getDestinationFile();
+    path.replace_extension(".jsonl");
+    return path;
+}
+
+void RenderTelemetry::startJobEvent(const RenderJob *job) {
+    Statistics::Snapshot counters = Statistics::getInstance()->getSnapshot();
+    LockGuard lock(m_mutex);
+    JobRecord &record = m_jobs[job];
+    record.counters.swap(counters);
+    record.hasCounters = true;
+}
+
+void RenderTelemetry::workBeginEvent(const RenderJob *job,
+        const RectangularWorkUnit *wu, int worker) {
+    LockGuard lock(m_mutex);
+    m_jobs[job].pending[std::make_pair(wu->getOffset().x, wu->getOffset().y)] =
+        std::make_pair(m_timer->getMilliseconds(), worker);
+}
+
+void RenderTelemetry::workEndEvent(const RenderJob *job,
+        const ImageBlock *block, bool cancelled) {
+    LockGuard lock(m_mutex);
+    JobRecord &record = m_jobs[job];
+    std::pair<int, int> key(block->getOffset().x, block->getOffset().y);
+    std::map<std::pair<int, int>, std::pair<unsigned int, int> >::iterator it
+        = record.pending.find(key);
+    if (it == record.pending.end())
+        return;
+
+    WorkUnitRecord wu;
+    wu.offset = block->getOffset();
+    wu.size = block->getSize();
+    wu.worker = it->second.second;
+    wu.time = (m_timer->getMilliseconds() - it->second.first) / 1000.0f;
+    wu.cancelled = cancelled;
+    record.finished.push_back(wu);
+    record.pending.erase(it);
+}
+
+void RenderTelemetry::finishJobEvent(const RenderJob *job, bool cancelled) {
+    write(job, cancelled);
+
+    LockGuard lock(m_mutex);
+    m_jobs.erase(job);
+}
+
+void RenderTelemetry::write(const RenderJob *job, bool cancelled) {
+    const Scene *scene = job->getScene();
+    Statistics *statistics = Statistics::getInstance();
+
+    /* Counters are reported relative to the previous snapshot of this job,
+       or cumulatively when the listener was registered after the job began */
+    std::vector<WorkUnitRecord> workUnits;
+    Statistics::Snapshot counters = statistics->getSnapshot();
+    bool hasCounters = false;
+    {
+        LockGuard lock(m_mutex);
+        std::map<const RenderJob *, JobRecord>::iterator it = m_jobs.find(job);
+        if (it != m_jobs.end()) {
+            workUnits.swap(it->second.finished);
+            counters.swap(it->second.counters);
+            hasCounters = it->second.hasCounters;
+            it->second.hasCounters = true;
+        }
+    }
+
+    char timestamp[32];
+    std::time_t now = std::time(NULL);
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    std::string sceneName = jsonString(scene->getSourceFile().string());
+
+    std::ostringstream oss;
+    if (m_workUnitRecords) {
+        for (size_t i=0; i<workUnits.size(); ++i) {
+            const WorkUnitRecord &wu = workUnits[i];
+            oss << "{\"type\": \"workunit\", \"timestamp\": \"" << timestamp << "\""
+                << ", \"scene\": " << sceneName
+                << ", \"offset\": [" << wu.offset.x << ", " << wu.offset.y << "]"
+                << ", \"size\": [" << wu.size.x << ", " << wu.size.y << "]"
+                << ", \"worker\": " << wu.worker
+                << ", \"time\": " << wu.time
+                << ", \"cancelled\": " << (wu.cancelled ? "true" : "false") << "}" << endl;
+        }
+    }
+
+    Float renderTime = job->getRenderTime();
+    Float minTime = 0, maxTime = 0, totalTime = 0;
+    size_t cancelledCount = 0;
+    for (size_t i=0; i<workUnits.size(); ++i) {
+        Float time = workUnits[i].time;
+        minTime = (i == 0) ? time : std::min(minTime, time);
+        maxTime = std::max(maxTime, time);
+        totalTime += time;
+        if (workUnits[i].cancelled)
+            ++cancelledCount;
+    }
+
+    const StatsCounter *normalRays = statistics->getCounter("General", "Normal rays traced"),
+                       *shadowRays = statistics->getCounter("General", "Shadow rays traced");
+    uint64_t normalRayCount = 0, shadowRayCount = 0;
+    if (normalRays)
+        normalRayCount = hasCounters ? Statistics::getIncrease(normalRays, counters) : normalRays->getValue();
+    if (shadowRays)
+        shadowRayCount = hasCounters ? Statistics::getIncrease(shadowRays, counters) : shadowRays->getValue();
+
+    const Film *film = scene->getFilm();
+    const Sampler *sampler = scene->getSampler();
+    const ShapeKDTree *kdtree = scene->getKDTree();
+
+    oss << "{\"type\": \"render\", \"timestamp\": \"" << timestamp << "\""
+        << ", \"version\": \"" << MTS_VERSION << "\""
+        << ", \"host\": " << jsonString(getHostName())
+        << ", \"scene\": " << sceneName
+        << ", \"output\": " << jsonString(scene->getDestinationFile().string())
+        << ", \"integrator\": " << jsonString(scene->getIntegrator()->getClass()->getName())
+        << ", \"sampler\": " << jsonString(sampler->getClass()->getName())
+        << ", \"resolution\": [" << film->getCropSize().x << ", " << film->getCropSize().y << "]"
+        << ", \"sampleCount\": " << sampler->getSampleCount()
+        << ", \"cores\": " << Scheduler::getInstance()->getCoreCount()
+        << ", \"cancelled\": " << (cancelled ? "true" : "false")
+        << ", \"renderTime\": " << renderTime
+        << ", \"workUnits\": {\"count\": " << workUnits.size()
+        << ", \"cancelled\": " << cancelledCount
+        << ", \"minTime\": " << minTime
+        << ", \"meanTime\": " << (workUnits.empty() ? 0 : totalTime / workUnits.size())
+        << ", \"maxTime\": " << maxTime << "}"
+        << ", \"rays\": {\"normal\": " << normalRayCount
+        << ", \"shadow\": " << shadowRayCount
+        << ", \"perSecond\": " << (renderTime > 0 ? (normalRayCount + shadowRayCount) / renderTime : 0) << "}";
+
+    if (kdtree && kdtree->isBuilt()) {
+        oss << ", \"kdtree\": {\"primitives\": " << kdtree->getPrimitiveCount()
+            << ", \"nodes\": " << kdtree->getNodeCount()
+            << ", \"indices\": " << kdtree->getIndexCount()
+            << ", \"buildTime\": " << kdtree->getBuildTime()
+            << ", \"cost\": " << kdtree->getHeuristicCost() << "}";
+    }
+
+    oss << ", \"memory\": {\"current\": " << getPrivateMemoryUsage()
+        << ", \"peak\": " << getPeakMemoryUsage() << "}"
+        << ", \"counters\": " << statistics->getStatsJSON(hasCounters ? &counters : NULL) << "}" << endl;
+
+    fs::path path = getTelemetryPath(scene);
+    fs::ofstream os(path, std::ios::out | std::ios::app);
+    if (!os.good()) {
+        Log(EWarn, "Could not write render telemetry to \"%s\"!", path.string().c_str());
+        return;
+    }
+    os << oss.str();
+    Log(EInfo, "Render telemetry appended to \"%s\"", path.filename().string().c_str());
+}
+
+MTS_IMPLEMENT_CLASS(RenderTelemetry, false, RenderListener)
+MTS_NAMESPACE_END
@@ -0,0 +1,195 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <mitsuba/render/texcache.h>
+#include <mitsuba/core/statistics.h>
+
+MTS_NAMESPACE_BEGIN
+
+static StatsCounter tileCacheHits("Texture system", "Tile cache hits", EPercentage);
+static StatsCounter tilesLoaded("Texture system", "Texture tile data loaded", EByteCount);
+static StatsCounter tilesEvicted("Texture system", "Texture tiles evicted");
+static StatsCounter tileMemory("Memory usage", "Texture tile cache", EMemoryUsage);
+
+TextureTileCache::TextureTileCache() : m_budget(1024 * 1024 * 1024) {
+    for (int i=0; i<MTS_TEXCACHE_SHARDS; ++i) {
+        Shard &shard = m_shards[i];
+        shard.mutex = new Mutex();
+        shard.head = shard.tail = NULL;
+        shard.usage = 0;
+    }
+}
+
+TextureTileCache::~TextureTileCache() {
+    for (int i=0; i<MTS_TEXCACHE_SHARDS; ++i) {
+        Shard &shard = m_shards[i];
+        for (Tile *tile = shard.head, *next; tile; tile = next) {
+            next = tile->next;
+            freeAligned(tile->data);
+            delete tile;
+        }
+    }
+}
+
+TextureTileCache *TextureTileCache::getInstance() {
+    /* Intentionally never released, since textures may still
+       be destructed during static shutdown */
+    static ref<TextureTileCache> *instance =
+        new ref<TextureTileCache>(new TextureTileCache());
+    return instance->get();
+}
+
+void TextureTileCache::setMemoryBudget(size_t budget) {
+    m_budget = budget;
+    for (int i=0; i<MTS_TEXCACHE_SHARDS; ++i) {
+        LockGuard lock(m_shards[i].mutex);
+        evict(m_shards[i]);
+    }
+}
+
+size_t TextureTileCache::getMemoryUsage() const {
+    size_t usage = 0;
+    for (int i=0; i<MTS_TEXCACHE_SHARDS; ++i) {
+        LockGuard lock(m_shards[i].mutex);
+        usage += m_shards[i].usage;
+    }
+    return usage;
+}
+
+const TextureTileCache::Tile *TextureTileCache::acquire(const TileSource *source,
+        int level, int x, int y) {
+    TileKey key;
+    key.source = source; key.level = level;
+    key.x = x; key.y = y;
+    size_t hash = TileKeyHash()(key);
+    Shard &shard = m_shards[(hash >> 8) % MTS_TEXCACHE_SHARDS];
+
+    tileCacheHits.incrementBase();
+    {
+        LockGuard lock(shard.mutex);
+        boost::unordered_map<TileKey, Tile *, TileKeyHash>::iterator it
+            = shard.tiles.find(key);
+        if (EXPECT_TAKEN(it != shard.tiles.end())) {
+            Tile *tile = it->second;
+            if (tile != shard.head) {
+                unlink(shard, tile);
+                pushFront(shard, tile);
+            }
+            atomicAdd(&tile->pins, 1);
+            ++tileCacheHits;
+            return tile;
+        }
+    }
+
+    /* Cache miss -- load the tile without holding the lock */
+    Tile *tile = new Tile();
+    tile->key = key;
+    tile->size = source->getTileBytes();
+    tile->data = static_cast<uint8_t *>(allocAligned(tile->size));
+    tile->pins = 1;
+    source->loadTile(level, x, y, tile->data);
+    tilesLoaded += tile->size;
+
+    LockGuard lock(shard.mutex);
+    std::pair<boost::unordered_map<TileKey, Tile *, TileKeyHash>::iterator, bool> result
+        = shard.tiles.insert(std::make_pair(key, tile));
+
+    if (!result.second) {
+        /* Another thread loaded the same tile in the meantime */
+        freeAligned(tile->data);
+        delete tile;
+        tile = result.first->second;
+        atomicAdd(&tile->pins, 1);
+    } else {
+        pushFront(shard, tile);
+        shard.usage += tile->size;
+        tileMemory.recordAllocation(tile->size);
+        evict(shard);
+    }
+
+    return tile;
+}
+
+void TextureTileCache::lookup(const TileSource *source, int level, int x, int y,
+        size_t offset, void *target, size_t size) {
+    const Tile *tile = acquire(source, level, x, y);
+    memcpy(target, tile->data + offset, size);
+    unpin(tile);
+}
+
+void TextureTileCache::release(const TileSource *source) {
+    for (int i=0; i<MTS_TEXCACHE_SHARDS; ++i) {
+        Shard &shard = m_shards[i];
+        LockGuard lock(shard.mutex);
+        for (Tile *tile = shard.head, *next; tile; tile = next) {
+            next = tile->next;
+            if (tile->key.source != source)
+                continue;
+            unlink(shard, tile);
+            shard.tiles.erase(tile->key);
+            shard.usage -= tile->size;
+            tileMemory.recordRelease(tile->size);
+            freeAligned(tile->data);
+            delete tile;
+        }
+    }
+}
+
+void TextureTileCache::unlink(Shard &shard, Tile *tile) {
+    if (tile->prev)
+        tile->prev->next = tile->next;
+    else
+        shard.head = tile->next;
+    if (tile->next)
+        tile->next->prev = tile->prev;
+    else
+        shard.tail = tile->prev;
+    tile->prev = tile->next = NULL;
+}
+
+void TextureTileCache::pushFront(Shard &shard, Tile *tile) {
+    tile->prev = NULL;
+    tile->next = shard.head;
+    if (shard.head)
+        shard.head->prev = tile;
+    else
+        shard.tail = tile;
+    shard.head = tile;
+}
+
+void TextureTileCache::evict(Shard &shard) {
+    /* Tiles are only pinned while holding the lock, hence
+       a tile without pins can safely be released here */
+    size_t budget = m_budget / MTS_TEXCACHE_SHARDS;
+    for (Tile *tile = shard.tail, *prev; tile && shard.usage > budget; tile = prev) {
+        prev = tile->prev;
+        if (tile->pins > 0)
+            continue;
+        unlink(shard, tile);
+        shard.tiles.erase(tile->key);
+        shard.usage -= tile->size;
+        tileMemory.recordRelease(tile->size);
+        freeAligned(tile->data);
+        delete tile;
+        ++tilesEvicted;
+    }
+}
+
+MTS_IMPLEMENT_CLASS(TextureTileCache, false, Object)
+MTS_NAMESPACE_END
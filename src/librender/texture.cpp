@@ -23,6 +23,7 @@ MTS_NAMESPACE_BEGIN
 
 namespace stats {
     StatsCounter mipStorage("Texture system", "Cumulative MIP map memory allocations", EByteCount);
+    StatsCounter mipMemory("Memory usage", "MIP maps", EMemoryUsage);
     StatsCounter clampedAnisotropy("Texture system", "Lookups with clamped anisotropy", EPercentage);
     StatsCounter avgEWASamples("Texture system", "Average EWA samples / lookup", EAverage);
     StatsCounter filteredLookups("Texture system", "Filtered texture lookups", EPercentage);
@@ -24,6 +24,7 @@
 #include <mitsuba/core/timer.h>
 #include <mitsuba/core/lock.h>
 #include <mitsuba/core/properties.h>
+#include <mitsuba/core/statistics.h>
 #include <mitsuba/render/subsurface.h>
 #include <mitsuba/render/medium.h>
 #include <mitsuba/render/bsdf.h>
@@ -37,6 +38,8 @@
 
 MTS_NAMESPACE_BEGIN
 
+static StatsCounter meshMemory("Memory usage", "Triangle meshes", EMemoryUsage);
+
 TriMesh::TriMesh(const std::string &name, size_t triangleCount,
         size_t vertexCount, bool hasNormals, bool hasTexcoords,
         bool hasVertexColors, bool flipNormals, bool faceNormals)
@@ -52,6 +55,7 @@ TriMesh::TriMesh(const std::string &name, size_t triangleCount,
     m_tangents = NULL;
     m_surfaceArea = m_invSurfaceArea = -1;
     m_mutex = new Mutex();
+    m_memoryUsage = 0;
 }
 
 TriMesh::TriMesh(const Properties &props)
@@ -74,6 +78,7 @@ TriMesh::TriMesh(const Properties &props)
     m_triangles = NULL;
     m_surfaceArea = m_invSurfaceArea = -1;
     m_mutex = new Mutex();
+    m_memoryUsage = 0;
 }
 
 TriMesh::TriMesh(Stream *stream, int index)
@@ -82,6 +87,7 @@ TriMesh::TriMesh(Stream *stream, int index)
     m_tangents(NULL), m_colors(NULL) {
 
     m_mutex = new Mutex();
+    m_memoryUsage = 0;
     loadCompressed(stream, index);
 }
 
@@ -141,6 +147,7 @@ TriMesh::TriMesh(Stream *stream, InstanceManager *manager)
     m_flipNormals = false;
     m_surfaceArea = m_invSurfaceArea = -1;
     m_mutex = new Mutex();
+    m_memoryUsage = 0;
     configure();
 }
 
@@ -349,6 +356,7 @@ TriMesh::~TriMesh() {
         delete[] m_colors;
     if (m_triangles)
         delete[] m_triangles;
+    meshMemory.recordRelease(m_memoryUsage);
 }
 
 AABB TriMesh::getAABB() const {
@@ -383,6 +391,27 @@ void TriMesh::configure() {
     /* For manifold exploration: always compute UV tangents when a glossy material
        is involved. TODO: find a way to avoid this expense (compute on demand?) */
     computeUVTangents();
+
+    updateMemoryUsage();
+}
+
+void TriMesh::updateMemoryUsage() {
+    size_t usage = m_triangleCount * sizeof(Triangle)
+        + m_vertexCount * sizeof(Point);
+    if (m_normals)
+        usage += m_vertexCount * sizeof(Normal);
+    if (m_texcoords)
+        usage += m_vertexCount * sizeof(Point2);
+    if (m_colors)
+        usage += m_vertexCount * sizeof(Color3);
+    if (m_tangents)
+        usage += m_triangleCount * sizeof(TangentSpace);
+
+    if (usage > m_memoryUsage)
+        meshMemory.recordAllocation(usage - m_memoryUsage);
+    else
+        meshMemory.recordRelease(m_memoryUsage - usage);
+    m_memoryUsage = usage;
 }
 
 void TriMesh::prepareSamplingTable() {
@@ -19,10 +19,12 @@
 #include <mitsuba/render/vpl.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/statistics.h>
+#include <queue>
 
 MTS_NAMESPACE_BEGIN
 
 static StatsCounter prunedVPLs("VPL renderer", "Pruned VPLs", EPercentage);
+static StatsCounter cutSize("VPL renderer", "Light tree cut size", EPercentage);
 
 static void appendVPL(const Scene *scene, Random *random,
     VPL &vpl, bool prune, std::deque<VPL> &vpls) {
@@ -209,6 +211,269 @@ size_t generateVPLs(const Scene *scene, Random *random,
     return offset;
 }
 
+/* ==================================================================== */
+/*                               VPLTree                                */
+/* ==================================================================== */
+
+namespace {
+    /// Sorts VPL indices along an axis (used during tree construction)
+    struct VPLAxisOrder {
+        VPLAxisOrder(const std::vector<VPL> &vpls, int axis)
+            : vpls(vpls), axis(axis) { }
+
+        inline bool operator()(uint32_t a, uint32_t b) const {
+            return vpls[a].its.p[axis] < vpls[b].its.p[axis];
+        }
+
+        const std::vector<VPL> &vpls;
+        int axis;
+    };
+
+    /// Cut node along with its error bound (used during cut selection)
+    struct CutEntry {
+        CutEntry(uint32_t node, Float bound) : node(node), bound(bound) { }
+
+        inline bool operator<(const CutEntry &other) const {
+            return bound < other.bound;
+        }
+
+        uint32_t node;
+        Float bound;
+    };
+}
+
+VPLTree::VPLTree(const std::deque<VPL> &vpls, Random *random)
+        : m_vpls(vpls.begin(), vpls.end()) {
+    std::vector<uint32_t> indices[3];
+    AABB aabb;
+
+    for (size_t i=0; i<m_vpls.size(); ++i) {
+        indices[m_vpls[i].type].push_back((uint32_t) i);
+        if (m_vpls[i].type != EDirectionalEmitterVPL)
+            aabb.expandBy(m_vpls[i].its.p);
+    }
+
+    /* Bound the inverse-squared falloff near the VPLs */
+    Float minDist = aabb.isValid() ? aabb.getExtents().length() * 1e-3f : 0.0f;
+    m_minDistSqr = std::max(minDist * minDist, std::numeric_limits<Float>::min());
+
+    m_nodes.reserve(2 * m_vpls.size());
+    for (int type=0; type<3; ++type) {
+        std::vector<uint32_t> &idx = indices[type];
+        if (idx.empty())
+            continue;
+        if (type == EDirectionalEmitterVPL) {
+            /* Directional VPLs are never clustered */
+            for (size_t i=0; i<idx.size(); ++i)
+                m_roots.push_back(build(&idx[i], &idx[i] + 1, random));
+        } else {
+            m_roots.push_back(build(&idx[0], &idx[0] + idx.size(), random));
+        }
+    }
+}
+
+uint32_t VPLTree::build(uint32_t *start, uint32_t *end, Random *random) {
+    uint32_t index = (uint32_t) m_nodes.size();
+    m_nodes.push_back(Node());
+
+    if (end - start == 1) {
+        const VPL &vpl = m_vpls[*start];
+        Node &node = m_nodes[index];
+        node.aabb = AABB(vpl.its.p);
+        node.axis = vpl.its.shFrame.n;
+        if (vpl.type == ESurfaceVPL && !(vpl.its.getBSDF()->getType() & BSDF::ETransmission))
+            node.angle = 0.0f;
+        else
+            node.angle = M_PI;
+        node.P = vpl.P;
+        node.emitterScale = vpl.emitterScale;
+        node.luminance = vpl.P.getLuminance();
+        node.representative = *start;
+        node.left = node.right = 0;
+        return index;
+    }
+
+    /* Split at the median along the largest axis of the position bounds */
+    AABB aabb;
+    for (uint32_t *it = start; it != end; ++it)
+        aabb.expandBy(m_vpls[*it].its.p);
+    uint32_t *mid = start + (end - start) / 2;
+    std::nth_element(start, mid, end, VPLAxisOrder(m_vpls, aabb.getLargestAxis()));
+
+    uint32_t left = build(start, mid, random);
+    uint32_t right = build(mid, end, random);
+
+    /* Note: 'm_nodes' may have been reallocated by the recursive calls */
+    const Node &l = m_nodes[left], &r = m_nodes[right];
+    Node &node = m_nodes[index];
+    node.aabb = aabb;
+    node.P = l.P + r.P;
+    node.emitterScale = l.emitterScale + r.emitterScale;
+    node.luminance = l.luminance + r.luminance;
+    node.left = left;
+    node.right = right;
+
+    /* Choose the representative proportional to luminance */
+    Float total = l.luminance + r.luminance;
+    if (total > 0)
+        node.representative = random->nextFloat() * total < l.luminance
+            ? l.representative : r.representative;
+    else
+        node.representative = l.representative;
+
+    /* Merge the normal cones (double cones, hence the axes may be flipped) */
+    Vector axis2 = dot(l.axis, r.axis) < 0 ? -r.axis : r.axis;
+    Float psi = unitAngle(l.axis, axis2);
+    if (l.angle >= psi + r.angle) {
+        node.axis = l.axis;
+        node.angle = l.angle;
+    } else if (r.angle >= psi + l.angle) {
+        node.axis = axis2;
+        node.angle = r.angle;
+    } else {
+        node.angle = (l.angle + psi + r.angle) * 0.5f;
+        if (node.angle >= M_PI * 0.5f) {
+            node.axis = l.axis;
+            node.angle = M_PI;
+        } else {
+            /* Rotate the left axis towards the right one */
+            Float rot = node.angle - l.angle;
+            node.axis = normalize(l.axis * std::sin(psi - rot) + axis2 * std::sin(rot));
+        }
+    }
+
+    return index;
+}
+
+Float VPLTree::getBound(const Node &node, const Point &p) const {
+    if (node.isLeaf())
+        return 0.0f;
+
+    Float distSqr = std::max(node.aabb.squaredDistanceTo(p), m_minDistSqr);
+    Float cosBound = 1.0f;
+
+    if (node.angle < M_PI * 0.5f) {
+        /* Bound the emission cosine over all directions from the box to 'p' */
+        Vector d = p - node.aabb.getCenter();
+        Float dist = d.length(), radius = node.aabb.getExtents().length() * 0.5f;
+        if (dist > radius) {
+            Float phi = unitAngle(node.axis, d / dist);
+            phi = std::min(phi, (Float) M_PI - phi);
+            Float alpha = math::safe_asin(radius / dist);
+            Float theta = phi - node.angle - alpha;
+            if (theta > 0)
+                cosBound = std::cos(theta);
+        }
+    }
+
+    return node.luminance * cosBound / distSqr;
+}
+
+Float VPLTree::getEstimate(const Node &node, const Point &p) const {
+    const VPL &vpl = m_vpls[node.representative];
+    if (vpl.type == EDirectionalEmitterVPL)
+        return node.luminance;
+
+    Vector d = p - vpl.its.p;
+    Float distSqr = std::max(d.lengthSquared(), m_minDistSqr);
+    Float cosTheta = 1.0f;
+    if (node.angle < M_PI * 0.5f && distSqr > m_minDistSqr)
+        cosTheta = absDot(vpl.its.shFrame.n, d) / std::sqrt(distSqr);
+
+    return node.luminance * cosTheta / distSqr;
+}
+
+void VPLTree::computeCut(const Point &p, Float maxError, size_t maxCutSize,
+        std::vector<uint32_t> &cut) const {
+    std::priority_queue<CutEntry> queue;
+    Float estimate = 0;
+    cut.clear();
+
+    for (size_t i=0; i<m_roots.size(); ++i) {
+        const Node &node = m_nodes[m_roots[i]];
+        queue.push(CutEntry(m_roots[i], getBound(node, p)));
+        estimate += getEstimate(node, p);
+    }
+
+    /* Refine the node with the largest error bound until all bounds are
+       small relative to the estimated total contribution */
+    while (!queue.empty() && queue.top().bound > 0 &&
+           queue.top().bound > maxError * estimate &&
+           queue.size() < maxCutSize) {
+        const Node &node = m_nodes[queue.top().node];
+        queue.pop();
+
+        const Node &l = m_nodes[node.left], &r = m_nodes[node.right];
+        estimate += getEstimate(l, p) + getEstimate(r, p) - getEstimate(node, p);
+        queue.push(CutEntry(node.left, getBound(l, p)));
+        queue.push(CutEntry(node.right, getBound(r, p)));
+    }
+
+    cut.reserve(cut.size() + queue.size());
+    while (!queue.empty()) {
+        cut.push_back(queue.top().node);
+        queue.pop();
+    }
+
+    cutSize += cut.size();
+    cutSize.incrementBase(m_vpls.size());
+}
+
+VPL VPLTree::getRepresentative(uint32_t index) const {
+    const Node &node = m_nodes[index];
+    VPL vpl = m_vpls[node.representative];
+    vpl.P = node.P;
+    vpl.emitterScale = node.emitterScale;
+    return vpl;
+}
+
+void VPLTree::computeSharedCut(const std::vector<Point> &points, Float maxError,
+        size_t maxCutSize, std::deque<VPL> &vpls) const {
+    /* Mark every node that was refined by at least one shading point */
+    std::vector<bool> refined(m_nodes.size(), false);
+    std::vector<uint32_t> cut;
+
+    for (size_t i=0; i<points.size(); ++i) {
+        computeCut(points[i], maxError, maxCutSize, cut);
+        for (size_t j=0; j<cut.size(); ++j) {
+            /* Nodes are stored in depth-first order, which makes it possible
+               to walk down from the enclosing root without parent links */
+            uint32_t node = cut[j];
+            uint32_t current = *(std::upper_bound(
+                m_roots.begin(), m_roots.end(), node) - 1);
+            while (current != node) {
+                refined[current] = true;
+                uint32_t right = m_nodes[current].right;
+                current = node < right ? m_nodes[current].left : right;
+            }
+        }
+    }
+
+    /* The shared cut consists of all unrefined nodes with a refined parent */
+    std::vector<uint32_t> stack(m_roots.rbegin(), m_roots.rend());
+    vpls.clear();
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        stack.pop_back();
+        if (refined[index]) {
+            stack.push_back(m_nodes[index].right);
+            stack.push_back(m_nodes[index].left);
+        } else {
+            vpls.push_back(getRepresentative(index));
+        }
+    }
+}
+
+std::string VPLTree::toString() const {
+    std::ostringstream oss;
+    oss << "VPLTree[" << endl
+        << "  vplCount = " << m_vpls.size() << "," << endl
+        << "  nodeCount = " << m_nodes.size() << "," << endl
+        << "  rootCount = " << m_roots.size() << endl
+        << "]";
+    return oss.str();
+}
+
 const char *toString(EVPLType type) {
     switch (type) {
         case EPointEmitterVPL: return "emitterVPL";
@@ -234,4 +499,5 @@ std::string VPL::toString() const {
     return oss.str();
 }
 
+MTS_IMPLEMENT_CLASS(VPLTree, false, Object)
 MTS_NAMESPACE_END
@@ -34,6 +34,7 @@
 #include <mitsuba/core/statistics.h>
 #include <mitsuba/render/renderjob.h>
 #include <mitsuba/render/scenehandler.h>
+#include <mitsuba/render/telemetry.h>
 #include <fstream>
 #include <stdexcept>
 #include <boost/algorithm/string.hpp>
@@ -71,14 +72,22 @@ void help() {
     cout <<  "                       out -- by default, \"~/mitsuba\" is used)" << endl << endl;
     cout <<  "   -s file     Connect to additional Mitsuba servers specified in a file" << endl;
     cout <<  "               with one name per line (same format as in -c)" << endl<< endl;
+    cout <<  "   -Z level    Compress work results sent back by mtssrv instances (zlib level" << endl;
+    cout <<  "               1-9, default: 0 = off). Useful on slow network links" << endl << endl;
+    cout <<  "   -B count    Number of work units kept in flight per remote core. Higher" << endl;
+    cout <<  "               values hide network latency (default: " << MTS_BACKLOG_FACTOR << ")" << endl << endl;
     cout <<  "   -j count    Simultaneously schedule several scenes. Can sometimes accelerate" << endl;
     cout <<  "               rendering when large amounts of processing power are available" << endl;
     cout <<  "               (e.g. when running Mitsuba on a cluster. Default: 1)" << endl << endl;
     cout <<  "   -n name     Assign a node name to this instance (Default: host name)" << endl << endl;
     cout <<  "   -x          Skip rendering of files where output already exists" << endl << endl;
     cout <<  "   -r sec      Write (partial) output images every 'sec' seconds" << endl << endl;
+    cout <<  "   -T          Append render telemetry (timings, counters, memory usage) as" << endl;
+    cout <<  "               JSON lines to a .jsonl file next to each output image" << endl << endl;
     cout <<  "   -b res      Specify the block resolution used to split images into parallel" << endl;
     cout <<  "               workloads (default: 32). Only applies to some integrators." << endl << endl;
+    cout <<  "   -N          Replicate the scene on every NUMA node. Uses more memory, but" << endl;
+    cout <<  "               avoids cross-socket traffic on multi-socket machines" << endl << endl;
     cout <<  "   -v          Be more verbose (can be specified twice)" << endl << endl;
     cout <<  "   -L level    Explicitly specify the log level (trace/debug/info/warn/error)" << endl << endl;
     cout <<  "   -w          Treat warnings as errors" << endl << endl;
@@ -137,12 +146,14 @@ int mitsuba_app(int argc, char **argv) {
         std::string nodeName = getHostName(),
                     networkHosts = "", destFile="";
         bool quietMode = false, progressBars = true, skipExisting = false;
+        bool replicateScene = false, writeTelemetry = false;
         ELogLevel logLevel = EInfo;
         ref<FileResolver> fileResolver = Thread::getThread()->getFileResolver();
         bool treatWarningsAsErrors = false;
         std::map<std::string, std::string, SimpleStringOrdering> parameters;
         int blockSize = 32;
         int flushTimer = -1;
+        int compressionLevel = 0, backlogFactor = MTS_BACKLOG_FACTOR;
 
         if (argc < 2) {
             help();
@@ -151,7 +162,7 @@ int mitsuba_app(int argc, char **argv) {
 
         optind = 1;
         /* Parse command-line arguments */
-        while ((optchar = getopt(argc, argv, "a:c:D:s:j:n:o:r:b:p:L:qhzvtwx")) != -1) {
+        while ((optchar = getopt(argc, argv, "a:c:D:s:j:n:o:r:b:p:L:Z:B:qhzvtwxNT")) != -1) {
             switch (optchar) {
                 case 'a': {
                         std::vector<std::string> paths = tokenize(optarg, ";");
@@ -240,6 +251,22 @@ int mitsuba_app(int argc, char **argv) {
                 case 'z':
                     progressBars = false;
                     break;
+                case 'N':
+                    replicateScene = true;
+                    break;
+                case 'T':
+                    writeTelemetry = true;
+                    break;
+                case 'Z':
+                    compressionLevel = strtol(optarg, &end_ptr, 10);
+                    if (*end_ptr != '\0' || compressionLevel < 0 || compressionLevel > 9)
+                        SLog(EError, "Invalid compression level!");
+                    break;
+                case 'B':
+                    backlogFactor = strtol(optarg, &end_ptr, 10);
+                    if (*end_ptr != '\0' || backlogFactor < 1)
+                        SLog(EError, "Invalid number of work units per remote core!");
+                    break;
                 case 'q':
                     quietMode = true;
                     break;
@@ -280,6 +307,10 @@ int mitsuba_app(int argc, char **argv) {
         for (int i=0; i<nprocs; ++i)
             scheduler->registerWorker(new LocalWorker(useCoreAffinity ? i : -1,
                 formatString("wrk%i", i)));
+        if (getNUMANodeCount() > 1)
+            SLog(EInfo, "Detected %i NUMA nodes%s", getNUMANodeCount(),
+                replicateScene ? " (replicating the scene on each node)" : "");
+        scheduler->setResourceReplication(replicateScene);
         std::vector<std::string> hosts = tokenize(networkHosts, ";");
 
         /* Establish network connections to nested servers */
@@ -311,7 +342,11 @@ int mitsuba_app(int argc, char **argv) {
                 stream = new SSHStream(tokens[0], tokens[1], cmdLine);
             }
             try {
-                scheduler->registerWorker(new RemoteWorker(formatString("net%i", i), stream));
+                ref<RemoteWorker> worker = new RemoteWorker(formatString("net%i", i), stream);
+                worker->setBacklogFactor(backlogFactor);
+                if (compressionLevel > 0)
+                    worker->setCompressionLevel(compressionLevel);
+                scheduler->registerWorker(worker);
             } catch (std::runtime_error &e) {
                 if (hostName.find("@") != std::string::npos) {
 #if defined(__WINDOWS__)
@@ -358,6 +393,12 @@ int mitsuba_app(int argc, char **argv) {
 
         renderQueue = new RenderQueue();
 
+        ref<RenderTelemetry> telemetry;
+        if (writeTelemetry) {
+            telemetry = new RenderTelemetry(true);
+            renderQueue->registerListener(telemetry);
+        }
+
         ref<FlushThread> flushThread;
         if (flushTimer > 0) {
             flushThread = new FlushThread(flushTimer);
@@ -400,6 +441,8 @@ int mitsuba_app(int argc, char **argv) {
         renderQueue->waitLeft(0);
         if (flushThread)
             flushThread->quit();
+        if (telemetry)
+            renderQueue->unregisterListener(telemetry);
         renderQueue = NULL;
 
         delete handler;
@@ -106,10 +106,12 @@ int mtssrv(int argc, char **argv) {
         std::string hostName = getFQDN();
         FileResolver *fileResolver = Thread::getThread()->getFileResolver();
         bool hostNameSet = false;
+        std::string cachePath = "";
+        size_t cacheSize = 4096;
 
         optind = 1;
         /* Parse command-line arguments */
-        while ((optchar = getopt(argc, argv, "a:c:s:n:p:i:l:L:qhv")) != -1) {
+        while ((optchar = getopt(argc, argv, "a:c:s:n:p:i:l:L:C:M:qhv")) != -1) {
             switch (optchar) {
                 case 'a': {
                         std::vector<std::string> paths = tokenize(optarg, ";");
@@ -176,6 +178,14 @@ int mtssrv(int argc, char **argv) {
                 case 'q':
                     quietMode = true;
                     break;
+                case 'C':
+                    cachePath = optarg;
+                    break;
+                case 'M':
+                    cacheSize = (size_t) strtol(optarg, &end_ptr, 10);
+                    if (*end_ptr != '\0')
+                        SLog(EError, "Could not parse the cache size!");
+                    break;
                 case 'h':
                 default:
                     cout <<  "Mitsuba version " << Version(MTS_VERSION).toStringComplete()
@@ -201,6 +211,10 @@ int mtssrv(int argc, char **argv) {
                     cout <<  "   -l port     Listen for connections on a certain port (Default: " << MTS_DEFAULT_PORT << ")." << endl;
                     cout <<  "               To listen on stdin, specify \"-ls\" (implies -q)" << endl << endl;
                     cout <<  "   -n name     Assign a node name to this instance (Default: host name)" << endl << endl;
+                    cout <<  "   -C path     Keep resources received from clients (e.g. scenes) in an on-disk" << endl;
+                    cout <<  "               cache, so that later jobs only need to transfer modified parts" << endl;
+                    cout <<  "               (Default: mtssrv.<node name>.cache, \"-C none\" disables caching)" << endl << endl;
+                    cout <<  "   -M size     Maximum size of the resource cache in megabytes (Default: 4096)" << endl << endl;
                     cout <<  "   -v          Be more verbose (can be specified twice)" << endl << endl;
                     cout <<  "   -L level    Explicitly specify the log level (trace/debug/info/warn/error)" << endl << endl;
                     cout <<  " For documentation, please refer to http://www.mitsuba-renderer.org/docs.html" << endl;
@@ -285,9 +299,21 @@ int mtssrv(int argc, char **argv) {
         }
         scheduler->start();
 
+        /* Set up the resource cache shared by all connections */
+        ref<ResourceCache> cache;
+        if (cachePath.empty())
+            cachePath = formatString("mtssrv.%s.cache", nodeName.c_str());
+        if (cachePath != "none" && cacheSize > 0) {
+            try {
+                cache = new ResourceCache(cachePath, cacheSize * 1024 * 1024);
+            } catch (const std::exception &e) {
+                SLog(EWarn, "Could not open the resource cache (%s) -- caching is disabled!", e.what());
+            }
+        }
+
         if (listenPort == -1) {
             ref<StreamBackend> backend = new StreamBackend("con0",
-                    scheduler, nodeName, new ConsoleStream(), false);
+                    scheduler, nodeName, new ConsoleStream(), false, cache);
             backend->start();
             backend->join();
             return 0;
@@ -385,7 +411,7 @@ int mtssrv(int argc, char **argv) {
             }
 
             ref<StreamBackend> backend = new StreamBackend(formatString("con%i", connectionIndex++),
-                scheduler, nodeName, new SocketStream(newSocket), true);
+                scheduler, nodeName, new SocketStream(newSocket), true, cache);
             backend->start();
         }
 #if defined(__WINDOWS__)
@@ -0,0 +1,185 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/render/imageblock.h>
+#include <mitsuba/core/plugin.h>
+#include <mitsuba/core/random.h>
+#include <mitsuba/core/timer.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestImageBlock : public TestCase {
+public:
+    MTS_BEGIN_TESTCASE()
+    MTS_DECLARE_TEST(test01_separableSplat)
+    MTS_DECLARE_TEST(test02_concurrentSplat)
+    MTS_DECLARE_BENCHMARK(test03_benchmark)
+    MTS_END_TESTCASE()
+
+    ref<ReconstructionFilter> createFilter(const std::string &name) {
+        Properties props(name);
+        ref<ReconstructionFilter> rfilter = static_cast<ReconstructionFilter *> (
+            PluginManager::getInstance()->createObject(
+            MTS_CLASS(ReconstructionFilter), props));
+        rfilter->configure();
+        return rfilter;
+    }
+
+    ref<ImageBlock> createBlock(const ReconstructionFilter *rfilter, int channels) {
+        ref<ImageBlock> block;
+        Vector2i size(48, 32);
+        if (channels == SPECTRUM_SAMPLES)
+            block = new ImageBlock(Bitmap::ESpectrum, size, rfilter);
+        else if (channels == SPECTRUM_SAMPLES + 2)
+            block = new ImageBlock(Bitmap::ESpectrumAlphaWeight, size, rfilter);
+        else
+            block = new ImageBlock(Bitmap::EMultiChannel, size, rfilter, channels);
+        block->setOffset(Point2i(16, 8));
+        block->clear();
+        return block;
+    }
+
+    /// Return the largest relative difference between two blocks
+    Float difference(const ImageBlock *block, const Float *reference) {
+        const Bitmap *bitmap = block->getBitmap();
+        const Float *data = bitmap->getFloatData();
+        Float maxError = 0;
+        for (size_t i=0, count=bitmap->getPixelCount() * bitmap->getChannelCount(); i<count; ++i)
+            maxError = std::max(maxError, std::abs(data[i] - reference[i])
+                / std::max(std::abs(reference[i]), (Float) 1e-3f));
+        return maxError;
+    }
+
+    void test01_separableSplat() {
+        const char *filters[] = { "box", "tent", "gaussian", "mitchell", "catmullrom", "lanczos" };
+        const int channelCounts[] = { SPECTRUM_SAMPLES, SPECTRUM_SAMPLES + 2, 7 };
+        ref<Random> random = new Random();
+
+        for (int i=0; i<6; ++i) {
+            ref<ReconstructionFilter> rfilter = createFilter(filters[i]);
+
+            for (int j=0; j<3; ++j) {
+                int channels = channelCounts[j];
+                ref<ImageBlock> block = createBlock(rfilter, channels);
+                int border = block->getBorderSize();
+                Vector2i size = block->getBitmap()->getSize();
+                std::vector<Float> reference((size_t) size.x * size.y * channels, 0.0f);
+                std::vector<Float> value(channels);
+
+                /* Splat samples, including ones that only partially overlap the block */
+                for (int k=0; k<5000; ++k) {
+                    Point2 pos(16 + (random->nextFloat() * 1.2f - 0.1f) * 48,
+                               8  + (random->nextFloat() * 1.2f - 0.1f) * 32);
+                    if (k < 32) /* Exercise integer sample positions */
+                        pos = Point2((Float) (16 + k), (Float) (8 + k / 2));
+                    for (int c=0; c<channels; ++c)
+                        value[c] = random->nextFloat();
+                    block->put(pos, &value[0]);
+
+                    /* Reference: evaluate the discretized filter at every pixel */
+                    Float px = pos.x - 0.5f - (16 - border), py = pos.y - 0.5f - (8 - border);
+                    for (int y=0; y<size.y; ++y) {
+                        for (int x=0; x<size.x; ++x) {
+                            if (std::abs(x - px) > rfilter->getRadius() ||
+                                std::abs(y - py) > rfilter->getRadius())
+                                continue;
+                            Float weight = rfilter->evalDiscretized(x - px)
+                                * rfilter->evalDiscretized(y - py);
+                            for (int c=0; c<channels; ++c)
+                                reference[(y * size.x + x) * channels + c] += weight * value[c];
+                        }
+                    }
+                }
+
+                Float error = difference(block, &reference[0]);
+                Log(EInfo, "%s filter, %i channels: max. relative error = %e",
+                    filters[i], channels, error);
+                assertTrue(error < 1e-4f);
+            }
+        }
+    }
+
+    void test02_concurrentSplat() {
+        ref<ReconstructionFilter> rfilter = createFilter("gaussian");
+        ref<Random> random = new Random();
+
+        for (int channels = SPECTRUM_SAMPLES; channels <= SPECTRUM_SAMPLES + 2; channels += 2) {
+            ref<ImageBlock> block1 = createBlock(rfilter, channels),
+                            block2 = createBlock(rfilter, channels);
+            std::vector<Float> value(channels);
+
+            for (int k=0; k<5000; ++k) {
+                Point2 pos(16 + (random->nextFloat() * 1.2f - 0.1f) * 48,
+                           8  + (random->nextFloat() * 1.2f - 0.1f) * 32);
+                for (int c=0; c<channels; ++c)
+                    value[c] = random->nextFloat();
+                block1->put(pos, &value[0]);
+                block2->putConcurrent(pos, &value[0]);
+            }
+            assertTrue(difference(block2, block1->getBitmap()->getFloatData()) < 1e-4f);
+
+            /* Merging a block must match the non-concurrent version exactly */
+            ref<ImageBlock> source = createBlock(rfilter, channels);
+            source->setOffset(Point2i(40, 20));
+            for (int k=0; k<1000; ++k) {
+                for (int c=0; c<channels; ++c)
+                    value[c] = random->nextFloat();
+                source->put(Point2(40 + random->nextFloat() * 48,
+                    20 + random->nextFloat() * 32), &value[0]);
+            }
+            block1->put(source);
+            block2->putConcurrent(source);
+            assertTrue(difference(block2, block1->getBitmap()->getFloatData()) < 1e-4f);
+        }
+    }
+
+    void test03_benchmark() {
+        const char *filters[] = { "box", "gaussian", "mitchell", "lanczos" };
+        const int channelCounts[] = { SPECTRUM_SAMPLES, SPECTRUM_SAMPLES + 2 };
+        const int sampleCount = 2000000;
+        ref<Random> random = new Random();
+
+        std::vector<Point2> positions(4096);
+        for (size_t i=0; i<positions.size(); ++i)
+            positions[i] = Point2(16 + random->nextFloat() * 48, 8 + random->nextFloat() * 32);
+
+        for (int i=0; i<4; ++i) {
+            ref<ReconstructionFilter> rfilter = createFilter(filters[i]);
+
+            for (int j=0; j<2; ++j) {
+                ref<ImageBlock> block = createBlock(rfilter, channelCounts[j]);
+                Float value[SPECTRUM_SAMPLES + 2];
+                for (int c=0; c<SPECTRUM_SAMPLES + 2; ++c)
+                    value[c] = 1.0f;
+
+                ref<Timer> timer = new Timer();
+                for (int k=0; k<sampleCount; ++k)
+                    block->put(positions[k & 4095], value);
+                Float ns = timer->getMicroseconds() * 1000.0f / sampleCount;
+
+                Log(EInfo, "%s filter (radius %.2f), %i channels: %.1f ns per splat",
+                    filters[i], rfilter->getRadius(), channelCounts[j], ns);
+            }
+        }
+    }
+};
+
+MTS_EXPORT_TESTCASE(TestImageBlock, "Testcase for image block splatting")
+MTS_NAMESPACE_END
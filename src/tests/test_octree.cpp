@@ -0,0 +1,126 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/core/octree.h>
+#include <mitsuba/core/random.h>
+#include <mitsuba/core/timer.h>
+
+#if defined(MTS_OPENMP)
+# include <omp.h>
+#endif
+
+MTS_NAMESPACE_BEGIN
+
+class TestOctree : public TestCase {
+public:
+    MTS_BEGIN_TESTCASE()
+    MTS_DECLARE_TEST(test01_lockFreeList)
+    MTS_DECLARE_TEST(test02_concurrentInsertion)
+    MTS_END_TESTCASE()
+
+    /// Counts the number of times that a specific item is visited
+    struct CountFunctor {
+        CountFunctor(uint32_t item) : item(item), count(0) { }
+
+        inline void operator()(uint32_t value) {
+            if (value == item)
+                count++;
+        }
+
+        uint32_t item;
+        size_t count;
+    };
+
+    void test01_lockFreeList() {
+        const int nItems = 100000;
+        LockFreeList<int> list;
+
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for
+        #endif
+        for (int i=0; i<nItems; ++i) {
+            if (i % 2 == 0)
+                list.prepend(i);
+            else
+                list.append(i);
+        }
+
+        assertEquals(nItems, (int) list.size());
+
+        std::vector<bool> seen(nItems, false);
+        for (const LockFreeList<int>::ListItem *item = list.head(); item; item = item->next) {
+            assertFalse(seen[item->value]);
+            seen[item->value] = true;
+        }
+    }
+
+    void test02_concurrentInsertion() {
+        const size_t nItems = 200000;
+        const Float radius = 0.01f;
+        AABB aabb(Point(0.0f), Point(1.0f));
+
+        std::vector<Point> positions(nItems);
+        ref<Random> random = new Random();
+        for (size_t i=0; i<nItems; ++i)
+            positions[i] = Point(random->nextFloat(), random->nextFloat(), random->nextFloat());
+
+        int maxThreads = mts_omp_get_max_threads();
+        for (int nThreads = 1; ; nThreads = std::min(2*nThreads, maxThreads)) {
+            DynamicOctree<uint32_t> octree(aabb);
+            volatile int32_t lookupHits = 0;
+
+            ref<Timer> timer = new Timer();
+
+            /* Insert all items while concurrently performing lookups,
+               which mimics the access pattern of the irradiance cache */
+            #if defined(MTS_OPENMP)
+                #pragma omp parallel for num_threads(nThreads) schedule(dynamic, 1024)
+            #endif
+            for (int i=0; i<(int) nItems; ++i) {
+                const Point &p = positions[i];
+                octree.insert((uint32_t) i, AABB(p - Vector(radius), p + Vector(radius)));
+
+                CountFunctor functor((uint32_t) i);
+                octree.lookup(p, functor);
+                if (functor.count > 0)
+                    atomicAdd(&lookupHits, 1);
+            }
+
+            unsigned int ms = timer->getMilliseconds();
+            Log(EInfo, "%i thread(s): inserted " SIZE_T_FMT " items in %i ms (%.2f M inserts/s)",
+                nThreads, nItems, ms, nItems / (std::max(ms, 1u) * (Float) 1000));
+
+            /* Each item must be visible to the thread that inserted it */
+            assertEquals((int) lookupHits, (int) nItems);
+
+            /* .. and to everyone else once all insertions have finished */
+            for (size_t i=0; i<nItems; i += 997) {
+                CountFunctor functor((uint32_t) i);
+                octree.lookup(positions[i], functor);
+                assertTrue(functor.count == 1);
+            }
+
+            if (nThreads == maxThreads)
+                break;
+        }
+    }
+};
+
+MTS_EXPORT_TESTCASE(TestOctree, "Testcase for the lock-free octree")
+MTS_NAMESPACE_END
@@ -0,0 +1,166 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/core/pmf.h>
+#include <mitsuba/core/random.h>
+#include <mitsuba/core/timer.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestPMF : public TestCase {
+public:
+    MTS_BEGIN_TESTCASE()
+    MTS_DECLARE_TEST(test01_discreteDistribution)
+    MTS_DECLARE_TEST(test02_aliasDistribution)
+    MTS_DECLARE_BENCHMARK(test03_benchmark)
+    MTS_END_TESTCASE()
+
+    /// Check the sample frequencies and reused sample values of a distribution
+    template <typename Distribution> void checkDistribution() {
+        const size_t nEntries = 100, nSamples = 1000000, nBins = 10;
+        ref<Random> random = new Random();
+        Distribution distr(nEntries);
+
+        std::vector<Float> weights(nEntries);
+        for (size_t i=0; i<nEntries; ++i) {
+            /* Include a few entries with zero probability */
+            weights[i] = (i % 7 == 3) ? 0.0f : random->nextFloat();
+            distr.append(weights[i]);
+        }
+        distr.normalize();
+        assertTrue(distr.isNormalized());
+        assertEquals((int) distr.size(), (int) nEntries);
+
+        std::vector<size_t> counts(nEntries, 0), reuseHist(nBins, 0);
+        for (size_t i=0; i<nSamples; ++i) {
+            Float sample = random->nextFloat(), pdf;
+            size_t index = distr.sampleReuse(sample, pdf);
+            assertTrue(index < nEntries);
+            assertEqualsEpsilon(pdf, distr[index], Epsilon);
+            assertTrue(sample >= 0 && sample <= 1);
+            counts[index]++;
+            reuseHist[std::min((size_t) (sample * nBins), nBins-1)]++;
+        }
+
+        for (size_t i=0; i<nEntries; ++i) {
+            Float expected = weights[i] * distr.getNormalization();
+            assertEqualsEpsilon(distr[i], expected, 1e-5f);
+            if (weights[i] == 0)
+                assertEquals((int) counts[i], 0);
+            else
+                assertEqualsEpsilon(counts[i] / (Float) nSamples, expected,
+                    5 * std::sqrt(expected / nSamples));
+        }
+
+        /* The reused sample values must be uniformly distributed */
+        for (size_t i=0; i<nBins; ++i)
+            assertEqualsEpsilon(reuseHist[i] / (Float) nSamples,
+                1.0f / nBins, 5 * std::sqrt(1.0f / (nBins * nSamples)));
+    }
+
+    /// Verify that an alias table reproduces the probabilities of its entries
+    void checkAliasTable(const Float *weights, uint32_t size) {
+        std::vector<Float> pmf(weights, weights + size);
+        std::vector<math::AliasTableEntry<Float, uint32_t> > table(size);
+        Float sum = math::makeAliasTable(&table[0], &pmf[0], size);
+
+        std::vector<Float> prob(size, 0.0f);
+        for (uint32_t i=0; i<size; ++i) {
+            assertTrue(table[i].prob >= 0 && table[i].prob <= 1);
+            assertTrue(table[i].index < size);
+            prob[i] += table[i].prob / size;
+            prob[table[i].index] += (1 - table[i].prob) / size;
+        }
+        for (uint32_t i=0; i<size; ++i)
+            assertEqualsEpsilon(prob[i], weights[i] / sum, 1e-5f);
+    }
+
+    void test01_discreteDistribution() {
+        checkDistribution<DiscreteDistribution>();
+    }
+
+    void test02_aliasDistribution() {
+        checkDistribution<AliasDistribution>();
+
+        /* A distribution without probability mass must not index out of bounds */
+        AliasDistribution empty(2);
+        empty.append(0.0f);
+        empty.append(0.0f);
+        assertEquals(empty.normalize(), (Float) 0.0f);
+        assertFalse(empty.isNormalized());
+        Float sample = 0.5f, pdf = 1.0f;
+        assertEquals((int) empty.sampleReuse(sample, pdf), 0);
+        assertEquals(pdf, (Float) 0.0f);
+
+        /* Entries exactly at the mean, and large entries that drop below
+           the mean after donating probability mass */
+        const Float weights1[] = { 1.0f, 1.2f, 1.3f, 0.1f, 1.4f },
+                    weights2[] = { 1.0f, 1.0f, 3.0f, 0.5f, 0.5f, 1.0f, 0.0f, 1.0f };
+        checkAliasTable(weights1, sizeof(weights1) / sizeof(weights1[0]));
+        checkAliasTable(weights2, sizeof(weights2) / sizeof(weights2[0]));
+    }
+
+    /// Time the generation of samples from a distribution
+    template <typename Distribution> void benchmark(const char *name,
+            const std::vector<Float> &weights, const std::vector<Float> &samples) {
+        Distribution distr(weights.size());
+        for (size_t i=0; i<weights.size(); ++i)
+            distr.append(weights[i]);
+
+        ref<Timer> timer = new Timer();
+        distr.normalize();
+        unsigned int setupTime = timer->getMilliseconds();
+
+        timer->reset();
+        size_t checksum = 0;
+        for (size_t i=0; i<samples.size(); ++i) {
+            Float sample = samples[i];
+            checksum += distr.sampleReuse(sample);
+        }
+        Float seconds = timer->getSeconds();
+
+        Log(EInfo, "%s: " SIZE_T_FMT " entries, setup %i ms, %.2f M samples/s (checksum "
+            SIZE_T_FMT ")", name, weights.size(), setupTime,
+            samples.size() * 1e-6f / std::max(seconds, (Float) 1e-6f), checksum);
+    }
+
+    void test03_benchmark() {
+        const size_t nSamples = 10000000;
+        ref<Random> random = new Random();
+
+        std::vector<Float> samples(nSamples);
+        for (size_t i=0; i<nSamples; ++i)
+            samples[i] = random->nextFloat();
+
+        /* Representative of scenes with few emitters, thousands of emitters,
+           and emissive meshes with many triangles */
+        const size_t sizes[] = { 8, 4096, 100000, 1000000 };
+        for (size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); ++i) {
+            std::vector<Float> weights(sizes[i]);
+            for (size_t j=0; j<sizes[i]; ++j)
+                weights[j] = random->nextFloat();
+
+            benchmark<DiscreteDistribution>("DiscreteDistribution", weights, samples);
+            benchmark<AliasDistribution>("AliasDistribution", weights, samples);
+        }
+    }
+};
+
+MTS_EXPORT_TESTCASE(TestPMF, "Testcase for discrete probability distributions")
+MTS_NAMESPACE_END
@@ -0,0 +1,257 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/render/texcache.h>
+#include <mitsuba/core/atomic.h>
+#include <mitsuba/core/random.h>
+
+#define TILE_BYTES 4096
+
+MTS_NAMESPACE_BEGIN
+
+/// Tile source with procedurally generated contents, which counts its loads
+class PatternTileSource : public TextureTileCache::TileSource {
+public:
+    PatternTileSource(int id) : m_id(id), m_loads(0) { }
+
+    size_t getTileBytes() const {
+        return TILE_BYTES;
+    }
+
+    void loadTile(int level, int x, int y, uint8_t *target) const {
+        for (int i=0; i<TILE_BYTES; ++i)
+            target[i] = getValue(level, x, y, i);
+        atomicAdd(&m_loads, 1);
+    }
+
+    /// Return the expected value of a byte within a tile
+    inline uint8_t getValue(int level, int x, int y, int offset) const {
+        return (uint8_t) (m_id * 131 + level * 71 + x * 31 + y * 17 + offset);
+    }
+
+    inline int getLoadCount() const { return (int) m_loads; }
+private:
+    int m_id;
+    mutable volatile int32_t m_loads;
+};
+
+/// Thread that performs random lookups and verifies their results
+class LookupThread : public Thread {
+public:
+    LookupThread(const PatternTileSource *source, int seed)
+        : Thread(formatString("lookup%i", seed)), m_source(source),
+          m_seed(seed), m_errors(0) { }
+
+    void run() {
+        TextureTileCache *cache = TextureTileCache::getInstance();
+        ref<Random> random = new Random(m_seed);
+        uint8_t data[16];
+
+        for (int i=0; i<20000; ++i) {
+            int x = random->nextUInt(32), y = random->nextUInt(32);
+            size_t offset = random->nextUInt(TILE_BYTES - 16);
+            cache->lookup(m_source, 0, x, y, offset, data, 16);
+            for (int j=0; j<16; ++j) {
+                if (data[j] != m_source->getValue(0, x, y, (int) offset + j))
+                    ++m_errors;
+            }
+        }
+    }
+
+    inline int getErrorCount() const { return m_errors; }
+private:
+    const PatternTileSource *m_source;
+    int m_seed, m_errors;
+};
+
+class TestTextureTileCache : public TestCase {
+public:
+    MTS_BEGIN_TESTCASE()
+    MTS_DECLARE_TEST(test01_lookup)
+    MTS_DECLARE_TEST(test02_budgetEviction)
+    MTS_DECLARE_TEST(test03_release)
+    MTS_DECLARE_TEST(test04_concurrentLookup)
+    MTS_DECLARE_TEST(test05_pinnedTiles)
+    MTS_END_TESTCASE()
+
+    void init() {
+        m_budget = TextureTileCache::getInstance()->getMemoryBudget();
+    }
+
+    void shutdown() {
+        TextureTileCache::getInstance()->setMemoryBudget(m_budget);
+    }
+
+    /// Return the number of tiles held by the cache
+    int getResidentTiles() const {
+        return (int) (TextureTileCache::getInstance()->getMemoryUsage() / TILE_BYTES);
+    }
+
+    void test01_lookup() {
+        TextureTileCache *cache = TextureTileCache::getInstance();
+        PatternTileSource source(1);
+        uint8_t data[64];
+
+        for (int k=0; k<3; ++k) {
+            for (int y=0; y<4; ++y) {
+                for (int x=0; x<4; ++x) {
+                    cache->lookup(&source, 1, x, y, 100, data, 64);
+                    for (int i=0; i<64; ++i)
+                        assertEquals((int) data[i], (int) source.getValue(1, x, y, 100 + i));
+                }
+            }
+        }
+
+        /* Resident tiles must not be loaded again */
+        assertEquals(source.getLoadCount(), 16);
+        assertEquals(getResidentTiles(), 16);
+
+        cache->release(&source);
+        assertEquals(getResidentTiles(), 0);
+    }
+
+    void test02_budgetEviction() {
+        TextureTileCache *cache = TextureTileCache::getInstance();
+        PatternTileSource source(2);
+        uint8_t data;
+
+        /* Room for two tiles per shard */
+        size_t budget = 2 * MTS_TEXCACHE_SHARDS * TILE_BYTES;
+        cache->setMemoryBudget(budget);
+
+        /* Keep touching one tile while streaming many others through the
+           cache: being among the two most recently used tiles of its shard,
+           it must never be evicted */
+        cache->lookup(&source, 0, 0, 0, 0, &data, 1);
+        for (int i=1; i<4096; ++i) {
+            cache->lookup(&source, 0, i % 64, i / 64, 0, &data, 1);
+            assertEquals((int) data, (int) source.getValue(0, i % 64, i / 64, 0));
+            cache->lookup(&source, 0, 0, 0, 0, &data, 1);
+            assertTrue(cache->getMemoryUsage() <= budget);
+        }
+        assertEquals(source.getLoadCount(), 4096);
+
+        /* Lowering the budget evicts tiles immediately */
+        cache->setMemoryBudget(MTS_TEXCACHE_SHARDS * TILE_BYTES);
+        assertTrue(cache->getMemoryUsage() <= (size_t) MTS_TEXCACHE_SHARDS * TILE_BYTES);
+
+        cache->release(&source);
+        assertEquals(getResidentTiles(), 0);
+        cache->setMemoryBudget(m_budget);
+    }
+
+    void test03_release() {
+        TextureTileCache *cache = TextureTileCache::getInstance();
+        PatternTileSource source1(3), source2(4);
+        uint8_t data;
+
+        for (int i=0; i<50; ++i) {
+            cache->lookup(&source1, 0, i, 0, 0, &data, 1);
+            cache->lookup(&source2, 0, i, 0, 0, &data, 1);
+        }
+        assertEquals(getResidentTiles(), 100);
+
+        /* Only the tiles of the released source are discarded */
+        cache->release(&source1);
+        assertEquals(getResidentTiles(), 50);
+        for (int i=0; i<50; ++i) {
+            cache->lookup(&source2, 0, i, 0, 0, &data, 1);
+            assertEquals((int) data, (int) source2.getValue(0, i, 0, 0));
+        }
+        assertEquals(source2.getLoadCount(), 50);
+
+        /* .. and are loaded again on the next access */
+        cache->lookup(&source1, 0, 0, 0, 0, &data, 1);
+        assertEquals(source1.getLoadCount(), 51);
+
+        cache->release(&source1);
+        cache->release(&source2);
+        assertEquals(getResidentTiles(), 0);
+    }
+
+    void test04_concurrentLookup() {
+        TextureTileCache *cache = TextureTileCache::getInstance();
+        PatternTileSource source(5);
+
+        /* The 32x32 tiles do not fit, hence threads contend on
+           loads and evictions of the same shards */
+        cache->setMemoryBudget(4 * MTS_TEXCACHE_SHARDS * TILE_BYTES);
+
+        std::vector<ref<LookupThread> > threads;
+        for (int i=0; i<8; ++i) {
+            threads.push_back(new LookupThread(&source, i + 1));
+            threads[i]->start();
+        }
+
+        int errors = 0;
+        for (size_t i=0; i<threads.size(); ++i) {
+            threads[i]->join();
+            errors += threads[i]->getErrorCount();
+        }
+        assertEquals(errors, 0);
+
+        /* Tiles that were pinned by other threads may have been
+           skipped during eviction, one per thread at most */
+        assertTrue(cache->getMemoryUsage() <= cache->getMemoryBudget()
+            + threads.size() * TILE_BYTES);
+
+        cache->release(&source);
+        assertEquals(getResidentTiles(), 0);
+        cache->setMemoryBudget(m_budget);
+    }
+    void test05_pinnedTiles() {
+        TextureTileCache *cache = TextureTileCache::getInstance();
+        PatternTileSource source(6);
+        uint8_t data;
+
+        /* Room for a single tile per shard */
+        cache->setMemoryBudget(MTS_TEXCACHE_SHARDS * TILE_BYTES);
+
+        {
+            /* Repeated fetches of the same tile acquire it only once */
+            TextureTileCache::Cursor cursor;
+            const uint8_t *tile = cursor.fetch(cache, &source, 0, 0, 0);
+            for (int i=0; i<16; ++i)
+                assertTrue(cursor.fetch(cache, &source, 0, 0, 0) == tile);
+
+            /* A pinned tile survives while many others stream through the cache */
+            for (int i=1; i<1024; ++i)
+                cache->lookup(&source, 0, i % 32, i / 32, 0, &data, 1);
+            for (int i=0; i<TILE_BYTES; ++i)
+                assertEquals((int) tile[i], (int) source.getValue(0, 0, 0, i));
+            assertEquals(source.getLoadCount(), 1024);
+
+            /* Moving on to another tile releases the first one */
+            cursor.fetch(cache, &source, 0, 1, 0);
+        }
+
+        for (int i=0; i<1024; ++i)
+            cache->lookup(&source, 0, i % 32, 32 + i / 32, 0, &data, 1);
+        assertTrue(cache->getMemoryUsage() <= cache->getMemoryBudget());
+
+        cache->release(&source);
+        assertEquals(getResidentTiles(), 0);
+        cache->setMemoryBudget(m_budget);
+    }
+private:
+    size_t m_budget;
+};
+
+MTS_EXPORT_TESTCASE(TestTextureTileCache, "Testcase for the texture tile cache")
+MTS_NAMESPACE_END
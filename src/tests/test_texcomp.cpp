@@ -0,0 +1,247 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/render/mipmap.h>
+#include <mitsuba/core/plugin.h>
+#include <mitsuba/core/random.h>
+#include <mitsuba/core/timer.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestTextureCompression : public TestCase {
+public:
+    MTS_BEGIN_TESTCASE()
+    MTS_DECLARE_TEST(test01_blockCodec)
+    MTS_DECLARE_TEST(test02_imageQuality)
+    MTS_DECLARE_BENCHMARK(test03_benchmark)
+    MTS_END_TESTCASE()
+
+    typedef TSpectrum<half, 3>                   Color3h;
+    typedef TCompressedBlock<Color3>             Block;
+    typedef TMIPMap<TSpectrum<Float, 3>, Color3h> MIPMap3;
+
+    /// Create an HDR test image with smooth gradients, edges, fine detail, and highlights
+    ref<Bitmap> createImage(const Vector2i &size) {
+        ref<Random> random = new Random();
+        ref<Bitmap> bitmap = new Bitmap(Bitmap::ERGB, Bitmap::EFloat, size);
+        Color3 *data = (Color3 *) bitmap->getData();
+
+        for (int y=0; y<size.y; ++y) {
+            for (int x=0; x<size.x; ++x) {
+                Float u = (x + 0.5f) / size.x, v = (y + 0.5f) / size.y;
+                Color3 value;
+                value[0] = 0.2f + 0.6f * u;
+                value[1] = 0.3f + 0.3f * std::sin(20 * u * v);
+                value[2] = ((x / 37 + y / 23) % 2 == 0) ? 0.8f : 0.1f;
+                value *= 1.0f + 0.05f * random->nextFloat();
+                if (math::hypot2(u - 0.7f, v - 0.3f) < 0.05f)
+                    value *= 20.0f;
+                *data++ = value;
+            }
+        }
+
+        return bitmap;
+    }
+
+    /// Return the largest component-wise difference of two colors
+    static Float difference(const Color3 &a, const Color3 &b) {
+        return (a - b).abs().max();
+    }
+
+    ref<ReconstructionFilter> createFilter() {
+        Properties props("lanczos");
+        props.setInteger("lobes", 2);
+        ref<ReconstructionFilter> rfilter = static_cast<ReconstructionFilter *> (
+            PluginManager::getInstance()->createObject(
+            MTS_CLASS(ReconstructionFilter), props));
+        rfilter->configure();
+        return rfilter;
+    }
+
+    void test01_blockCodec() {
+        ref<Random> random = new Random();
+        Color3 texels[Block::texelCount], decoded[Block::texelCount];
+        Block block;
+
+        /* Constant blocks are reproduced up to half precision */
+        for (int i=0; i<Block::texelCount; ++i)
+            texels[i] = Color3(0.25f, 0.5f, 2.0f);
+        block.encode(texels);
+        for (int i=0; i<Block::texelCount; ++i)
+            assertEquals(difference(block.decode(i), texels[i]), 0.0f);
+
+        /* Blocks that only contain two colors are reproduced as well */
+        for (int i=0; i<Block::texelCount; ++i)
+            texels[i] = random->nextFloat() < 0.5f ? Color3(1.0f, 0.5f, 0.25f)
+                                                   : Color3(0.0f, 0.125f, 4.0f);
+        block.encode(texels);
+        for (int i=0; i<Block::texelCount; ++i)
+            assertEqualsEpsilon(difference(block.decode(i), texels[i]), 0.0f, 4e-3f);
+
+        /* Partial blocks along the image boundary ignore the missing texels */
+        for (int i=0; i<Block::texelCount; ++i)
+            texels[i] = (i % Block::blockSize < 2 && i / Block::blockSize < 3)
+                ? Color3(0.5f) : Color3(100.0f);
+        block.encode(texels, 2, 3);
+        for (int i=0; i<Block::texelCount; ++i)
+            if (i % Block::blockSize < 2 && i / Block::blockSize < 3)
+                assertEquals(difference(block.decode(i), texels[i]), 0.0f);
+
+        /* Linear gradients are resolved to within the palette resolution, and
+           full-block decoding agrees with the single-texel path */
+        for (int trial=0; trial<1000; ++trial) {
+            Color3 start, end;
+            for (int i=0; i<3; ++i) {
+                start[i] = random->nextFloat();
+                end[i] = random->nextFloat();
+            }
+            for (int i=0; i<Block::texelCount; ++i)
+                texels[i] = start + (end - start) * random->nextFloat();
+
+            block.encode(texels);
+            block.decodeBlock(decoded);
+            for (int i=0; i<Block::texelCount; ++i) {
+                assertTrue(decoded[i] == block.decode(i));
+                assertTrue(difference(decoded[i], texels[i])
+                    <= 0.5f / Block::maxIndex * difference(start, end) + 2e-3f);
+            }
+        }
+    }
+
+    /// Compute the peak signal-to-noise ratio between two bitmaps (in dB)
+    Float computePSNR(const Bitmap *ref, const Bitmap *test) {
+        const Color3h *a = (const Color3h *) ref->getData(),
+                      *b = (const Color3h *) test->getData();
+        size_t count = ref->getPixelCount();
+        double squaredError = 0, peak = 0;
+        for (size_t i=0; i<count; ++i) {
+            TSpectrum<Float, 3> va(a[i]), vb(b[i]);
+            for (int j=0; j<3; ++j) {
+                squaredError += (va[j] - vb[j]) * (va[j] - vb[j]);
+                peak = std::max(peak, (double) va[j]);
+            }
+        }
+        double mse = squaredError / (3 * count);
+        return (Float) (10 * std::log10(peak * peak / std::max(mse, 1e-20)));
+    }
+
+    void test02_imageQuality() {
+        ref<Bitmap> bitmap = createImage(Vector2i(512, 384));
+        ref<ReconstructionFilter> rfilter = createFilter();
+
+        ref<MIPMap3> reference = new MIPMap3(bitmap, Bitmap::ERGB, Bitmap::EFloat,
+            rfilter, ReconstructionFilter::ERepeat, ReconstructionFilter::ERepeat,
+            EEWA, 20.0f, fs::path(), 0, 100.0f);
+        ref<MIPMap3> compressed = new MIPMap3(bitmap, Bitmap::ERGB, Bitmap::EFloat,
+            rfilter, ReconstructionFilter::ERepeat, ReconstructionFilter::ERepeat,
+            EEWA, 20.0f, fs::path(), 0, 100.0f, Spectrum::EReflectance, true);
+
+        assertTrue(compressed->isCompressed());
+        assertTrue(compressed->getBufferSize() * 4 < reference->getBufferSize());
+        assertEqualsEpsilon((Float) difference(reference->getAverage(),
+            compressed->getAverage()), 0.0f, 1e-5f);
+
+        /* Compare the individual levels of the image pyramid. The coarsest
+           levels mix unrelated colors within each block, which is where
+           the single pair of endpoints per block struggles the most. */
+        for (int level=0; level<reference->getLevels(); ++level) {
+            ref<Bitmap> refLevel = reference->toBitmap(level);
+            Float psnr = computePSNR(refLevel, compressed->toBitmap(level));
+            Log(EInfo, "Level %i (%s): PSNR = %.2f dB", level,
+                refLevel->getSize().toString().c_str(), psnr);
+            assertTrue(psnr > (refLevel->getPixelCount() >= 4096 ? 35 : 20));
+        }
+
+        /* Compare filtered lookups */
+        ref<Random> random = new Random();
+        double relError = 0;
+        const int nLookups = 100000;
+        for (int i=0; i<nLookups; ++i) {
+            Point2 uv(random->nextFloat(), random->nextFloat());
+            Vector2 d0(random->nextFloat() * 0.01f, random->nextFloat() * 0.001f),
+                    d1(random->nextFloat() * 0.001f, random->nextFloat() * 0.01f);
+            Color3 a = reference->eval(uv, d0, d1),
+                   b = compressed->eval(uv, d0, d1);
+            relError += difference(a, b) / std::max(a.max(), (Float) 1e-3f);
+        }
+        relError /= nLookups;
+        Log(EInfo, "Average relative error of EWA lookups: %.5f", relError);
+        assertTrue(relError < 0.015);
+    }
+
+    /**
+     * \brief Time filtered lookups along randomly placed paths that
+     * consist of \c pathLength consecutive footprints
+     */
+    void benchmark(const MIPMap3 *mipmap, const char *name, Float scale, int pathLength) {
+        const int nLookups = 4000000;
+        ref<Random> random = new Random();
+        Point2 uv(0.5f);
+        Color3 checksum(0.0f);
+
+        ref<Timer> timer = new Timer();
+        for (int i=0; i<nLookups; ++i) {
+            /* Walk along the texture like consecutive camera rays would */
+            if (i % pathLength == 0)
+                uv = Point2(random->nextFloat(), random->nextFloat());
+            uv.x += scale * 0.5f;
+
+            Vector2 d0(scale, 0.0f), d1(0.0f, scale * 0.25f);
+            checksum += mipmap->eval(uv, d0, d1);
+        }
+        Float seconds = timer->getSeconds();
+
+        Log(EInfo, "%s (%s, footprint %g, path length %i): %.2f M lookups/s (checksum %s)",
+            name, memString(mipmap->getBufferSize()).c_str(), scale, pathLength,
+            nLookups * 1e-6f / std::max(seconds, (Float) 1e-6f),
+            checksum.toString().c_str());
+    }
+
+    void test03_benchmark() {
+        ref<Bitmap> bitmap = createImage(Vector2i(4096, 4096));
+        ref<ReconstructionFilter> rfilter = createFilter();
+
+        const EMIPFilterType filterTypes[] = { ETrilinear, EEWA };
+        const char *names[] = { "trilinear", "EWA" };
+
+        for (int i=0; i<2; ++i) {
+            ref<MIPMap3> reference = new MIPMap3(bitmap, Bitmap::ERGB, Bitmap::EFloat,
+                rfilter, ReconstructionFilter::ERepeat, ReconstructionFilter::ERepeat,
+                filterTypes[i], 20.0f, fs::path(), 0, 100.0f);
+            ref<MIPMap3> compressed = new MIPMap3(bitmap, Bitmap::ERGB, Bitmap::EFloat,
+                rfilter, ReconstructionFilter::ERepeat, ReconstructionFilter::ERepeat,
+                filterTypes[i], 20.0f, fs::path(), 0, 100.0f, Spectrum::EReflectance, true);
+
+            /* Coherent lookups (e.g. camera rays) and incoherent
+               ones (e.g. diffuse interreflection) */
+            for (int pathLength = 1; pathLength <= 64; pathLength *= 64) {
+                for (Float scale = 1.0f / 4096; scale < 0.01f; scale *= 8) {
+                    benchmark(reference, formatString("%s, half", names[i]).c_str(),
+                        scale, pathLength);
+                    benchmark(compressed, formatString("%s, compressed", names[i]).c_str(),
+                        scale, pathLength);
+                }
+            }
+        }
+    }
+};
+
+MTS_EXPORT_TESTCASE(TestTextureCompression, "Testcase for block-compressed textures")
+MTS_NAMESPACE_END
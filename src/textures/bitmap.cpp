@@ -20,6 +20,7 @@
 #include <mitsuba/core/fresolver.h>
 #include <mitsuba/core/fstream.h>
 #include <mitsuba/core/mstream.h>
+#include <mitsuba/core/profiler.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/sched.h>
 #include <mitsuba/render/texture.h>
@@ -75,6 +76,23 @@ MTS_NAMESPACE_BEGIN
  *        \emph{filename}\code{.mip} to be created.
  *        \default{automatic---use caching for textures larger than 1M pixels.}
  *     }
+ *     \parameter{tiled}{\Boolean}{
+ *        Load the MIP map cache file on demand in tiles of $64\times 64$ texels,
+ *        which are kept in a texture cache shared by all textures? This bounds
+ *        texture memory by the working set of the renderer (see below).
+ *        Only has an effect when a cache file is used. \default{\code{false}}
+ *     }
+ *     \parameter{tileCacheSize}{\Integer}{
+ *        Memory budget of the shared texture tile cache in MiB. This is a global
+ *        setting---when several textures specify it, the last one wins.
+ *        \default{1024}
+ *     }
+ *     \parameter{compressed}{\Boolean}{
+ *        Store the texture in a lossy block-compressed format that requires
+ *        4.8$\times$ (RGB) or 2.7$\times$ (monochromatic) less memory than
+ *        the default half precision representation (see below).
+ *        \default{\code{false}}
+ *     }
  *     \parameter{uoffset, voffset}{\Float}{
  *       Numerical offset that should be applied to UV lookups
  *     }
@@ -155,6 +173,19 @@ MTS_NAMESPACE_BEGIN
  *    Mitsuba is able to work with truly massive textures that would otherwise exhaust the main system memory.
  * \end{enumerate}
  *
+ * When a scene references many large textures, even memory-mapped caches can exhaust
+ * the available memory. In that case, the \code{tiled} parameter can be used to
+ * load square tiles of the MIP map levels on demand from the cache file. Tiles of
+ * all tiled textures are kept in a single cache with a least-recently-used eviction
+ * policy, whose size is controlled by \code{tileCacheSize}.
+ *
+ * Alternatively (or additionally), the \code{compressed} parameter stores each block
+ * of $4\times 4$ texels using two half precision endpoint colors and a 4-bit palette
+ * index per texel, similar to the BC6H format used by graphics hardware.
+ * Texels are decoded on the fly during texture lookups. Since more of the texture
+ * fits into the processor caches, this can even speed up rendering, at the cost of
+ * a small loss of precision in blocks with strong color variation.
+ *
  * The texture caches are automatically regenerated when the input texture is modified.
  * Of course, the cache files can be cumbersome when they are not needed anymore. On Linux
  * or Mac OS, they can safely be deleted by executing the following command within a scene directory.
@@ -234,14 +265,20 @@ public:
         if (m_filterType != EEWA)
             m_maxAnisotropy = 1.0f;
 
+        m_tiled = props.getBoolean("tiled", false);
+        m_compressed = props.getBoolean("compressed", false);
+        if (props.hasProperty("tileCacheSize"))
+            TextureTileCache::getInstance()->setMemoryBudget(
+                (size_t) props.getInteger("tileCacheSize") * 1024 * 1024);
+
         if (tryReuseCache && MIPMap3::validateCacheFile(cacheFile, timestamp,
-                Bitmap::ERGB, m_wrapModeU, m_wrapModeV, m_filterType, m_gamma)) {
+                Bitmap::ERGB, m_wrapModeU, m_wrapModeV, m_filterType, m_gamma, m_compressed)) {
             /* Reuse an existing MIP map cache file */
-            m_mipmap3 = new MIPMap3(cacheFile, m_maxAnisotropy);
+            m_mipmap3 = new MIPMap3(cacheFile, m_maxAnisotropy, m_tiled);
         } else if (tryReuseCache && MIPMap1::validateCacheFile(cacheFile, timestamp,
-                Bitmap::ELuminance, m_wrapModeU, m_wrapModeV, m_filterType, m_gamma)) {
+                Bitmap::ELuminance, m_wrapModeU, m_wrapModeV, m_filterType, m_gamma, m_compressed)) {
             /* Reuse an existing MIP map cache file */
-            m_mipmap1 = new MIPMap1(cacheFile, m_maxAnisotropy);
+            m_mipmap1 = new MIPMap1(cacheFile, m_maxAnisotropy, m_tiled);
         } else {
             if (bitmap == NULL) {
                 /* Load the input image if necessary */
@@ -293,11 +330,48 @@ public:
             if (pixelFormat == Bitmap::ELuminance)
                 m_mipmap1 = new MIPMap1(bitmap, pixelFormat, Bitmap::EFloat,
                     rfilter, m_wrapModeU, m_wrapModeV, m_filterType, m_maxAnisotropy,
-                    createCache ? cacheFile : fs::path(), timestamp);
+                    createCache ? cacheFile : fs::path(), timestamp, 1.0f,
+                    Spectrum::EReflectance, m_compressed);
             else
                 m_mipmap3 = new MIPMap3(bitmap, pixelFormat, Bitmap::EFloat,
                     rfilter, m_wrapModeU, m_wrapModeV, m_filterType, m_maxAnisotropy,
-                    createCache ? cacheFile : fs::path(), timestamp);
+                    createCache ? cacheFile : fs::path(), timestamp, 1.0f,
+                    Spectrum::EReflectance, m_compressed);
+
+            if (m_tiled && createCache)
+                reopenTiled(cacheFile, timestamp, pixelFormat);
+        }
+    }
+
+    /**
+     * \brief Release the freshly generated MIP map and reopen
+     * its cache file in tiled mode
+     */
+    void reopenTiled(const fs::path &cacheFile, uint64_t timestamp,
+            Bitmap::EPixelFormat pixelFormat) {
+        if (m_mipmap1.get() && MIPMap1::validateCacheFile(cacheFile, timestamp,
+                pixelFormat, m_wrapModeU, m_wrapModeV, m_filterType, m_gamma,
+                m_compressed)) {
+            m_mipmap1 = NULL;
+            m_mipmap1 = new MIPMap1(cacheFile, m_maxAnisotropy, true);
+        } else if (m_mipmap3.get() && MIPMap3::validateCacheFile(cacheFile, timestamp,
+                pixelFormat, m_wrapModeU, m_wrapModeV, m_filterType, m_gamma,
+                m_compressed)) {
+            m_mipmap3 = NULL;
+            m_mipmap3 = new MIPMap3(cacheFile, m_maxAnisotropy, true);
+        } else {
+            Log(EWarn, "Unable to reopen the MIP map cache file \"%s\" in tiled "
+                "mode -- keeping the texture in memory.", cacheFile.string().c_str());
+        }
+    }
+
+    virtual ~BitmapTexture() {
+        if (!m_tempCacheFile.empty()) {
+            /* Close the cache file before removing it */
+            m_mipmap1 = NULL;
+            m_mipmap3 = NULL;
+            boost::system::error_code ec;
+            fs::remove(m_tempCacheFile, ec);
         }
     }
 
@@ -347,12 +421,13 @@ public:
         m_wrapModeV = (ReconstructionFilter::EBoundaryCondition) stream->readUInt();
         m_gamma = stream->readFloat();
         m_maxAnisotropy = stream->readFloat();
+        m_compressed = stream->readBool();
+        m_tiled = stream->readBool();
         m_channel = stream->readString();
 
+        /* Decode the embedded image in place if possible */
         size_t size = stream->readSize();
-        ref<MemoryStream> mStream = new MemoryStream(size);
-        stream->copyTo(mStream, size);
-        mStream->seek(0);
+        ref<MemoryStream> mStream = MemoryStream::readView(stream, size);
         ref<Bitmap> bitmap = new Bitmap(Bitmap::EAuto, mStream);
         if (m_gamma != 0)
             bitmap->setGamma(m_gamma);
@@ -388,14 +463,23 @@ public:
             }
         }
 
+        /* A tiled texture is kept out of core on this machine as well,
+           using a temporary cache file that is removed with the texture */
+        if (m_tiled)
+            m_tempCacheFile = fs::temp_directory_path()
+                / fs::unique_path("mitsuba_%%%%%%%%%%%%.mip");
+
         if (pixelFormat == Bitmap::ELuminance)
             m_mipmap1 = new MIPMap1(bitmap, pixelFormat, Bitmap::EFloat,
                 rfilter, m_wrapModeU, m_wrapModeV, m_filterType, m_maxAnisotropy,
-                fs::path(), 0);
+                m_tempCacheFile, 0, 1.0f, Spectrum::EReflectance, m_compressed);
         else
             m_mipmap3 = new MIPMap3(bitmap, pixelFormat, Bitmap::EFloat,
                 rfilter, m_wrapModeU, m_wrapModeV, m_filterType, m_maxAnisotropy,
-                fs::path(), 0);
+                m_tempCacheFile, 0, 1.0f, Spectrum::EReflectance, m_compressed);
+
+        if (m_tiled)
+            reopenTiled(m_tempCacheFile, 0, pixelFormat);
     }
 
     void serialize(Stream *stream, InstanceManager *manager) const {
@@ -406,6 +490,8 @@ public:
         stream->writeUInt(m_wrapModeV);
         stream->writeFloat(m_gamma);
         stream->writeFloat(m_maxAnisotropy);
+        stream->writeBool(m_compressed);
+        stream->writeBool(m_tiled);
 
         if (!m_filename.empty() && fs::exists(m_filename)) {
             /* We still have access to the original image -- use that, since
@@ -429,6 +515,7 @@ public:
     }
 
     Spectrum eval(const Point2 &uv) const {
+        MTS_PROFILE_SCOPE(EProfilerTextureEval);
         /* There are no ray differentials to do any kind of
            prefiltering. Evaluate the full-resolution texture */
 
@@ -484,6 +571,7 @@ public:
     }
 
     Spectrum eval(const Point2 &uv, const Vector2 &d0, const Vector2 &d1) const {
+        MTS_PROFILE_SCOPE(EProfilerTextureEval);
         stats::filteredLookups.incrementBase();
         ++stats::filteredLookups;
 
@@ -586,8 +674,9 @@ protected:
     ReconstructionFilter::EBoundaryCondition m_wrapModeU;
     ReconstructionFilter::EBoundaryCondition m_wrapModeV;
     Float m_gamma, m_maxAnisotropy;
+    bool m_compressed, m_tiled;
     std::string m_channel;
-    fs::path m_filename;
+    fs::path m_filename, m_tempCacheFile;
 };
 
 // ================ Hardware shader implementation ================
@@ -0,0 +1,462 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/util.h>
+#include <mitsuba/render/renderjob.h>
+#include <mitsuba/core/fresolver.h>
+#include <mitsuba/core/plugin.h>
+#include <mitsuba/core/statistics.h>
+#include <mitsuba/core/version.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <iomanip>
+#if defined(WIN32)
+#include <mitsuba/core/getopt.h>
+#endif
+
+MTS_NAMESPACE_BEGIN
+
+class Bench : public Utility {
+public:
+    /// Outcome of rendering one scene with a certain number of workers
+    struct Result {
+        std::string scene;
+        size_t threads, sampleCount;
+        Float renderTime;
+        Float samplesPerSecond;
+        Float raysPerSecond;
+        Float speedup;      ///< Relative to the first thread count
+        size_t baseThreads; ///< First thread count (the speedup baseline)
+        Float rmse; ///< Negative if no reference is available
+    };
+
+    void help() {
+        cout << endl;
+        cout << "Synopsis: Rendering benchmark. Renders a set of reference scenes with a fixed" << endl;
+        cout << "seed using different numbers of worker threads and reports the achieved" << endl;
+        cout << "number of samples and rays per second, the parallel speedup, and the RMSE" << endl;
+        cout << "with respect to stored reference images. The main intent of this utility" << endl;
+        cout << "is to compare builds and to detect performance and scaling regressions." << endl;
+        cout << endl;
+        cout << "Usage: mtsutil bench [options] [Scene XML files or directories]" << endl;
+        cout << "Options/Arguments:" << endl;
+        cout << "   -h             Display this help text" << endl << endl;
+        cout << "   -t list        Comma-separated list of worker thread counts" << endl;
+        cout << "                  (default: powers of two up to the number of cores)." << endl;
+        cout << "                  The speedup is reported relative to the first count" << endl << endl;
+        cout << "   -s count       Override the number of samples per pixel ($spp)" << endl << endl;
+        cout << "   -n runs        Render every configuration several times and report" << endl;
+        cout << "                  the fastest run (default: 1)" << endl << endl;
+        cout << "   -o file        Append the results as JSON lines to a file" << endl << endl;
+        cout << "   -g             Generate the reference images instead of benchmarking" << endl;
+        cout << "                  (uses all cores and 1024 samples per pixel unless" << endl;
+        cout << "                  specified otherwise using -s)" << endl << endl;
+        cout << "When no scenes are given, all scenes in \"data/bench\" are rendered. The" << endl;
+        cout << "reference image of \"name.xml\" is expected in \"references/name.exr\" next" << endl;
+        cout << "to the scene file. Rendered images are written to the current directory." << endl;
+        cout << endl;
+        cout << "Examples:" << endl;
+        cout << "  $ mtsutil bench -g" << endl;
+        cout << "  $ mtsutil bench -t 1,4,16 -n 3 -o results.jsonl" << endl;
+        cout << "  $ mtsutil bench -s 16 data/bench/volumes.xml" << endl << endl;
+    }
+
+    /**
+     * \brief Replace the local workers of the scheduler by
+     * \c count new ones (remote workers are left untouched)
+     */
+    void setLocalWorkerCount(size_t count) {
+        Scheduler *sched = Scheduler::getInstance();
+        if (sched->getLocalWorkerCount() == count)
+            return;
+
+        sched->pause();
+        for (int i=(int) sched->getWorkerCount()-1; i>=0; --i) {
+            Worker *worker = sched->getWorker(i);
+            if (!worker->isRemoteWorker())
+                sched->unregisterWorker(worker);
+        }
+
+        /* Same policy as mtsutil: only pin workers when all cores are used */
+        bool useCoreAffinity = count == (size_t) getCoreCount();
+        for (size_t i=0; i<count; ++i)
+            sched->registerWorker(new LocalWorker(useCoreAffinity ? (int) i : -1,
+                formatString("wrk%i", (int) i)));
+        sched->start();
+    }
+
+    /**
+     * \brief Render a scene using the currently registered workers
+     *
+     * Only the rendering step is timed, i.e. the kd-tree construction
+     * and integrator preprocessing are excluded. Returns the developed
+     * image, or \c NULL if the rendering did not complete.
+     */
+    ref<Bitmap> render(Scene *scene, Float &renderTime) {
+        Scheduler *sched = Scheduler::getInstance();
+        ref<RenderQueue> queue = new RenderQueue();
+
+        /* Register the resources with the scheduler. Every worker gets its
+           own sampler instance, which is created for the current core count */
+        int sceneResID = sched->registerResource(scene);
+        int sensorResID = sched->registerResource(scene->getSensor());
+        std::vector<SerializableObject *> samplers(sched->getCoreCount());
+        for (size_t i=0; i<sched->getCoreCount(); ++i) {
+            ref<Sampler> clonedSampler = scene->getSampler()->clone();
+            clonedSampler->incRef();
+            samplers[i] = clonedSampler.get();
+        }
+        int samplerResID = sched->registerMultiResource(samplers);
+        for (size_t i=0; i<sched->getCoreCount(); ++i)
+            samplers[i]->decRef();
+
+        ref<RenderJob> job = new RenderJob("bench", scene, queue,
+            sceneResID, sensorResID, samplerResID);
+        Film *film = scene->getFilm();
+        film->setDestinationFile(scene->getDestinationFile(), scene->getBlockSize());
+
+        bool success = scene->preprocess(queue, job, sceneResID, sensorResID, samplerResID);
+
+        /* Only count the rays traced while rendering */
+        Statistics::getInstance()->resetAll();
+
+        ref<Timer> timer = new Timer();
+        if (success)
+            success = scene->render(queue, job, sceneResID, sensorResID, samplerResID);
+        renderTime = timer->getSeconds();
+
+        if (success)
+            scene->postprocess(queue, job, sceneResID, sensorResID, samplerResID);
+        queue->removeJob(job, !success);
+
+        /* The job was not run as a separate thread, hence there is nothing
+           to join -- release the reference held by the queue right away */
+        job->decRef();
+
+        sched->unregisterResource(samplerResID);
+        sched->unregisterResource(sensorResID);
+        sched->unregisterResource(sceneResID);
+
+        if (!success)
+            return NULL;
+
+        ref<Bitmap> bitmap = new Bitmap(Bitmap::ERGB, Bitmap::EFloat32,
+            film->getCropSize());
+        film->develop(Point2i(0), film->getCropSize(), Point2i(0), bitmap);
+        return bitmap;
+    }
+
+    /// Compute the root-mean-square error over all pixels and channels
+    Float computeRMSE(const Bitmap *image, const Bitmap *reference) {
+        if (image->getSize() != reference->getSize()) {
+            Log(EWarn, "The reference image has a different resolution (%s vs. %s)!",
+                reference->getSize().toString().c_str(), image->getSize().toString().c_str());
+            return -1;
+        }
+
+        const float *data1 = image->getFloat32Data(),
+                    *data2 = reference->getFloat32Data();
+        size_t count = image->getPixelCount() * image->getChannelCount();
+        double sum = 0;
+        for (size_t i=0; i<count; ++i) {
+            double diff = (double) data1[i] - (double) data2[i];
+            sum += diff * diff;
+        }
+        return (Float) std::sqrt(sum / count);
+    }
+
+    /// Collect the scenes referenced on the command line
+    std::vector<fs::path> findScenes(int argc, char **argv) {
+        FileResolver *fileResolver = Thread::getThread()->getFileResolver();
+        std::vector<fs::path> args, scenes;
+        for (int i=optind; i<argc; ++i)
+            args.push_back(fileResolver->resolve(argv[i]));
+        if (args.empty())
+            args.push_back(fileResolver->resolve("data/bench"));
+
+        for (size_t i=0; i<args.size(); ++i) {
+            if (fs::is_directory(args[i])) {
+                std::vector<fs::path> entries;
+                fs::directory_iterator end, it(args[i]);
+                for (; it != end; ++it) {
+                    if (fs::is_regular_file(*it) &&
+                        boost::to_lower_copy(it->path().extension().string()) == ".xml")
+                        entries.push_back(it->path());
+                }
+                std::sort(entries.begin(), entries.end());
+                scenes.insert(scenes.end(), entries.begin(), entries.end());
+            } else if (fs::exists(args[i])) {
+                scenes.push_back(args[i]);
+            } else {
+                Log(EError, "Scene \"%s\" does not exist!", args[i].string().c_str());
+            }
+        }
+        if (scenes.empty())
+            Log(EError, "No scenes found!");
+        return scenes;
+    }
+
+    int run(int argc, char **argv) {
+        ref<FileResolver> fileResolver = Thread::getThread()->getFileResolver();
+        Scheduler *sched = Scheduler::getInstance();
+        std::vector<size_t> threadCounts;
+        std::string outputFile;
+        size_t sampleCount = 0, runs = 1;
+        bool generateReferences = false;
+        int optchar;
+        char *end_ptr = NULL;
+        optind = 1;
+
+        /* Parse command-line arguments */
+        while ((optchar = getopt(argc, argv, "t:s:n:o:gh")) != -1) {
+            switch (optchar) {
+                case 'h': {
+                        help();
+                        return 0;
+                    }
+                    break;
+                case 't': {
+                        std::vector<std::string> tokens = tokenize(optarg, ",");
+                        for (size_t i=0; i<tokens.size(); ++i) {
+                            long count = strtol(tokens[i].c_str(), &end_ptr, 10);
+                            if (*end_ptr != '\0' || count <= 0)
+                                Log(EError, "Could not parse the thread counts!");
+                            threadCounts.push_back((size_t) count);
+                        }
+                    }
+                    break;
+                case 's':
+                    sampleCount = (size_t) strtol(optarg, &end_ptr, 10);
+                    if (*end_ptr != '\0' || sampleCount == 0)
+                        Log(EError, "Could not parse the sample count!");
+                    break;
+                case 'n':
+                    runs = (size_t) strtol(optarg, &end_ptr, 10);
+                    if (*end_ptr != '\0' || runs == 0)
+                        Log(EError, "Could not parse the number of runs!");
+                    break;
+                case 'o':
+                    outputFile = optarg;
+                    break;
+                case 'g':
+                    generateReferences = true;
+                    break;
+            };
+        }
+
+        if (sched->hasRemoteWorkers())
+            Log(EWarn, "Remote workers are registered -- the results will not be "
+                "comparable to purely local runs!");
+
+        size_t localWorkers = sched->getLocalWorkerCount();
+        if (generateReferences) {
+            threadCounts.assign(1, localWorkers);
+            if (sampleCount == 0)
+                sampleCount = 1024;
+        } else if (threadCounts.empty()) {
+            for (size_t count = 1; count < localWorkers; count *= 2)
+                threadCounts.push_back(count);
+            threadCounts.push_back(localWorkers);
+        }
+
+        std::vector<fs::path> scenes = findScenes(argc, argv);
+        std::vector<Result> results;
+
+        for (size_t i=0; i<scenes.size(); ++i) {
+            fs::path
+                filename = fs::absolute(scenes[i]),
+                filePath = filename.parent_path(),
+                baseName = filename.stem(),
+                referenceFile = filePath / "references" / (baseName.string() + ".exr");
+
+            /* Resolve relative paths within the scene with respect to its directory */
+            ref<FileResolver> frClone = fileResolver->clone();
+            frClone->prependPath(filePath);
+            Thread::getThread()->setFileResolver(frClone);
+
+            ParameterMap params;
+            if (sampleCount != 0)
+                params["spp"] = formatString(SIZE_T_FMT, sampleCount);
+
+            Log(EInfo, "Loading benchmark scene \"%s\" ..", baseName.string().c_str());
+            ref<Scene> scene = loadScene(filename, params);
+            scene->setSourceFile(filename);
+            scene->setDestinationFile(generateReferences ?
+                referenceFile.parent_path() / baseName : fs::path(baseName));
+            if (generateReferences && !fs::exists(referenceFile.parent_path()))
+                fs::create_directory(referenceFile.parent_path());
+
+            /* Use a sampler that is seeded per pixel, so that the image
+               does not depend on the number of workers or the scheduling */
+            if (scene->getSampler()->getClass()->getName() != "DeterministicSampler") {
+                Properties samplerProps("deterministic");
+                samplerProps.setSize("sampleCount", scene->getSampler()->getSampleCount());
+                Log(EInfo, "Replacing the sampler of \"%s\" by a deterministic sampler",
+                    baseName.string().c_str());
+                scene->setSampler(static_cast<Sampler *>(PluginManager::getInstance()->
+                    createObject(MTS_CLASS(Sampler), samplerProps)));
+            }
+
+            ref<Bitmap> reference;
+            if (!generateReferences && fs::exists(referenceFile)) {
+                reference = new Bitmap(referenceFile);
+                reference = reference->convert(Bitmap::ERGB, Bitmap::EFloat32);
+            } else if (!generateReferences) {
+                Log(EWarn, "No reference image found for \"%s\" (run \"mtsutil bench -g\" "
+                    "to create one)", baseName.string().c_str());
+            }
+
+            const Vector2i size = scene->getFilm()->getCropSize();
+            size_t spp = scene->getSampler()->getSampleCount();
+            /* The speedup is measured relative to the first thread count
+               instead of extrapolating a single-threaded time */
+            Float baseTime = 0;
+
+            for (size_t j=0; j<threadCounts.size(); ++j) {
+                setLocalWorkerCount(threadCounts[j]);
+
+                Result result;
+                result.scene = baseName.string();
+                result.threads = threadCounts[j];
+                result.sampleCount = spp;
+                result.renderTime = std::numeric_limits<Float>::infinity();
+                result.rmse = -1;
+                uint64_t rayCount = 0;
+                ref<Bitmap> image;
+
+                for (size_t k=0; k<runs; ++k) {
+                    Float renderTime = 0;
+                    ref<Bitmap> bitmap = render(scene, renderTime);
+                    if (!bitmap)
+                        Log(EError, "Rendering of \"%s\" did not complete!",
+                            baseName.string().c_str());
+
+                    if (renderTime < result.renderTime) {
+                        Statistics *statistics = Statistics::getInstance();
+                        const StatsCounter
+                            *normalRays = statistics->getCounter("General", "Normal rays traced"),
+                            *shadowRays = statistics->getCounter("General", "Shadow rays traced");
+                        rayCount = (normalRays ? normalRays->getValue() : 0)
+                                 + (shadowRays ? shadowRays->getValue() : 0);
+                        result.renderTime = renderTime;
+                        image = bitmap;
+                    }
+                }
+
+                Float time = std::max(result.renderTime, (Float) 1e-6f);
+                result.samplesPerSecond = (Float) size.x * size.y * spp / time;
+                result.raysPerSecond = rayCount / time;
+                if (j == 0)
+                    baseTime = time;
+                result.speedup = baseTime / time;
+                result.baseThreads = threadCounts[0];
+                if (reference)
+                    result.rmse = computeRMSE(image, reference);
+
+                Log(EInfo, "%s, %i threads: %s, %.2f Msamples/s, %.2f Mrays/s",
+                    result.scene.c_str(), (int) result.threads,
+                    timeString(result.renderTime, true).c_str(),
+                    result.samplesPerSecond * 1e-6f, result.raysPerSecond * 1e-6f);
+                results.push_back(result);
+            }
+
+            if (generateReferences)
+                Log(EInfo, "Wrote reference image \"%s\"", referenceFile.string().c_str());
+
+            Thread::getThread()->setFileResolver(fileResolver);
+        }
+
+        setLocalWorkerCount(localWorkers);
+
+        if (!generateReferences)
+            printResults(results);
+
+        if (!outputFile.empty())
+            writeResults(outputFile, results);
+
+        return 0;
+    }
+
+    /// Print a summary table of all results
+    void printResults(const std::vector<Result> &results) {
+        if (results.empty())
+            return;
+        std::string speedupLabel = formatString("Speedup/%i", (int) results[0].baseThreads);
+        std::ostringstream oss;
+        oss << endl << std::left << std::setw(20) << "Scene"
+            << std::right << std::setw(8) << "Threads"
+            << std::setw(12) << "Time"
+            << std::setw(13) << "Msamples/s"
+            << std::setw(11) << "Mrays/s"
+            << std::setw(14) << speedupLabel
+            << std::setw(12) << "RMSE" << endl;
+        oss << std::string(90, '-') << endl;
+        for (size_t i=0; i<results.size(); ++i) {
+            const Result &r = results[i];
+            oss << std::left << std::setw(20) << r.scene << std::right
+                << std::setw(8) << r.threads
+                << std::setw(12) << timeString(r.renderTime, true)
+                << std::fixed << std::setprecision(3)
+                << std::setw(13) << r.samplesPerSecond * 1e-6f
+                << std::setw(11) << r.raysPerSecond * 1e-6f
+                << std::setprecision(2)
+                << std::setw(14) << r.speedup;
+            if (r.rmse >= 0)
+                oss << std::setw(12) << std::setprecision(5) << r.rmse;
+            else
+                oss << std::setw(12) << "n/a";
+            oss << endl;
+        }
+        cout << oss.str() << endl;
+    }
+
+    /// Append the results to a file (one JSON object per line)
+    void writeResults(const fs::path &path, const std::vector<Result> &results) {
+        fs::ofstream os(path, std::ios::out | std::ios::app);
+        if (!os.good())
+            Log(EError, "Could not open \"%s\" for writing!", path.string().c_str());
+
+        std::string host = jsonString(getHostName());
+        for (size_t i=0; i<results.size(); ++i) {
+            const Result &r = results[i];
+            os << "{\"type\": \"bench\", \"version\": \"" << MTS_VERSION << "\""
+               << ", \"host\": " << host
+               << ", \"scene\": " << jsonString(r.scene)
+               << ", \"threads\": " << r.threads
+               << ", \"sampleCount\": " << r.sampleCount
+               << ", \"renderTime\": " << r.renderTime
+               << ", \"samplesPerSecond\": " << r.samplesPerSecond
+               << ", \"raysPerSecond\": " << r.raysPerSecond
+               << ", \"speedup\": " << r.speedup
+               << ", \"speedupBaseThreads\": " << r.baseThreads
+               << ", \"rmse\": ";
+            if (r.rmse >= 0)
+                os << r.rmse;
+            else
+                os << "null";
+            os << "}" << endl;
+        }
+        Log(EInfo, "Appended %i results to \"%s\"", (int) results.size(),
+            path.string().c_str());
+    }
+
+    MTS_DECLARE_UTILITY()
+};
+
+MTS_EXPORT_UTILITY(Bench, "Rendering benchmark suite")
+MTS_NAMESPACE_END
@@ -13,8 +13,10 @@
 #include <mitsuba/core/sshstream.h>
 #include <mitsuba/core/shvector.h>
 #include <mitsuba/core/statistics.h>
+#include <mitsuba/core/profiler.h>
 #include <mitsuba/render/renderjob.h>
 #include <mitsuba/render/scenehandler.h>
+#include <mitsuba/render/telemetry.h>
 #include <fstream>
 #include <stdexcept>
 #include <boost/algorithm/string.hpp>
@@ -112,6 +114,8 @@ public:
         // write output image
         renderQueue->flush();
 
+        // record the counters before they are reset
+        m_telemetry->write(m_renderJob, false);
         Statistics::getInstance()->printStats();
         Statistics::getInstance()->resetAll();
 
@@ -123,6 +127,9 @@ public:
         runPreprocess();
 
         ref<Timer> renderPixelTimer = new Timer();
+#if defined(MTS_ENABLE_PROFILER)
+        Profiler::getInstance()->reset();
+#endif
 
         // basic render process copied from render/integrator.cpp
         const Point2i pixel(x, y);
@@ -149,6 +156,7 @@ public:
         // work with provided data API interface for mitsuba
         DataApiMitsuba *dataApiMitsuba = DataApiMitsuba::getInstance();
         for (uint32_t sampleIdx = 0; sampleIdx < sampleCount; sampleIdx++) {
+            MTS_PROFILE_SCOPE(EProfilerRender);
             dataApiMitsuba->setPathIdx(sampleIdx);
             rRec.newQuery(queryType, sensor->getMedium());
             Point2 samplePos(Point2(pixel) + Vector2(rRec.nextSample2D()));
@@ -170,6 +178,9 @@ public:
 
         Float duration = renderPixelTimer->stop();
         SLog(EInfo, "renderPixel() took %s", timeString(duration, true).c_str());
+#if defined(MTS_ENABLE_PROFILER)
+        Profiler::getInstance()->printReport();
+#endif
     }
 
     std::string getRendererName() const override {
@@ -361,6 +372,8 @@ private:
             setSampleCount(m_scene->getSampler()->getSampleCount());
 
             renderQueue = new RenderQueue();
+            m_telemetry = new RenderTelemetry();
+            renderQueue->registerListener(m_telemetry);
             m_renderJob = new RenderJob(formatString("ren%i", 0), m_scene, renderQueue, m_sceneResID, m_sensorResID, m_samplerResID);
         } catch (const std::exception &e) {
             std::cerr << "Caught a critical exception: " << e.what() << endl;
@@ -381,6 +394,7 @@ private:
     int m_sensorResID {-1};
     int m_samplerResID {-1};
     ref<RenderJob> m_renderJob;
+    ref<RenderTelemetry> m_telemetry;
 
     bool m_preprocessed {false};
 };